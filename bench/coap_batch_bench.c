@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "coap.h"
+
+/* Encoding a burst of responses for sendmmsg(), as after a recvmmsg() of BURST requests.
+ * separate: coap_build() of every response into its own datagram buffer, then the mmsghdr array is filled
+ * batch:    coap_build_batch() into one arena, then the mmsghdr array is filled from the offsets
+ * Both are checked to produce the same bytes.
+ */
+
+#define ROUNDS 200000
+#define BURST 64
+#define DATAGRAM 1280
+
+static coap_packet_t responses[BURST];
+static uint8_t buffers[BURST][DATAGRAM];
+static uint8_t arena[BURST * DATAGRAM];
+static coap_batch_msg_t msgs[BURST];
+static struct iovec iov[BURST];
+static struct mmsghdr mmsg[BURST];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void make_responses(uint8_t *payload)
+{
+    static const uint8_t token[4] = {0xCA, 0xFE, 0x00, 0x01};
+    int i;
+
+    for (i = 0; i < BURST; i++)
+    {
+        memset(&responses[i], 0, sizeof(responses[i]));
+        coap_header_init(&responses[i], COAP_TYPE_ACK, COAP_CONTENT, (uint16_t)i);
+        coap_header_add_token(&responses[i], token, sizeof(token));
+        coap_add_option_uint(&responses[i], COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_JSON);
+        responses[i].payload.p = payload;
+        responses[i].payload.len = 24 + i % 16;
+    }
+}
+
+static size_t gather(size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        mmsg[i].msg_hdr.msg_iov = &iov[i];
+        mmsg[i].msg_hdr.msg_iovlen = 1;
+    }
+    return count;
+}
+
+static size_t build_separate(void)
+{
+    size_t i, j = 0, len;
+
+    for (i = 0; i < BURST; i++)
+    {
+        len = DATAGRAM;
+        if (COAP_ERR_NONE != coap_build(buffers[i], &len, &responses[i]))
+            continue;
+        iov[j].iov_base = buffers[i];
+        iov[j].iov_len = len;
+        j++;
+    }
+    return gather(j);
+}
+
+static size_t build_batch(void)
+{
+    size_t i, j = 0;
+
+    coap_build_batch(arena, sizeof(arena), responses, BURST, msgs);
+    for (i = 0; i < BURST; i++)
+    {
+        if (COAP_ERR_NONE != msgs[i].err)
+            continue;
+        iov[j].iov_base = arena + msgs[i].offset;
+        iov[j].iov_len = msgs[i].len;
+        j++;
+    }
+    return gather(j);
+}
+
+static double run(size_t (*build)(void), size_t *bytes)
+{
+    uint64_t start;
+    size_t sent = 0, i;
+    int r;
+
+    start = now_ns();
+    for (r = 0; r < ROUNDS; r++)
+    {
+        sent += build();
+        // a byte of every datagram, as the kernel copies them
+        for (i = 0; i < BURST; i++)
+            *bytes += ((const uint8_t *)iov[i].iov_base)[iov[i].iov_len - 1];
+    }
+    return (double)(now_ns() - start) / (double)sent;
+}
+
+int main(void)
+{
+    uint8_t payload[40];
+    size_t bytes = 0, i, arena_used;
+    double separate, batch;
+
+    memset(payload, '7', sizeof(payload));
+    make_responses(payload);
+
+    build_separate();
+    build_batch();
+    for (i = 0; i < BURST; i++)
+    {
+        if (0 != memcmp(buffers[i], arena + msgs[i].offset, msgs[i].len))
+        {
+            printf("batch differs at message %zu\n", i);
+            return 1;
+        }
+    }
+    arena_used = msgs[BURST - 1].offset + msgs[BURST - 1].len;
+
+    separate = run(build_separate, &bytes);
+    batch = run(build_batch, &bytes);
+    printf("burst of %d responses, %zu bytes in the arena, %zu bytes of separate buffers\n", BURST, arena_used, sizeof(buffers));
+    printf("separate %7.1f ns/msg\n", separate);
+    printf("batch    %7.1f ns/msg  %.2fx\n", batch, separate / batch);
+    return (int)(bytes & 0);
+}
@@ -0,0 +1,124 @@
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "coap_client.hpp"
+#include "coap_server.h"
+
+/* Loopback between the coroutine client (coap_client.hpp) and the request pipeline (coap_server.h).
+ * 100k coroutines keep one NON GET in flight each and issue ROUNDS requests one after another, so there are 100k
+ * concurrent requests at any time. Reports requests per second and heap allocations after the coroutines started.
+ */
+
+#define IN_FLIGHT 100000
+#define ROUNDS 10
+#define MAX_DATAGRAM 64
+
+static unsigned long allocations;
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+struct datagram
+{
+    std::array<uint8_t, MAX_DATAGRAM> buf;
+    size_t len;
+};
+
+static std::vector<datagram> to_server;
+static std::vector<datagram> to_client;
+static unsigned long completed, failed;
+
+static void send_to_server(void *, coap::bytes data)
+{
+    datagram d;
+    std::copy(data.begin(), data.end(), d.buf.begin());
+    d.len = data.size();
+    to_server.push_back(d);
+}
+
+static int handle_get_x(coap_arena_t *, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    static const uint8_t ok[] = {'o', 'k'};
+    return coap_make_response(outpkt, ok, sizeof(ok), ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_TEXT_PLAIN);
+}
+
+static const coap_endpoint_path_t path_x = {1, {"x"}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get_x, &path_x, NULL, NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static coap::task worker(coap::client &c)
+{
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        coap::reply rsp = co_await c.get("coap://[::1]/x");
+        if (rsp && rsp.view().payload().size() == 2)
+            completed++;
+        else
+            failed++;
+    }
+}
+
+int main()
+{
+    static uint8_t arena_memory[2048];
+    coap_server_t server;
+    coap::client::config cfg;
+    cfg.type = COAP_TYPE_NONCON;
+    cfg.capacity = IN_FLIGHT;
+    cfg.timeout = UINT32_MAX / 2;
+
+    to_server.reserve(IN_FLIGHT);
+    to_client.reserve(IN_FLIGHT);
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    coap::client client(send_to_server, nullptr, cfg);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < IN_FLIGHT; i++)
+        worker(client);
+    unsigned long before = allocations;
+    size_t peak = client.in_flight();
+
+    while (!to_server.empty())
+    {
+        for (const datagram &req : to_server)
+        {
+            datagram rsp;
+            rsp.len = sizeof(rsp.buf);
+            if (COAP_ERR_NONE == coap_server_handle(&server, req.buf.data(), req.len, rsp.buf.data(), &rsp.len) && rsp.len > 0)
+                to_client.push_back(rsp);
+        }
+        to_server.clear();
+        for (const datagram &rsp : to_client)
+            client.receive(coap::bytes(rsp.buf.data(), rsp.len));
+        to_client.clear();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("in flight:   %zu\n", peak);
+    std::printf("requests:    %lu (%lu failed)\n", completed + failed, failed);
+    std::printf("throughput:  %.0f requests/s\n", (completed + failed) / elapsed.count());
+    std::printf("per request: %.0f ns (client and server)\n", elapsed.count() * 1e9 / (completed + failed));
+    std::printf("allocations after start: %lu\n", allocations - before);
+    return (0 == failed && completed == (unsigned long)IN_FLIGHT * ROUNDS && allocations == before) ? 0 : 1;
+}
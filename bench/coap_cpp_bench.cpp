@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "coap.hpp"
+
+/* Compares the C++ wrapper (coap.hpp) with the C API it wraps.
+ * build: ACK 2.05 with Observe, Uri-Path, Content-Format, Block2 and payload
+ * parse: parse the same message and read Uri-Path, Content-Format and Block2
+ * Both variants must produce identical bytes, and the wrapper must not allocate.
+ */
+
+#define ITERATIONS 10000000UL
+
+static unsigned long allocations;
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static const uint8_t token[] = {0xCA, 0xFE};
+static const uint8_t hello[] = {'h', 'e', 'l', 'l', 'o'};
+static volatile uint32_t sink;
+
+static size_t build_c(uint8_t *buf, size_t len, uint32_t observe)
+{
+    coap_packet_t pkt;
+    uint8_t block[3];
+    coap_header_init(&pkt, COAP_TYPE_ACK, COAP_CONTENT, 0x1234);
+    coap_header_add_token(&pkt, token, sizeof(token));
+    pkt.numopts = 0;
+    pkt.scratch_len = 0;
+    coap_add_option_uint(&pkt, COAP_OPTION_OBSERVE, observe);
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "sensors");
+    coap_add_option_uint(&pkt, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_CBOR);
+    coap_add_option(&pkt, COAP_OPTION_BLOCK_2, block, coap_make_option_blockwise(block, COAP_BLOCKSIZE_64, true, 1));
+    pkt.payload.p = hello;
+    pkt.payload.len = sizeof(hello);
+    coap_build(buf, &len, &pkt);
+    return len;
+}
+
+static size_t build_cpp(uint8_t *buf, size_t len, uint32_t observe)
+{
+    coap::packet pkt;
+    coap::message(pkt, COAP_TYPE_ACK, COAP_CONTENT, 0x1234, token)
+        .uint<COAP_OPTION_OBSERVE>(observe)
+        .string<COAP_OPTION_URI_PATH>("sensors")
+        .uint<COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_CBOR>()
+        .block<COAP_OPTION_BLOCK_2, COAP_BLOCKSIZE_64, true, 1>()
+        .payload(coap::bytes(hello));
+    auto built = pkt.build(std::span<uint8_t>(buf, len));
+    return built ? built->size() : 0;
+}
+
+static void parse_c(const uint8_t *buf, size_t len)
+{
+    coap_packet_t pkt;
+    uint8_t count;
+    uint32_t cf = 0;
+    const coap_option_t *path, *block;
+    coap_parse(&pkt, buf, len);
+    path = coap_findOptions(&pkt, COAP_OPTION_URI_PATH, &count);
+    coap_option_get_uint(&pkt, COAP_OPTION_CONTENT_FORMAT, &cf);
+    block = coap_findOptions(&pkt, COAP_OPTION_BLOCK_2, &count);
+    sink = (uint32_t)path->buf.len + cf + coap_option_blockwise_get_num(block);
+}
+
+static void parse_cpp(const uint8_t *buf, size_t len)
+{
+    coap::packet pkt;
+    pkt.parse(coap::bytes(buf, len));
+    coap::packet_view v = pkt;
+    sink = (uint32_t)v.string_option(COAP_OPTION_URI_PATH)->size() + v.uint_option(COAP_OPTION_CONTENT_FORMAT).value_or(0)
+        + (v.uint_option(COAP_OPTION_BLOCK_2).value_or(0) >> 4);
+}
+
+template <typename F>
+static double ns_per_op(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < ITERATIONS; i++)
+        f(i);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+int main()
+{
+    uint8_t c_buf[64], cpp_buf[64];
+    size_t c_len = build_c(c_buf, sizeof(c_buf), 7);
+    size_t cpp_len = build_cpp(cpp_buf, sizeof(cpp_buf), 7);
+
+    if (c_len != cpp_len || 0 != std::memcmp(c_buf, cpp_buf, c_len))
+    {
+        std::printf("C and C++ builds differ\n");
+        return 1;
+    }
+
+    unsigned long before = allocations;
+    double build_c_ns = ns_per_op([&](unsigned long i) { sink = (uint32_t)build_c(c_buf, sizeof(c_buf), (uint32_t)i); });
+    double build_cpp_ns = ns_per_op([&](unsigned long i) { sink = (uint32_t)build_cpp(cpp_buf, sizeof(cpp_buf), (uint32_t)i); });
+    c_len = build_c(c_buf, sizeof(c_buf), 7);
+    double parse_c_ns = ns_per_op([&](unsigned long) { parse_c(c_buf, c_len); });
+    double parse_cpp_ns = ns_per_op([&](unsigned long) { parse_cpp(c_buf, c_len); });
+
+    std::printf("%-8s %10s %10s\n", "", "C ns/op", "C++ ns/op");
+    std::printf("%-8s %10.1f %10.1f\n", "build", build_c_ns, build_cpp_ns);
+    std::printf("%-8s %10.1f %10.1f\n", "parse", parse_c_ns, parse_cpp_ns);
+    std::printf("allocations: %lu\n", allocations - before);
+    return (allocations == before) ? 0 : 1;
+}
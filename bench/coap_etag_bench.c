@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "coap_server.h"
+#include "coap_etag.h"
+
+/* Polling an unchanged resource through coap_server_handle(), the handler formats a JSON document of 40 readings.
+ * handler:   no ETag store, every poll runs the handler and encodes the payload
+ * etag miss: with the store, the client has no or a stale ETag, the handler runs and the response gets the ETag
+ * etag hit:  the client's ETag is current, 2.03 without the handler
+ * update:    coap_etag_write() of a 4 byte reading against coap_etag_set() over the whole document
+ */
+
+#define ROUNDS 1000000
+#define READINGS 40
+
+static int32_t readings[READINGS];
+static char document[1024];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t format_document(void)
+{
+    size_t len = 0;
+    int i;
+    document[len++] = '[';
+    for (i = 0; i < READINGS; i++)
+        len += (size_t)snprintf(document + len, sizeof(document) - len, "%s%ld", i ? "," : "", (long)readings[i]);
+    document[len++] = ']';
+    return len;
+}
+
+static int handle_get_sensors(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    (void)arena;
+    return coap_make_response(outpkt, (const uint8_t *)document, format_document(), ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_JSON);
+}
+
+static const coap_endpoint_path_t path_sensors = {1, {"sensors"}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get_sensors, &path_sensors, NULL, NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static double poll_sensors(coap_server_t *server, uint8_t *etag, size_t *rsplen)
+{
+    static const uint8_t token[4] = {1, 2, 3, 4};
+    static uint8_t inbuf[64], outbuf[1200];
+    coap_packet_t req;
+    size_t inlen = sizeof(inbuf), outlen = 0;
+    uint64_t start;
+    int i;
+
+    memset(&req, 0, sizeof(req));
+    coap_header_init(&req, COAP_TYPE_CON, COAP_GET, 1);
+    coap_header_add_token(&req, token, sizeof(token));
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, "sensors");
+    if (NULL != etag)
+        coap_add_option(&req, COAP_OPTION_ETAG, etag, COAP_ETAG_SIZE);
+    coap_build(inbuf, &inlen, &req);
+
+    start = now_ns();
+    for (i = 0; i < ROUNDS; i++)
+    {
+        outlen = sizeof(outbuf);
+        coap_server_handle(server, inbuf, inlen, outbuf, &outlen);
+    }
+    *rsplen = outlen;
+    return (double)(now_ns() - start) / ROUNDS;
+}
+
+int main(void)
+{
+    static uint8_t arena_memory[2048];
+    static coap_etag_resource_t resources[1] = {{&path_sensors, 0}};
+    coap_etag_store_t store = {resources, 1};
+    coap_server_t server;
+    uint8_t current[COAP_ETAG_SIZE], stale[COAP_ETAG_SIZE] = {0};
+    uint64_t start, sum = 0;
+    size_t rsplen;
+    double ns;
+    int i;
+
+    for (i = 0; i < READINGS; i++)
+        readings[i] = 20000 + i * 37;
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    ns = poll_sensors(&server, NULL, &rsplen);
+    printf("handler    %8.1f ns/poll, %zu byte response\n", ns, rsplen);
+
+    server.etags = &store;
+    coap_etag_set(&resources[0], document, format_document());
+    coap_etag_encode(resources[0].etag, current);
+    ns = poll_sensors(&server, stale, &rsplen);
+    printf("etag miss  %8.1f ns/poll, %zu byte response\n", ns, rsplen);
+    ns = poll_sensors(&server, current, &rsplen);
+    printf("etag hit   %8.1f ns/poll, %zu byte response\n", ns, rsplen);
+
+    start = now_ns();
+    for (i = 0; i < ROUNDS; i++)
+    {
+        readings[i % READINGS]++;
+        coap_etag_write(&resources[0], &readings[i % READINGS], sizeof(readings[0]));
+        sum += resources[0].etag;
+    }
+    ns = (double)(now_ns() - start) / ROUNDS;
+    printf("update     %8.1f ns/write incremental, ", ns);
+    start = now_ns();
+    for (i = 0; i < ROUNDS / 100; i++)
+    {
+        readings[i % READINGS]++;
+        coap_etag_set(&resources[0], document, format_document());
+        sum += resources[0].etag;
+    }
+    ns = (double)(now_ns() - start) / (ROUNDS / 100);
+    printf("%.1f ns/write format and rehash (checksum %llu)\n", ns, (unsigned long long)sum);
+    return 0;
+}
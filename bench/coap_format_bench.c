@@ -0,0 +1,114 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "coap_format.h"
+
+/* Rendering parsed messages as log lines with coap_format_packet().
+ * request:  CON GET with token, two Uri-Path, Accept and Block2 options
+ * response: ACK 2.05 with Content-Format, ETag and a 45 byte JSON payload
+ * snprintf: the logfmt line of the request written with snprintf() per field, for comparison
+ * Each figure is the fastest of BATCHES batches, so that other load of the host does not add to it.
+ */
+
+#define BATCHES 20
+#define ROUNDS 100000
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t format_snprintf(char *buf, size_t buflen, const coap_packet_t *pkt)
+{
+    size_t len;
+    uint32_t value;
+    uint8_t i;
+
+    len = (size_t)snprintf(buf, buflen, "type=%s code=%u.%02u id=%u token=0x%02x%02x", "CON", pkt->hdr.code >> 5,
+        pkt->hdr.code & 0x1F, pkt->hdr.id, pkt->tok.p[0], pkt->tok.p[1]);
+    for (i = 0; i < pkt->numopts; i++)
+    {
+        const coap_option_t *opt = &pkt->opts[i];
+        if (COAP_OPTION_URI_PATH == opt->num)
+            len += (size_t)snprintf(buf + len, buflen - len, " %s=%.*s", coap_format_option_name(opt->num), (int)opt->buf.len, (const char *)opt->buf.p);
+        else if (COAP_ERR_NONE == coap_decode_uint(&opt->buf, &value))
+            len += (size_t)snprintf(buf + len, buflen - len, " %s=%u", coap_format_option_name(opt->num), value);
+    }
+    len += (size_t)snprintf(buf + len, buflen - len, " payload_len=%zu", pkt->payload.len);
+    return len;
+}
+
+static double run(const coap_packet_t *pkt, const coap_format_config_t *config, size_t *chars)
+{
+    char buf[512];
+    size_t len;
+    uint64_t start, elapsed, best = UINT64_MAX;
+    int b, r;
+
+    for (b = 0; b < BATCHES; b++)
+    {
+        start = now_ns();
+        for (r = 0; r < ROUNDS; r++)
+        {
+            len = sizeof(buf);
+            if (NULL == config)
+                len = format_snprintf(buf, len, pkt);
+            else
+                coap_format_packet(buf, &len, pkt, config);
+            *chars += len + (size_t)buf[len / 2];
+        }
+        elapsed = now_ns() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return (double)best / ROUNDS;
+}
+
+int main(void)
+{
+    static const uint8_t token[2] = {0x12, 0xAB}, etag[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    static const char payload[] = "{\"temperature\":21.5,\"humidity\":43,\"unit\":\"C\"}";
+    coap_format_config_t json = {COAP_FORMAT_JSON, COAP_FORMAT_VALUES_AUTO, 64, 256};
+    coap_format_config_t logfmt = {COAP_FORMAT_LOGFMT, COAP_FORMAT_VALUES_AUTO, 64, 256};
+    coap_format_config_t hex = {COAP_FORMAT_LOGFMT, COAP_FORMAT_VALUES_HEX, 64, 256};
+    coap_packet_t request, response;
+    uint8_t block[1];
+    char line[512];
+    size_t chars = 0, len = sizeof(line);
+
+    memset(&request, 0, sizeof(request));
+    coap_header_init(&request, COAP_TYPE_CON, COAP_GET, 4660);
+    coap_header_add_token(&request, token, sizeof(token));
+    coap_add_option_string(&request, COAP_OPTION_URI_PATH, "sensors");
+    coap_add_option_string(&request, COAP_OPTION_URI_PATH, "room-12");
+    coap_add_option_uint(&request, COAP_OPTION_ACCEPT, COAP_CONTENTTYPE_APPLICATION_JSON);
+    coap_make_option_blockwise(block, COAP_BLOCKSIZE_64, false, 2);
+    coap_add_option_uint(&request, COAP_OPTION_BLOCK_2, block[0]);
+
+    memset(&response, 0, sizeof(response));
+    coap_header_init(&response, COAP_TYPE_ACK, COAP_CONTENT, 4660);
+    coap_header_add_token(&response, token, sizeof(token));
+    coap_add_option(&response, COAP_OPTION_ETAG, (uint8_t *)etag, sizeof(etag));
+    coap_add_option_uint(&response, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_JSON);
+    response.payload.p = (const uint8_t *)payload;
+    response.payload.len = sizeof(payload) - 1;
+
+    coap_format_packet(line, &len, &response, &json);
+    printf("%.*s\n", (int)len, line);
+    len = sizeof(line);
+    coap_format_packet(line, &len, &request, &logfmt);
+    printf("%.*s\n\n", (int)len, line);
+
+    printf("request  json     %6.1f ns/msg\n", run(&request, &json, &chars));
+    printf("request  logfmt   %6.1f ns/msg\n", run(&request, &logfmt, &chars));
+    printf("request  snprintf %6.1f ns/msg\n", run(&request, NULL, &chars));
+    printf("response json     %6.1f ns/msg\n", run(&response, &json, &chars));
+    printf("response logfmt   %6.1f ns/msg\n", run(&response, &logfmt, &chars));
+    printf("response hex      %6.1f ns/msg\n", run(&response, &hex, &chars));
+    return (int)(chars & 0);
+}
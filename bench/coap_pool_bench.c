@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "coap_pool.h"
+
+/* Contention benchmark of coap_pool_t.
+ * local:   every thread acquires and releases slots on its own (parse and respond on the same thread)
+ * handoff: threads are paired, the receiver acquires a slot and passes it over a ring to the worker, which releases
+ *          it into its own cache. Slots therefore travel back to the receiver through the global freelist.
+ */
+
+#define ITERATIONS 1000000UL
+#define SLOTS_PER_THREAD 64
+#define HANDOFF_RING 256
+
+typedef struct
+{
+    _Atomic size_t head;
+    _Atomic size_t tail;
+    coap_pool_slot_t *slots[HANDOFF_RING];
+} handoff_ring_t;
+
+typedef struct
+{
+    coap_pool_t *pool;
+    handoff_ring_t *ring;
+    int role;   // 0 local, 1 receiver, 2 worker
+} bench_thread_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_thread_t *t = arg;
+    coap_pool_cache_t cache;
+    coap_pool_slot_t *slot;
+    unsigned long i;
+
+    coap_pool_cache_init(&cache, t->pool);
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        if (2 == t->role)
+        {
+            size_t tail = atomic_load_explicit(&t->ring->tail, memory_order_relaxed);
+            while (atomic_load_explicit(&t->ring->head, memory_order_acquire) == tail)
+                sched_yield();
+            slot = t->ring->slots[tail % HANDOFF_RING];
+            atomic_store_explicit(&t->ring->tail, tail + 1, memory_order_release);
+            coap_pool_release(&cache, slot);
+            continue;
+        }
+        while (NULL == (slot = coap_pool_acquire(&cache)))
+            sched_yield();
+        slot->buf[0] = (uint8_t)i;
+        if (0 == t->role)
+        {
+            coap_pool_release(&cache, slot);
+        }
+        else
+        {
+            size_t head = atomic_load_explicit(&t->ring->head, memory_order_relaxed);
+            while (head - atomic_load_explicit(&t->ring->tail, memory_order_acquire) == HANDOFF_RING)
+                sched_yield();
+            t->ring->slots[head % HANDOFF_RING] = slot;
+            atomic_store_explicit(&t->ring->head, head + 1, memory_order_release);
+        }
+    }
+    coap_pool_cache_flush(&cache);
+    return NULL;
+}
+
+static void run(const char *name, int threads, bool handoff)
+{
+    uint32_t count = (uint32_t)threads * SLOTS_PER_THREAD + HANDOFF_RING * (uint32_t)threads;
+    coap_pool_slot_t *slots = malloc(sizeof(coap_pool_slot_t) * count);
+    handoff_ring_t *rings = calloc((size_t)threads, sizeof(handoff_ring_t));
+    bench_thread_t *args = calloc((size_t)threads, sizeof(bench_thread_t));
+    pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+    coap_pool_t pool;
+    uint64_t start, elapsed;
+    int i;
+
+    coap_pool_init(&pool, slots, count);
+    for (i = 0; i < threads; i++)
+    {
+        args[i].pool = &pool;
+        args[i].ring = &rings[i / 2];
+        args[i].role = handoff ? 1 + (i & 1) : 0;
+    }
+    start = now_ns();
+    for (i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, bench_thread, &args[i]);
+    for (i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    elapsed = now_ns() - start;
+
+    printf("%-8s threads=%-2d %8.1f ns/op per thread %10.0f ops/s total\n", name, threads,
+           (double)elapsed / ITERATIONS, (double)ITERATIONS * threads / ((double)elapsed / 1e9));
+    free(tids);
+    free(args);
+    free(rings);
+    free(slots);
+}
+
+int main(void)
+{
+    const int threads[] = {1, 4, 16};
+    size_t i;
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        run("local", threads[i], false);
+    for (i = 1; i < sizeof(threads) / sizeof(threads[0]); i++)
+        run("handoff", threads[i], true);
+    return 0;
+}
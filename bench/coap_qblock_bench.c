@@ -0,0 +1,194 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "coap_qblock.h"
+
+/* Upload of a 1 MB body in 1024 byte blocks over a simulated link with 100 ms one way latency.
+ * Times are simulated, so results are the same on every machine.
+ * lock-step: Block1 over CON, one round trip per block, a lost request or ACK costs ACK_TIMEOUT doubling per retry
+ * q-block:   Q-Block1 with coap_qblock.h, 2.31 Continue per payload set and 4.08 for missing blocks
+ * cpu:       cost of sender and receiver per block (add, build, parse, put) without loss
+ */
+
+#define BODY_SIZE (1 << 20)
+#define BLOCK_SIZE 1024
+#define BLOCKS (BODY_SIZE / BLOCK_SIZE)
+#define LATENCY_MS 100
+#define QUEUE_SIZE 256
+
+typedef struct
+{
+    uint8_t buf[BLOCK_SIZE + 64];
+    size_t len;
+    uint32_t at;
+} datagram_t;
+
+typedef struct
+{
+    datagram_t queue[QUEUE_SIZE];
+    uint32_t head;
+    uint32_t count;
+    uint32_t loss_permille;
+    uint32_t random;
+} channel_t;
+
+static channel_t up, down;
+static uint8_t body[BODY_SIZE];
+static uint8_t received[BODY_SIZE];
+static uint32_t bitmap[COAP_QBLOCK_BITMAP_WORDS(BODY_SIZE)];
+static const uint8_t token[4] = {1, 2, 3, 4};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool lost(uint32_t *random, uint32_t loss_permille)
+{
+    *random = *random * 1103515245U + 12345U;
+    return (*random >> 8) % 1000 < loss_permille;
+}
+
+static void channel_send(channel_t *ch, const coap_packet_t *pkt, uint32_t now)
+{
+    datagram_t *d;
+
+    if (lost(&ch->random, ch->loss_permille) || QUEUE_SIZE == ch->count)
+        return;
+    d = &ch->queue[(ch->head + ch->count++) % QUEUE_SIZE];
+    d->len = sizeof(d->buf);
+    coap_build(d->buf, &d->len, pkt);
+    d->at = now + LATENCY_MS;
+}
+
+static bool channel_recv(channel_t *ch, coap_packet_t *pkt, uint32_t now)
+{
+    datagram_t *d = &ch->queue[ch->head];
+
+    if (0 == ch->count || (int32_t)(now - d->at) < 0)
+        return false;
+    ch->head = (ch->head + 1) % QUEUE_SIZE;
+    ch->count--;
+    return 0 == coap_parse(pkt, d->buf, d->len);
+}
+
+// Block1 waits for each ACK, retransmissions follow http://tools.ietf.org/html/rfc7252#section-4.2
+static uint32_t lock_step(uint32_t loss_permille, uint32_t seed)
+{
+    uint32_t now = 0, num, timeout;
+
+    for (num = 0; num < BLOCKS; num++)
+    {
+        for (timeout = 2000; lost(&seed, loss_permille) || lost(&seed, loss_permille); timeout *= 2)
+            now += timeout;
+        now += 2 * LATENCY_MS;
+    }
+    return now;
+}
+
+static uint32_t q_block(uint32_t loss_permille, uint32_t seed)
+{
+    coap_qblock_tx_t tx;
+    coap_qblock_rx_t rx;
+    coap_packet_t pkt, rsp, last;
+    uint8_t option[3], rsp_buf[256], last_token[8], count;
+    uint32_t now, num;
+    uint16_t id = 0;
+
+    memset(&up, 0, sizeof(up));
+    memset(&down, 0, sizeof(down));
+    up.loss_permille = down.loss_permille = loss_permille;
+    up.random = seed;
+    down.random = seed * 7 + 1;
+    memset(&last, 0, sizeof(last));
+    coap_qblock_tx_init(&tx, body, sizeof(body), COAP_BLOCKSIZE_1024, 0);
+    coap_qblock_rx_init(&rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    for (now = 0; now < 3600000; now++)
+    {
+        while (coap_qblock_tx_next(&tx, now, &num))
+        {
+            memset(&pkt, 0, sizeof(pkt));
+            coap_header_init(&pkt, COAP_TYPE_NONCON, COAP_PUT, id++);
+            coap_header_add_token(&pkt, token, sizeof(token));
+            coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "fw");
+            coap_qblock_tx_add(&tx, &pkt, COAP_OPTION_Q_BLOCK_1, num, option);
+            channel_send(&up, &pkt, now);
+        }
+        while (channel_recv(&up, &pkt, now))
+        {
+            coap_qblock_result_t result = coap_qblock_rx_put(&rx, coap_findOptions(&pkt, COAP_OPTION_Q_BLOCK_1, &count), &pkt.payload, now);
+            last = pkt;
+            memcpy(last_token, pkt.tok.p, pkt.tok.len);
+            last.tok.p = last_token;
+            if (COAP_QBLOCK_COMPLETE == result)
+            {
+                coap_make_response(&rsp, NULL, 0, pkt.hdr.id, &pkt.tok, COAP_CHANGED, COAP_CONTENTTYPE_NONE);
+                rsp.hdr.t = COAP_TYPE_NONCON;
+                channel_send(&down, &rsp, now);
+            }
+            else if (COAP_ERR_NONE == coap_qblock_rx_make_response(&rx, result, &pkt, &rsp, rsp_buf, sizeof(rsp_buf)))
+                channel_send(&down, &rsp, now);
+        }
+        if (coap_qblock_rx_timeout(&rx, now) && COAP_ERR_NONE == coap_qblock_rx_make_response(&rx, COAP_QBLOCK_MISSING, &last, &rsp, rsp_buf, sizeof(rsp_buf)))
+            channel_send(&down, &rsp, now);
+        while (channel_recv(&down, &rsp, now))
+        {
+            if (COAP_CONTINUE == rsp.hdr.code)
+                coap_qblock_tx_continue(&tx);
+            else if (COAP_REQUEST_ENTITY_INCOMPLETE == rsp.hdr.code)
+                coap_qblock_tx_missing(&tx, &rsp.payload);
+            else if (COAP_CHANGED == rsp.hdr.code)
+                return memcmp(body, received, sizeof(body)) ? UINT32_MAX : now;
+        }
+    }
+    return UINT32_MAX;
+}
+
+int main(void)
+{
+    static const uint32_t losses[] = {0, 10, 50};
+    coap_qblock_tx_t tx;
+    coap_qblock_rx_t rx;
+    coap_packet_t pkt, parsed;
+    uint8_t option[3], datagram[BLOCK_SIZE + 64], count;
+    uint64_t start;
+    uint32_t num, i, qb;
+    size_t len;
+
+    for (i = 0; i < sizeof(body); i++)
+        body[i] = (uint8_t)(i * 2654435761U >> 24);
+
+    for (i = 0; i < sizeof(losses) / sizeof(losses[0]); i++)
+    {
+        qb = q_block(losses[i], 1);
+        printf("loss %2u.%u%%  lock-step %8.1f s  q-block ", losses[i] / 10, losses[i] % 10, lock_step(losses[i], 1) / 1000.0);
+        if (UINT32_MAX == qb)
+            printf("   failed\n");
+        else
+            printf("%6.1f s\n", qb / 1000.0);
+    }
+
+    coap_qblock_tx_init(&tx, body, sizeof(body), COAP_BLOCKSIZE_1024, 0);
+    coap_qblock_rx_init(&rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    start = now_ns();
+    for (num = 0; num < BLOCKS; num++)
+    {
+        memset(&pkt, 0, sizeof(pkt));
+        coap_header_init(&pkt, COAP_TYPE_NONCON, COAP_PUT, (uint16_t)num);
+        coap_header_add_token(&pkt, token, sizeof(token));
+        coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "fw");
+        coap_qblock_tx_add(&tx, &pkt, COAP_OPTION_Q_BLOCK_1, num, option);
+        len = sizeof(datagram);
+        coap_build(datagram, &len, &pkt);
+        coap_parse(&parsed, datagram, len);
+        coap_qblock_rx_put(&rx, coap_findOptions(&parsed, COAP_OPTION_Q_BLOCK_1, &count), &parsed.payload, 0);
+    }
+    printf("cpu        %8.1f ns/block, complete %d\n", (double)(now_ns() - start) / BLOCKS, coap_qblock_rx_complete(&rx));
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "coap.hpp"
+#include "coap_routes.hpp"
+
+/* Dispatches GET requests over 512 routes /dNN/rNN (32 devices with 16 resources each) with
+ * router:      compile-time table of coap_routes.hpp
+ * trie:        trie built at startup, sorted children per node, searched by segment
+ * handle_req:  linear coap_endpoint_t table of coap_handle_req()
+ * Requests visit all routes in a scattered order. Every variant must call the same handlers.
+ */
+
+#define DEVICES 32
+#define RESOURCES 16
+#define ROUTES (DEVICES * RESOURCES)
+#define ITERATIONS 4000000UL
+
+static volatile uint32_t sink;
+
+template <size_t I>
+static int handler(coap_arena_t *, const coap_packet_t *, coap_packet_t *, uint8_t, uint8_t)
+{
+    sink = sink + I;
+    return 0;
+}
+
+static constexpr void append_number(coap::fixed_string<16> &s, size_t n)
+{
+    s.data[s.len++] = static_cast<char>('0' + n / 10);
+    s.data[s.len++] = static_cast<char>('0' + n % 10);
+}
+
+template <size_t I>
+static constexpr coap::fixed_string<16> route_path()
+{
+    coap::fixed_string<16> s;
+    s.data[s.len++] = 'd';
+    append_number(s, I / RESOURCES);
+    s.data[s.len++] = '/';
+    s.data[s.len++] = 'r';
+    append_number(s, I % RESOURCES);
+    return s;
+}
+
+template <size_t... I>
+static auto make_router(std::index_sequence<I...>) -> coap::router<coap::route<route_path<I>(), COAP_GET, handler<I>>...>;
+
+using routes = decltype(make_router(std::make_index_sequence<ROUTES>()));
+
+template <size_t... I>
+static constexpr std::array<coap_endpoint_func, ROUTES> make_handlers(std::index_sequence<I...>)
+{
+    return {handler<I>...};
+}
+
+static constexpr std::array<coap_endpoint_func, ROUTES> handlers = make_handlers(std::make_index_sequence<ROUTES>());
+
+class trie
+{
+public:
+    trie() : nodes_(1) {}
+
+    void add(std::string_view path, coap_code_t method, coap_endpoint_func handler)
+    {
+        size_t node = 0;
+        while (!path.empty())
+        {
+            size_t slash = path.find('/');
+            std::string seg(path.substr(0, slash));
+            path = (slash == std::string_view::npos) ? std::string_view() : path.substr(slash + 1);
+            auto &children = nodes_[node].children;
+            auto it = std::lower_bound(children.begin(), children.end(), seg,
+                                       [](const auto &child, const std::string &s) { return child.first < s; });
+            if (it == children.end() || it->first != seg)
+            {
+                it = children.insert(it, {seg, nodes_.size()});
+                nodes_.emplace_back();
+            }
+            node = it->second;
+        }
+        nodes_[node].handlers.push_back({method, handler});
+    }
+
+    coap_endpoint_func find(const coap_packet_t *inpkt) const
+    {
+        uint8_t count;
+        const coap_option_t *segs = coap_findOptions(inpkt, COAP_OPTION_URI_PATH, &count);
+        size_t node = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            std::string_view seg = coap::string_view(segs[i].buf);
+            const auto &children = nodes_[node].children;
+            auto it = std::lower_bound(children.begin(), children.end(), seg,
+                                       [](const auto &child, std::string_view s) { return std::string_view(child.first) < s; });
+            if (it == children.end() || it->first != seg)
+                return nullptr;
+            node = it->second;
+        }
+        for (const auto &h : nodes_[node].handlers)
+        {
+            if (h.first == inpkt->hdr.code)
+                return h.second;
+        }
+        return nullptr;
+    }
+
+private:
+    struct node
+    {
+        std::vector<std::pair<std::string, size_t>> children;
+        std::vector<std::pair<uint8_t, coap_endpoint_func>> handlers;
+    };
+    std::vector<node> nodes_;
+};
+
+template <typename F>
+static double ns_per_op(const std::vector<coap_packet_t> &requests, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < ITERATIONS; i++)
+        f(&requests[(i * 97) % ROUTES]);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+int main()
+{
+    static char names[ROUTES][2][4];
+    static coap_endpoint_path_t paths[ROUTES];
+    static coap_endpoint_t endpoints[ROUTES + 1];
+    std::vector<coap_packet_t> requests(ROUTES);
+    coap_packet_t rsp;
+    trie t;
+
+    for (size_t i = 0; i < ROUTES; i++)
+    {
+        std::snprintf(names[i][0], sizeof(names[i][0]), "d%02zu", i / RESOURCES);
+        std::snprintf(names[i][1], sizeof(names[i][1]), "r%02zu", i % RESOURCES);
+        paths[i] = coap_endpoint_path_t{2, {names[i][0], names[i][1]}};
+        endpoints[i] = coap_endpoint_t{COAP_GET, handlers[i], &paths[i], nullptr, nullptr, nullptr};
+        t.add(std::string(names[i][0]) + "/" + names[i][1], COAP_GET, handlers[i]);
+
+        coap_header_init(&requests[i], COAP_TYPE_CON, COAP_GET, static_cast<uint16_t>(i));
+        coap_header_add_token(&requests[i], nullptr, 0);
+        requests[i].numopts = 0;
+        requests[i].scratch_len = 0;
+        requests[i].payload = coap_buffer_t{nullptr, 0};
+        coap_add_option_string(&requests[i], COAP_OPTION_URI_PATH, names[i][0]);
+        coap_add_option_string(&requests[i], COAP_OPTION_URI_PATH, names[i][1]);
+    }
+    endpoints[ROUTES] = coap_endpoint_t{COAP_GET, nullptr, nullptr, nullptr, nullptr, nullptr};
+
+    for (size_t i = 0; i < ROUTES; i++)
+    {
+        if (routes::find(&requests[i]) != handlers[i] || t.find(&requests[i]) != handlers[i])
+        {
+            std::printf("route %zu dispatched to the wrong handler\n", i);
+            return 1;
+        }
+    }
+
+    double router_ns = ns_per_op(requests, [&](const coap_packet_t *req) { routes::dispatch(nullptr, req, &rsp); });
+    double trie_ns = ns_per_op(requests, [&](const coap_packet_t *req)
+    {
+        coap_endpoint_func h = t.find(req);
+        if (nullptr != h)
+            h(nullptr, req, &rsp, static_cast<uint8_t>(req->hdr.id >> 8), static_cast<uint8_t>(req->hdr.id));
+    });
+    double linear_ns = ns_per_op(requests, [&](const coap_packet_t *req) { coap_handle_req(nullptr, endpoints, req, &rsp); });
+
+    std::printf("%d routes, ns/dispatch\n", ROUTES);
+    std::printf("%-12s %8.1f\n", "router", router_ns);
+    std::printf("%-12s %8.1f\n", "trie", trie_ns);
+    std::printf("%-12s %8.1f\n", "handle_req", linear_ns);
+    return 0;
+}
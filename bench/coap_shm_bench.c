@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "coap_shm.h"
+
+/* Throughput of a 60 byte CoAP message from producer threads to a consumer thread that parses it.
+ * udp:  sendto() and recv() over loopback, one system call per message on each side. UDP drops what the socket
+ *       buffer cannot hold, so producers keep at most WINDOW messages in flight.
+ * spsc: one producer builds into the ring, the consumer parses batches in place and sleeps on the eventfd.
+ * mpsc: PRODUCERS producers build on the stack and copy into the ring.
+ */
+
+#define MESSAGES 1000000UL
+#define UDP_MESSAGES 200000UL
+#define PRODUCERS 4
+#define RING_SIZE 65536
+#define WINDOW 256
+#define BATCH 64
+
+typedef struct
+{
+    coap_shm_t shm;
+    int fd;                             // udp: socket of the consumer, producers connect their own
+    struct sockaddr_in addr;
+    unsigned long count;                // messages per producer
+    _Atomic unsigned long received;
+    unsigned long errors;
+} bench_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void make_message(coap_packet_t *pkt, uint8_t *payload, uint16_t id)
+{
+    static const uint8_t token[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    memset(pkt, 0, sizeof(*pkt));
+    coap_header_init(pkt, COAP_TYPE_NONCON, COAP_POST, id);
+    coap_header_add_token(pkt, token, sizeof(token));
+    coap_add_option_string(pkt, COAP_OPTION_URI_PATH, "telemetry");
+    coap_add_option_string(pkt, COAP_OPTION_URI_PATH, "sensor-0042");
+    memset(payload, 'x', 32);
+    pkt->payload.p = payload;
+    pkt->payload.len = 32;
+}
+
+static void *udp_producer(void *arg)
+{
+    bench_t *b = arg;
+    uint8_t payload[32], buf[128];
+    coap_packet_t pkt;
+    unsigned long i;
+    size_t len;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    connect(fd, (const struct sockaddr *)&b->addr, sizeof(b->addr));
+    for (i = 0; i < b->count; i++)
+    {
+        make_message(&pkt, payload, (uint16_t)i);
+        len = sizeof(buf);
+        coap_build(buf, &len, &pkt);
+        while (i - atomic_load_explicit(&b->received, memory_order_acquire) >= WINDOW)
+            sched_yield();
+        if (send(fd, buf, len, 0) < 0)
+            b->errors++;
+    }
+    close(fd);
+    return NULL;
+}
+
+static void udp_consume(bench_t *b, unsigned long total)
+{
+    uint8_t buf[1500];
+    coap_packet_t pkt;
+    ssize_t n;
+
+    while (atomic_load_explicit(&b->received, memory_order_relaxed) < total)
+    {
+        if ((n = recv(b->fd, buf, sizeof(buf), 0)) <= 0)
+            break;
+        if (0 != coap_parse(&pkt, buf, (size_t)n))
+            b->errors++;
+        atomic_store_explicit(&b->received, atomic_load_explicit(&b->received, memory_order_relaxed) + 1, memory_order_release);
+    }
+}
+
+static void *shm_producer(void *arg)
+{
+    bench_t *b = arg;
+    uint8_t payload[32];
+    coap_packet_t pkt;
+    unsigned long i;
+
+    for (i = 0; i < b->count; i++)
+    {
+        make_message(&pkt, payload, (uint16_t)i);
+        while (COAP_SHM_FULL == coap_shm_send_packet(&b->shm, &pkt))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void shm_consume(bench_t *b, unsigned long total)
+{
+    coap_buffer_t msgs[BATCH];
+    coap_packet_t pkt;
+    unsigned long received = 0;
+    size_t i, n;
+
+    while (received < total && coap_shm_wait(&b->shm, 1000))
+    {
+        n = coap_shm_peek(&b->shm, msgs, BATCH);
+        for (i = 0; i < n; i++)
+            if (0 != coap_parse(&pkt, msgs[i].p, msgs[i].len))
+                b->errors++;
+        coap_shm_release(&b->shm);
+        received += n;
+    }
+    atomic_store(&b->received, received);
+}
+
+static void run(const char *name, bench_t *b, int producers, void *(*producer)(void *), void (*consume)(bench_t *, unsigned long))
+{
+    pthread_t threads[PRODUCERS];
+    unsigned long total = b->count * (unsigned long)producers;
+    uint64_t start = now_ns(), elapsed;
+    int i;
+
+    for (i = 0; i < producers; i++)
+        pthread_create(&threads[i], NULL, producer, b);
+    consume(b, total);
+    for (i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+    elapsed = now_ns() - start;
+    printf("%-6s %d producer%s %9lu msgs %8.2f Mmsg/s %7.1f ns/msg %lu errors\n", name, producers, (1 == producers) ? " " : "s",
+        atomic_load(&b->received), (double)atomic_load(&b->received) * 1e3 / (double)elapsed,
+        (double)elapsed / (double)atomic_load(&b->received), b->errors);
+}
+
+int main(void)
+{
+    static bench_t b;
+    socklen_t addr_len = sizeof(b.addr);
+    uint8_t payload[32], buf[128];
+    coap_packet_t pkt;
+    size_t len = sizeof(buf);
+
+    make_message(&pkt, payload, 0);
+    coap_build(buf, &len, &pkt);
+    printf("message of %zu bytes\n", len);
+
+    memset(&b, 0, sizeof(b));
+    b.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    b.addr.sin_family = AF_INET;
+    b.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != bind(b.fd, (const struct sockaddr *)&b.addr, sizeof(b.addr)) ||
+        0 != getsockname(b.fd, (struct sockaddr *)&b.addr, &addr_len))
+    {
+        perror("udp");
+        return 1;
+    }
+    b.count = UDP_MESSAGES;
+    run("udp", &b, 1, udp_producer, udp_consume);
+    close(b.fd);
+
+    memset(&b, 0, sizeof(b));
+    if (COAP_SHM_OK != coap_shm_create(&b.shm, RING_SIZE, COAP_SHM_SPSC))
+    {
+        perror("coap_shm_create");
+        return 1;
+    }
+    b.count = MESSAGES;
+    run("spsc", &b, 1, shm_producer, shm_consume);
+    coap_shm_close(&b.shm);
+
+    memset(&b, 0, sizeof(b));
+    coap_shm_create(&b.shm, RING_SIZE, COAP_SHM_MPSC);
+    b.count = MESSAGES;
+    run("mpsc", &b, 1, shm_producer, shm_consume);
+    b.count = MESSAGES / PRODUCERS;
+    atomic_store(&b.received, 0);
+    run("mpsc", &b, PRODUCERS, shm_producer, shm_consume);
+    coap_shm_close(&b.shm);
+    return 0;
+}
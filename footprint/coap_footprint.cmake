@@ -0,0 +1,47 @@
+# Prints the footprint table, run by the footprint target with SIZE set to the size tool and PROFILES to a file
+# with one line "name library packet_library" per profile
+
+file(STRINGS ${PROFILES} lines)
+
+# Sum of text, data and bss of all objects of an archive, from the (TOTALS) line of size -t
+function(coap_footprint_size archive prefix)
+    execute_process(COMMAND ${SIZE} -t ${archive} OUTPUT_VARIABLE out RESULT_VARIABLE res)
+    if(NOT res EQUAL 0 OR NOT out MATCHES "([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)[ \t]+[0-9]+[ \t]+[0-9a-f]+[ \t]+\\(TOTALS\\)")
+        message(FATAL_ERROR "${SIZE} -t ${archive} failed")
+    endif()
+    set(${prefix}_text ${CMAKE_MATCH_1} PARENT_SCOPE)
+    set(${prefix}_data ${CMAKE_MATCH_2} PARENT_SCOPE)
+    set(${prefix}_bss ${CMAKE_MATCH_3} PARENT_SCOPE)
+endfunction()
+
+# Appends value to var, padded with spaces to width, in front of value unless it is the first column
+function(coap_footprint_column var width value)
+    set(column "${value}")
+    string(LENGTH "${column}" len)
+    while(len LESS width)
+        if("${${var}}" STREQUAL "")
+            set(column "${column} ")
+        else()
+            set(column " ${column}")
+        endif()
+        math(EXPR len "${len} + 1")
+    endwhile()
+    set(${var} "${${var}}${column}" PARENT_SCOPE)
+endfunction()
+
+message("profile                 text     data      bss   packet")
+foreach(line ${lines})
+    separate_arguments(fields UNIX_COMMAND "${line}")
+    list(GET fields 0 name)
+    list(GET fields 1 library)
+    list(GET fields 2 packet)
+    coap_footprint_size(${library} lib)
+    coap_footprint_size(${packet} pkt)
+    set(row "")
+    coap_footprint_column(row 18 ${name})
+    coap_footprint_column(row 9 ${lib_text})
+    coap_footprint_column(row 9 ${lib_data})
+    coap_footprint_column(row 9 ${lib_bss})
+    coap_footprint_column(row 9 ${pkt_bss})
+    message("${row}")
+endforeach()
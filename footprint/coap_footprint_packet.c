@@ -0,0 +1,4 @@
+#include "coap.h"
+
+// Its size in bss is the RAM a coap_packet_t takes with the settings of the profile
+coap_packet_t coap_footprint_packet;
@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include "coap.h"
 #include "byte_order.h"
+#include "coap_stats.h"
 
 #ifdef DEBUG
 void coap_dumpHeader(coap_header_t *hdr)
@@ -87,6 +88,8 @@ int coap_parseOption(coap_option_t *option, uint16_t *running_delta, const uint8
 
     delta = (p[0] & 0xF0) >> 4;
     len = p[0] & 0x0F;
+    if (delta >= 13 || len >= 13)
+        COAP_STATS_INC(parse_ext_headers);
 
     // These are untested and may be buggy
     if (delta == 13)
@@ -103,7 +106,7 @@ int coap_parseOption(coap_option_t *option, uint16_t *running_delta, const uint8
         headlen += 2;
         if (buflen < headlen)
             return COAP_ERR_OPTION_TOO_SHORT_FOR_HEADER;
-        delta = ((p[1] << 8) | p[2]) + 269;
+        delta = endian_load16(uint16_t, &p[1]) + 269;
         p+=2;
     }
     else
@@ -124,7 +127,7 @@ int coap_parseOption(coap_option_t *option, uint16_t *running_delta, const uint8
         headlen += 2;
         if (buflen < headlen)
             return COAP_ERR_OPTION_TOO_SHORT_FOR_HEADER;
-        len = ((p[1] << 8) | p[2]) + 269;
+        len = endian_load16(uint16_t, &p[1]) + 269;
         p+=2;
     }
     else
@@ -148,13 +151,20 @@ int coap_parseOption(coap_option_t *option, uint16_t *running_delta, const uint8
 // http://tools.ietf.org/html/rfc7252#section-3.1
 int coap_parseOptionsAndPayload(coap_option_t *options, uint8_t *numOptions, coap_buffer_t *payload, const coap_header_t *hdr, const uint8_t *buf, size_t buflen)
 {
-    size_t optionIndex = 0;
-    uint16_t delta = 0;
     const uint8_t *p = buf + 4 + hdr->tkl;
     const uint8_t *end = buf + buflen;
-    int rc;
     if (p > end)
         return COAP_ERR_OPTION_OVERRUNS_PACKET;   // out of bounds
+    return coap_parse_options(options, numOptions, payload, p, end - p);
+}
+
+int coap_parse_options(coap_option_t *options, uint8_t *numOptions, coap_buffer_t *payload, const uint8_t *buf, size_t buflen)
+{
+    size_t optionIndex = 0;
+    uint16_t delta = 0;
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + buflen;
+    int rc;
 
     // 0xFF is payload marker
     while((optionIndex < *numOptions) && (p < end) && (*p != 0xFF))
@@ -163,6 +173,8 @@ int coap_parseOptionsAndPayload(coap_option_t *options, uint8_t *numOptions, coa
             return rc;
         optionIndex++;
     }
+    if ((optionIndex == *numOptions) && (p < end) && (*p != 0xFF))
+        COAP_STATS_INC(parse_truncated);
     *numOptions = optionIndex;
 
     if (p+1 < end && *p == 0xFF)  // payload marker
@@ -207,14 +219,24 @@ void coap_dumpPacket(coap_packet_t *pkt)
 int coap_parse(coap_packet_t *pkt, const uint8_t *buf, size_t buflen)
 {
     int rc;
+    COAP_STATS_TIME_START(start);
 
-    if (0 != (rc = coap_parseHeader(&pkt->hdr, buf, buflen)))
-        return rc;
-    if (0 != (rc = coap_parseToken(&pkt->tok, &pkt->hdr, buf, buflen)))
-        return rc;
-    pkt->numopts = MAXOPT;
-    if (0 != (rc = coap_parseOptionsAndPayload(pkt->opts, &(pkt->numopts), &(pkt->payload), &pkt->hdr, buf, buflen)))
+    if (0 == (rc = coap_parseHeader(&pkt->hdr, buf, buflen))
+        && 0 == (rc = coap_parseToken(&pkt->tok, &pkt->hdr, buf, buflen)))
+    {
+        pkt->numopts = MAXOPT;
+        pkt->scratch_len = 0;
+        rc = coap_parseOptionsAndPayload(pkt->opts, &(pkt->numopts), &(pkt->payload), &pkt->hdr, buf, buflen);
+    }
+    COAP_STATS_TIME_END(parse_ns, start);
+    if (0 != rc)
+    {
+        COAP_STATS_ERROR(parse_errors, rc);
         return rc;
+    }
+    COAP_STATS_INC(parse_ok);
+    COAP_STATS_ADD(parse_options, pkt->numopts);
+    COAP_STATS_HIST(parse_size, buflen);
     return 0;
 }
 
@@ -242,33 +264,68 @@ const coap_option_t *coap_findOptions(const coap_packet_t *pkt, uint8_t num, uin
     return first;
 }
 
+#ifndef COAP_NO_BLOCKWISE
 coap_blocksize_t coap_option_blockwise_get_szx(const coap_option_t *block_option) {
-    uint8_t lsb = block_option->buf.p[block_option->buf.len - 1]; // last byte in option buffer stores szx.
-    return (lsb & 0x07); //Last three bits are szx encoded.
+    uint32_t value = 0;
+    coap_decode_uint(&block_option->buf, &value);
+    return (value & 0x07); //Last three bits are szx encoded.
 }
 
 uint32_t coap_option_blockwise_get_num(const coap_option_t *block_option)
 {
-    uint32_t num = 0;
-    if(block_option->buf.len == 1) {
-        //num is 4 MSBs
-        num = block_option->buf.p[0] >> 4;
-    }
-    else if (block_option->buf.len == 2) {
-        //num is complete first byte and 4 MSBs of second byte
-        num = (block_option->buf.p[0] << 4) | (block_option->buf.p[1] >> 4);
-    }
-    else {
-        //num two first bytes complete and 4 MSBs of third byte
-        num = (block_option->buf.p[0] << 12) | (block_option->buf.p[1] << 4) | (block_option->buf.p[2] >> 4);
-    }
-    return num;
+    uint32_t value = 0;
+    coap_decode_uint(&block_option->buf, &value);
+    return value >> 4; //num is everything in front of m and szx
 }
 
 bool coap_option_blockwise_get_m(const coap_option_t *block_option)
 {
-    uint8_t lsb = block_option->buf.p[block_option->buf.len - 1]; // last byte in option buffer stores m.
-    return (lsb & 0x08); //Fourth last bit is m flag.
+    uint32_t value = 0;
+    coap_decode_uint(&block_option->buf, &value);
+    return (value & 0x08); //Fourth last bit is m flag.
+}
+#endif
+
+uint8_t coap_encode_uint(uint8_t *buf, uint32_t value)
+{
+    uint8_t len = 0;
+    if (value > 0xFFFFFF)
+        buf[len++] = (value >> 24) & 0xFF;
+    if (value > 0xFFFF)
+        buf[len++] = (value >> 16) & 0xFF;
+    if (value > 0xFF)
+        buf[len++] = (value >> 8) & 0xFF;
+    if (value > 0)
+        buf[len++] = value & 0xFF;
+    return len;
+}
+
+coap_error_t coap_decode_uint(const coap_buffer_t *buf, uint32_t *value)
+{
+    size_t i;
+    if (buf->len > 4)
+        return COAP_ERR_OPTION_LEN_INVALID;
+    *value = 0;
+    for (i = 0; i < buf->len; i++)
+        *value = (*value << 8) | buf->p[i];
+    return COAP_ERR_NONE;
+}
+
+bool coap_option_get_uint(const coap_packet_t *pkt, uint8_t num, uint32_t *value)
+{
+    uint8_t count;
+    uint32_t decoded;
+    const coap_option_t *opt = coap_findOptions(pkt, num, &count);
+    if (NULL == opt || COAP_ERR_NONE != coap_decode_uint(&opt->buf, &decoded))
+        return false;
+    *value = decoded;
+    return true;
+}
+
+bool coap_buffer_equals_string(const coap_buffer_t *buf, const char *str)
+{
+    size_t len = strlen(str);
+    return (buf->len == len) && (0 == memcmp(buf->p, str, len));
 }
 
 int coap_buffer_to_string(char *strbuf, size_t strbuflen, const coap_buffer_t *buf)
@@ -280,12 +337,11 @@ int coap_buffer_to_string(char *strbuf, size_t strbuflen, const coap_buffer_t *b
     return 0;
 }
 
-coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
+coap_error_t coap_build_head(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
 {
-    size_t opts_len = 0;
-    size_t i;
     uint8_t *p;
-    uint16_t running_delta = 0;
+    size_t optlen;
+    coap_error_t err;
 
     // build header
     if (*buflen < (4U + pkt->hdr.tkl))
@@ -314,8 +370,23 @@ coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
 
     p += pkt->hdr.tkl;
 
-    // // http://tools.ietf.org/html/rfc7252#section-3.1
+    // http://tools.ietf.org/html/rfc7252#section-3.1
     // inject options
+    optlen = *buflen - (size_t)(p - buf);
+    if (COAP_ERR_NONE != (err = coap_build_options(p, &optlen, pkt)))
+        return err;
+    p += optlen;
+
+    *buflen = p - buf;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_build_options(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
+{
+    size_t i;
+    uint8_t *p = buf;
+    uint16_t running_delta = 0;
+
     uint8_t option_indices[MAXOPT] = {0};
     coap_order_options(pkt->opts, pkt->numopts, option_indices);
 
@@ -323,12 +394,16 @@ coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
     {
         uint32_t optDelta;
         uint8_t len, delta = 0;
+        size_t optlen = 1 + pkt->opts[option_indices[i]].buf.len;
 
-        if (((size_t)(p-buf)) > *buflen)
-             return COAP_ERR_BUFFER_TOO_SMALL;
         optDelta = pkt->opts[option_indices[i]].num - running_delta;
         coap_option_nibble(optDelta, &delta);
         coap_option_nibble((uint32_t)pkt->opts[option_indices[i]].buf.len, &len);
+        optlen += (delta == 13) + 2 * (delta == 14) + (len == 13) + 2 * (len == 14);
+        if (optlen > *buflen - (size_t)(p - buf))
+             return COAP_ERR_BUFFER_TOO_SMALL;
+        if (delta >= 13 || len >= 13)
+            COAP_STATS_INC(build_ext_headers);
 
         *p++ = (0xFF & (delta << 4 | len));
         if (delta == 13)
@@ -348,7 +423,7 @@ coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
         else
         if (len == 14)
   	    {
-            *p++ = (pkt->opts[option_indices[i]].buf.len >> 8);
+            *p++ = ((pkt->opts[option_indices[i]].buf.len-269) >> 8);
             *p++ = (0xFF & (pkt->opts[option_indices[i]].buf.len-269));
         }
 
@@ -357,21 +432,76 @@ coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
         running_delta = pkt->opts[option_indices[i]].num;
     }
 
-    opts_len = (p - buf) - 4;   // number of bytes used by options
+    *buflen = p - buf;
+    return COAP_ERR_NONE;
+}
+
+static coap_error_t coap_build_datagram(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
+{
+    size_t head_len = *buflen;  // header, token and options
+    coap_error_t err;
 
+    if (COAP_ERR_NONE != (err = coap_build_head(buf, &head_len, pkt)))
+        return err;
     if (pkt->payload.len > 0)
     {
-        if (*buflen < 4 + 1 + pkt->payload.len + opts_len)
+        if (*buflen < head_len + 1 + pkt->payload.len)
             return COAP_ERR_BUFFER_TOO_SMALL;
-        buf[4 + opts_len] = 0xFF;  // payload marker
-        memcpy(buf+5 + opts_len, pkt->payload.p, pkt->payload.len);
-        *buflen = opts_len + 5 + pkt->payload.len;
+        buf[head_len] = 0xFF;  // payload marker
+        memcpy(buf + head_len + 1, pkt->payload.p, pkt->payload.len);
+        *buflen = head_len + 1 + pkt->payload.len;
     }
     else
-        *buflen = opts_len + 4;
+        *buflen = head_len;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt)
+{
+    coap_error_t err;
+    COAP_STATS_TIME_START(start);
+
+    err = coap_build_datagram(buf, buflen, pkt);
+    COAP_STATS_TIME_END(build_ns, start);
+    if (COAP_ERR_NONE != err)
+    {
+        COAP_STATS_ERROR(build_errors, err);
+        return err;
+    }
+    COAP_STATS_INC(build_ok);
+    COAP_STATS_ADD(build_bytes, *buflen);
+    COAP_STATS_HIST(build_size, *buflen);
     return COAP_ERR_NONE;
 }
 
+size_t coap_build_batch(uint8_t *arena, size_t arenalen, const coap_packet_t *pkts, size_t count, coap_batch_msg_t *msgs)
+{
+    size_t i, used = 0, built = 0;
+    COAP_STATS_TIME_START(start);
+
+    for (i = 0; i < count; i++)
+    {
+        size_t len = arenalen - used;
+        msgs[i].offset = used;
+        if (COAP_ERR_NONE != (msgs[i].err = coap_build_datagram(arena + used, &len, &pkts[i])))
+        {
+            // a failed message takes no space, later and smaller ones may still fit
+            msgs[i].len = 0;
+            COAP_STATS_ERROR(build_errors, msgs[i].err);
+            continue;
+        }
+        msgs[i].len = len;
+        used += len;
+        built++;
+        COAP_STATS_HIST(build_size, len);
+    }
+    // one clock reading per batch, its duration is counted once per message
+    COAP_STATS_ADD_AT(build_ns, coap_stats_log2((coap_stats_now() - start) / (count ? count : 1)), COAP_STATS_BUCKETS, count);
+    COAP_STATS_ADD(build_ok, built);
+    COAP_STATS_ADD(build_bytes, used);
+    return built;
+}
+
 bool coap_header_init(coap_packet_t *pkt, const coap_msgtype_t type, const coap_code_t method, const uint16_t id)
 {
     //type options out ouf bound
@@ -402,6 +532,26 @@ void coap_add_option(coap_packet_t *pkt, coap_option_num_t option, uint8_t* opti
     pkt->numopts++;
 }
 
+coap_error_t coap_add_option_uint(coap_packet_t *pkt, coap_option_num_t option, uint32_t value)
+{
+    uint8_t len;
+    if (pkt->numopts >= MAXOPT || pkt->scratch_len + 4U > COAP_OPTION_SCRATCH_SIZE)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    len = coap_encode_uint(&pkt->scratch[pkt->scratch_len], value);
+    coap_add_option(pkt, option, &pkt->scratch[pkt->scratch_len], len);
+    pkt->scratch_len += len;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_add_option_string(coap_packet_t *pkt, coap_option_num_t option, const char *str)
+{
+    if (pkt->numopts >= MAXOPT)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    coap_add_option(pkt, option, (uint8_t *)str, strlen(str));
+    return COAP_ERR_NONE;
+}
+
+#ifndef COAP_NO_BLOCKWISE
 uint8_t coap_make_option_blockwise(uint8_t *option_buffer, const coap_blocksize_t szx, const bool m, const uint32_t num)
 {
     if(szx > 6 || szx < 0 || num > 1048576)
@@ -447,6 +597,7 @@ uint8_t coap_make_option_blockwise(uint8_t *option_buffer, const coap_blocksize_
     }
     return option_length;
 }
+#endif
 
 void coap_option_nibble(uint32_t value, uint8_t *nibble)
 {
@@ -464,7 +615,7 @@ void coap_option_nibble(uint32_t value, uint8_t *nibble)
     }
 }
 
-int coap_make_response(coap_rw_buffer_t *scratch, coap_packet_t *pkt, const uint8_t *content, size_t content_len, uint16_t msgid, const coap_buffer_t* tok, coap_code_t rspcode, coap_content_type_t content_type)
+int coap_make_response(coap_packet_t *pkt, const uint8_t *content, size_t content_len, uint16_t msgid, const coap_buffer_t* tok, coap_code_t rspcode, coap_content_type_t content_type)
 {
     pkt->hdr.ver = 0x01;
     pkt->hdr.t = COAP_TYPE_ACK;
@@ -472,6 +623,7 @@ int coap_make_response(coap_rw_buffer_t *scratch, coap_packet_t *pkt, const uint
     pkt->hdr.code = rspcode;
     pkt->hdr.id = msgid;
     pkt->numopts = 0;
+    pkt->scratch_len = 0;
 
     // need token in response
     if (tok) {
@@ -479,22 +631,87 @@ int coap_make_response(coap_rw_buffer_t *scratch, coap_packet_t *pkt, const uint
         pkt->tok = *tok;
     }
 
-    if (content_type != COAP_CONTENTTYPE_NONE) {
-        pkt->numopts = 1;
-    // safe because 1 < MAXOPT
-    pkt->opts[0].num = COAP_OPTION_CONTENT_FORMAT;
-    pkt->opts[0].buf.p = scratch->p;
-    if (scratch->len < 2)
-        return COAP_ERR_BUFFER_TOO_SMALL;
-    scratch->p[0] = ((uint16_t)content_type & 0xFF00) >> 8;
-    scratch->p[1] = ((uint16_t)content_type & 0x00FF);
-    pkt->opts[0].buf.len = 2;
-    }
+    // safe because 1 < MAXOPT, minimal length encoding, so text/plain takes no value bytes at all
+    if (content_type != COAP_CONTENTTYPE_NONE)
+        coap_add_option_uint(pkt, COAP_OPTION_CONTENT_FORMAT, (uint16_t)content_type);
     pkt->payload.p = content;
     pkt->payload.len = content_len;
     return 0;
 }
 
+#ifndef COAP_NO_ROUTING
+static bool coap_endpoint_matches(const coap_endpoint_t *ep, const coap_packet_t *inpkt)
+{
+    const coap_option_t *opt;
+    uint8_t count;
+    int i;
+
+    if (ep->method != inpkt->hdr.code)
+        return false;
+    opt = coap_findOptions(inpkt, COAP_OPTION_URI_PATH, &count);
+    if (count != ep->path->count)
+        return false;
+    for (i = 0; i < count; i++)
+    {
+        if (!coap_buffer_equals_string(&opt[i].buf, ep->path->elems[i]))
+            return false;
+    }
+    return true;
+}
+
+int coap_handle_req(coap_arena_t *arena, const coap_endpoint_t *endpoints, const coap_packet_t *inpkt, coap_packet_t *outpkt)
+{
+    const coap_endpoint_t *ep;
+    int rc;
+    COAP_STATS_TIME_START(start);
+
+    for (ep = endpoints; NULL != ep->handler; ep++)
+    {
+        if (coap_endpoint_matches(ep, inpkt))
+        {
+            rc = ep->handler(arena, inpkt, outpkt, (uint8_t)(inpkt->hdr.id >> 8), (uint8_t)inpkt->hdr.id);
+            COAP_STATS_TIME_END(dispatch_ns, start);
+            COAP_STATS_INC(dispatch_ok);
+            return rc;
+        }
+    }
+    coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, COAP_NOT_FOUND, COAP_CONTENTTYPE_NONE);
+    COAP_STATS_TIME_END(dispatch_ns, start);
+    COAP_STATS_INC(dispatch_not_found);
+    return 0;
+}
+#endif
+
+coap_packet_t *coap_packet_alloc(coap_arena_t *arena)
+{
+    coap_packet_t *pkt = coap_arena_alloc(arena, sizeof(coap_packet_t), _Alignof(coap_packet_t));
+    if (NULL != pkt)
+        memset(pkt, 0, sizeof(coap_packet_t));
+    return pkt;
+}
+
+coap_error_t coap_add_option_copy(coap_packet_t *pkt, coap_arena_t *arena, coap_option_num_t option, const uint8_t *value, size_t len)
+{
+    uint8_t *copy;
+    if (pkt->numopts >= MAXOPT)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    if (NULL == (copy = coap_arena_dup(arena, value, len)))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    coap_add_option(pkt, option, copy, len);
+    return COAP_ERR_NONE;
+}
+
+uint8_t *coap_payload_alloc(coap_packet_t *pkt, coap_arena_t *arena, size_t len)
+{
+    uint8_t *payload = coap_arena_alloc(arena, len, 1);
+    if (NULL != payload)
+    {
+        pkt->payload.p = payload;
+        pkt->payload.len = len;
+    }
+    return payload;
+}
+
 void coap_order_options(const coap_option_t *opts, const uint8_t num_opts, uint8_t* ordered_indices)
 {
     if(num_opts == 1) {
@@ -38,9 +38,8 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
-
-
-#define MAXOPT 16
+#include "coap_config.h"
+#include "coap_arena.h"
 
 //http://tools.ietf.org/html/rfc7252#section-3
 typedef struct
@@ -80,6 +79,10 @@ typedef struct
     coap_option_t opts[MAXOPT]; /* Options of the packet. For possible entries see
                                  * http://tools.ietf.org/html/rfc7252#section-5.10 */
     coap_buffer_t payload;      /* Payload carried by the packet */
+    uint8_t scratch_len;        /* Number of bytes used in scratch */
+    uint8_t scratch[COAP_OPTION_SCRATCH_SIZE]; /* Packet owned storage for option values encoded by
+                                 * coap_add_option_uint(). Options of a copied packet still point into
+                                 * the scratch of the original packet. */
 } coap_packet_t;
 
 /////////////////////////////////////////
@@ -99,11 +102,15 @@ typedef enum
     COAP_OPTION_MAX_AGE = 14,
     COAP_OPTION_URI_QUERY = 15,
     COAP_OPTION_ACCEPT = 17,
+    COAP_OPTION_Q_BLOCK_1 = 19, //http://tools.ietf.org/html/rfc9177#section-12.1
     COAP_OPTION_LOCATION_QUERY = 20,
     COAP_OPTION_BLOCK_2 = 23,
     COAP_OPTION_BLOCK_1 = 27,
+    COAP_OPTION_SIZE2 = 28,     //http://tools.ietf.org/html/rfc7959#section-4
+    COAP_OPTION_Q_BLOCK_2 = 31,
     COAP_OPTION_PROXY_URI = 35,
-    COAP_OPTION_PROXY_SCHEME = 39
+    COAP_OPTION_PROXY_SCHEME = 39,
+    COAP_OPTION_SIZE1 = 60
 } coap_option_num_t;
 
 //http://tools.ietf.org/html/rfc7252#section-12.1.1
@@ -131,6 +138,7 @@ typedef enum
     COAP_VALID,
     COAP_CHANGED,
     COAP_CONTENT,
+    COAP_CONTINUE=0x5F,             //http://tools.ietf.org/html/rfc7959#section-2.9.1
     COAP_BAD_REQUEST=0x80,
     COAP_UNAUTHORIZED,
     COAP_BAD_OPTION,
@@ -138,6 +146,7 @@ typedef enum
     COAP_NOT_FOUND,
     COAP_METHOD_NOT_ALLOWED,
     COAP_NOT_ACCEPTABLE,
+    COAP_REQUEST_ENTITY_INCOMPLETE=0x88,
     COAP_PRECONDITION_FAILED=0x8C,
     COAP_REQUEST_ENTITY_TOO_LARGE=0x8D,
     COAP_UNSUPPORTED_CONTENT_FORMAT=0x8F,
@@ -147,6 +156,11 @@ typedef enum
     COAP_SERVICE_UNAVAILABLE,
     COAP_GATEWAY_TIMEOUT,
     COAP_PROXYING_NOT_SUPPORTED,
+    COAP_SIGNAL_CSM=0xE1,           // Signaling codes of reliable transports, see
+    COAP_SIGNAL_PING,               // http://tools.ietf.org/html/rfc8323#section-5
+    COAP_SIGNAL_PONG,
+    COAP_SIGNAL_RELEASE,
+    COAP_SIGNAL_ABORT,
     COAP_UNDEFINED_CODE=0xFF
 } coap_code_t;
 
@@ -160,6 +174,16 @@ typedef enum
     COAP_CONTENTTYPE_APPLICATION_OCTECT_STREAM = 42,
     COAP_CONTENTTYPE_APPLICATION_EXI = 47,
     COAP_CONTENTTYPE_APPLICATION_JSON = 50,
+    COAP_CONTENTTYPE_APPLICATION_CBOR = 60,         //http://tools.ietf.org/html/rfc7049#section-7.4
+    COAP_CONTENTTYPE_APPLICATION_SENML_JSON = 110,  //http://tools.ietf.org/html/rfc8428#section-12.3
+    COAP_CONTENTTYPE_APPLICATION_SENSML_JSON = 111,
+    COAP_CONTENTTYPE_APPLICATION_SENML_CBOR = 112,
+    COAP_CONTENTTYPE_APPLICATION_SENSML_CBOR = 113,
+    COAP_CONTENTTYPE_APPLICATION_SENML_EXI = 114,
+    COAP_CONTENTTYPE_APPLICATION_SENSML_EXI = 115,
+    COAP_CONTENTTYPE_APPLICATION_MISSING_BLOCKS_CBOR_SEQ = 272,  //http://tools.ietf.org/html/rfc9177#section-12.3
+    COAP_CONTENTTYPE_APPLICATION_SENML_XML = 310,
+    COAP_CONTENTTYPE_APPLICATION_SENSML_XML = 311,
 } coap_content_type_t;
 
 ///////////////////////
@@ -179,13 +203,17 @@ typedef enum
     COAP_ERR_UNSUPPORTED = 10,
     COAP_ERR_OPTION_DELTA_INVALID = 11,
     COAP_ERR_TOKEN_LENGTH_MISMATCH = 12,    /**< Only used in building coap, when tkl in header mismatch with token buffer */
-    COAP_ERR_TOKEN_TOO_LONG = 13           /**< Only used in building coap, when tkl in header > 8 */
+    COAP_ERR_TOKEN_TOO_LONG = 13,          /**< Only used in building coap, when tkl in header > 8 */
+    COAP_ERR_CBOR_INVALID = 14,            /**< Malformed or truncated CBOR payload */
+    COAP_ERR_LINKFORMAT_INVALID = 15,      /**< Malformed CoRE Link Format payload */
+    COAP_ERR_URI_INVALID = 16,             /**< URI is no valid coap or coaps URI */
+    COAP_ERR_FRAME_LENGTH_MISMATCH = 17    /**< Length field of a stream message does not match its frame */
 } coap_error_t;
 
 ///////////////////////
 
-typedef int (*coap_endpoint_func)(coap_rw_buffer_t *scratch, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo);
-#define MAX_SEGMENTS 2  // 2 = /foo/bar, 3 = /foo/bar/baz
+#ifndef COAP_NO_ROUTING
+typedef int (*coap_endpoint_func)(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo);
 typedef struct
 {
     int count;
@@ -204,12 +232,93 @@ typedef struct
                                          * provides a hint about the 
                                          * Content-Formats this resource returns." 
                                          * (Section 12.3. lists possible ct values.) */
+    const char *core_rt;                /* the 'rt' (resource type) attribute value, space separated, as defined
+                                         * in RFC6690, section 3.1. NULL if not present. */
+    const char *core_if;                /* the 'if' (interface description) attribute value, as defined in
+                                         * RFC6690, section 3.1. NULL if not present. */
 } coap_endpoint_t;
+#endif
+
+
+/// Where coap_build_batch() put one message in the arena
+typedef struct
+{
+    size_t offset;                      /* Start of the message in the arena */
+    size_t len;                         /* Bytes of the message, 0 if it failed */
+    coap_error_t err;                   /* COAP_ERR_NONE or why the message was not built */
+} coap_batch_msg_t;
 
 
 ///////////////////////
 coap_error_t coap_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt);
 
+/// @brief Builds header, token and options of a packet, but neither payload marker nor payload.
+/// Used to write the payload straight into the output buffer (see coap_cbor_build_begin()) or to send it from
+/// another buffer with scatter-gather I/O.
+/// @param[out] buf Buffer to build into
+/// @param[in,out] buflen Size of buf, set to the number of bytes written
+/// @param[in] pkt Packet to build, its payload is ignored
+/// @return COAP_ERR_NONE on success, otherwise the same errors as coap_build()
+coap_error_t coap_build_head(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt);
+
+/// @brief Encodes only the options of a packet, in ascending order with delta encoding. Shared by the datagram and
+/// the stream (see coap_tcp.h) message formats.
+/// @param[out] buf Buffer to build into
+/// @param[in,out] buflen Size of buf, set to the number of bytes written
+/// @param[in] pkt Packet with the options to encode
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if buf is too small
+coap_error_t coap_build_options(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt);
+
+/// @brief Builds a burst of packets back to back into one arena, in a single pass over one contiguous region.
+/// Messages that fail take no space, so the messages built are adjacent and in order, ready to be gathered for
+/// sendmmsg():
+///
+///     n = coap_build_batch(arena, sizeof(arena), responses, count, msgs);
+///     for (i = 0, j = 0; i < count; i++)
+///         if (COAP_ERR_NONE == msgs[i].err)
+///         {
+///             iov[j].iov_base = arena + msgs[i].offset;
+///             iov[j].iov_len = msgs[i].len;
+///             mmsg[j].msg_hdr.msg_iov = &iov[j];
+///             mmsg[j].msg_hdr.msg_iovlen = 1;
+///             mmsg[j].msg_hdr.msg_name = &peers[i];   // filled by recvmmsg()
+///             j++;
+///         }
+///
+/// @param[out] arena Buffer to build into
+/// @param arenalen Size of arena
+/// @param pkts Packets to build
+/// @param count Number of packets
+/// @param[out] msgs Offset, length and result of each packet, count entries
+/// @return Number of packets built. A packet that does not fit the rest of the arena fails with
+/// COAP_ERR_BUFFER_TOO_SMALL, later packets are still tried.
+size_t coap_build_batch(uint8_t *arena, size_t arenalen, const coap_packet_t *pkts, size_t count, coap_batch_msg_t *msgs);
+
+/// @brief Parses the fixed 4 byte header of a datagram
+/// @param[out] hdr Parsed header
+/// @param buf Datagram
+/// @param buflen Length of the datagram
+/// @return 0 on success, COAP_ERR_HEADER_TOO_SHORT or COAP_ERR_VERSION_NOT_1
+int coap_parseHeader(coap_header_t *hdr, const uint8_t *buf, size_t buflen);
+
+/// @brief Parses a single option and advances buf behind it
+/// @param[out] option Parsed option, its value points into the buffer
+/// @param[in,out] running_delta Number of the previous option, 0 before the first one
+/// @param[in,out] buf Option header
+/// @param buflen Bytes available from buf
+/// @return 0 on success, otherwise one of the COAP_ERR_OPTION_* errors
+int coap_parseOption(coap_option_t *option, uint16_t *running_delta, const uint8_t **buf, size_t buflen);
+
+/// @brief Parses a sequence of options, optionally followed by payload marker and payload. Shared by the datagram and
+/// the stream (see coap_tcp.h) message formats.
+/// @param[out] options Array to store the options in, they point into buf
+/// @param[in,out] numOptions Size of options, set to the number of parsed options
+/// @param[out] payload Set to the payload in buf, or to NULL/0 if there is none
+/// @param buf First option byte
+/// @param buflen Length of options and payload
+/// @return 0 on success, otherwise one of the COAP_ERR_OPTION_* errors
+int coap_parse_options(coap_option_t *options, uint8_t *numOptions, coap_buffer_t *payload, const uint8_t *buf, size_t buflen);
+
 /// @brief Initializes header version, type, code(method) and message id
 /// @param pkt Packet pointer to store data to
 /// @param type Message type, can be:
@@ -235,6 +344,48 @@ void coap_header_add_token(coap_packet_t *pkt, const uint8_t* token, const size_
 /// @param option_pt_len Length of option bytes
 void coap_add_option(coap_packet_t *pkt, coap_option_num_t option, uint8_t* option_pt, size_t option_pt_len);
 
+/// @brief Encodes an unsigned integer option value with minimal length, see
+/// https://www.rfc-editor.org/rfc/rfc7252#section-3.2. Leading zero bytes are dropped, so 0 is encoded with 0 bytes.
+/// @param[out] buf Buffer to store the value to. MUST be at least 4 bytes.
+/// @param[in] value Value to encode
+/// @return Number of bytes written to buf (0 to 4)
+uint8_t coap_encode_uint(uint8_t *buf, uint32_t value);
+
+/// @brief Decodes an unsigned integer option value in network byte order, as encoded by coap_encode_uint().
+/// @param[in] buf Buffer holding the value, for example the buf member of a parsed coap_option_t
+/// @param[out] value Decoded value
+/// @return COAP_ERR_NONE on success, COAP_ERR_OPTION_LEN_INVALID if buf is longer than 4 bytes
+coap_error_t coap_decode_uint(const coap_buffer_t *buf, uint32_t *value);
+
+/// @brief Adds an unsigned integer option (for example Content-Format, Max-Age, Observe, Accept or Size1/Size2).
+/// The value is encoded with minimal length into the scratch area owned by the packet, so no caller managed buffer
+/// is needed.
+/// @param pkt Packet pointer to store data to
+/// @param option Option definition/option number
+/// @param value Option value
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the packet has no room for another option or the
+/// packet scratch area is exhausted
+coap_error_t coap_add_option_uint(coap_packet_t *pkt, coap_option_num_t option, uint32_t value);
+
+/// @brief Adds a string option (for example Uri-Path, Uri-Query or Location-Path).
+/// The option references str directly, it is not copied. str must therefore stay valid until the packet is built.
+/// @param pkt Packet pointer to store data to
+/// @param option Option definition/option number
+/// @param str Zero terminated option value, the terminator is not part of the option
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the packet has no room for another option
+coap_error_t coap_add_option_string(coap_packet_t *pkt, coap_option_num_t option, const char *str);
+
+/// @brief Finds the first option with number num and decodes it as unsigned integer
+/// @param pkt Packet to search in
+/// @param num Option number
+/// @param[out] value Decoded value, untouched if the option is not present
+/// @return True if the option is present and holds a valid uint, false if not
+bool coap_option_get_uint(const coap_packet_t *pkt, uint8_t num, uint32_t *value);
+
+/// @brief Compares a buffer (for example an option value) with a zero terminated string, without copying either
+/// @return True if buf holds exactly the characters of str
+bool coap_buffer_equals_string(const coap_buffer_t *buf, const char *str);
+
 typedef enum  {
     COAP_BLOCKSIZE_16 = 0,
     COAP_BLOCKSIZE_32,
@@ -245,6 +396,7 @@ typedef enum  {
     COAP_BLOCKSIZE_1024
 } coap_blocksize_t;
 
+#ifndef COAP_NO_BLOCKWISE
 /// @brief Creates option BLOCK1 or BLOCK2
 /// Takes information about block size and creates option representation of it. The output size varies, depending on how
 /// large num is. Output length varies from 1 to 3 bytes. 
@@ -263,12 +415,16 @@ typedef enum  {
 /// @param[in] num Block number. Block 0 is starting block.
 /// @return Size of the block option.
 uint8_t coap_make_option_blockwise(uint8_t *option_buffer, const coap_blocksize_t szx, const bool m, const uint32_t num);
+#endif
 
+#ifdef DEBUG
 void coap_dumpPacket(coap_packet_t *pkt);
+#endif
 int coap_parse(coap_packet_t *pkt, const uint8_t *buf, size_t buflen);
 int coap_buffer_to_string(char *strbuf, size_t strbuflen, const coap_buffer_t *buf);
 const coap_option_t *coap_findOptions(const coap_packet_t *pkt, uint8_t num, uint8_t *count);
 
+#ifndef COAP_NO_BLOCKWISE
 /// @brief Retrieves blocksize (szx) from a block1 (option no. 27) or block2 (option no. 23) option.
 /// Make sure to pass a valid block option. If passed coap_option_t is neither block1 or block2, behavior is undefined!
 /// @param block_option Pointer to option object, retrieved for example by coap_findOptions().
@@ -286,11 +442,47 @@ uint32_t coap_option_blockwise_get_num(const coap_option_t *block_option);
 /// @param block_option Pointer to option object, retrieved for example by coap_findOpti
 /// @return More messages flag.
 bool coap_option_blockwise_get_m(const coap_option_t *block_option);
+#endif
 
-
+#ifdef DEBUG
 void coap_dump(const uint8_t *buf, size_t buflen, bool bare);
-int coap_make_response(coap_rw_buffer_t *scratch, coap_packet_t *pkt, const uint8_t *content, size_t content_len, uint16_t msgid, const coap_buffer_t* tok, coap_code_t rspcode, coap_content_type_t content_type);
-int coap_handle_req(coap_rw_buffer_t *scratch, const coap_packet_t *inpkt, coap_packet_t *outpkt);
+#endif
+int coap_make_response(coap_packet_t *pkt, const uint8_t *content, size_t content_len, uint16_t msgid, const coap_buffer_t* tok, coap_code_t rspcode, coap_content_type_t content_type);
+
+#ifndef COAP_NO_ROUTING
+/// @brief Dispatches a request to the matching endpoint, see coap_endpoint_t.
+/// If no endpoint matches method and Uri-Path of the request, a 4.04 Not Found response is made.
+/// @param arena Arena the handler allocates option values, payload etc. from. Everything allocated must stay valid
+/// until outpkt is built.
+/// @param endpoints Endpoint table, terminated by an entry with handler set to NULL
+/// @param inpkt Parsed request
+/// @param outpkt Response to fill
+/// @return Return value of the handler, 0 if no endpoint matched
+int coap_handle_req(coap_arena_t *arena, const coap_endpoint_t *endpoints, const coap_packet_t *inpkt, coap_packet_t *outpkt);
+#endif
+
+/// @brief Allocates a zero initialized packet from an arena
+/// @param arena Arena to allocate from
+/// @return Packet, NULL if the arena is exhausted
+coap_packet_t *coap_packet_alloc(coap_arena_t *arena);
+
+/// @brief Adds an option with a copy of value allocated from an arena, so value itself may be temporary
+/// @param pkt Packet pointer to store data to
+/// @param arena Arena to allocate the option value from
+/// @param option Option definition/option number
+/// @param value Option value to copy
+/// @param len Length of value
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the packet has no room for another option or the
+/// arena is exhausted
+coap_error_t coap_add_option_copy(coap_packet_t *pkt, coap_arena_t *arena, coap_option_num_t option, const uint8_t *value, size_t len);
+
+/// @brief Allocates the payload of a packet from an arena. The caller writes the payload content to the returned
+/// pointer afterwards.
+/// @param pkt Packet to set payload of
+/// @param arena Arena to allocate from
+/// @param len Length of the payload
+/// @return Writable payload memory, NULL if the arena is exhausted (payload of pkt is not changed then)
+uint8_t *coap_payload_alloc(coap_packet_t *pkt, coap_arena_t *arena, size_t len);
 void coap_option_nibble(uint32_t value, uint8_t *nibble);
 void coap_order_options(const coap_option_t *opts, const uint8_t num_opts, uint8_t* ordered_indices);
 
@@ -0,0 +1,359 @@
+#ifndef COAP_HPP
+#define COAP_HPP 1
+
+// Header-only C++20 layer over coap.h. All types are thin views or wrappers around the C structs, nothing allocates.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include "coap.h"
+
+namespace coap
+{
+
+using bytes = std::span<const uint8_t>;
+
+/// @brief Views a buffer as bytes
+inline bytes view(const coap_buffer_t &buf)
+{
+    return {buf.p, buf.len};
+}
+
+/// @brief Views a buffer as string, option values and payloads are not zero terminated
+inline std::string_view string_view(const coap_buffer_t &buf)
+{
+    return {reinterpret_cast<const char *>(buf.p), buf.len};
+}
+
+/// Minimal length encoding of an option value, usable in constant expressions, see coap_encode_uint()
+struct encoded_uint
+{
+    std::array<uint8_t, 4> value{};
+    uint8_t len = 0;
+
+    constexpr bytes view() const { return {value.data(), len}; }
+};
+
+constexpr encoded_uint encode_uint(uint32_t v)
+{
+    encoded_uint enc;
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        if ((v >> shift) != 0 || enc.len > 0)
+            enc.value[enc.len++] = static_cast<uint8_t>(v >> shift);
+    }
+    return enc;
+}
+
+/// @brief Encodes a Block1/Block2 value, see coap_make_option_blockwise()
+constexpr encoded_uint encode_block(coap_blocksize_t szx, bool more, uint32_t num)
+{
+    return encode_uint((num << 4) | (more ? 0x08U : 0U) | (static_cast<uint32_t>(szx) & 0x07U));
+}
+
+/// Option of a packet
+class option
+{
+public:
+    explicit option(const coap_option_t &opt) : opt_(&opt) {}
+
+    coap_option_num_t number() const { return static_cast<coap_option_num_t>(opt_->num); }
+    bytes value() const { return view(opt_->buf); }
+    std::string_view string() const { return string_view(opt_->buf); }
+
+    std::optional<uint32_t> uint() const
+    {
+        uint32_t v;
+        if (COAP_ERR_NONE != coap_decode_uint(&opt_->buf, &v))
+            return std::nullopt;
+        return v;
+    }
+
+    const coap_option_t &c() const { return *opt_; }
+
+private:
+    const coap_option_t *opt_;
+};
+
+/// Contiguous range of options for range-for loops
+class option_range
+{
+public:
+    class iterator
+    {
+    public:
+        using value_type = option;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(const coap_option_t *p) : p_(p) {}
+        option operator*() const { return option(*p_); }
+        iterator &operator++() { ++p_; return *this; }
+        iterator operator++(int) { iterator it = *this; ++p_; return it; }
+        bool operator==(const iterator &other) const = default;
+
+    private:
+        const coap_option_t *p_ = nullptr;
+    };
+
+    option_range(const coap_option_t *first, size_t count) : first_(first), count_(count) {}
+
+    iterator begin() const { return iterator(first_); }
+    iterator end() const { return iterator(first_ + count_); }
+    size_t size() const { return count_; }
+    bool empty() const { return 0 == count_; }
+
+private:
+    const coap_option_t *first_;
+    size_t count_;
+};
+
+/// Read-only view of a parsed or built packet
+class packet_view
+{
+public:
+    packet_view(const coap_packet_t &pkt) : pkt_(&pkt) {}
+
+    coap_msgtype_t type() const { return static_cast<coap_msgtype_t>(pkt_->hdr.t); }
+    coap_code_t code() const { return static_cast<coap_code_t>(pkt_->hdr.code); }
+    uint16_t id() const { return pkt_->hdr.id; }
+    bytes token() const { return view(pkt_->tok); }
+    bytes payload() const { return view(pkt_->payload); }
+
+    /// All options in ascending order
+    option_range options() const { return {pkt_->opts, pkt_->numopts}; }
+
+    /// All options with the given number, see coap_findOptions()
+    option_range options(coap_option_num_t num) const
+    {
+        uint8_t count;
+        const coap_option_t *first = coap_findOptions(pkt_, num, &count);
+        return {first, count};
+    }
+
+    std::optional<option> find(coap_option_num_t num) const
+    {
+        option_range range = options(num);
+        if (range.empty())
+            return std::nullopt;
+        return *range.begin();
+    }
+
+    std::optional<uint32_t> uint_option(coap_option_num_t num) const
+    {
+        uint32_t v;
+        if (!coap_option_get_uint(pkt_, num, &v))
+            return std::nullopt;
+        return v;
+    }
+
+    std::optional<std::string_view> string_option(coap_option_num_t num) const
+    {
+        std::optional<option> opt = find(num);
+        if (!opt)
+            return std::nullopt;
+        return opt->string();
+    }
+
+    const coap_packet_t &c() const { return *pkt_; }
+
+private:
+    const coap_packet_t *pkt_;
+};
+
+/// Packet stored by value, options and payload point into the parsed datagram or into buffers of the builder
+class packet
+{
+public:
+    // the option array is left uninitialized like in C, options beyond numopts are never read
+    packet()
+    {
+        pkt_.hdr = coap_header_t{1, COAP_TYPE_CON, 0, COAP_EMPTY, 0};
+        pkt_.tok = coap_buffer_t{nullptr, 0};
+        pkt_.numopts = 0;
+        pkt_.payload = coap_buffer_t{nullptr, 0};
+        pkt_.scratch_len = 0;
+    }
+    packet(const packet &) = delete;    // options may point into the scratch of this object
+    packet &operator=(const packet &) = delete;
+
+    /// @brief Parses a datagram, see coap_parse(). The datagram must outlive the packet.
+    coap_error_t parse(bytes datagram)
+    {
+        return static_cast<coap_error_t>(coap_parse(&pkt_, datagram.data(), datagram.size()));
+    }
+
+    /// @brief Builds the packet into out, see coap_build()
+    /// @return Written bytes on success, empty if the buffer is too small or the packet is invalid
+    std::optional<std::span<uint8_t>> build(std::span<uint8_t> out, coap_error_t *err = nullptr) const
+    {
+        size_t len = out.size();
+        coap_error_t rc = coap_build(out.data(), &len, &pkt_);
+        if (nullptr != err)
+            *err = rc;
+        if (COAP_ERR_NONE != rc)
+            return std::nullopt;
+        return out.first(len);
+    }
+
+    packet_view view() const { return pkt_; }
+    operator packet_view() const { return pkt_; }
+    coap_packet_t *c() { return &pkt_; }
+    const coap_packet_t *c() const { return &pkt_; }
+
+private:
+    coap_packet_t pkt_;
+};
+
+/// Releases everything allocated from an arena during its lifetime, see coap_arena_mark()
+class arena_scope
+{
+public:
+    explicit arena_scope(coap_arena_t &arena) : arena_(&arena), mark_(coap_arena_mark(&arena)) {}
+    ~arena_scope() { coap_arena_release(arena_, mark_); }
+    arena_scope(const arena_scope &) = delete;
+    arena_scope &operator=(const arena_scope &) = delete;
+
+private:
+    coap_arena_t *arena_;
+    coap_arena_mark_t mark_;
+};
+
+/// Adds options in ascending order. The number of the last option is part of the type, so adding a smaller
+/// number fails to compile. Constant values given as template arguments are encoded at compile time into static
+/// storage, runtime values use the packet scratch (see coap_add_option_uint()). Errors are sticky and reported by
+/// done().
+template <unsigned Last = 0>
+class builder
+{
+public:
+    builder(coap_packet_t *pkt, coap_error_t err) : pkt_(pkt), err_(err) {}
+
+    template <coap_option_num_t Num>
+    builder<Num> opaque(bytes value) const
+    {
+        static_assert(Num >= Last, "options must be added in ascending order");
+        builder<Num> next(pkt_, err_);
+        next.add(Num, value);
+        return next;
+    }
+
+    template <coap_option_num_t Num>
+    builder<Num> string(std::string_view value) const
+    {
+        return opaque<Num>(bytes(reinterpret_cast<const uint8_t *>(value.data()), value.size()));
+    }
+
+    template <coap_option_num_t Num>
+    builder<Num> empty() const
+    {
+        return opaque<Num>(bytes());
+    }
+
+    /// Constant value, encoded at compile time
+    template <coap_option_num_t Num, uint32_t Value>
+    builder<Num> uint() const
+    {
+        static constexpr encoded_uint encoded = encode_uint(Value);
+        return opaque<Num>(encoded.view());
+    }
+
+    /// Runtime value, encoded into the packet scratch
+    template <coap_option_num_t Num>
+    builder<Num> uint(uint32_t value) const
+    {
+        static_assert(Num >= Last, "options must be added in ascending order");
+        builder<Num> next(pkt_, err_);
+        if (COAP_ERR_NONE == next.err_)
+            next.err_ = coap_add_option_uint(pkt_, Num, value);
+        return next;
+    }
+
+    template <coap_option_num_t Num, coap_blocksize_t Szx, bool More, uint32_t BlockNum>
+    builder<Num> block() const
+    {
+        static_assert(Num == COAP_OPTION_BLOCK_1 || Num == COAP_OPTION_BLOCK_2, "not a block option");
+        static constexpr encoded_uint encoded = encode_block(Szx, More, BlockNum);
+        return opaque<Num>(encoded.view());
+    }
+
+    template <coap_option_num_t Num>
+    builder<Num> block(coap_blocksize_t szx, bool more, uint32_t num) const
+    {
+        static_assert(Num == COAP_OPTION_BLOCK_1 || Num == COAP_OPTION_BLOCK_2, "not a block option");
+        return uint<Num>((num << 4) | (more ? 0x08U : 0U) | (static_cast<uint32_t>(szx) & 0x07U));
+    }
+
+    /// Sets the payload, the memory must outlive the build
+    builder payload(bytes value) const
+    {
+        pkt_->payload.p = value.data();
+        pkt_->payload.len = value.size();
+        return *this;
+    }
+
+    builder payload(std::string_view value) const
+    {
+        return payload(bytes(reinterpret_cast<const uint8_t *>(value.data()), value.size()));
+    }
+
+    coap_error_t done() const { return err_; }
+
+private:
+    template <unsigned>
+    friend class builder;
+
+    void add(coap_option_num_t num, bytes value)
+    {
+        if (COAP_ERR_NONE != err_)
+            return;
+        if (pkt_->numopts >= MAXOPT)
+        {
+            err_ = COAP_ERR_BUFFER_TOO_SMALL;
+            return;
+        }
+        coap_add_option(pkt_, num, const_cast<uint8_t *>(value.data()), value.size());
+    }
+
+    coap_packet_t *pkt_;
+    coap_error_t err_;
+};
+
+/// @brief Starts building a message into pkt, which is reset
+/// @param pkt Packet to build
+/// @param type Message type
+/// @param code Method or response code
+/// @param id Message ID
+/// @param token Token, at most 8 bytes, must outlive the build
+inline builder<> message(packet &pkt, coap_msgtype_t type, coap_code_t code, uint16_t id, bytes token = {})
+{
+    coap_packet_t *c = pkt.c();
+    coap_header_init(c, type, code, id);
+    c->numopts = 0;
+    c->scratch_len = 0;
+    c->payload.p = nullptr;
+    c->payload.len = 0;
+    coap_header_add_token(c, token.data(), token.size());
+    return builder<>(c, (token.size() > 8) ? COAP_ERR_TOKEN_TOO_LONG : COAP_ERR_NONE);
+}
+
+/// @brief Starts building the response to a request: a piggybacked ACK for a Confirmable request, a NON message
+/// otherwise
+/// @param pkt Packet to build
+/// @param request Request to answer
+/// @param code Response code
+/// @param non_id Message ID of a NON response, which is a new message
+/// (http://tools.ietf.org/html/rfc7252#section-5.2.3). Not used for Confirmable requests, the ACK takes their ID.
+inline builder<> response(packet &pkt, packet_view request, coap_code_t code, uint16_t non_id)
+{
+    if (request.type() == COAP_TYPE_CON)
+        return message(pkt, COAP_TYPE_ACK, code, request.id(), request.token());
+    return message(pkt, COAP_TYPE_NONCON, code, non_id, request.token());
+}
+
+} // namespace coap
+
+#endif
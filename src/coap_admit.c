@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_admit.h"
+
+// Tokens of a full bucket, in 64 bits as burst * COAP_ADMIT_COST exceeds 32 bits for large bursts
+static uint32_t coap_admit_capacity(const coap_admit_limit_t *limit)
+{
+    uint64_t cap = (uint64_t)limit->burst * COAP_ADMIT_COST;
+    return (cap > UINT32_MAX) ? UINT32_MAX : (uint32_t)cap;
+}
+
+void coap_admit_init(coap_admit_t *adm, coap_admit_peer_t *peers, uint32_t num_peers, coap_admit_limit_t peer_limit, coap_admit_limit_t global_limit, uint32_t max_age, uint32_t now)
+{
+    coap_packet_t tmpl;
+    size_t len = sizeof(adm->reply);
+
+    memset(peers, 0, num_peers * sizeof(coap_admit_peer_t));
+    adm->peers = peers;
+    adm->mask = num_peers - 1;
+    adm->peer_limit = peer_limit;
+    adm->global_limit = global_limit;
+    adm->global.tokens = coap_admit_capacity(&global_limit);
+    adm->global.last = now;
+    adm->accepted = 0;
+    adm->rejected = 0;
+    adm->dropped = 0;
+
+    // the options of the 5.03 never change, only header and token are copied from the request
+    tmpl.numopts = 0;
+    tmpl.scratch_len = 0;
+    coap_add_option_uint(&tmpl, COAP_OPTION_MAX_AGE, max_age);
+    coap_build_options(adm->reply, &len, &tmpl);
+    adm->reply_len = (uint8_t)len;
+}
+
+static void coap_admit_refill(coap_admit_bucket_t *bucket, const coap_admit_limit_t *limit, uint32_t now)
+{
+    // a rate in requests per second is a rate in thousandths of a request per ms
+    uint64_t tokens = bucket->tokens + (uint64_t)(now - bucket->last) * limit->rate;
+    uint32_t cap = coap_admit_capacity(limit);
+    bucket->tokens = (tokens > cap) ? cap : (uint32_t)tokens;
+    bucket->last = now;
+}
+
+static coap_admit_peer_t *coap_admit_peer(coap_admit_t *adm, const coap_addr_t *addr, uint32_t now)
+{
+    coap_admit_peer_t *victim = NULL;
+    uint32_t hash = 2166136261U;
+    uint32_t i;
+
+    // FNV-1a
+    for (i = 0; i < addr->len; i++)
+        hash = (hash ^ addr->addr[i]) * 16777619U;
+
+    for (i = 0; i < COAP_ADMIT_PROBES; i++)
+    {
+        coap_admit_peer_t *p = &adm->peers[(hash + i) & adm->mask];
+        if (p->addr.len == addr->len && 0 == memcmp(p->addr.addr, addr->addr, addr->len))
+            return p;
+        // prefer unused slots, then the peer seen least recently
+        if (NULL == victim || (0 != victim->addr.len && (0 == p->addr.len || (int32_t)(p->bucket.last - victim->bucket.last) < 0)))
+            victim = p;
+    }
+    victim->addr.len = addr->len;
+    memcpy(victim->addr.addr, addr->addr, addr->len);
+    victim->bucket.tokens = coap_admit_capacity(&adm->peer_limit);
+    victim->bucket.last = now;
+    return victim;
+}
+
+coap_admit_verdict_t coap_admit(coap_admit_t *adm, const coap_addr_t *peer, const uint8_t *buf, size_t len, uint32_t now, uint8_t *outbuf, size_t *outlen)
+{
+    coap_header_t hdr;
+    coap_admit_peer_t *p;
+
+    *outlen = 0;
+    if (0 != coap_parseHeader(&hdr, buf, len) || COAP_EMPTY == hdr.code || hdr.code > COAP_LASTMETHOD)
+        return COAP_ADMIT_ACCEPT;
+    if ((hdr.t != COAP_TYPE_CON && hdr.t != COAP_TYPE_NONCON) || hdr.tkl > 8 || len < 4U + hdr.tkl)
+        return COAP_ADMIT_ACCEPT;
+    // addresses the peer table cannot hold are not metered, like in coap_cc_peer()
+    if (peer->len > COAP_ADDR_SIZE)
+    {
+        adm->accepted++;
+        return COAP_ADMIT_ACCEPT;
+    }
+
+    p = coap_admit_peer(adm, peer, now);
+    coap_admit_refill(&p->bucket, &adm->peer_limit, now);
+    coap_admit_refill(&adm->global, &adm->global_limit, now);
+    if (p->bucket.tokens >= COAP_ADMIT_COST && adm->global.tokens >= COAP_ADMIT_COST)
+    {
+        p->bucket.tokens -= COAP_ADMIT_COST;
+        adm->global.tokens -= COAP_ADMIT_COST;
+        adm->accepted++;
+        return COAP_ADMIT_ACCEPT;
+    }
+
+    if (COAP_TYPE_NONCON == hdr.t)
+    {
+        adm->dropped++;
+        return COAP_ADMIT_DROP;
+    }
+    // http://tools.ietf.org/html/rfc7252#section-5.9.3.4
+    outbuf[0] = 0x40 | (COAP_TYPE_ACK << 4) | hdr.tkl;
+    outbuf[1] = COAP_SERVICE_UNAVAILABLE;
+    outbuf[2] = buf[2];
+    outbuf[3] = buf[3];
+    memcpy(&outbuf[4], &buf[4], hdr.tkl);
+    memcpy(&outbuf[4 + hdr.tkl], adm->reply, adm->reply_len);
+    *outlen = 4U + hdr.tkl + adm->reply_len;
+    adm->rejected++;
+    return COAP_ADMIT_REJECT;
+}
@@ -0,0 +1,96 @@
+#ifndef COAP_ADMIT_H
+#define COAP_ADMIT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+#include "coap_cc.h"
+
+// Admission control: token buckets per peer and for all peers, checked right after the fixed header is parsed.
+// Excess Confirmable requests get a 5.03 with Max-Age, excess Non-confirmable requests are dropped. Only requests
+// are metered, responses, ACKs, RSTs and pings always pass. Times are ms from a caller provided clock.
+
+// Slots probed for a peer before the least recently seen one is replaced
+#ifndef COAP_ADMIT_PROBES
+#define COAP_ADMIT_PROBES 4
+#endif
+
+// Largest 5.03: header, token and Max-Age option
+#define COAP_ADMIT_REPLY_SIZE 20
+
+// Token bucket in thousandths of a request, a request costs COAP_ADMIT_COST
+#define COAP_ADMIT_COST 1000
+
+typedef enum
+{
+    COAP_ADMIT_ACCEPT = 0,              /* Process the datagram */
+    COAP_ADMIT_REJECT,                  /* Send the 5.03 in outbuf */
+    COAP_ADMIT_DROP                     /* Ignore the datagram */
+} coap_admit_verdict_t;
+
+typedef struct
+{
+    uint32_t rate;                      /* Requests per second */
+    uint32_t burst;                     /* Requests accepted at once after an idle period */
+} coap_admit_limit_t;
+
+typedef struct
+{
+    uint32_t tokens;                    /* Thousandths of a request */
+    uint32_t last;                      /* Time of the last refill */
+} coap_admit_bucket_t;
+
+typedef struct
+{
+    coap_addr_t addr;                   /* len is 0 for an unused slot */
+    coap_admit_bucket_t bucket;
+} coap_admit_peer_t;
+
+/// Admission state of one thread
+typedef struct
+{
+    coap_admit_peer_t *peers;
+    uint32_t mask;                      /* Number of peers - 1 */
+    coap_admit_limit_t peer_limit;
+    coap_admit_limit_t global_limit;
+    coap_admit_bucket_t global;
+    uint8_t reply[8];                   /* Max-Age option of the 5.03, following header and token */
+    uint8_t reply_len;
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t dropped;
+} coap_admit_t;
+
+/// @brief Initializes admission control with full buckets
+/// @param adm State to initialize
+/// @param peers Peer table storage, must stay valid as long as adm is used
+/// @param num_peers Number of peers, a power of two
+/// @param peer_limit Limit of each peer
+/// @param global_limit Limit of all peers together
+/// @param max_age Max-Age of the 5.03 in seconds, the time after which clients should retry
+/// @param now Current time
+void coap_admit_init(coap_admit_t *adm, coap_admit_peer_t *peers, uint32_t num_peers, coap_admit_limit_t peer_limit, coap_admit_limit_t global_limit, uint32_t max_age, uint32_t now);
+
+/// @brief Decides whether to process a datagram. Parses only the header, a rejected request costs a hash lookup
+/// and a copy of the token.
+/// @param adm Admission state
+/// @param peer Address of the sender
+/// @param buf Received datagram
+/// @param len Length of buf
+/// @param now Current time
+/// @param[out] outbuf Buffer for the 5.03, at least COAP_ADMIT_REPLY_SIZE bytes
+/// @param[out] outlen Length of the 5.03 for COAP_ADMIT_REJECT, 0 otherwise
+/// @return Verdict. Datagrams with an invalid header are accepted, the full parse reports the error. Requests of
+/// peers with an address longer than COAP_ADDR_SIZE are accepted without metering.
+coap_admit_verdict_t coap_admit(coap_admit_t *adm, const coap_addr_t *peer, const uint8_t *buf, size_t len, uint32_t now, uint8_t *outbuf, size_t *outlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_arena.h"
+
+void coap_arena_init(coap_arena_t *arena, uint8_t *buf, size_t len)
+{
+    arena->first.next = NULL;
+    arena->first.p = buf;
+    arena->first.len = len;
+    arena->cur = &arena->first;
+    arena->used = 0;
+}
+
+void coap_arena_add_block(coap_arena_t *arena, coap_arena_block_t *block, uint8_t *buf, size_t len)
+{
+    coap_arena_block_t *last = &arena->first;
+    while (NULL != last->next)
+        last = last->next;
+    block->next = NULL;
+    block->p = buf;
+    block->len = len;
+    last->next = block;
+}
+
+void *coap_arena_alloc(coap_arena_t *arena, size_t size, size_t align)
+{
+    coap_arena_block_t *block = arena->cur;
+    size_t used = arena->used;
+
+    while (NULL != block)
+    {
+        // align the address, not the offset, block memory itself may be unaligned
+        uintptr_t addr = (uintptr_t)(block->p + used);
+        size_t pad = (size_t)((align - (addr & (align - 1))) & (align - 1));
+        if (used + pad <= block->len && size <= block->len - used - pad)
+        {
+            arena->cur = block;
+            arena->used = used + pad + size;
+            return block->p + used + pad;
+        }
+        // skipped blocks are lost until the next release, allocations are usually much smaller than a block
+        block = block->next;
+        used = 0;
+    }
+    return NULL;
+}
+
+uint8_t *coap_arena_dup(coap_arena_t *arena, const void *src, size_t len)
+{
+    uint8_t *dst = coap_arena_alloc(arena, len, 1);
+    if (NULL != dst && len > 0)
+        memcpy(dst, src, len);
+    return dst;
+}
+
+coap_arena_mark_t coap_arena_mark(const coap_arena_t *arena)
+{
+    coap_arena_mark_t mark;
+    mark.block = arena->cur;
+    mark.used = arena->used;
+    return mark;
+}
+
+void coap_arena_release(coap_arena_t *arena, coap_arena_mark_t mark)
+{
+    arena->cur = mark.block;
+    arena->used = mark.used;
+}
+
+void coap_arena_reset(coap_arena_t *arena)
+{
+    arena->cur = &arena->first;
+    arena->used = 0;
+}
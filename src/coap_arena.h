@@ -0,0 +1,83 @@
+#ifndef COAP_ARENA_H
+#define COAP_ARENA_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Memory block an arena allocates from. The memory itself is always provided by the caller, the arena never calls
+/// malloc.
+typedef struct coap_arena_block
+{
+    struct coap_arena_block *next;  /* Next (overflow) block, NULL if this is the last block */
+    uint8_t *p;                     /* Memory of the block */
+    size_t len;                     /* Size of the memory in bytes */
+} coap_arena_block_t;
+
+/// Bump pointer arena. Allocations are served from the current block, when it is exhausted the arena moves on to
+/// the next chained overflow block. Memory is only given back all at once by coap_arena_reset() or
+/// coap_arena_release(). The arena must not be copied, as it references its own first block.
+typedef struct
+{
+    coap_arena_block_t first;       /* Block the arena was initialized with */
+    coap_arena_block_t *cur;        /* Block allocations are currently served from */
+    size_t used;                    /* Bytes used in cur */
+} coap_arena_t;
+
+/// Allocation state of an arena, see coap_arena_mark()
+typedef struct
+{
+    coap_arena_block_t *block;
+    size_t used;
+} coap_arena_mark_t;
+
+/// @brief Initializes an arena on caller provided memory
+/// @param arena Arena to initialize
+/// @param buf Memory to allocate from
+/// @param len Size of buf in bytes
+void coap_arena_init(coap_arena_t *arena, uint8_t *buf, size_t len);
+
+/// @brief Chains an overflow block to the end of the arena. It is only used once all blocks before it are exhausted.
+/// @param arena Arena to extend
+/// @param block Block descriptor, must stay valid as long as the arena is used
+/// @param buf Memory of the block
+/// @param len Size of buf in bytes
+void coap_arena_add_block(coap_arena_t *arena, coap_arena_block_t *block, uint8_t *buf, size_t len);
+
+/// @brief Allocates memory from the arena
+/// @param arena Arena to allocate from
+/// @param size Number of bytes to allocate
+/// @param align Alignment of the returned pointer, must be a power of two. Use 1 for byte buffers.
+/// @return Pointer to the allocated memory, NULL if neither the current nor any following block has enough room
+void *coap_arena_alloc(coap_arena_t *arena, size_t size, size_t align);
+
+/// @brief Allocates a copy of a byte buffer from the arena
+/// @param arena Arena to allocate from
+/// @param src Bytes to copy
+/// @param len Number of bytes to copy
+/// @return Pointer to the copy, NULL if the arena is exhausted
+uint8_t *coap_arena_dup(coap_arena_t *arena, const void *src, size_t len);
+
+/// @brief Records the current allocation state, so it can be restored by coap_arena_release()
+/// @param arena Arena to mark
+/// @return Allocation state
+coap_arena_mark_t coap_arena_mark(const coap_arena_t *arena);
+
+/// @brief Frees everything allocated after mark was taken
+/// @param arena Arena to release memory of
+/// @param mark State returned by coap_arena_mark() on the same arena
+void coap_arena_release(coap_arena_t *arena, coap_arena_mark_t mark);
+
+/// @brief Frees all memory of the arena, overflow blocks stay chained
+/// @param arena Arena to reset
+void coap_arena_reset(coap_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
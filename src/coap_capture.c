@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_capture.h"
+#include "byte_order.h"
+
+#define COAP_CAPTURE_LINKTYPE_IPV4 228
+#define COAP_CAPTURE_HEADROOM 28    // IPv4 and UDP header
+
+void coap_capture_init(coap_capture_t *cap, coap_capture_slot_t *slots, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        atomic_init(&slots[i].seq, i);
+    cap->slots = slots;
+    cap->mask = count - 1;
+    atomic_init(&cap->tail, 0);
+    cap->head = 0;
+    atomic_init(&cap->dropped, 0);
+    atomic_init(&cap->sampled, 0);
+    coap_capture_filter(cap, 1, -1, 0);
+}
+
+void coap_capture_filter(coap_capture_t *cap, uint32_t sample_every, int16_t code, uint16_t option)
+{
+    cap->sample_every = (0 == sample_every) ? 1 : sample_every;
+    cap->code = code;
+    cap->option = option;
+}
+
+static bool coap_capture_matches(const coap_capture_t *cap, const uint8_t *buf, size_t len)
+{
+    coap_header_t hdr;
+    coap_option_t opt;
+    uint16_t delta = 0;
+    const uint8_t *p, *end = buf + len;
+
+    if (cap->code < 0 && 0 == cap->option)
+        return true;
+    if (0 != coap_parseHeader(&hdr, buf, len))
+        return false;
+    if (cap->code >= 0 && hdr.code != cap->code)
+        return false;
+    if (0 == cap->option)
+        return true;
+    // options are sorted, so the walk ends at the first larger option
+    for (p = buf + 4 + hdr.tkl; p < end && *p != 0xFF; )
+    {
+        if (0 != coap_parseOption(&opt, &delta, &p, end - p) || opt.num > cap->option)
+            return false;
+        if (opt.num == cap->option)
+            return true;
+    }
+    return false;
+}
+
+bool coap_capture_record(coap_capture_t *cap, const uint8_t *buf, size_t len, coap_capture_dir_t dir, uint64_t ts_ns)
+{
+    coap_capture_slot_t *slot;
+    size_t pos, seq;
+
+    if (!coap_capture_matches(cap, buf, len))
+        return false;
+    if (cap->sample_every > 1 && 0 != atomic_fetch_add_explicit(&cap->sampled, 1, memory_order_relaxed) % cap->sample_every)
+        return false;
+
+    // bounded MPMC queue by Dmitry Vyukov: a slot is free for position pos if its sequence equals pos
+    pos = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+    while (true)
+    {
+        slot = &cap->slots[pos & cap->mask];
+        seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos)
+        {
+            if (atomic_compare_exchange_weak_explicit(&cap->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if ((ptrdiff_t)(seq - pos) < 0)
+        {
+            atomic_fetch_add_explicit(&cap->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        else
+            pos = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+    }
+
+    slot->ts_ns = ts_ns;
+    slot->len = (uint32_t)len;
+    slot->caplen = (uint16_t)((len < COAP_CAPTURE_SNAPLEN) ? len : COAP_CAPTURE_SNAPLEN);
+    slot->dir = (uint8_t)dir;
+    memcpy(slot->data, buf, slot->caplen);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+bool coap_capture_write_header(coap_capture_write_func write, void *ctx)
+{
+    // https://datatracker.ietf.org/doc/draft-ietf-opsawg-pcap/, fields in host byte order
+    struct
+    {
+        uint32_t magic;
+        uint16_t major;
+        uint16_t minor;
+        uint32_t reserved[2];
+        uint32_t snaplen;
+        uint32_t linktype;
+    } hdr = {0xA1B23C4D, 2, 4, {0, 0}, COAP_CAPTURE_SNAPLEN + COAP_CAPTURE_HEADROOM, COAP_CAPTURE_LINKTYPE_IPV4};
+    return write(ctx, &hdr, sizeof(hdr));
+}
+
+static void coap_capture_udp_header(uint8_t *p, const coap_capture_slot_t *slot)
+{
+    static const uint8_t own[4] = {192, 0, 2, 1};
+    static const uint8_t peer[4] = {192, 0, 2, 2};
+    uint16_t port = 5683;
+    uint32_t sum = 0;
+    int i;
+
+    // http://tools.ietf.org/html/rfc791#section-3.1
+    p[0] = 0x45;
+    p[1] = 0;
+    endian_store16(&p[2], (uint16_t)(COAP_CAPTURE_HEADROOM + slot->len));
+    memset(&p[4], 0, 4);    // identification, no fragmentation
+    p[8] = 64;              // TTL
+    p[9] = 17;              // UDP
+    memset(&p[10], 0, 2);
+    memcpy(&p[12], (slot->dir == COAP_CAPTURE_IN) ? peer : own, 4);
+    memcpy(&p[16], (slot->dir == COAP_CAPTURE_IN) ? own : peer, 4);
+    for (i = 0; i < 20; i += 2)
+        sum += ((uint32_t)p[i] << 8) | p[i + 1];
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    endian_store16(&p[10], (uint16_t)~sum);
+
+    // http://tools.ietf.org/html/rfc768, checksum 0 means none
+    endian_store16(&p[20], port);
+    endian_store16(&p[22], port);
+    endian_store16(&p[24], (uint16_t)(8 + slot->len));
+    memset(&p[26], 0, 2);
+}
+
+size_t coap_capture_drain(coap_capture_t *cap, coap_capture_write_func write, void *ctx)
+{
+    size_t written = 0;
+
+    while (true)
+    {
+        coap_capture_slot_t *slot = &cap->slots[cap->head & cap->mask];
+        uint32_t rec[4];
+        uint8_t headers[COAP_CAPTURE_HEADROOM];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != cap->head + 1)
+            break;
+        rec[0] = (uint32_t)(slot->ts_ns / 1000000000U);
+        rec[1] = (uint32_t)(slot->ts_ns % 1000000000U);
+        rec[2] = COAP_CAPTURE_HEADROOM + slot->caplen;
+        rec[3] = COAP_CAPTURE_HEADROOM + slot->len;
+        coap_capture_udp_header(headers, slot);
+        if (!write(ctx, rec, sizeof(rec)) || !write(ctx, headers, sizeof(headers)) || !write(ctx, slot->data, slot->caplen))
+            break;
+        atomic_store_explicit(&slot->seq, cap->head + cap->mask + 1, memory_order_release);
+        cap->head++;
+        written++;
+    }
+    return written;
+}
@@ -0,0 +1,95 @@
+#ifndef COAP_CAPTURE_H
+#define COAP_CAPTURE_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap.h"
+
+// Capture of raw datagrams into a lock-free ring, written out as pcap by a background thread. Each datagram gets a
+// synthesized IPv4/UDP header (peer 192.0.2.2, own address 192.0.2.1, port 5683 on both sides), so Wireshark's CoAP
+// dissector decodes the file without configuration.
+
+// Bytes of a datagram that are stored, longer datagrams are truncated
+#ifndef COAP_CAPTURE_SNAPLEN
+#define COAP_CAPTURE_SNAPLEN 1280
+#endif
+
+typedef enum
+{
+    COAP_CAPTURE_IN = 0,        /* Received from the peer */
+    COAP_CAPTURE_OUT = 1        /* Sent to the peer */
+} coap_capture_dir_t;
+
+typedef struct
+{
+    _Atomic size_t seq;         /* Ring sequence, see coap_capture_record() */
+    uint64_t ts_ns;
+    uint32_t len;               /* Length of the datagram */
+    uint16_t caplen;            /* Stored bytes */
+    uint8_t dir;
+    uint8_t data[COAP_CAPTURE_SNAPLEN];
+} coap_capture_slot_t;
+
+/// Bounded multi-producer, single-consumer ring of captured datagrams
+typedef struct
+{
+    coap_capture_slot_t *slots;
+    size_t mask;                /* Number of slots - 1 */
+    _Atomic size_t tail;        /* Next slot to claim by a producer */
+    size_t head;                /* Next slot to write out by the consumer */
+    _Atomic uint64_t dropped;   /* Datagrams lost because the ring was full */
+    _Atomic uint32_t sampled;   /* Datagrams seen by the sampler */
+    uint32_t sample_every;      /* Capture only every n-th datagram passing the filter, 1 captures all */
+    int16_t code;               /* Capture only this code, -1 for any */
+    uint16_t option;            /* Capture only datagrams containing this option, 0 for any */
+} coap_capture_t;
+
+/// Callback writing out pcap data, returns false on error
+typedef bool (*coap_capture_write_func)(void *ctx, const void *data, size_t len);
+
+/// @brief Initializes an empty capture ring which captures everything
+/// @param cap Capture to initialize
+/// @param slots Slot storage, must stay valid as long as the capture is used
+/// @param count Number of slots, must be a power of two
+void coap_capture_init(coap_capture_t *cap, coap_capture_slot_t *slots, size_t count);
+
+/// @brief Restricts the capture. Must not be called while datagrams are recorded.
+/// @param cap Capture
+/// @param sample_every Capture every n-th matching datagram, 1 for all
+/// @param code Code to capture, -1 for any
+/// @param option Option that must be present, 0 for any
+void coap_capture_filter(coap_capture_t *cap, uint32_t sample_every, int16_t code, uint16_t option);
+
+/// @brief Records a datagram if it passes filter and sampling. Lock-free, may be called from any thread.
+/// @param cap Capture
+/// @param buf Datagram
+/// @param len Length of the datagram
+/// @param dir Direction
+/// @param ts_ns Timestamp in ns since the epoch
+/// @return True if the datagram was recorded, false if it was filtered out or the ring is full
+bool coap_capture_record(coap_capture_t *cap, const uint8_t *buf, size_t len, coap_capture_dir_t dir, uint64_t ts_ns);
+
+/// @brief Writes the pcap file header (nanosecond timestamps, link type IPv4)
+/// @param write Output callback
+/// @param ctx Context of the callback
+/// @return True on success
+bool coap_capture_write_header(coap_capture_write_func write, void *ctx);
+
+/// @brief Writes all recorded datagrams as pcap records. Must only be called by one thread at a time.
+/// @param cap Capture
+/// @param write Output callback
+/// @param ctx Context of the callback
+/// @return Number of written records, stops early if the callback fails
+size_t coap_capture_drain(coap_capture_t *cap, coap_capture_write_func write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_cbor.h"
+
+#define COAP_CBOR_INDEFINITE UINT64_MAX
+
+void coap_cbor_reader_init(coap_cbor_reader_t *reader, const coap_buffer_t *buf)
+{
+    reader->p = buf->p;
+    reader->end = buf->p + buf->len;
+}
+
+bool coap_cbor_at_end(const coap_cbor_reader_t *reader)
+{
+    return reader->p >= reader->end;
+}
+
+static uint64_t coap_cbor_load(const uint8_t *p, uint8_t len)
+{
+    uint64_t value = 0;
+    uint8_t i;
+    for (i = 0; i < len; i++)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+//http://tools.ietf.org/html/rfc8949#appendix-D
+static double coap_cbor_half_to_double(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exp = (half >> 10) & 0x1F;
+    uint32_t mant = half & 0x3FF;
+    uint32_t bits;
+    float f;
+
+    if (exp == 0)
+    {
+        // subnormal, mant * 2^-24
+        f = (float)mant / 16777216.0f;
+        return sign ? -f : f;
+    }
+    if (exp == 31)
+        bits = sign | 0x7F800000U | (mant << 13);
+    else
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+coap_error_t coap_cbor_read(coap_cbor_reader_t *reader, coap_cbor_item_t *item)
+{
+    const uint8_t *p = reader->p;
+    size_t avail = reader->end - p;
+    uint8_t major, info, arglen;
+    uint64_t arg;
+
+    if (avail < 1)
+        return COAP_ERR_CBOR_INVALID;
+    major = p[0] >> 5;
+    info = p[0] & 0x1F;
+    p++;
+    avail--;
+
+    // http://tools.ietf.org/html/rfc8949#section-3
+    if (info < 24)
+        arglen = 0;
+    else if (info <= 27)
+        arglen = 1 << (info - 24);
+    else if (info == 31 && (major >= COAP_CBOR_BYTES && major != COAP_CBOR_TAG))
+        arglen = 0;
+    else
+        return COAP_ERR_CBOR_INVALID;
+    if (avail < arglen)
+        return COAP_ERR_CBOR_INVALID;
+    arg = (arglen > 0) ? coap_cbor_load(p, arglen) : info;
+    p += arglen;
+    avail -= arglen;
+
+    item->indefinite = (info == 31);
+    item->val = arg;
+    item->str.p = NULL;
+    item->str.len = 0;
+    item->f = 0;
+
+    switch (major)
+    {
+    case 0:
+    case 1:
+    case 6:
+        item->type = (coap_cbor_type_t)major;
+        break;
+    case 2:
+    case 3:
+        item->type = (coap_cbor_type_t)major;
+        if (!item->indefinite)
+        {
+            if (arg > avail)
+                return COAP_ERR_CBOR_INVALID;
+            item->str.p = p;
+            item->str.len = (size_t)arg;
+            p += arg;
+        }
+        break;
+    case 4:
+    case 5:
+        item->type = (coap_cbor_type_t)major;
+        // every item takes at least one byte, this also keeps coap_cbor_skip() from overflowing its counters
+        if (!item->indefinite && arg > avail / (major == 5 ? 2 : 1))
+            return COAP_ERR_CBOR_INVALID;
+        break;
+    default:
+        if (info == 31)
+        {
+            item->type = COAP_CBOR_BREAK;
+            item->indefinite = false;
+        }
+        else if (info == 25)
+        {
+            item->type = COAP_CBOR_FLOAT;
+            item->f = coap_cbor_half_to_double((uint16_t)arg);
+        }
+        else if (info == 26)
+        {
+            uint32_t bits = (uint32_t)arg;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            item->type = COAP_CBOR_FLOAT;
+            item->f = f;
+        }
+        else if (info == 27)
+        {
+            memcpy(&item->f, &arg, sizeof(item->f));
+            item->type = COAP_CBOR_FLOAT;
+        }
+        else
+        {
+            item->type = COAP_CBOR_SIMPLE;
+        }
+        break;
+    }
+    reader->p = p;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_cbor_skip(coap_cbor_reader_t *reader)
+{
+    uint64_t remaining[COAP_CBOR_MAX_DEPTH + 1];    // items left per nesting level
+    size_t depth = 0;
+    coap_cbor_item_t item;
+    coap_error_t err;
+
+    remaining[0] = 1;
+    while (true)
+    {
+        if (COAP_ERR_NONE != (err = coap_cbor_read(reader, &item)))
+            return err;
+        if (item.type == COAP_CBOR_BREAK)
+        {
+            if (remaining[depth] != COAP_CBOR_INDEFINITE)
+                return COAP_ERR_CBOR_INVALID;
+            depth--;
+        }
+        else if (item.type != COAP_CBOR_TAG)   // a tag and the item it tags count as one
+        {
+            if (remaining[depth] != COAP_CBOR_INDEFINITE)
+                remaining[depth]--;
+            if (item.type == COAP_CBOR_ARRAY || item.type == COAP_CBOR_MAP || item.indefinite)
+            {
+                if (depth == COAP_CBOR_MAX_DEPTH)
+                    return COAP_ERR_UNSUPPORTED;
+                depth++;
+                if (item.indefinite)
+                    remaining[depth] = COAP_CBOR_INDEFINITE;
+                else
+                    remaining[depth] = (item.type == COAP_CBOR_MAP) ? 2 * item.val : item.val;
+            }
+        }
+        while (depth > 0 && remaining[depth] == 0)
+            depth--;
+        if (depth == 0 && remaining[0] == 0)
+            return COAP_ERR_NONE;
+    }
+}
+
+bool coap_cbor_get_int(const coap_cbor_item_t *item, int64_t *value)
+{
+    if ((item->type != COAP_CBOR_UINT && item->type != COAP_CBOR_NEGINT) || item->val > INT64_MAX)
+        return false;
+    *value = (item->type == COAP_CBOR_UINT) ? (int64_t)item->val : -1 - (int64_t)item->val;
+    return true;
+}
+
+bool coap_cbor_get_double(const coap_cbor_item_t *item, double *value)
+{
+    if (item->type == COAP_CBOR_FLOAT)
+        *value = item->f;
+    else if (item->type == COAP_CBOR_UINT)
+        *value = (double)item->val;
+    else if (item->type == COAP_CBOR_NEGINT)
+        *value = -1.0 - (double)item->val;
+    else
+        return false;
+    return true;
+}
+
+void coap_cbor_writer_init(coap_cbor_writer_t *writer, uint8_t *buf, size_t len)
+{
+    writer->p = buf;
+    writer->len = len;
+    writer->used = 0;
+    writer->head_len = 0;
+    writer->err = COAP_ERR_NONE;
+}
+
+coap_error_t coap_cbor_writer_init_payload(coap_cbor_writer_t *writer, coap_packet_t *pkt, coap_arena_t *arena, size_t cap)
+{
+    uint8_t *payload = coap_payload_alloc(pkt, arena, cap);
+    coap_cbor_writer_init(writer, payload, (NULL != payload) ? cap : 0);
+    if (NULL == payload)
+        writer->err = COAP_ERR_BUFFER_TOO_SMALL;
+    return writer->err;
+}
+
+coap_error_t coap_cbor_writer_finish_payload(const coap_cbor_writer_t *writer, coap_packet_t *pkt)
+{
+    pkt->payload.p = writer->p;
+    pkt->payload.len = (COAP_ERR_NONE == writer->err) ? writer->used : 0;
+    return writer->err;
+}
+
+coap_error_t coap_cbor_build_begin(coap_cbor_writer_t *writer, uint8_t *buf, size_t buflen, const coap_packet_t *pkt)
+{
+    size_t head_len = buflen;
+    coap_error_t err = coap_build_head(buf, &head_len, pkt);
+
+    if (COAP_ERR_NONE == err && head_len >= buflen)
+        err = COAP_ERR_BUFFER_TOO_SMALL;
+    if (COAP_ERR_NONE != err)
+    {
+        coap_cbor_writer_init(writer, buf, 0);
+        writer->err = err;
+        return err;
+    }
+    buf[head_len] = 0xFF;   // payload marker
+    coap_cbor_writer_init(writer, buf + head_len + 1, buflen - head_len - 1);
+    writer->head_len = head_len + 1;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_cbor_build_end(const coap_cbor_writer_t *writer, size_t *msglen)
+{
+    if (COAP_ERR_NONE != writer->err)
+        return writer->err;
+    // without payload the payload marker must not be sent
+    *msglen = (writer->used > 0) ? writer->head_len + writer->used : writer->head_len - 1;
+    return COAP_ERR_NONE;
+}
+
+static coap_error_t coap_cbor_put(coap_cbor_writer_t *writer, const uint8_t *bytes, size_t len)
+{
+    if (COAP_ERR_NONE != writer->err)
+        return writer->err;
+    if (len > writer->len - writer->used)
+    {
+        writer->err = COAP_ERR_BUFFER_TOO_SMALL;
+        return writer->err;
+    }
+    if (len > 0)
+        memcpy(writer->p + writer->used, bytes, len);
+    writer->used += len;
+    return COAP_ERR_NONE;
+}
+
+static coap_error_t coap_cbor_put_head(coap_cbor_writer_t *writer, uint8_t major, uint64_t arg)
+{
+    uint8_t head[9];
+    uint8_t len, i;
+
+    if (arg < 24)
+    {
+        head[0] = (major << 5) | (uint8_t)arg;
+        return coap_cbor_put(writer, head, 1);
+    }
+    if (arg <= 0xFF)
+        len = 1;
+    else if (arg <= 0xFFFF)
+        len = 2;
+    else if (arg <= 0xFFFFFFFFU)
+        len = 4;
+    else
+        len = 8;
+    head[0] = (major << 5) | (uint8_t)(24 + (len == 1 ? 0 : len == 2 ? 1 : len == 4 ? 2 : 3));
+    for (i = 0; i < len; i++)
+        head[len - i] = (uint8_t)(arg >> (8 * i));
+    return coap_cbor_put(writer, head, len + 1U);
+}
+
+coap_error_t coap_cbor_write_uint(coap_cbor_writer_t *writer, uint64_t value)
+{
+    return coap_cbor_put_head(writer, COAP_CBOR_UINT, value);
+}
+
+coap_error_t coap_cbor_write_int(coap_cbor_writer_t *writer, int64_t value)
+{
+    if (value >= 0)
+        return coap_cbor_put_head(writer, COAP_CBOR_UINT, (uint64_t)value);
+    return coap_cbor_put_head(writer, COAP_CBOR_NEGINT, (uint64_t)(-1 - value));
+}
+
+coap_error_t coap_cbor_write_bytes(coap_cbor_writer_t *writer, const uint8_t *bytes, size_t len)
+{
+    coap_cbor_put_head(writer, COAP_CBOR_BYTES, len);
+    return coap_cbor_put(writer, bytes, len);
+}
+
+coap_error_t coap_cbor_write_text(coap_cbor_writer_t *writer, const char *text, size_t len)
+{
+    coap_cbor_put_head(writer, COAP_CBOR_TEXT, len);
+    return coap_cbor_put(writer, (const uint8_t *)text, len);
+}
+
+coap_error_t coap_cbor_write_array(coap_cbor_writer_t *writer, size_t len)
+{
+    return coap_cbor_put_head(writer, COAP_CBOR_ARRAY, len);
+}
+
+coap_error_t coap_cbor_write_map(coap_cbor_writer_t *writer, size_t len)
+{
+    return coap_cbor_put_head(writer, COAP_CBOR_MAP, len);
+}
+
+coap_error_t coap_cbor_write_array_indefinite(coap_cbor_writer_t *writer)
+{
+    const uint8_t head = (COAP_CBOR_ARRAY << 5) | 31;
+    return coap_cbor_put(writer, &head, 1);
+}
+
+coap_error_t coap_cbor_write_map_indefinite(coap_cbor_writer_t *writer)
+{
+    const uint8_t head = (COAP_CBOR_MAP << 5) | 31;
+    return coap_cbor_put(writer, &head, 1);
+}
+
+coap_error_t coap_cbor_write_break(coap_cbor_writer_t *writer)
+{
+    const uint8_t head = 0xFF;
+    return coap_cbor_put(writer, &head, 1);
+}
+
+coap_error_t coap_cbor_write_tag(coap_cbor_writer_t *writer, uint64_t tag)
+{
+    return coap_cbor_put_head(writer, COAP_CBOR_TAG, tag);
+}
+
+coap_error_t coap_cbor_write_bool(coap_cbor_writer_t *writer, bool value)
+{
+    return coap_cbor_put_head(writer, 7, value ? COAP_CBOR_TRUE : COAP_CBOR_FALSE);
+}
+
+coap_error_t coap_cbor_write_null(coap_cbor_writer_t *writer)
+{
+    return coap_cbor_put_head(writer, 7, COAP_CBOR_NULL);
+}
+
+coap_error_t coap_cbor_write_double(coap_cbor_writer_t *writer, double value)
+{
+    uint8_t out[9];
+    float f = (float)value;
+    uint8_t i;
+
+    if ((double)f == value || value != value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        out[0] = 0xFA;
+        for (i = 0; i < 4; i++)
+            out[4 - i] = (uint8_t)(bits >> (8 * i));
+        return coap_cbor_put(writer, out, 5);
+    }
+    else
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        out[0] = 0xFB;
+        for (i = 0; i < 8; i++)
+            out[8 - i] = (uint8_t)(bits >> (8 * i));
+        return coap_cbor_put(writer, out, 9);
+    }
+}
@@ -0,0 +1,173 @@
+#ifndef COAP_CBOR_H
+#define COAP_CBOR_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Maximum nesting of arrays, maps and indefinite length strings coap_cbor_skip() can step over
+#ifndef COAP_CBOR_MAX_DEPTH
+#define COAP_CBOR_MAX_DEPTH 16
+#endif
+
+//http://tools.ietf.org/html/rfc8949#section-3.1
+typedef enum
+{
+    COAP_CBOR_UINT = 0,         /* Unsigned integer, value in val */
+    COAP_CBOR_NEGINT = 1,       /* Negative integer -1 - val */
+    COAP_CBOR_BYTES = 2,        /* Byte string, content in str */
+    COAP_CBOR_TEXT = 3,         /* UTF-8 text string, content in str */
+    COAP_CBOR_ARRAY = 4,        /* Array of val items, the items follow */
+    COAP_CBOR_MAP = 5,          /* Map of val key/value pairs, the pairs follow */
+    COAP_CBOR_TAG = 6,          /* Tag number val, the tagged item follows */
+    COAP_CBOR_SIMPLE = 7,       /* Simple value val, see COAP_CBOR_FALSE etc. */
+    COAP_CBOR_FLOAT = 8,        /* Half, single or double precision float, value in f */
+    COAP_CBOR_BREAK = 9         /* End of an indefinite length array, map or string */
+} coap_cbor_type_t;
+
+//http://tools.ietf.org/html/rfc8949#section-3.3
+#define COAP_CBOR_FALSE 20
+#define COAP_CBOR_TRUE 21
+#define COAP_CBOR_NULL 22
+#define COAP_CBOR_UNDEFINED 23
+
+/// One data item header as read by coap_cbor_read()
+typedef struct
+{
+    coap_cbor_type_t type;
+    bool indefinite;            /* Array, map or string of indefinite length. Items or string chunks follow until
+                                 * an item of type COAP_CBOR_BREAK. */
+    uint64_t val;               /* Integer argument: value, number of items, tag number or simple value */
+    double f;                   /* Value of COAP_CBOR_FLOAT */
+    coap_buffer_t str;          /* Content of COAP_CBOR_BYTES and COAP_CBOR_TEXT, points into the read buffer */
+} coap_cbor_item_t;
+
+/// Pull parser over a CBOR encoded buffer (usually pkt->payload). It never copies or allocates, strings are
+/// returned as views into the buffer, which must therefore stay valid while items are used.
+typedef struct
+{
+    const uint8_t *p;           /* Next byte to read */
+    const uint8_t *end;         /* End of buffer */
+} coap_cbor_reader_t;
+
+/// Serializer into a caller provided buffer. Errors are sticky: once a write failed, all following writes fail
+/// with the same error and nothing more is written, so it is sufficient to check the result of the last call.
+typedef struct
+{
+    uint8_t *p;                 /* Output buffer */
+    size_t len;                 /* Size of p */
+    size_t used;                /* Bytes written to p */
+    size_t head_len;            /* Bytes of the message in front of p, only used by coap_cbor_build_begin() */
+    coap_error_t err;           /* First error */
+} coap_cbor_writer_t;
+
+//http://tools.ietf.org/html/rfc8428#section-6
+typedef enum
+{
+    COAP_SENML_BASE_VERSION = -1,
+    COAP_SENML_BASE_NAME = -2,
+    COAP_SENML_BASE_TIME = -3,
+    COAP_SENML_BASE_UNIT = -4,
+    COAP_SENML_BASE_VALUE = -5,
+    COAP_SENML_BASE_SUM = -6,
+    COAP_SENML_NAME = 0,
+    COAP_SENML_UNIT = 1,
+    COAP_SENML_VALUE = 2,
+    COAP_SENML_STRING_VALUE = 3,
+    COAP_SENML_BOOL_VALUE = 4,
+    COAP_SENML_SUM = 5,
+    COAP_SENML_TIME = 6,
+    COAP_SENML_UPDATE_TIME = 7,
+    COAP_SENML_DATA_VALUE = 8
+} coap_senml_label_t;
+
+/// @brief Initializes a reader
+/// @param reader Reader to initialize
+/// @param buf CBOR data, for example the payload of a parsed packet
+void coap_cbor_reader_init(coap_cbor_reader_t *reader, const coap_buffer_t *buf);
+
+/// @brief Checks whether all data has been read
+/// @return True if no bytes are left
+bool coap_cbor_at_end(const coap_cbor_reader_t *reader);
+
+/// @brief Reads the next data item header. Arrays and maps are not descended into automatically, their items are
+/// returned by the following calls.
+/// @param reader Reader
+/// @param[out] item Item read
+/// @return COAP_ERR_NONE on success, COAP_ERR_CBOR_INVALID if the data is malformed or truncated
+coap_error_t coap_cbor_read(coap_cbor_reader_t *reader, coap_cbor_item_t *item);
+
+/// @brief Skips the next complete data item, including all nested items
+/// @param reader Reader
+/// @return COAP_ERR_NONE on success, COAP_ERR_CBOR_INVALID if the data is malformed or truncated,
+/// COAP_ERR_UNSUPPORTED if it is nested deeper than COAP_CBOR_MAX_DEPTH
+coap_error_t coap_cbor_skip(coap_cbor_reader_t *reader);
+
+/// @brief Retrieves the value of an integer item
+/// @param item Item of type COAP_CBOR_UINT or COAP_CBOR_NEGINT
+/// @param[out] value Value
+/// @return True on success, false if item is no integer or does not fit into int64_t
+bool coap_cbor_get_int(const coap_cbor_item_t *item, int64_t *value);
+
+/// @brief Retrieves the value of a numeric item, integers are converted
+/// @param item Item of type COAP_CBOR_UINT, COAP_CBOR_NEGINT or COAP_CBOR_FLOAT
+/// @param[out] value Value
+/// @return True on success, false if item is not numeric
+bool coap_cbor_get_double(const coap_cbor_item_t *item, double *value);
+
+/// @brief Initializes a writer on a caller provided buffer
+void coap_cbor_writer_init(coap_cbor_writer_t *writer, uint8_t *buf, size_t len);
+
+/// @brief Initializes a writer on a payload of up to cap bytes allocated from an arena, see coap_payload_alloc().
+/// Call coap_cbor_writer_finish_payload() once done.
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the arena is exhausted
+coap_error_t coap_cbor_writer_init_payload(coap_cbor_writer_t *writer, coap_packet_t *pkt, coap_arena_t *arena, size_t cap);
+
+/// @brief Sets the payload of pkt to the bytes written, counterpart of coap_cbor_writer_init_payload()
+/// @return First error of the writer, the payload is emptied on error
+coap_error_t coap_cbor_writer_finish_payload(const coap_cbor_writer_t *writer, coap_packet_t *pkt);
+
+/// @brief Builds header, token and options of pkt into buf and positions the writer behind the payload marker, so
+/// the payload is serialized straight into the output buffer. Call coap_cbor_build_end() once done.
+/// @param writer Writer to initialize
+/// @param buf Buffer to build the message into
+/// @param buflen Size of buf
+/// @param pkt Packet to build, its payload is ignored
+/// @return COAP_ERR_NONE on success, otherwise the error of coap_build_head()
+coap_error_t coap_cbor_build_begin(coap_cbor_writer_t *writer, uint8_t *buf, size_t buflen, const coap_packet_t *pkt);
+
+/// @brief Completes a message started by coap_cbor_build_begin()
+/// @param writer Writer
+/// @param[out] msglen Total length of the message. The payload marker is dropped if nothing was written.
+/// @return First error of the writer
+coap_error_t coap_cbor_build_end(const coap_cbor_writer_t *writer, size_t *msglen);
+
+coap_error_t coap_cbor_write_uint(coap_cbor_writer_t *writer, uint64_t value);
+coap_error_t coap_cbor_write_int(coap_cbor_writer_t *writer, int64_t value);
+coap_error_t coap_cbor_write_bytes(coap_cbor_writer_t *writer, const uint8_t *bytes, size_t len);
+coap_error_t coap_cbor_write_text(coap_cbor_writer_t *writer, const char *text, size_t len);
+/// @brief Writes the header of an array, the len items are written afterwards
+coap_error_t coap_cbor_write_array(coap_cbor_writer_t *writer, size_t len);
+/// @brief Writes the header of a map, the len key/value pairs are written afterwards
+coap_error_t coap_cbor_write_map(coap_cbor_writer_t *writer, size_t len);
+/// @brief Writes the header of an indefinite length array, terminate it with coap_cbor_write_break()
+coap_error_t coap_cbor_write_array_indefinite(coap_cbor_writer_t *writer);
+/// @brief Writes the header of an indefinite length map, terminate it with coap_cbor_write_break()
+coap_error_t coap_cbor_write_map_indefinite(coap_cbor_writer_t *writer);
+coap_error_t coap_cbor_write_break(coap_cbor_writer_t *writer);
+coap_error_t coap_cbor_write_tag(coap_cbor_writer_t *writer, uint64_t tag);
+coap_error_t coap_cbor_write_bool(coap_cbor_writer_t *writer, bool value);
+coap_error_t coap_cbor_write_null(coap_cbor_writer_t *writer);
+/// @brief Writes a float, as single precision if that is lossless, otherwise as double precision
+coap_error_t coap_cbor_write_double(coap_cbor_writer_t *writer, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_cc.h"
+
+static uint16_t coap_cc_hash(const coap_cc_t *cc, const coap_addr_t *addr)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    uint8_t i;
+    for (i = 0; i < addr->len; i++)
+        hash = (hash ^ addr->addr[i]) * 16777619U;
+    return (uint16_t)(hash % cc->num_peers);
+}
+
+static void coap_cc_lru_unlink(coap_cc_t *cc, uint16_t index)
+{
+    coap_peer_t *peer = &cc->peers[index];
+    if (COAP_CC_NO_PEER != peer->lru_prev)
+        cc->peers[peer->lru_prev].lru_next = peer->lru_next;
+    else
+        cc->lru_head = peer->lru_next;
+    if (COAP_CC_NO_PEER != peer->lru_next)
+        cc->peers[peer->lru_next].lru_prev = peer->lru_prev;
+    else
+        cc->lru_tail = peer->lru_prev;
+}
+
+static void coap_cc_lru_push(coap_cc_t *cc, uint16_t index)
+{
+    coap_peer_t *peer = &cc->peers[index];
+    peer->lru_prev = COAP_CC_NO_PEER;
+    peer->lru_next = cc->lru_head;
+    if (COAP_CC_NO_PEER != cc->lru_head)
+        cc->peers[cc->lru_head].lru_prev = index;
+    else
+        cc->lru_tail = index;
+    cc->lru_head = index;
+}
+
+static void coap_cc_hash_remove(coap_cc_t *cc, uint16_t index)
+{
+    uint16_t *link = &cc->peers[coap_cc_hash(cc, &cc->peers[index].addr)].bucket;
+    while (*link != index)
+        link = &cc->peers[*link].hash_next;
+    *link = cc->peers[index].hash_next;
+}
+
+void coap_cc_init(coap_cc_t *cc, coap_peer_t *peers, uint16_t num_peers, uint8_t nstart)
+{
+    uint16_t i;
+    cc->peers = peers;
+    cc->num_peers = num_peers;
+    cc->nstart = nstart;
+    cc->lru_head = COAP_CC_NO_PEER;
+    cc->lru_tail = COAP_CC_NO_PEER;
+    // unused peers sit at the tail of the LRU list, so they are taken before any peer is evicted
+    for (i = 0; i < num_peers; i++)
+    {
+        peers[i].used = false;
+        peers[i].bucket = COAP_CC_NO_PEER;
+        peers[i].hash_next = COAP_CC_NO_PEER;
+        coap_cc_lru_push(cc, i);
+    }
+}
+
+coap_peer_t *coap_cc_peer(coap_cc_t *cc, const coap_addr_t *addr, uint32_t now)
+{
+    uint16_t index, bucket;
+    coap_peer_t *peer;
+
+    if (0 == cc->num_peers || addr->len > COAP_ADDR_SIZE)
+        return NULL;
+    bucket = coap_cc_hash(cc, addr);
+    for (index = cc->peers[bucket].bucket; COAP_CC_NO_PEER != index; index = cc->peers[index].hash_next)
+    {
+        peer = &cc->peers[index];
+        if (peer->addr.len == addr->len && 0 == memcmp(peer->addr.addr, addr->addr, addr->len))
+        {
+            coap_cc_lru_unlink(cc, index);
+            coap_cc_lru_push(cc, index);
+            return peer;
+        }
+    }
+
+    // take the least recently used idle peer
+    for (index = cc->lru_tail; COAP_CC_NO_PEER != index; index = cc->peers[index].lru_prev)
+    {
+        peer = &cc->peers[index];
+        if (!peer->used || (0 == peer->outstanding && 0 == peer->queue_len))
+            break;
+    }
+    if (COAP_CC_NO_PEER == index)
+        return NULL;
+    if (peer->used)
+        coap_cc_hash_remove(cc, index);
+
+    peer->addr.len = addr->len;
+    memcpy(peer->addr.addr, addr->addr, addr->len);
+    peer->used = true;
+    peer->rto = COAP_ACK_TIMEOUT_MS;
+    peer->rto_updated = now;
+    peer->strong.valid = false;
+    peer->weak.valid = false;
+    peer->outstanding = 0;
+    peer->queue_head = 0;
+    peer->queue_len = 0;
+    peer->hash_next = cc->peers[bucket].bucket;
+    cc->peers[bucket].bucket = index;
+    coap_cc_lru_unlink(cc, index);
+    coap_cc_lru_push(cc, index);
+    return peer;
+}
+
+coap_error_t coap_cc_start(coap_cc_t *cc, coap_peer_t *peer, void *request, bool *send_now)
+{
+    if (peer->outstanding < cc->nstart)
+    {
+        peer->outstanding++;
+        *send_now = true;
+        return COAP_ERR_NONE;
+    }
+    if (peer->queue_len >= COAP_CC_QUEUE_SIZE)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    peer->queue[(peer->queue_head + peer->queue_len) % COAP_CC_QUEUE_SIZE] = request;
+    peer->queue_len++;
+    *send_now = false;
+    return COAP_ERR_NONE;
+}
+
+uint32_t coap_cc_initial_timeout(coap_peer_t *peer, uint32_t now, uint32_t random)
+{
+    uint32_t idle = now - peer->rto_updated;
+
+    // RTO aging: small values grow back towards 1 s, large ones decay towards 2 s
+    if (peer->rto < 1000 && idle > 16U * peer->rto)
+    {
+        peer->rto = (2U * peer->rto < 1000) ? 2U * peer->rto : 1000;
+        peer->rto_updated = now;
+    }
+    else if (peer->rto > 3000 && idle > 4U * peer->rto)
+    {
+        peer->rto = (2000 + peer->rto) / 2;
+        peer->rto_updated = now;
+    }
+    return peer->rto + (uint32_t)(((uint64_t)peer->rto / 2 * (random % 1024)) / 1024);
+}
+
+uint32_t coap_cc_backoff(uint32_t initial_timeout, uint32_t timeout)
+{
+    uint64_t next;
+    if (initial_timeout < 1000)
+        next = 3ULL * timeout;
+    else if (initial_timeout > 3000)
+        next = 3ULL * timeout / 2;
+    else
+        next = 2ULL * timeout;
+    return (next > COAP_CC_MAX_RTO_MS) ? COAP_CC_MAX_RTO_MS : (uint32_t)next;
+}
+
+// http://tools.ietf.org/html/rfc6298#section-2, returns SRTT + K * RTTVAR
+static uint32_t coap_cc_estimate(coap_rtt_estimator_t *est, uint32_t rtt, uint32_t k)
+{
+    if (!est->valid)
+    {
+        est->srtt = rtt;
+        est->rttvar = rtt / 2;
+        est->valid = true;
+    }
+    else
+    {
+        uint32_t delta = (est->srtt > rtt) ? est->srtt - rtt : rtt - est->srtt;
+        est->rttvar = (3U * est->rttvar + delta) / 4;
+        est->srtt = (7U * est->srtt + rtt) / 8;
+    }
+    return est->srtt + k * est->rttvar;
+}
+
+static void *coap_cc_dequeue(coap_peer_t *peer)
+{
+    void *request;
+    if (peer->outstanding > 0)
+        peer->outstanding--;
+    if (0 == peer->queue_len)
+        return NULL;
+    request = peer->queue[peer->queue_head];
+    peer->queue_head = (peer->queue_head + 1) % COAP_CC_QUEUE_SIZE;
+    peer->queue_len--;
+    peer->outstanding++;
+    return request;
+}
+
+void *coap_cc_complete(coap_peer_t *peer, uint32_t rtt, uint8_t retransmissions, uint32_t now)
+{
+    uint64_t rto = peer->rto;
+
+    // strong RTTs are unambiguous, weak ones may belong to any transmission and get a lower weight. Exchanges with
+    // more retransmissions say little about the RTT and are ignored.
+    if (0 == retransmissions)
+        rto = ((uint64_t)coap_cc_estimate(&peer->strong, rtt, 4) + rto) / 2;
+    else if (retransmissions <= 2)
+        rto = ((uint64_t)coap_cc_estimate(&peer->weak, rtt, 1) + 3 * rto) / 4;
+    if (retransmissions <= 2)
+    {
+        peer->rto = (rto > COAP_CC_MAX_RTO_MS) ? COAP_CC_MAX_RTO_MS : (uint32_t)rto;
+        peer->rto_updated = now;
+    }
+    return coap_cc_dequeue(peer);
+}
+
+void *coap_cc_fail(coap_peer_t *peer)
+{
+    return coap_cc_dequeue(peer);
+}
@@ -0,0 +1,131 @@
+#ifndef COAP_CC_H
+#define COAP_CC_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Per peer congestion control following CoCoA, see https://datatracker.ietf.org/doc/draft-ietf-core-cocoa/
+// All times are milliseconds from a caller provided monotonic clock, they may wrap around.
+
+// Size of a peer address, large enough for a struct sockaddr_in6
+#ifndef COAP_ADDR_SIZE
+#define COAP_ADDR_SIZE 28
+#endif
+
+// Requests a peer may queue while NSTART exchanges are outstanding
+#ifndef COAP_CC_QUEUE_SIZE
+#define COAP_CC_QUEUE_SIZE 4
+#endif
+
+// http://tools.ietf.org/html/rfc7252#section-4.8
+#define COAP_ACK_TIMEOUT_MS 2000
+#define COAP_NSTART 1
+#define COAP_MAX_RETRANSMIT 4
+#define COAP_CC_MAX_RTO_MS 60000
+
+#define COAP_CC_NO_PEER 0xFFFF
+
+/// Opaque peer address, usually the bytes of a struct sockaddr. Addresses are equal if length and bytes are equal,
+/// so padding must be zeroed.
+typedef struct
+{
+    uint8_t len;
+    uint8_t addr[COAP_ADDR_SIZE];
+} coap_addr_t;
+
+/// RTT estimator of RFC 6298, CoCoA keeps a strong (K = 4) and a weak (K = 1) one
+typedef struct
+{
+    uint32_t srtt;
+    uint32_t rttvar;
+    bool valid;                         /* False until the first measurement */
+} coap_rtt_estimator_t;
+
+typedef struct
+{
+    coap_addr_t addr;
+    bool used;
+    uint32_t rto;                       /* Overall RTO */
+    uint32_t rto_updated;               /* Time of the last RTO update, used for aging */
+    coap_rtt_estimator_t strong;        /* Fed by exchanges without retransmission */
+    coap_rtt_estimator_t weak;          /* Fed by exchanges with one or two retransmissions */
+    uint8_t outstanding;                /* Exchanges in flight, at most NSTART */
+    uint8_t queue_head;
+    uint8_t queue_len;
+    void *queue[COAP_CC_QUEUE_SIZE];    /* Requests waiting for an exchange to complete */
+    uint16_t lru_prev;                  /* LRU list, head is the most recently used peer */
+    uint16_t lru_next;
+    uint16_t hash_next;                 /* Next peer in the same hash bucket */
+    uint16_t bucket;                    /* Head of hash bucket with the index of this peer */
+} coap_peer_t;
+
+/// Peer table with bounded size. Idle peers (nothing outstanding or queued) are evicted in LRU order.
+typedef struct
+{
+    coap_peer_t *peers;
+    uint16_t num_peers;
+    uint8_t nstart;
+    uint16_t lru_head;
+    uint16_t lru_tail;
+} coap_cc_t;
+
+/// @brief Initializes an empty peer table on caller provided storage
+/// @param cc Table to initialize
+/// @param peers Peer storage, must stay valid as long as the table is used
+/// @param num_peers Number of peers, at most 0xFFFE
+/// @param nstart Number of simultaneous exchanges per peer, COAP_NSTART by default
+void coap_cc_init(coap_cc_t *cc, coap_peer_t *peers, uint16_t num_peers, uint8_t nstart);
+
+/// @brief Finds the state of a peer, creates it if it is unknown. The peer becomes the most recently used one.
+/// @param cc Peer table
+/// @param addr Address of the peer
+/// @param now Current time
+/// @return Peer, NULL if the table is full and no peer is idle
+coap_peer_t *coap_cc_peer(coap_cc_t *cc, const coap_addr_t *addr, uint32_t now);
+
+/// @brief Starts an exchange with a peer, or queues it if NSTART exchanges are outstanding
+/// @param cc Peer table
+/// @param peer Peer
+/// @param request Opaque handle of the request, returned by coap_cc_complete() once it may be sent
+/// @param[out] send_now True if the request may be sent immediately, false if it was queued
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the queue of the peer is full
+coap_error_t coap_cc_start(coap_cc_t *cc, coap_peer_t *peer, void *request, bool *send_now);
+
+/// @brief Returns the initial retransmission timeout for a new Confirmable message to the peer. Ages the RTO if it
+/// was not updated for a long time and dithers it to [RTO, 1.5 * RTO].
+/// @param peer Peer
+/// @param now Current time
+/// @param random Random value, for example from rand()
+/// @return Initial timeout in ms
+uint32_t coap_cc_initial_timeout(coap_peer_t *peer, uint32_t now, uint32_t random);
+
+/// @brief Returns the timeout after the next retransmission using the variable backoff factor of CoCoA
+/// @param initial_timeout Initial timeout of the exchange, from coap_cc_initial_timeout()
+/// @param timeout Current timeout
+/// @return Next timeout in ms
+uint32_t coap_cc_backoff(uint32_t initial_timeout, uint32_t timeout);
+
+/// @brief Completes an exchange that was acknowledged (or answered) and updates the RTO
+/// @param peer Peer
+/// @param rtt Time from the first transmission to the acknowledgement
+/// @param retransmissions Number of retransmissions of the exchange
+/// @param now Current time
+/// @return Queued request that may be sent now (it counts as outstanding), NULL if none is queued
+void *coap_cc_complete(coap_peer_t *peer, uint32_t rtt, uint8_t retransmissions, uint32_t now);
+
+/// @brief Completes an exchange that timed out after the last retransmission. The RTO is not updated.
+/// @param peer Peer
+/// @return Queued request that may be sent now (it counts as outstanding), NULL if none is queued
+void *coap_cc_fail(coap_peer_t *peer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
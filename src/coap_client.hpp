@@ -0,0 +1,479 @@
+#ifndef COAP_CLIENT_HPP
+#define COAP_CLIENT_HPP 1
+
+// Coroutine client for a single threaded event loop. A request is awaited inside a coap::task:
+//
+//     coap::task fetch(coap::client &c)
+//     {
+//         coap::reply rsp = co_await c.get("coap://sensor.local/temp");
+//         if (rsp)
+//             use(rsp.view().payload());
+//     }
+//
+// The event loop passes received datagrams to client::receive() and the time to client::tick(). The awaiting
+// coroutine is resumed from there on the response with its token, or on timeout. The client preallocates all
+// exchange state, coroutine frames come from frame_pool, so a request allocates nothing in steady state.
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <string_view>
+#include <vector>
+#include "coap.hpp"
+#include "coap_cc.h"
+#include "coap_uri.h"
+
+namespace coap
+{
+
+/// Thread local pool of coroutine frames in size classes of 64 bytes. Frames are carved from chunks that stay with
+/// the thread, freed frames are reused by the next coroutine of the same size class.
+class frame_pool
+{
+public:
+    static constexpr size_t granularity = 64;
+    static constexpr size_t classes = 32;           // larger frames come from operator new
+    static constexpr size_t frames_per_chunk = 64;
+
+    static void *allocate(size_t size)
+    {
+        size_t c = (size + granularity - 1) / granularity - 1;
+        if (c >= classes)
+            return ::operator new(size);
+        if (nullptr == free_[c])
+        {
+            size_t frame = (c + 1) * granularity;
+            char *chunk = static_cast<char *>(::operator new(frames_per_chunk * frame));
+            for (size_t i = 0; i < frames_per_chunk; i++)
+                free_[c] = new (chunk + i * frame) block{free_[c]};
+        }
+        block *b = free_[c];
+        free_[c] = b->next;
+        return b;
+    }
+
+    static void deallocate(void *p, size_t size) noexcept
+    {
+        size_t c = (size + granularity - 1) / granularity - 1;
+        if (c >= classes)
+        {
+            ::operator delete(p);
+            return;
+        }
+        free_[c] = new (p) block{free_[c]};
+    }
+
+private:
+    struct block
+    {
+        block *next;
+    };
+
+    static inline thread_local block *free_[classes] = {};
+};
+
+/// Detached coroutine with a pooled frame. It starts immediately and frees its frame when it returns.
+/// Exceptions terminate the program.
+class task
+{
+public:
+    struct promise_type
+    {
+        task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+
+        static void *operator new(size_t size) { return frame_pool::allocate(size); }
+        static void operator delete(void *p, size_t size) noexcept { frame_pool::deallocate(p, size); }
+    };
+};
+
+enum class outcome : uint8_t
+{
+    ok,         // response received
+    timeout,    // no response within the timeout
+    reset,      // the server rejected the request with RST
+    invalid,    // the request could not be encoded, see reply::err
+    busy        // all exchanges are in use
+};
+
+/// Result of an awaited request
+struct reply
+{
+    outcome result;
+    coap_error_t err;                   // encoding error for outcome::invalid
+    const coap_packet_t *pkt;           // response for outcome::ok, valid until the coroutine suspends again
+
+    explicit operator bool() const { return outcome::ok == result; }
+    packet_view view() const { return *pkt; }
+};
+
+/// Client of one server. Requests carry a 4 byte token naming their exchange, Confirmable requests are
+/// retransmitted with exponential backoff (http://tools.ietf.org/html/rfc7252#section-4.2), separate responses
+/// are acknowledged. Not thread safe, the client and its coroutines belong to the event loop thread.
+class client
+{
+public:
+    /// Sends a datagram to the server. Must not call receive() synchronously.
+    using send_fn = void (*)(void *ctx, bytes datagram);
+
+    struct config
+    {
+        coap_msgtype_t type = COAP_TYPE_CON;    // type of requests
+        uint32_t timeout = 93000;               // ms until a request fails, MAX_TRANSMIT_WAIT by default
+        uint32_t capacity = 1024;               // concurrent requests, clamped to 2^16 for Confirmable requests
+                                                // (one message ID each) and to 2^20 otherwise
+        uint16_t first_id = 0;                  // first message ID, should be random
+        uint32_t seed = 1;                      // seed for the dithering of the initial retransmission timeout
+    };
+
+    class awaiter
+    {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) { return client_->start(*this, h); }
+        reply await_resume() const noexcept { return rsp_; }
+
+    private:
+        friend class client;
+        awaiter(client *c, coap_code_t method, std::string_view uri, bytes payload)
+            : client_(c), method_(method), uri_(uri), payload_(payload), rsp_{outcome::busy, COAP_ERR_NONE, nullptr} {}
+
+        client *client_;
+        coap_code_t method_;
+        std::string_view uri_;          // must stay valid until the request completes
+        bytes payload_;
+        reply rsp_;
+    };
+
+    client(send_fn send, void *ctx, const config &cfg)
+        : send_(send), ctx_(ctx), cfg_(clamped(cfg)), slots_(cfg_.capacity), id_slot_(0x10000, no_slot),
+          next_id_(cfg.first_id), random_(cfg.seed ? cfg.seed : 1)
+    {
+        for (uint32_t i = 0; i < cfg_.capacity; i++)
+            slots_[i].next_free = (i + 1 < cfg_.capacity) ? i + 1 : no_slot;
+        free_ = (cfg_.capacity > 0) ? 0 : no_slot;
+        heap_.reserve(cfg_.capacity);
+    }
+
+    /// Destroys the coroutines still waiting for a response
+    ~client()
+    {
+        for (slot &s : slots_)
+        {
+            if (s.waiter)
+                s.waiter.destroy();
+        }
+    }
+
+    client(const client &) = delete;
+    client &operator=(const client &) = delete;
+
+    /// @brief Request to await, the URI must be absolute (coap://host/path?query), see coap_uri_to_options().
+    /// URI and payload must stay valid until the request completes.
+    awaiter request(coap_code_t method, std::string_view uri, bytes payload = {}) { return awaiter(this, method, uri, payload); }
+    awaiter get(std::string_view uri) { return request(COAP_GET, uri); }
+    awaiter post(std::string_view uri, bytes payload) { return request(COAP_POST, uri, payload); }
+    awaiter put(std::string_view uri, bytes payload) { return request(COAP_PUT, uri, payload); }
+    awaiter del(std::string_view uri) { return request(COAP_DELETE, uri); }
+
+    /// @brief Handles a datagram of the server, resumes the coroutine waiting for it
+    void receive(bytes datagram)
+    {
+        if (COAP_ERR_NONE != rx_.parse(datagram))
+        {
+            // a malformed Confirmable message is rejected, http://tools.ietf.org/html/rfc7252#section-4.2
+            if (datagram.size() >= 4 && 0x40 == (datagram[0] & 0xC0) && COAP_TYPE_CON == ((datagram[0] >> 4) & 0x03))
+                send_empty(COAP_TYPE_RESET, static_cast<uint16_t>((datagram[2] << 8) | datagram[3]));
+            return;
+        }
+        const coap_packet_t *pkt = rx_.c();
+
+        if (COAP_EMPTY == pkt->hdr.code)
+        {
+            uint32_t i = id_slot_[pkt->hdr.id];
+            if (COAP_TYPE_CON == pkt->hdr.t)
+                send_empty(COAP_TYPE_RESET, pkt->hdr.id);   // ping
+            else if (no_slot != i && COAP_TYPE_RESET == pkt->hdr.t)
+                finish(i, outcome::reset, nullptr);
+            else if (no_slot != i && COAP_TYPE_ACK == pkt->hdr.t && !slots_[i].acked)
+            {
+                // separate response follows, http://tools.ietf.org/html/rfc7252#section-5.2.2
+                slots_[i].acked = true;
+                reschedule(i, slots_[i].deadline);
+            }
+            return;
+        }
+
+        // the client serves no resources, requests are rejected
+        if (pkt->hdr.code <= COAP_LASTMETHOD)
+        {
+            if (COAP_TYPE_CON == pkt->hdr.t)
+                send_empty(COAP_TYPE_RESET, pkt->hdr.id);
+            return;
+        }
+        // every Confirmable response is acknowledged, also duplicates of one whose exchange already finished,
+        // http://tools.ietf.org/html/rfc7252#section-4.5
+        uint32_t i = find(pkt->tok);
+        if (COAP_TYPE_CON == pkt->hdr.t)
+            send_empty(COAP_TYPE_ACK, pkt->hdr.id);
+        if (no_slot != i)
+            finish(i, outcome::ok, pkt);
+    }
+
+    /// @brief Advances the time, retransmits Confirmable requests and resumes timed out coroutines
+    void tick(uint32_t now)
+    {
+        now_ = now;
+        while (!heap_.empty() && static_cast<int32_t>(now - slots_[heap_[0]].due) >= 0)
+        {
+            uint32_t i = heap_[0];
+            slot &s = slots_[i];
+            if (COAP_TYPE_CON == cfg_.type && !s.acked && s.retransmissions < COAP_MAX_RETRANSMIT
+                && static_cast<int32_t>(s.deadline - now) > 0)
+            {
+                s.retransmissions++;
+                s.timeout *= 2;
+                transmit(i);
+                reschedule(i, earlier(now + s.timeout, s.deadline));
+            }
+            else
+                finish(i, outcome::timeout, nullptr);
+        }
+    }
+
+    /// @brief Time in ms until tick() has something to do, UINT32_MAX if no request is in flight
+    uint32_t next_timeout() const
+    {
+        if (heap_.empty())
+            return UINT32_MAX;
+        int32_t left = static_cast<int32_t>(slots_[heap_[0]].due - now_);
+        return (left > 0) ? static_cast<uint32_t>(left) : 0;
+    }
+
+    size_t in_flight() const { return heap_.size(); }
+    uint32_t capacity() const { return cfg_.capacity; }
+
+private:
+    static constexpr uint32_t no_slot = 0xFFFFFFFF;
+    static constexpr uint32_t index_bits = 20;
+    static constexpr size_t max_datagram = 1280;
+
+    struct slot
+    {
+        std::coroutine_handle<> waiter;
+        awaiter *aw = nullptr;
+        uint32_t token = 0;             // generation << index_bits | index
+        uint32_t due = 0;               // next retransmission or deadline
+        uint32_t deadline = 0;
+        uint32_t timeout = 0;
+        uint32_t heap_pos = 0;
+        uint32_t next_free = no_slot;
+        uint16_t id = 0;
+        uint8_t retransmissions = 0;
+        bool acked = false;
+    };
+
+    // find() takes the slot from the low index_bits of the token, Confirmable requests need distinct message IDs
+    static config clamped(config cfg)
+    {
+        uint32_t max = (COAP_TYPE_CON == cfg.type) ? 0x10000 : (1U << index_bits);
+        if (cfg.capacity > max)
+            cfg.capacity = max;
+        return cfg;
+    }
+
+    bool start(awaiter &aw, std::coroutine_handle<> h)
+    {
+        if (no_slot == free_)
+        {
+            aw.rsp_ = {outcome::busy, COAP_ERR_NONE, nullptr};
+            return false;
+        }
+        uint32_t i = free_;
+        slot &s = slots_[i];
+        s.aw = &aw;
+        // IDs of Confirmable requests in flight are skipped, there is a free one as capacity is at most 2^16,
+        // http://tools.ietf.org/html/rfc7252#section-4.4
+        if (COAP_TYPE_CON == cfg_.type)
+        {
+            while (no_slot != id_slot_[next_id_])
+                next_id_++;
+        }
+        s.id = next_id_++;
+        s.token = ((((s.token >> index_bits) + 1) << index_bits) | i);
+        s.retransmissions = 0;
+        s.acked = false;
+        coap_error_t err = transmit(i);
+        if (COAP_ERR_NONE != err)
+        {
+            aw.rsp_ = {outcome::invalid, err, nullptr};
+            return false;
+        }
+
+        free_ = s.next_free;
+        s.waiter = h;
+        id_slot_[s.id] = i;
+        s.deadline = now_ + cfg_.timeout;
+        s.timeout = COAP_ACK_TIMEOUT_MS + (COAP_ACK_TIMEOUT_MS / 2) * (next_random() % 1024) / 1024;
+        s.due = (COAP_TYPE_CON == cfg_.type) ? earlier(now_ + s.timeout, s.deadline) : s.deadline;
+        heap_.push_back(i);
+        sift_up(static_cast<uint32_t>(heap_.size() - 1));
+        return true;
+    }
+
+    coap_error_t transmit(uint32_t i)
+    {
+        const slot &s = slots_[i];
+        uint8_t token[4];
+        size_t len = sizeof(txbuf_);
+        coap_error_t err;
+
+        token[0] = static_cast<uint8_t>(s.token >> 24);
+        token[1] = static_cast<uint8_t>(s.token >> 16);
+        token[2] = static_cast<uint8_t>(s.token >> 8);
+        token[3] = static_cast<uint8_t>(s.token);
+        message(tx_, cfg_.type, s.aw->method_, s.id, bytes(token));
+        coap_arena_init(&arena_, arena_buf_, sizeof(arena_buf_));
+        if (COAP_ERR_NONE != (err = coap_uri_to_options(tx_.c(), &arena_, s.aw->uri_.data(), s.aw->uri_.size(), nullptr)))
+            return err;
+        tx_.c()->payload.p = s.aw->payload_.data();
+        tx_.c()->payload.len = s.aw->payload_.size();
+        if (COAP_ERR_NONE != (err = coap_build(txbuf_, &len, tx_.c())))
+            return err;
+        send_(ctx_, bytes(txbuf_, len));
+        return COAP_ERR_NONE;
+    }
+
+    void send_empty(coap_msgtype_t type, uint16_t id)
+    {
+        uint8_t msg[4] = {static_cast<uint8_t>(0x40 | (type << 4)), COAP_EMPTY, static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)};
+        send_(ctx_, bytes(msg));
+    }
+
+    uint32_t find(const coap_buffer_t &tok) const
+    {
+        if (4 != tok.len)
+            return no_slot;
+        uint32_t token = (static_cast<uint32_t>(tok.p[0]) << 24) | (static_cast<uint32_t>(tok.p[1]) << 16)
+            | (static_cast<uint32_t>(tok.p[2]) << 8) | tok.p[3];
+        uint32_t i = token & ((1U << index_bits) - 1);
+        if (i >= slots_.size() || !slots_[i].waiter || slots_[i].token != token)
+            return no_slot;
+        return i;
+    }
+
+    // Ends the exchange and resumes its coroutine, which may start the next request on the same slot
+    void finish(uint32_t i, outcome result, const coap_packet_t *pkt)
+    {
+        slot &s = slots_[i];
+        std::coroutine_handle<> h = s.waiter;
+        remove(s.heap_pos);
+        if (id_slot_[s.id] == i)
+            id_slot_[s.id] = no_slot;
+        s.aw->rsp_ = {result, COAP_ERR_NONE, pkt};
+        s.waiter = nullptr;
+        s.next_free = free_;
+        free_ = i;
+        h.resume();
+    }
+
+    uint32_t next_random()
+    {
+        // xorshift32
+        random_ ^= random_ << 13;
+        random_ ^= random_ >> 17;
+        random_ ^= random_ << 5;
+        return random_;
+    }
+
+    static uint32_t earlier(uint32_t a, uint32_t b)
+    {
+        return (static_cast<int32_t>(a - b) < 0) ? a : b;
+    }
+
+    // binary min heap of in flight slots ordered by due time, with the position kept in the slot
+
+    bool before(uint32_t a, uint32_t b) const
+    {
+        return static_cast<int32_t>(slots_[a].due - slots_[b].due) < 0;
+    }
+
+    void place(uint32_t pos, uint32_t i)
+    {
+        heap_[pos] = i;
+        slots_[i].heap_pos = pos;
+    }
+
+    void sift_up(uint32_t pos)
+    {
+        uint32_t i = heap_[pos];
+        while (pos > 0 && before(i, heap_[(pos - 1) / 2]))
+        {
+            place(pos, heap_[(pos - 1) / 2]);
+            pos = (pos - 1) / 2;
+        }
+        place(pos, i);
+    }
+
+    void sift_down(uint32_t pos)
+    {
+        uint32_t i = heap_[pos];
+        uint32_t size = static_cast<uint32_t>(heap_.size());
+        for (;;)
+        {
+            uint32_t child = 2 * pos + 1;
+            if (child >= size)
+                break;
+            if (child + 1 < size && before(heap_[child + 1], heap_[child]))
+                child++;
+            if (!before(heap_[child], i))
+                break;
+            place(pos, heap_[child]);
+            pos = child;
+        }
+        place(pos, i);
+    }
+
+    void reschedule(uint32_t i, uint32_t due)
+    {
+        slots_[i].due = due;
+        sift_up(slots_[i].heap_pos);
+        sift_down(slots_[i].heap_pos);
+    }
+
+    void remove(uint32_t pos)
+    {
+        uint32_t last = heap_.back();
+        heap_.pop_back();
+        if (pos == heap_.size())
+            return;
+        place(pos, last);
+        sift_up(pos);
+        sift_down(slots_[last].heap_pos);
+    }
+
+    send_fn send_;
+    void *ctx_;
+    config cfg_;
+    std::vector<slot> slots_;
+    std::vector<uint32_t> id_slot_;     // message ID to slot, for empty ACKs and RSTs
+    std::vector<uint32_t> heap_;
+    uint32_t free_;
+    uint32_t now_ = 0;
+    uint16_t next_id_;
+    uint32_t random_;
+    packet tx_;
+    packet rx_;
+    coap_arena_t arena_;
+    uint8_t arena_buf_[256];
+    uint8_t txbuf_[max_datagram];
+};
+
+} // namespace coap
+
+#endif
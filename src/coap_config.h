@@ -0,0 +1,46 @@
+#ifndef COAP_CONFIG_H
+#define COAP_CONFIG_H 1
+
+// Build time configuration of the library. Every setting can be given as compiler definition, the CMake options of
+// src/CMakeLists.txt set them, or collected in a header named by COAP_CONFIG_FILE, for example
+// -DCOAP_CONFIG_FILE='"my_coap_config.h"'. The footprint target reports text, data and bss of a set of profiles,
+// see footprint/CMakeLists.txt.
+//
+// Settings that change coap_packet_t or coap_endpoint_path_t must be the same for the library and everything that
+// includes coap.h.
+
+#ifdef COAP_CONFIG_FILE
+#include COAP_CONFIG_FILE
+#endif
+
+// Options a packet holds at most. Every option takes a coap_option_t (12 bytes on 32 bit, 24 bytes on 64 bit
+// targets) in each coap_packet_t, further options of a parsed message are dropped.
+#ifndef MAXOPT
+#define MAXOPT 16
+#endif
+#if MAXOPT < 1 || MAXOPT > 255
+#error "MAXOPT must be 1 to 255, coap_packet_t counts options in a uint8_t"
+#endif
+
+// Size of the packet owned storage used by coap_add_option_uint(). A minimal length uint value takes at most 4 bytes.
+#ifndef COAP_OPTION_SCRATCH_SIZE
+#define COAP_OPTION_SCRATCH_SIZE 16
+#endif
+#if COAP_OPTION_SCRATCH_SIZE > 255
+#error "COAP_OPTION_SCRATCH_SIZE must not exceed 255, coap_packet_t counts the used bytes in a uint8_t"
+#endif
+
+// Uri-Path segments of an endpoint path, 2 = /foo/bar, 3 = /foo/bar/baz
+#ifndef MAX_SEGMENTS
+#define MAX_SEGMENTS 2
+#endif
+
+// COAP_NO_BLOCKWISE: leaves out coap_make_option_blockwise() and the coap_option_blockwise_get_*() helpers.
+// coap_files.h, coap_qblock.h, coap_server.h and coap_wellknown.h need them.
+
+// COAP_NO_ROUTING: leaves out the endpoint table, coap_endpoint_t and coap_handle_req(), for applications that
+// dispatch on their own. coap_etag.h, coap_server.h and coap_wellknown.h need them.
+
+// DEBUG: compiles in coap_dump() and coap_dumpPacket(), which print with printf()
+
+#endif
@@ -0,0 +1,284 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "byte_order.h"
+#include "coap_deferred.h"
+
+void coap_deferred_init(coap_deferred_table_t *table, coap_deferred_t *slots, uint32_t count, coap_cc_t *cc)
+{
+    uint32_t i;
+    table->slots = slots;
+    table->count = count;
+    table->cc = cc;
+    atomic_init(&table->completed, 0);
+    for (i = 0; i < count; i++)
+    {
+        slots[i].state = COAP_DEFERRED_FREE;
+        slots[i].next = (i + 1 < count) ? i + 1 : COAP_DEFERRED_NONE;
+        atomic_init(&slots[i].completed_next, 0);
+    }
+    table->free_head = (count > 0) ? 0 : COAP_DEFERRED_NONE;
+    table->ready_head = COAP_DEFERRED_NONE;
+    table->ready_tail = COAP_DEFERRED_NONE;
+    table->in_flight_head = COAP_DEFERRED_NONE;
+}
+
+coap_deferred_t *coap_deferred_start(coap_deferred_table_t *table, const coap_addr_t *peer, const coap_packet_t *request)
+{
+    coap_deferred_t *d;
+    if (COAP_DEFERRED_NONE == table->free_head || request->tok.len > sizeof(d->token))
+        return NULL;
+    d = &table->slots[table->free_head];
+    table->free_head = d->next;
+
+    d->peer = *peer;
+    memcpy(d->token, request->tok.p, request->tok.len);
+    d->tkl = (uint8_t)request->tok.len;
+    d->type = request->hdr.t;
+    d->state = COAP_DEFERRED_PENDING;
+    d->retransmissions = 0;
+    d->cc_peer = NULL;
+    d->len = 0;
+    return d;
+}
+
+size_t coap_deferred_make_ack(const coap_packet_t *request, uint8_t *buf)
+{
+    if (COAP_TYPE_CON != request->hdr.t)
+        return 0;
+    buf[0] = 0x40 | (COAP_TYPE_ACK << 4);
+    buf[1] = COAP_EMPTY;
+    endian_store16(&buf[2], request->hdr.id);
+    return 4;
+}
+
+// Hands a completed or cancelled handle to the owner
+static void coap_deferred_push_completed(coap_deferred_table_t *table, coap_deferred_t *deferred)
+{
+    uint32_t index = (uint32_t)(deferred - table->slots);
+    uint32_t head;
+
+    // Treiber stack, the owner takes all entries at once, so there is no ABA problem
+    head = atomic_load_explicit(&table->completed, memory_order_relaxed);
+    do
+        atomic_store_explicit(&deferred->completed_next, head, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&table->completed, &head, index + 1, memory_order_release, memory_order_relaxed));
+}
+
+coap_error_t coap_deferred_complete(coap_deferred_table_t *table, coap_deferred_t *deferred, coap_packet_t *response)
+{
+    size_t len = sizeof(deferred->buf);
+    coap_error_t err;
+
+    response->hdr.ver = 1;
+    response->hdr.t = (COAP_TYPE_CON == deferred->type) ? COAP_TYPE_CON : COAP_TYPE_NONCON;
+    response->hdr.tkl = deferred->tkl;
+    response->hdr.id = 0;
+    response->tok.p = deferred->token;
+    response->tok.len = deferred->tkl;
+    if (COAP_ERR_NONE != (err = coap_build(deferred->buf, &len, response)))
+        return err;
+    deferred->len = len;
+    coap_deferred_push_completed(table, deferred);
+    return COAP_ERR_NONE;
+}
+
+void coap_deferred_cancel(coap_deferred_table_t *table, coap_deferred_t *deferred)
+{
+    deferred->len = 0;
+    coap_deferred_push_completed(table, deferred);
+}
+
+static void coap_deferred_push_in_flight(coap_deferred_table_t *table, coap_deferred_t *d, uint32_t now)
+{
+    uint32_t index = (uint32_t)(d - table->slots);
+    d->state = COAP_DEFERRED_SENDING;
+    d->due = now;
+    d->retransmissions = 0;
+    d->prev = COAP_DEFERRED_NONE;
+    d->next = table->in_flight_head;
+    if (COAP_DEFERRED_NONE != d->next)
+        table->slots[d->next].prev = index;
+    table->in_flight_head = index;
+}
+
+// Removes d from the in flight list and frees it, next is a queued response of the same peer that may be sent now
+static void coap_deferred_finish(coap_deferred_table_t *table, coap_deferred_t *d, coap_deferred_t *next, uint32_t now)
+{
+    uint32_t index = (uint32_t)(d - table->slots);
+    if (COAP_DEFERRED_NONE != d->prev)
+        table->slots[d->prev].next = d->next;
+    else
+        table->in_flight_head = d->next;
+    if (COAP_DEFERRED_NONE != d->next)
+        table->slots[d->next].prev = d->prev;
+
+    d->state = COAP_DEFERRED_FREE;
+    d->next = table->free_head;
+    table->free_head = index;
+    if (NULL != next)
+        coap_deferred_push_in_flight(table, next, now);
+}
+
+// Starts the exchange of a completed response, false if the peer can take no further request yet
+static bool coap_deferred_begin(coap_deferred_table_t *table, coap_deferred_t *d, uint32_t now)
+{
+    coap_peer_t *peer;
+    bool send_now;
+
+    if (COAP_TYPE_CON != d->type)
+    {
+        coap_deferred_push_in_flight(table, d, now);
+        return true;
+    }
+    if (NULL == (peer = coap_cc_peer(table->cc, &d->peer, now)))
+        return false;
+    if (COAP_ERR_NONE != coap_cc_start(table->cc, peer, d, &send_now))
+        return false;
+    d->cc_peer = peer;
+    if (send_now)
+        coap_deferred_push_in_flight(table, d, now);
+    else
+        d->state = COAP_DEFERRED_QUEUED;
+    return true;
+}
+
+static void coap_deferred_take_completed(coap_deferred_table_t *table)
+{
+    uint32_t head = atomic_exchange_explicit(&table->completed, 0, memory_order_acquire);
+    uint32_t list = COAP_DEFERRED_NONE;
+
+    // the stack is newest first, reverse it to keep the completion order
+    while (0 != head)
+    {
+        coap_deferred_t *d = &table->slots[head - 1];
+        uint32_t index = head - 1;
+        head = atomic_load_explicit(&d->completed_next, memory_order_relaxed);
+        if (0 == d->len)
+        {
+            // cancelled
+            d->state = COAP_DEFERRED_FREE;
+            d->next = table->free_head;
+            table->free_head = index;
+            continue;
+        }
+        d->state = COAP_DEFERRED_READY;
+        d->next = list;
+        list = index;
+    }
+    if (COAP_DEFERRED_NONE == list)
+        return;
+    if (COAP_DEFERRED_NONE == table->ready_tail)
+        table->ready_head = list;
+    else
+        table->slots[table->ready_tail].next = list;
+    while (COAP_DEFERRED_NONE != table->slots[list].next)
+        list = table->slots[list].next;
+    table->ready_tail = list;
+}
+
+static void coap_deferred_start_ready(coap_deferred_table_t *table, uint32_t now)
+{
+    uint32_t prev = COAP_DEFERRED_NONE;
+    uint32_t i = table->ready_head;
+
+    while (COAP_DEFERRED_NONE != i)
+    {
+        coap_deferred_t *d = &table->slots[i];
+        uint32_t next = d->next;
+        if (coap_deferred_begin(table, d, now))
+        {
+            if (COAP_DEFERRED_NONE == prev)
+                table->ready_head = next;
+            else
+                table->slots[prev].next = next;
+            if (table->ready_tail == i)
+                table->ready_tail = prev;
+        }
+        else
+            prev = i;
+        i = next;
+    }
+}
+
+void coap_deferred_poll(coap_deferred_table_t *table, uint16_t *next_id, uint32_t now, uint32_t random, coap_addr_t *peer, uint8_t *outbuf, size_t *outlen)
+{
+    uint32_t i, next;
+
+    *outlen = 0;
+    coap_deferred_take_completed(table);
+    coap_deferred_start_ready(table, now);
+
+    for (i = table->in_flight_head; COAP_DEFERRED_NONE != i; i = next)
+    {
+        coap_deferred_t *d = &table->slots[i];
+        next = d->next;
+        if ((int32_t)(now - d->due) < 0)
+            continue;
+
+        if (COAP_DEFERRED_SENDING == d->state)
+        {
+            d->state = COAP_DEFERRED_IN_FLIGHT;
+            endian_store16(&d->buf[2], *next_id);
+            d->id = (*next_id)++;
+            d->first_sent = now;
+            if (COAP_TYPE_CON == d->type)
+                d->initial_timeout = d->timeout = coap_cc_initial_timeout(d->cc_peer, now, random);
+        }
+        else if (d->retransmissions >= COAP_MAX_RETRANSMIT)
+        {
+            // http://tools.ietf.org/html/rfc7252#section-4.2: the exchange failed, the peer may take the next one
+            coap_deferred_finish(table, d, coap_cc_fail(d->cc_peer), now);
+            next = table->in_flight_head;   // a queued response may have become due
+            continue;
+        }
+        else
+        {
+            d->retransmissions++;
+            d->timeout = coap_cc_backoff(d->initial_timeout, d->timeout);
+        }
+
+        *peer = d->peer;
+        memcpy(outbuf, d->buf, d->len);
+        *outlen = d->len;
+        if (COAP_TYPE_CON != d->type)
+        {
+            coap_deferred_finish(table, d, NULL, now);
+            return;
+        }
+        d->due = now + d->timeout;
+        return;
+    }
+}
+
+uint32_t coap_deferred_timeout(coap_deferred_table_t *table, uint32_t now)
+{
+    uint32_t i, timeout = UINT32_MAX;
+
+    if (0 != atomic_load_explicit(&table->completed, memory_order_relaxed))
+        return 0;
+    for (i = table->in_flight_head; COAP_DEFERRED_NONE != i; i = table->slots[i].next)
+    {
+        int32_t left = (int32_t)(table->slots[i].due - now);
+        if (left <= 0)
+            return 0;
+        if ((uint32_t)left < timeout)
+            timeout = (uint32_t)left;
+    }
+    return timeout;
+}
+
+bool coap_deferred_ack(coap_deferred_table_t *table, const coap_addr_t *peer, uint16_t id, uint32_t now)
+{
+    uint32_t i;
+    for (i = table->in_flight_head; COAP_DEFERRED_NONE != i; i = table->slots[i].next)
+    {
+        coap_deferred_t *d = &table->slots[i];
+        if (COAP_DEFERRED_IN_FLIGHT != d->state || d->id != id || d->peer.len != peer->len || 0 != memcmp(d->peer.addr, peer->addr, peer->len))
+            continue;
+        coap_deferred_finish(table, d, coap_cc_complete(d->cc_peer, now - d->first_sent, d->retransmissions, now), now);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,140 @@
+#ifndef COAP_DEFERRED_H
+#define COAP_DEFERRED_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap.h"
+#include "coap_cc.h"
+
+// Separate responses, see http://tools.ietf.org/html/rfc7252#section-5.2.2
+// A request is deferred on the thread that owns the table, the response is completed later from any thread and
+// transmitted by the owner, Confirmable responses with retransmission and per peer congestion control (coap_cc.h).
+
+// Largest separate response
+#ifndef COAP_DEFERRED_RESPONSE_SIZE
+#define COAP_DEFERRED_RESPONSE_SIZE 512
+#endif
+
+#define COAP_DEFERRED_NONE 0xFFFFFFFF
+
+typedef enum
+{
+    COAP_DEFERRED_FREE = 0,
+    COAP_DEFERRED_PENDING,              /* Waiting for coap_deferred_complete() */
+    COAP_DEFERRED_READY,                /* Completed, waiting for a free exchange with the peer */
+    COAP_DEFERRED_QUEUED,               /* Queued by congestion control */
+    COAP_DEFERRED_SENDING,              /* Exchange started, first transmission is due */
+    COAP_DEFERRED_IN_FLIGHT             /* Transmitted, waiting for an ACK */
+} coap_deferred_state_t;
+
+/// Continuation of a deferred request: peer, token and type of the request, later the response and its
+/// retransmission state
+typedef struct coap_deferred
+{
+    coap_addr_t peer;
+    uint8_t token[8];
+    uint8_t tkl;
+    uint8_t type;                       /* Type of the request, the response is CON for CON requests, NON otherwise */
+    uint8_t state;                      /* coap_deferred_state_t, only accessed by the owner */
+    uint8_t retransmissions;
+    uint16_t id;                        /* Message ID of the response */
+    uint32_t first_sent;                /* Time of the first transmission */
+    uint32_t due;                       /* Time of the next transmission */
+    uint32_t initial_timeout;
+    uint32_t timeout;
+    coap_peer_t *cc_peer;
+    uint32_t prev;                      /* Owner lists (free, ready, in flight), COAP_DEFERRED_NONE ends them */
+    uint32_t next;
+    _Atomic uint32_t completed_next;    /* Link of the completion stack: index + 1, 0 ends it */
+    size_t len;                         /* Length of the built response, 0 if cancelled */
+    uint8_t buf[COAP_DEFERRED_RESPONSE_SIZE];   /* Built response, the message ID is set on transmission */
+} coap_deferred_t;
+
+/// Deferred requests of one owner thread
+typedef struct coap_deferred_table
+{
+    coap_deferred_t *slots;
+    uint32_t count;
+    coap_cc_t *cc;
+    _Atomic uint32_t completed;         /* Completion stack, pushed by any thread: index + 1, 0 if empty */
+    uint32_t free_head;
+    uint32_t ready_head;                /* Completed, FIFO */
+    uint32_t ready_tail;
+    uint32_t in_flight_head;
+} coap_deferred_table_t;
+
+/// @brief Initializes a table on caller provided slots
+/// @param table Table to initialize
+/// @param slots Slot storage, must stay valid as long as the table is used
+/// @param count Number of slots, the maximum of deferred requests at a time
+/// @param cc Peer table for congestion control of Confirmable responses
+void coap_deferred_init(coap_deferred_table_t *table, coap_deferred_t *slots, uint32_t count, coap_cc_t *cc);
+
+/// @brief Defers a request. Owner thread only.
+/// The caller answers a Confirmable request with an empty ACK (see coap_deferred_make_ack()) and nothing else.
+/// @param table Table
+/// @param peer Address of the requesting peer
+/// @param request Parsed request
+/// @return Continuation handle, NULL if all slots are in use
+coap_deferred_t *coap_deferred_start(coap_deferred_table_t *table, const coap_addr_t *peer, const coap_packet_t *request);
+
+/// @brief Builds the empty ACK for a deferred Confirmable request
+/// @param request Parsed request
+/// @param[out] buf Buffer of at least 4 bytes
+/// @return Length of the ACK, 0 if the request is not Confirmable
+size_t coap_deferred_make_ack(const coap_packet_t *request, uint8_t *buf);
+
+/// @brief Completes a deferred request with its response. May be called from any thread, exactly once per handle
+/// unless it fails. Type, message ID and token of response are set from the request.
+/// @param table Table the handle belongs to
+/// @param deferred Handle from coap_deferred_start()
+/// @param response Response with code, options and payload
+/// @return COAP_ERR_NONE on success, the build error otherwise (COAP_ERR_BUFFER_TOO_SMALL if the response exceeds
+/// COAP_DEFERRED_RESPONSE_SIZE). The handle stays pending on errors, complete it with a smaller response such as
+/// 5.00 or give it up with coap_deferred_cancel().
+coap_error_t coap_deferred_complete(coap_deferred_table_t *table, coap_deferred_t *deferred, coap_packet_t *response);
+
+/// @brief Gives up a deferred request without a response, for example when its backend call failed. May be called
+/// from any thread instead of coap_deferred_complete(). The slot is freed by the next coap_deferred_poll().
+/// @param table Table the handle belongs to
+/// @param deferred Pending handle from coap_deferred_start()
+void coap_deferred_cancel(coap_deferred_table_t *table, coap_deferred_t *deferred);
+
+/// @brief Returns the next datagram to send: a new separate response or a retransmission. Confirmable responses
+/// that were not acknowledged after COAP_MAX_RETRANSMIT retransmissions are dropped. Owner thread only, call it
+/// until outlen is 0 whenever a response was completed or a timeout expired.
+/// @param table Table
+/// @param next_id Message ID counter, shared with the other messages of the endpoint
+/// @param now Current time in ms
+/// @param random Random value for the dithering of the initial timeout, for example from rand()
+/// @param[out] peer Destination
+/// @param[out] outbuf Buffer of at least COAP_DEFERRED_RESPONSE_SIZE bytes
+/// @param[out] outlen Length of the datagram, 0 if nothing is to be sent
+void coap_deferred_poll(coap_deferred_table_t *table, uint16_t *next_id, uint32_t now, uint32_t random, coap_addr_t *peer, uint8_t *outbuf, size_t *outlen);
+
+/// @brief Returns the time until coap_deferred_poll() has to be called again for a retransmission. Owner thread only.
+/// @param table Table
+/// @param now Current time in ms
+/// @return Time in ms, 0 if something is due, UINT32_MAX if nothing is in flight
+uint32_t coap_deferred_timeout(coap_deferred_table_t *table, uint32_t now);
+
+/// @brief Handles an empty ACK or RST of a peer. Ends the exchange of the matching Confirmable response and frees
+/// its handle. Owner thread only. A queued response to the same peer may become due, see coap_deferred_poll().
+/// @param table Table
+/// @param peer Address of the peer
+/// @param id Message ID of the ACK or RST
+/// @param now Current time in ms
+/// @return True if a response matched
+bool coap_deferred_ack(coap_deferred_table_t *table, const coap_addr_t *peer, uint16_t id, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_etag.h"
+#include "byte_order.h"
+
+#define COAP_ETAG_PRIME1 0x9E3779B185EBCA87ULL
+#define COAP_ETAG_PRIME2 0xC2B2AE3D27D4EB4FULL
+
+static uint64_t coap_etag_round(uint64_t h, uint64_t word)
+{
+    h ^= word * COAP_ETAG_PRIME2;
+    return ((h << 31) | (h >> 33)) * COAP_ETAG_PRIME1;
+}
+
+uint64_t coap_etag_hash(uint64_t seed, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint64_t h = seed ^ ((uint64_t)len * COAP_ETAG_PRIME1);
+    uint64_t word = 0;
+
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        memcpy(&word, p, 8);
+        h = coap_etag_round(h, word);
+    }
+    word = 0;
+    if (len > 0)
+        memcpy(&word, p, len);
+    h = coap_etag_round(h, word);
+
+    // avalanche of MurmurHash3, so similar contents get unrelated ETags
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return (0 == h) ? 1 : h;
+}
+
+void coap_etag_encode(uint64_t hash, uint8_t *buf)
+{
+    endian_store64(buf, hash);
+}
+
+bool coap_etag_matches(const coap_buffer_t *buf, uint64_t hash)
+{
+    return COAP_ETAG_SIZE == buf->len && endian_load64(uint64_t, buf->p) == hash;
+}
+
+void coap_etag_set(coap_etag_resource_t *resource, const void *data, size_t len)
+{
+    resource->etag = (NULL == data) ? 0 : coap_etag_hash(0, data, len);
+}
+
+void coap_etag_write(coap_etag_resource_t *resource, const void *data, size_t len)
+{
+    resource->etag = coap_etag_hash(resource->etag, data, len);
+}
+
+coap_etag_resource_t *coap_etag_find(const coap_etag_store_t *store, const coap_packet_t *request)
+{
+    const coap_option_t *opt;
+    uint8_t count;
+    uint32_t i;
+    int j;
+
+    opt = coap_findOptions(request, COAP_OPTION_URI_PATH, &count);
+    for (i = 0; i < store->count; i++)
+    {
+        const coap_endpoint_path_t *path = store->resources[i].path;
+        if (count != path->count)
+            continue;
+        for (j = 0; j < count; j++)
+            if (!coap_buffer_equals_string(&opt[j].buf, path->elems[j]))
+                break;
+        if (j == count)
+            return &store->resources[i];
+    }
+    return NULL;
+}
+
+coap_code_t coap_etag_evaluate(const coap_etag_store_t *store, const coap_packet_t *request, coap_etag_resource_t **resource)
+{
+    const coap_option_t *opts;
+    uint64_t etag;
+    uint8_t count, i;
+
+    // other methods without preconditions skip the lookup, GET needs the resource for the ETag of the response
+    *resource = NULL;
+    for (i = 0; i < request->numopts; i++)
+        if (COAP_OPTION_IF_MATCH == request->opts[i].num || COAP_OPTION_IF_NONE_MATCH == request->opts[i].num)
+            break;
+    if ((i == request->numopts && COAP_GET != request->hdr.code) || NULL == (*resource = coap_etag_find(store, request)))
+        return COAP_EMPTY;
+    etag = (*resource)->etag;
+
+    // an empty If-Match only asks for an existing representation
+    if (NULL != (opts = coap_findOptions(request, COAP_OPTION_IF_MATCH, &count)))
+    {
+        for (i = 0; i < count; i++)
+            if (0 != etag && (0 == opts[i].buf.len || coap_etag_matches(&opts[i].buf, etag)))
+                break;
+        if (i == count)
+            return COAP_PRECONDITION_FAILED;
+    }
+    if (NULL != coap_findOptions(request, COAP_OPTION_IF_NONE_MATCH, &count) && 0 != etag)
+        return COAP_PRECONDITION_FAILED;
+
+    if (COAP_GET == request->hdr.code && 0 != etag && NULL != (opts = coap_findOptions(request, COAP_OPTION_ETAG, &count)))
+    {
+        for (i = 0; i < count; i++)
+            if (coap_etag_matches(&opts[i].buf, etag))
+                return COAP_VALID;
+    }
+    return COAP_EMPTY;
+}
@@ -0,0 +1,88 @@
+#ifndef COAP_ETAG_H
+#define COAP_ETAG_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Entity tags, see http://tools.ietf.org/html/rfc7252#section-5.10.6
+// ETags are a 64 bit hash of the representation, non-cryptographic: fast enough to hash MB sized resources, but
+// not collision resistant against deliberately crafted content.
+// A store keeps the current ETag of each resource, so conditional requests (If-Match, If-None-Match and ETag
+// validation) are answered before the handler runs, see coap_etag_evaluate().
+
+#define COAP_ETAG_SIZE 8
+
+/// Resource with an ETag. Endpoints with the same path (for example GET and PUT) share it.
+typedef struct
+{
+    const coap_endpoint_path_t *path;   /* Uri-Path of the resource */
+    uint64_t etag;                      /* Current ETag, 0 while the resource has no representation */
+} coap_etag_resource_t;
+
+/// Resources with ETags. Only the thread running the server may read or update them.
+typedef struct
+{
+    coap_etag_resource_t *resources;
+    uint32_t count;
+} coap_etag_store_t;
+
+/// @brief Hashes data, 8 bytes per step. Chaining calls (seed is the previous result) hashes a sequence of writes
+/// without going over earlier data again, the result then depends on how the data was split.
+/// Words are read in host byte order, so hosts of different byte order compute different values.
+/// @param seed 0, or the result of a previous call to continue from
+/// @param data Data to hash
+/// @param len Length of data
+/// @return Hash, never 0, so 0 can mean "not computed yet"
+uint64_t coap_etag_hash(uint64_t seed, const void *data, size_t len);
+
+/// @brief Encodes a hash as ETag option value
+/// @param hash Hash from coap_etag_hash()
+/// @param[out] buf Buffer of COAP_ETAG_SIZE bytes
+void coap_etag_encode(uint64_t hash, uint8_t *buf);
+
+/// @brief Compares an ETag option value with a hash
+/// @param buf Option value
+/// @param hash Hash from coap_etag_hash()
+/// @return True if buf is the encoding of hash
+bool coap_etag_matches(const coap_buffer_t *buf, uint64_t hash);
+
+/// @brief Sets the ETag after the representation was replaced
+/// @param resource Resource
+/// @param data New representation, NULL if the resource was deleted
+/// @param len Length of data
+void coap_etag_set(coap_etag_resource_t *resource, const void *data, size_t len);
+
+/// @brief Updates the ETag after a partial write (a block, an appended record, a changed field), hashing only the
+/// written bytes into the current ETag
+/// @param resource Resource
+/// @param data Written bytes
+/// @param len Length of data
+void coap_etag_write(coap_etag_resource_t *resource, const void *data, size_t len);
+
+/// @brief Finds the resource of a request by its Uri-Path
+/// @param store Store
+/// @param request Parsed request
+/// @return Resource, NULL if the store does not know the path
+coap_etag_resource_t *coap_etag_find(const coap_etag_store_t *store, const coap_packet_t *request);
+
+/// @brief Evaluates the preconditions of a request, see http://tools.ietf.org/html/rfc7252#section-5.10.8, and for
+/// GET the ETags the client has cached, see http://tools.ietf.org/html/rfc7252#section-5.10.6.2
+/// @param store Store
+/// @param request Parsed request
+/// @param[out] resource Resource of the request, looked up for GET and for requests with preconditions, NULL if
+/// the store does not know the path
+/// @return COAP_EMPTY if the handler is to run, COAP_VALID if a cached representation is current (the response
+/// carries the ETag of resource), COAP_PRECONDITION_FAILED if If-Match or If-None-Match does not hold
+coap_code_t coap_etag_evaluate(const coap_etag_store_t *store, const coap_packet_t *request, coap_etag_resource_t **resource);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
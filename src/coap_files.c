@@ -0,0 +1,257 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "coap_files.h"
+#include "coap_etag.h"
+
+// SZX of COAP_FILES_BLOCK_SIZE, see http://tools.ietf.org/html/rfc7959#section-2.2
+#define COAP_FILES_SZX ((COAP_FILES_BLOCK_SIZE >= 1024) ? 6 : (COAP_FILES_BLOCK_SIZE >= 512) ? 5 : \
+    (COAP_FILES_BLOCK_SIZE >= 256) ? 4 : (COAP_FILES_BLOCK_SIZE >= 128) ? 3 : (COAP_FILES_BLOCK_SIZE >= 64) ? 2 : \
+    (COAP_FILES_BLOCK_SIZE >= 32) ? 1 : 0)
+
+void coap_files_init(coap_files_t *files, coap_file_t *storage, uint32_t capacity)
+{
+    files->sets[0].files = storage;
+    files->sets[0].count = 0;
+    atomic_init(&files->sets[0].pins, 0);
+    files->sets[1].files = storage + capacity;
+    files->sets[1].count = 0;
+    atomic_init(&files->sets[1].pins, 0);
+    atomic_init(&files->current, 0);
+    files->capacity = capacity;
+}
+
+static void coap_files_unmap(coap_file_set_t *set)
+{
+    uint32_t i;
+    for (i = 0; i < set->count; i++)
+    {
+        if (NULL != set->files[i].data)
+            munmap((void *)set->files[i].data, set->files[i].len);
+        set->files[i].data = NULL;
+    }
+    set->count = 0;
+}
+
+static bool coap_files_map(coap_file_t *file, const coap_file_source_t *source)
+{
+    struct stat st;
+    void *data = NULL;
+    int fd;
+
+    if (strlen(source->uri_path) >= sizeof(file->uri_path))
+        return false;
+    if ((fd = open(source->file, O_RDONLY)) < 0)
+        return false;
+    if (0 != fstat(fd, &st) || (st.st_size > 0 && MAP_FAILED == (data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))))
+    {
+        close(fd);
+        return false;
+    }
+    // the mapping outlives the descriptor
+    close(fd);
+    strcpy(file->uri_path, source->uri_path);
+    file->data = data;
+    file->len = (size_t)st.st_size;
+    file->content_format = source->content_format;
+    atomic_store_explicit(&file->etag, 0, memory_order_relaxed);
+    return true;
+}
+
+coap_files_result_t coap_files_reload(coap_files_t *files, const coap_file_source_t *sources, uint32_t count)
+{
+    coap_file_set_t *spare = &files->sets[1 - atomic_load(&files->current)];
+    uint32_t i;
+
+    if (count > files->capacity)
+        return COAP_FILES_TOO_MANY;
+    // readers pin before they check which generation is current, see coap_files_acquire()
+    if (0 != atomic_load(&spare->pins))
+        return COAP_FILES_BUSY;
+    coap_files_unmap(spare);
+    for (i = 0; i < count; i++)
+    {
+        if (!coap_files_map(&spare->files[i], &sources[i]))
+        {
+            spare->count = i;
+            coap_files_unmap(spare);
+            return COAP_FILES_IO;
+        }
+    }
+    spare->count = count;
+    atomic_store(&files->current, (uint32_t)(spare - files->sets));
+    return COAP_FILES_OK;
+}
+
+static coap_file_set_t *coap_files_acquire(coap_files_t *files)
+{
+    for (;;)
+    {
+        uint32_t current = atomic_load(&files->current);
+        coap_file_set_t *set = &files->sets[current];
+        atomic_fetch_add(&set->pins, 1);
+        // still current, so a reload cannot unmap it any more
+        if (atomic_load(&files->current) == current)
+            return set;
+        atomic_fetch_sub(&set->pins, 1);
+    }
+}
+
+void coap_files_release(coap_file_set_t *pin)
+{
+    if (NULL != pin)
+        atomic_fetch_sub(&pin->pins, 1);
+}
+
+static bool coap_files_path_matches(const char *path, const coap_packet_t *request)
+{
+    bool first = true;
+    size_t i, j;
+
+    for (i = 0; i < request->numopts; i++)
+    {
+        const coap_option_t *opt = &request->opts[i];
+        if (COAP_OPTION_URI_PATH != opt->num)
+            continue;
+        if (!first && '/' != *path++)
+            return false;
+        first = false;
+        for (j = 0; j < opt->buf.len; j++)
+            if ('\0' == path[j] || (char)opt->buf.p[j] != path[j])
+                return false;
+        path += opt->buf.len;
+    }
+    return '\0' == *path;
+}
+
+static uint64_t coap_files_etag(coap_file_t *file)
+{
+    uint64_t etag = atomic_load_explicit(&file->etag, memory_order_relaxed);
+    // concurrent first GETs compute the same value
+    if (0 == etag)
+    {
+        etag = coap_etag_hash(0, file->data, file->len);
+        atomic_store_explicit(&file->etag, etag, memory_order_relaxed);
+    }
+    return etag;
+}
+
+static coap_code_t coap_files_content(coap_file_t *file, const coap_packet_t *request, coap_packet_t *rsp, uint8_t *block_option, coap_buffer_t *payload)
+{
+    const coap_option_t *block = NULL;
+    uint8_t count;
+    uint32_t szx = COAP_FILES_SZX, num = 0;
+    size_t size, offset;
+
+    if (NULL != (block = coap_findOptions(request, COAP_OPTION_BLOCK_2, &count)))
+    {
+        if (block->buf.len > 3 || 7 == (int)coap_option_blockwise_get_szx(block))
+            return COAP_BAD_OPTION;
+        // http://tools.ietf.org/html/rfc7959#section-2.4, the server may pick a smaller size
+        if ((uint32_t)coap_option_blockwise_get_szx(block) < szx)
+            szx = (uint32_t)coap_option_blockwise_get_szx(block);
+        num = coap_option_blockwise_get_num(block);
+    }
+    size = (size_t)16 << szx;
+    offset = (size_t)num * size;
+
+    if (NULL == block && file->len <= size)
+    {
+        payload->p = file->data;
+        payload->len = file->len;
+    }
+    else
+    {
+        if (offset >= file->len && offset > 0)
+            return COAP_BAD_OPTION;
+        payload->p = file->data + offset;
+        payload->len = (file->len - offset < size) ? file->len - offset : size;
+        coap_add_option(rsp, COAP_OPTION_BLOCK_2, block_option,
+            coap_make_option_blockwise(block_option, (coap_blocksize_t)szx, offset + size < file->len, num));
+        if (0 == num)
+            coap_add_option_uint(rsp, COAP_OPTION_SIZE2, (uint32_t)file->len);
+    }
+    if (COAP_CONTENTTYPE_NONE != file->content_format)
+        coap_add_option_uint(rsp, COAP_OPTION_CONTENT_FORMAT, (uint32_t)file->content_format);
+    return COAP_CONTENT;
+}
+
+coap_error_t coap_files_respond(coap_files_t *files, const coap_packet_t *request, uint8_t *head, size_t *headlen, coap_buffer_t *payload, coap_file_set_t **pin)
+{
+    coap_file_set_t *set = coap_files_acquire(files);
+    coap_file_t *file = NULL;
+    coap_packet_t rsp;
+    uint8_t etag_value[COAP_ETAG_SIZE], block_option[3];
+    coap_error_t err;
+    size_t len = *headlen;
+    uint32_t i;
+
+    *pin = NULL;
+    payload->p = NULL;
+    payload->len = 0;
+    for (i = 0; i < set->count && NULL == file; i++)
+        if (coap_files_path_matches(set->files[i].uri_path, request))
+            file = &set->files[i];
+    if (NULL == file)
+    {
+        coap_files_release(set);
+        return COAP_ERR_NONE;
+    }
+
+    coap_make_response(&rsp, NULL, 0, request->hdr.id, &request->tok, COAP_METHOD_NOT_ALLOWED, COAP_CONTENTTYPE_NONE);
+    if (COAP_TYPE_NONCON == request->hdr.t)
+        rsp.hdr.t = COAP_TYPE_NONCON;
+    if (COAP_GET == request->hdr.code)
+    {
+        const coap_option_t *etags;
+        uint64_t etag = coap_files_etag(file);
+        uint8_t count = 0;
+
+        // http://tools.ietf.org/html/rfc7252#section-5.10.6.2
+        rsp.hdr.code = COAP_CONTENT;
+        etags = coap_findOptions(request, COAP_OPTION_ETAG, &count);
+        for (i = 0; i < count; i++)
+            if (coap_etag_matches(&etags[i].buf, etag))
+                rsp.hdr.code = COAP_VALID;
+        if (COAP_CONTENT == rsp.hdr.code)
+            rsp.hdr.code = coap_files_content(file, request, &rsp, block_option, payload);
+        if (COAP_BAD_OPTION != rsp.hdr.code)
+        {
+            coap_etag_encode(etag, etag_value);
+            coap_add_option(&rsp, COAP_OPTION_ETAG, etag_value, sizeof(etag_value));
+        }
+    }
+
+    err = coap_build_head(head, &len, &rsp);
+    if (COAP_ERR_NONE == err && payload->len > 0)
+    {
+        if (len < *headlen)
+            head[len++] = 0xFF;     // payload marker
+        else
+            err = COAP_ERR_BUFFER_TOO_SMALL;
+    }
+    if (COAP_ERR_NONE != err)
+    {
+        payload->p = NULL;
+        payload->len = 0;
+        coap_files_release(set);
+        return err;
+    }
+    *headlen = len;
+    *pin = set;
+    return COAP_ERR_NONE;
+}
+
+void coap_files_destroy(coap_files_t *files)
+{
+    coap_files_unmap(&files->sets[0]);
+    coap_files_unmap(&files->sets[1]);
+}
@@ -0,0 +1,119 @@
+#ifndef COAP_FILES_H
+#define COAP_FILES_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap.h"
+
+// Static resources served from memory mapped files (POSIX only). Files are mapped once per reload, ETags are
+// computed on the first GET of a file. Responses are split into a head (header, token, options and payload marker)
+// built into a caller buffer and a payload pointing into the mapping, to be sent together with scatter-gather I/O:
+//
+//     struct iovec iov[2] = {{head, headlen}, {(void *)payload.p, payload.len}};
+//     sendmsg(fd, &(struct msghdr){.msg_name = &peer, .msg_namelen = peerlen, .msg_iov = iov, .msg_iovlen = 2}, 0);
+//     coap_files_release(pin);
+//
+// Reloads map the new files into the spare generation and switch over atomically. A generation stays mapped while
+// responses pin it. Block-wise transfers that span a reload see a new ETag on the next block, see
+// http://tools.ietf.org/html/rfc7959#section-2.4. Replace files by renaming them, a file changed in place changes
+// under the mapping.
+
+// Longest Uri-Path of a file, segments separated by '/'
+#ifndef COAP_FILES_PATH_SIZE
+#define COAP_FILES_PATH_SIZE 64
+#endif
+
+// Largest block, a power of two from 16 to 1024. Larger files are split even if the client did not ask for Block2.
+#ifndef COAP_FILES_BLOCK_SIZE
+#define COAP_FILES_BLOCK_SIZE 1024
+#endif
+
+// Largest head: header, token, ETag, Content-Format, Block2, Size2 and payload marker
+#define COAP_FILES_HEAD_SIZE 48
+
+typedef enum
+{
+    COAP_FILES_OK = 0,
+    COAP_FILES_BUSY,                    /* The previous generation is still pinned, try again later */
+    COAP_FILES_TOO_MANY,                /* More files than the capacity of a generation */
+    COAP_FILES_IO                       /* A file could not be opened or mapped */
+} coap_files_result_t;
+
+/// A file to serve
+typedef struct
+{
+    const char *uri_path;               /* Uri-Path without leading '/', for example "fw/image.bin" */
+    const char *file;                   /* File system path */
+    coap_content_type_t content_format; /* COAP_CONTENTTYPE_NONE to leave out Content-Format */
+} coap_file_source_t;
+
+typedef struct
+{
+    char uri_path[COAP_FILES_PATH_SIZE];
+    const uint8_t *data;                /* Mapping, NULL for an empty file */
+    size_t len;
+    coap_content_type_t content_format;
+    _Atomic uint64_t etag;              /* Hash of the content, 0 until the first GET */
+} coap_file_t;
+
+/// Generation of files
+typedef struct
+{
+    coap_file_t *files;
+    uint32_t count;
+    _Atomic uint32_t pins;              /* Responses still pointing into the mappings */
+} coap_file_set_t;
+
+typedef struct
+{
+    coap_file_set_t sets[2];            /* Current and previous generation */
+    _Atomic uint32_t current;           /* Index of the current generation */
+    uint32_t capacity;                  /* Files per generation */
+} coap_files_t;
+
+/// @brief Initializes an empty resource set
+/// @param files Resource set
+/// @param storage Storage for 2 * capacity files, must stay valid as long as files is used
+/// @param capacity Files per generation
+void coap_files_init(coap_files_t *files, coap_file_t *storage, uint32_t capacity);
+
+/// @brief Maps a new set of files and makes it current. The previous generation is unmapped, so only one reload
+/// may run at a time. Lookups continue during a reload.
+/// @param files Resource set
+/// @param sources Files to serve
+/// @param count Number of sources
+/// @return COAP_FILES_OK on success. On errors the current generation stays.
+coap_files_result_t coap_files_reload(coap_files_t *files, const coap_file_source_t *sources, uint32_t count);
+
+/// @brief Answers a request for a file: 2.05 with the whole file or a Block2 slice, 2.03 if the ETag of the request
+/// is current, 4.05 for other methods than GET and 4.02 for a block behind the end. The response has the type and
+/// message ID of a piggybacked response (NON for NON requests). Thread safe.
+/// @param files Resource set
+/// @param request Parsed request
+/// @param[out] head Buffer for header, token, options and payload marker
+/// @param[in,out] headlen Size of head (COAP_FILES_HEAD_SIZE is enough), set to the bytes to send before payload
+/// @param[out] payload Part of the file to send after head, empty without payload
+/// @param[out] pin Generation payload points into, NULL if no file has the Uri-Path of the request (nothing is
+/// built then). Release it with coap_files_release() once the response was sent.
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if head is too small (pin is NULL then)
+coap_error_t coap_files_respond(coap_files_t *files, const coap_packet_t *request, uint8_t *head, size_t *headlen, coap_buffer_t *payload, coap_file_set_t **pin);
+
+/// @brief Releases a generation pinned by coap_files_respond()
+/// @param pin Generation, may be NULL
+void coap_files_release(coap_file_set_t *pin);
+
+/// @brief Unmaps all files. No generation may be pinned.
+/// @param files Resource set
+void coap_files_destroy(coap_files_t *files);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,471 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_format.h"
+
+typedef enum
+{
+    COAP_FORMAT_OPAQUE = 0,
+    COAP_FORMAT_EMPTY,
+    COAP_FORMAT_UINT,
+    COAP_FORMAT_TEXT,
+    COAP_FORMAT_BLOCK
+} coap_format_kind_t;
+
+static const char coap_format_hex[] = "0123456789abcdef";
+
+// Option names are padded, so that they are copied as a whole, the longest is "Location-Query"
+#define COAP_FORMAT_OPTION_NAME_SIZE 16
+
+typedef struct
+{
+    char name[COAP_FORMAT_OPTION_NAME_SIZE];
+    uint8_t len;
+    uint8_t kind;                   /* coap_format_kind_t of the value */
+} coap_format_option_name_t;
+
+// Names of codes are copied once per packet, they are not padded
+typedef struct
+{
+    const char *name;
+    size_t len;                     /* A size_t: GCC inlines copies of at most 255 bytes as slow rep movsb */
+    bool quote;                     /* A logfmt value of the name needs quotes: it has a space */
+} coap_format_code_name_t;
+
+#define COAP_FORMAT_OPTION_NAME(name, kind) {name, sizeof(name) - 1, kind}
+#define COAP_FORMAT_CODE_NAME(name, quote) {name, sizeof(name) - 1, quote}
+
+// http://www.iana.org/assignments/core-parameters/core-parameters.xhtml#option-numbers
+static const coap_format_option_name_t coap_format_options[61] =
+{
+    [1] = COAP_FORMAT_OPTION_NAME("If-Match", COAP_FORMAT_OPAQUE),
+    [3] = COAP_FORMAT_OPTION_NAME("Uri-Host", COAP_FORMAT_TEXT),
+    [4] = COAP_FORMAT_OPTION_NAME("ETag", COAP_FORMAT_OPAQUE),
+    [5] = COAP_FORMAT_OPTION_NAME("If-None-Match", COAP_FORMAT_EMPTY),
+    [6] = COAP_FORMAT_OPTION_NAME("Observe", COAP_FORMAT_UINT),
+    [7] = COAP_FORMAT_OPTION_NAME("Uri-Port", COAP_FORMAT_UINT),
+    [8] = COAP_FORMAT_OPTION_NAME("Location-Path", COAP_FORMAT_TEXT),
+    [9] = COAP_FORMAT_OPTION_NAME("OSCORE", COAP_FORMAT_OPAQUE),
+    [11] = COAP_FORMAT_OPTION_NAME("Uri-Path", COAP_FORMAT_TEXT),
+    [12] = COAP_FORMAT_OPTION_NAME("Content-Format", COAP_FORMAT_UINT),
+    [14] = COAP_FORMAT_OPTION_NAME("Max-Age", COAP_FORMAT_UINT),
+    [15] = COAP_FORMAT_OPTION_NAME("Uri-Query", COAP_FORMAT_TEXT),
+    [16] = COAP_FORMAT_OPTION_NAME("Hop-Limit", COAP_FORMAT_UINT),
+    [17] = COAP_FORMAT_OPTION_NAME("Accept", COAP_FORMAT_UINT),
+    [19] = COAP_FORMAT_OPTION_NAME("Q-Block1", COAP_FORMAT_BLOCK),
+    [20] = COAP_FORMAT_OPTION_NAME("Location-Query", COAP_FORMAT_TEXT),
+    [21] = COAP_FORMAT_OPTION_NAME("EDHOC", COAP_FORMAT_EMPTY),
+    [23] = COAP_FORMAT_OPTION_NAME("Block2", COAP_FORMAT_BLOCK),
+    [27] = COAP_FORMAT_OPTION_NAME("Block1", COAP_FORMAT_BLOCK),
+    [28] = COAP_FORMAT_OPTION_NAME("Size2", COAP_FORMAT_UINT),
+    [31] = COAP_FORMAT_OPTION_NAME("Q-Block2", COAP_FORMAT_BLOCK),
+    [35] = COAP_FORMAT_OPTION_NAME("Proxy-Uri", COAP_FORMAT_TEXT),
+    [39] = COAP_FORMAT_OPTION_NAME("Proxy-Scheme", COAP_FORMAT_TEXT),
+    [60] = COAP_FORMAT_OPTION_NAME("Size1", COAP_FORMAT_UINT)
+};
+
+static const coap_format_option_name_t coap_format_option_echo = COAP_FORMAT_OPTION_NAME("Echo", COAP_FORMAT_OPAQUE);
+
+// http://www.iana.org/assignments/core-parameters/core-parameters.xhtml#method-codes and #response-codes
+static const coap_format_code_name_t coap_format_codes[256] =
+{
+    [0x00] = COAP_FORMAT_CODE_NAME("Empty", false),
+    [0x01] = COAP_FORMAT_CODE_NAME("GET", false),
+    [0x02] = COAP_FORMAT_CODE_NAME("POST", false),
+    [0x03] = COAP_FORMAT_CODE_NAME("PUT", false),
+    [0x04] = COAP_FORMAT_CODE_NAME("DELETE", false),
+    [0x05] = COAP_FORMAT_CODE_NAME("FETCH", false),
+    [0x06] = COAP_FORMAT_CODE_NAME("PATCH", false),
+    [0x07] = COAP_FORMAT_CODE_NAME("iPATCH", false),
+    [0x41] = COAP_FORMAT_CODE_NAME("Created", false),
+    [0x42] = COAP_FORMAT_CODE_NAME("Deleted", false),
+    [0x43] = COAP_FORMAT_CODE_NAME("Valid", false),
+    [0x44] = COAP_FORMAT_CODE_NAME("Changed", false),
+    [0x45] = COAP_FORMAT_CODE_NAME("Content", false),
+    [0x5F] = COAP_FORMAT_CODE_NAME("Continue", false),
+    [0x80] = COAP_FORMAT_CODE_NAME("Bad Request", true),
+    [0x81] = COAP_FORMAT_CODE_NAME("Unauthorized", false),
+    [0x82] = COAP_FORMAT_CODE_NAME("Bad Option", true),
+    [0x83] = COAP_FORMAT_CODE_NAME("Forbidden", false),
+    [0x84] = COAP_FORMAT_CODE_NAME("Not Found", true),
+    [0x85] = COAP_FORMAT_CODE_NAME("Method Not Allowed", true),
+    [0x86] = COAP_FORMAT_CODE_NAME("Not Acceptable", true),
+    [0x88] = COAP_FORMAT_CODE_NAME("Request Entity Incomplete", true),
+    [0x89] = COAP_FORMAT_CODE_NAME("Conflict", false),
+    [0x8C] = COAP_FORMAT_CODE_NAME("Precondition Failed", true),
+    [0x8D] = COAP_FORMAT_CODE_NAME("Request Entity Too Large", true),
+    [0x8F] = COAP_FORMAT_CODE_NAME("Unsupported Content-Format", true),
+    [0x96] = COAP_FORMAT_CODE_NAME("Unprocessable Entity", true),
+    [0x9D] = COAP_FORMAT_CODE_NAME("Too Many Requests", true),
+    [0xA0] = COAP_FORMAT_CODE_NAME("Internal Server Error", true),
+    [0xA1] = COAP_FORMAT_CODE_NAME("Not Implemented", true),
+    [0xA2] = COAP_FORMAT_CODE_NAME("Bad Gateway", true),
+    [0xA3] = COAP_FORMAT_CODE_NAME("Service Unavailable", true),
+    [0xA4] = COAP_FORMAT_CODE_NAME("Gateway Timeout", true),
+    [0xA5] = COAP_FORMAT_CODE_NAME("Proxying Not Supported", true),
+    [0xA8] = COAP_FORMAT_CODE_NAME("Hop Limit Reached", true),
+    [0xE1] = COAP_FORMAT_CODE_NAME("CSM", false),
+    [0xE2] = COAP_FORMAT_CODE_NAME("Ping", false),
+    [0xE3] = COAP_FORMAT_CODE_NAME("Pong", false),
+    [0xE4] = COAP_FORMAT_CODE_NAME("Release", false),
+    [0xE5] = COAP_FORMAT_CODE_NAME("Abort", false)
+};
+
+// Entry of a named option, NULL for others
+static const coap_format_option_name_t *coap_format_option_entry(uint8_t num)
+{
+    if (num < sizeof(coap_format_options) / sizeof(coap_format_options[0]))
+        return (0 != coap_format_options[num].len) ? &coap_format_options[num] : NULL;
+    return (252 == num) ? &coap_format_option_echo : NULL;
+}
+
+const char *coap_format_option_name(uint8_t num)
+{
+    const coap_format_option_name_t *entry = coap_format_option_entry(num);
+    return (NULL != entry) ? entry->name : NULL;
+}
+
+const char *coap_format_code_name(uint8_t code)
+{
+    return coap_format_codes[code].name;
+}
+
+// Writers below do not check for space, the caller makes sure that the buffer has room for what they write at most
+
+static char *coap_format_uint(char *p, uint32_t value)
+{
+    char *end;
+    uint32_t rest = value;
+
+    do
+        p++;
+    while (0 != (rest /= 10));
+    end = p;
+    do
+    {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (0 != value);
+    return end;
+}
+
+// Separator and key, 3 characters plus key at most
+static char *coap_format_key(char *p, bool json, const char *key, size_t len)
+{
+    if (json)
+    {
+        *p++ = ',';
+        *p++ = '"';
+        memcpy(p, key, len);
+        p += len;
+        *p++ = '"';
+        *p++ = ':';
+    }
+    else
+    {
+        *p++ = ' ';
+        memcpy(p, key, len);
+        p += len;
+        *p++ = '=';
+    }
+    return p;
+}
+
+#define COAP_FORMAT_KEY(p, json, key) coap_format_key(p, json, key, sizeof(key) - 1)
+
+// Classes of bytes in text values
+#define COAP_FORMAT_PLAIN 0             /* Copied as is */
+#define COAP_FORMAT_QUOTE 1             /* Copied, a logfmt value with it needs quotes: space, '=' and DEL */
+#define COAP_FORMAT_ESCAPE 2            /* Escaped with a backslash: quote, backslash, tab and line breaks */
+#define COAP_FORMAT_BINARY 3            /* Other control characters and bytes that start no UTF-8 sequence */
+#define COAP_FORMAT_SEQ2 4              /* First byte of a 2, 3 or 4 byte UTF-8 sequence */
+#define COAP_FORMAT_SEQ3 5
+#define COAP_FORMAT_SEQ4 6
+
+static const uint8_t coap_format_class[256] =
+{
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 3, 3, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+};
+
+// Writes the first len bytes as text: UTF-8 without control characters other than tab and line breaks. A
+// sequence crossing len is left out if the value is cut there anyway. Needs 2 * len + 5 characters. NULL if the
+// bytes are no text, out then holds garbage.
+static char *coap_format_text(char *out, const uint8_t *p, size_t len, bool json, bool cut)
+{
+    const uint8_t *end = p + len, *q;
+    bool quote = json || 0 == len;
+    size_t seq;
+
+    // quotes are decided up front, so that the value is written in place
+    for (q = p; !quote && q < end; q++)
+        quote = COAP_FORMAT_QUOTE == coap_format_class[*q] || COAP_FORMAT_ESCAPE == coap_format_class[*q];
+    if (quote)
+        *out++ = '"';
+    while (p < end)
+    {
+        uint8_t c = *p;
+        switch (coap_format_class[c])
+        {
+            case COAP_FORMAT_PLAIN:
+                *out++ = (char)c;
+                p++;
+                continue;
+            case COAP_FORMAT_QUOTE:
+                *out++ = (char)c;
+                p++;
+                continue;
+            case COAP_FORMAT_ESCAPE:
+                *out++ = '\\';
+                *out++ = ('\n' == c) ? 'n' : ('\r' == c) ? 'r' : ('\t' == c) ? 't' : (char)c;
+                p++;
+                continue;
+            case COAP_FORMAT_SEQ2:
+                seq = 2;
+                break;
+            case COAP_FORMAT_SEQ3:
+                seq = 3;
+                break;
+            case COAP_FORMAT_SEQ4:
+                seq = 4;
+                break;
+            default:
+                return NULL;
+        }
+        if ((size_t)(end - p) < seq)
+        {
+            if (!cut)
+                return NULL;
+            break;
+        }
+        // continuation bytes, overlong three and four byte forms, surrogates and code points above U+10FFFF
+        if ((p[1] & 0xC0) != 0x80 || (seq > 2 && (p[2] & 0xC0) != 0x80) || (seq > 3 && (p[3] & 0xC0) != 0x80) ||
+            (0xE0 == c && p[1] < 0xA0) || (0xED == c && p[1] > 0x9F) || (0xF0 == c && p[1] < 0x90) || (0xF4 == c && p[1] > 0x8F))
+            return NULL;
+        memcpy(out, p, seq);
+        out += seq;
+        p += seq;
+    }
+    if (cut)
+    {
+        memcpy(out, "...", 3);
+        out += 3;
+    }
+    if (quote)
+        *out++ = '"';
+    return out;
+}
+
+// 2 * len + 7 characters
+static char *coap_format_hex_value(char *out, bool json, const uint8_t *p, size_t len, bool cut)
+{
+    const uint8_t *end = p + len;
+
+    if (json)
+        *out++ = '"';
+    *out++ = '0';
+    *out++ = 'x';
+    for (; p < end; p++)
+    {
+        *out++ = coap_format_hex[*p >> 4];
+        *out++ = coap_format_hex[*p & 0x0F];
+    }
+    if (cut)
+    {
+        memcpy(out, "...", 3);
+        out += 3;
+    }
+    if (json)
+        *out++ = '"';
+    return out;
+}
+
+// Text as text if it is, otherwise as hex, both cut at limit. NULL if it does not fit before end.
+static char *coap_format_bytes(char *out, const char *end, const coap_format_config_t *config, const coap_buffer_t *buf, size_t limit, bool text)
+{
+    size_t len = (buf->len > limit) ? limit : buf->len;
+    bool cut = buf->len > limit, json = COAP_FORMAT_JSON == config->style;
+    char *next;
+
+    if ((size_t)(end - out) < 2 * len + 7)
+        return NULL;
+    if (text && COAP_FORMAT_VALUES_AUTO == config->values && NULL != (next = coap_format_text(out, buf->p, len, json, cut)))
+        return next;
+    return coap_format_hex_value(out, json, buf->p, len, cut);
+}
+
+// Value of an option of the given kind, NULL if it does not fit before end
+static char *coap_format_option(char *p, const char *end, const coap_format_config_t *config, const coap_option_t *opt, coap_format_kind_t kind)
+{
+    bool json = COAP_FORMAT_JSON == config->style;
+    uint32_t value;
+
+    if (COAP_FORMAT_UINT == kind || COAP_FORMAT_BLOCK == kind)
+    {
+        if (COAP_ERR_NONE != coap_decode_uint(&opt->buf, &value))
+            kind = COAP_FORMAT_OPAQUE;
+        else if ((size_t)(end - p) < 20)
+            return NULL;
+        else if (COAP_FORMAT_UINT == kind)
+            return coap_format_uint(p, value);
+        else
+        {
+            // num/m/size, szx 7 is shown as 2048 like BERT blocks of TCP
+            if (json)
+                *p++ = '"';
+            p = coap_format_uint(p, value >> 4);
+            *p++ = '/';
+            *p++ = (char)('0' + ((value >> 3) & 1));
+            *p++ = '/';
+            p = coap_format_uint(p, 16U << (value & 0x07));
+            if (json)
+                *p++ = '"';
+            return p;
+        }
+    }
+    if (COAP_FORMAT_EMPTY == kind && 0 == opt->buf.len)
+    {
+        if ((size_t)(end - p) < 2)
+            return NULL;
+        *p++ = '"';
+        *p++ = '"';
+        return p;
+    }
+    return coap_format_bytes(p, end, config, &opt->buf, config->max_value, COAP_FORMAT_TEXT == kind);
+}
+
+// Longest code name, "Request Entity Incomplete"
+#define COAP_FORMAT_CODE_NAME_MAX 26
+
+coap_error_t coap_format_packet(char *buf, size_t *buflen, const coap_packet_t *pkt, const coap_format_config_t *config)
+{
+    static const char *const types[4] = {"CON", "NON", "ACK", "RST"};
+    char *p = buf, *end = buf + *buflen, *next;
+    bool json = COAP_FORMAT_JSON == config->style;
+    const coap_format_code_name_t *code = &coap_format_codes[pkt->hdr.code];
+    uint8_t i;
+
+    // type, code with name, id and token
+    if ((size_t)(end - p) < 13 + 14 + 10 + COAP_FORMAT_CODE_NAME_MAX + 2 + 11 + 12 + 2 * pkt->tok.len + 2)
+        goto full;
+    if (json)
+    {
+        memcpy(p, "{\"type\":\"", 9);
+        p += 9;
+    }
+    else
+    {
+        memcpy(p, "type=", 5);
+        p += 5;
+    }
+    memcpy(p, types[pkt->hdr.t & 0x03], 3);
+    p += 3;
+    if (json)
+        *p++ = '"';
+    p = COAP_FORMAT_KEY(p, json, "code");
+    if (json)
+        *p++ = '"';
+    *p++ = (char)('0' + (pkt->hdr.code >> 5));
+    *p++ = '.';
+    *p++ = (char)('0' + (pkt->hdr.code & 0x1F) / 10);
+    *p++ = (char)('0' + (pkt->hdr.code & 0x1F) % 10);
+    if (json)
+        *p++ = '"';
+    if (NULL != code->name)
+    {
+        bool quote = json || code->quote;
+        p = COAP_FORMAT_KEY(p, json, "name");
+        if (quote)
+            *p++ = '"';
+        memcpy(p, code->name, code->len);
+        p += code->len;
+        if (quote)
+            *p++ = '"';
+    }
+    p = COAP_FORMAT_KEY(p, json, "id");
+    p = coap_format_uint(p, pkt->hdr.id);
+    if (pkt->tok.len > 0)
+    {
+        p = COAP_FORMAT_KEY(p, json, "token");
+        p = coap_format_hex_value(p, json, pkt->tok.p, pkt->tok.len, false);
+    }
+
+    for (i = 0; i < pkt->numopts; i++)
+    {
+        const coap_option_t *opt = &pkt->opts[i];
+        const coap_format_option_name_t *entry = coap_format_option_entry(opt->num);
+        coap_format_option_name_t number;
+
+        if (NULL == entry)
+        {
+            // unknown options are named by number
+            memset(&number, 0, sizeof(number));
+            if (opt->num >= 100)
+                number.name[number.len++] = (char)('0' + opt->num / 100);
+            if (opt->num >= 10)
+                number.name[number.len++] = (char)('0' + opt->num / 10 % 10);
+            number.name[number.len++] = (char)('0' + opt->num % 10);
+            entry = &number;
+        }
+        if ((size_t)(end - p) < 14 + COAP_FORMAT_OPTION_NAME_SIZE + 2)
+            goto full;
+        if (json)
+        {
+            memcpy(p, (0 == i) ? ",\"options\":[[\"" : ",[\"", (0 == i) ? 14 : 3);
+            p += (0 == i) ? 14 : 3;
+        }
+        else
+            *p++ = ' ';
+        // the name is copied with its padding, which is overwritten by what follows
+        memcpy(p, entry->name, COAP_FORMAT_OPTION_NAME_SIZE);
+        p += entry->len;
+        if (json)
+        {
+            *p++ = '"';
+            *p++ = ',';
+        }
+        else
+            *p++ = '=';
+        // room for the closing brackets of option and options
+        if (NULL == (next = coap_format_option(p, end - 2, config, opt, (coap_format_kind_t)entry->kind)))
+            goto full;
+        p = next;
+        if (json)
+            *p++ = ']';
+    }
+    if (json && pkt->numopts > 0)
+        *p++ = ']';
+
+    if ((size_t)(end - p) < 16 + 10)
+        goto full;
+    p = COAP_FORMAT_KEY(p, json, "payload_len");
+    p = coap_format_uint(p, (uint32_t)pkt->payload.len);
+    if (pkt->payload.len > 0 && config->max_payload > 0)
+    {
+        if ((size_t)(end - p) < 12)
+            goto full;
+        next = COAP_FORMAT_KEY(p, json, "payload");
+        if (NULL == (next = coap_format_bytes(next, end - 1, config, &pkt->payload, config->max_payload, true)))
+            goto full;
+        p = next;
+    }
+    if (json)
+    {
+        if (p == end)
+            goto full;
+        *p++ = '}';
+    }
+    *buflen = (size_t)(p - buf);
+    return COAP_ERR_NONE;
+
+full:
+    *buflen = (size_t)(p - buf);
+    return COAP_ERR_BUFFER_TOO_SMALL;
+}
@@ -0,0 +1,69 @@
+#ifndef COAP_FORMAT_H
+#define COAP_FORMAT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Renders a packet as one line of structured text for log pipelines, into a caller buffer and without printf().
+// Options and codes are named, options with a registered format are decoded:
+//
+//     {"type":"CON","code":"0.01","name":"GET","id":4660,"token":"0x12ab","options":[["Uri-Path","sensors"],
+//      ["Accept",50],["Block2","2/0/64"]],"payload_len":0}
+//     type=CON code=0.01 name=GET id=4660 token=0x12ab Uri-Path=sensors Accept=50 Block2=2/0/64 payload_len=0
+//
+// Opaque values are written as hex with 0x prefix. Text is escaped as needed by the style, logfmt values are quoted
+// if they hold a space, a quote, '=' or nothing. Block options are shown as num/m/size. A value cut at its limit
+// ends in "...".
+
+typedef enum
+{
+    COAP_FORMAT_JSON = 0,               /* One object per message */
+    COAP_FORMAT_LOGFMT                  /* key=value pairs separated by spaces */
+} coap_format_style_t;
+
+typedef enum
+{
+    COAP_FORMAT_VALUES_AUTO = 0,        /* Text options and payload as text if they are UTF-8 without control
+                                         * characters other than tab and line breaks, hex otherwise */
+    COAP_FORMAT_VALUES_HEX              /* Text options and payload always as hex */
+} coap_format_values_t;
+
+typedef struct
+{
+    coap_format_style_t style;
+    coap_format_values_t values;
+    size_t max_value;                   /* Bytes of an option value shown at most */
+    size_t max_payload;                 /* Bytes of the payload shown at most, 0 shows only its length */
+} coap_format_config_t;
+
+/// @brief Name of an option number
+/// @param num Option number
+/// @return Name as registered in the CoAP Option Numbers registry, for example "Uri-Path", NULL if unknown
+const char *coap_format_option_name(uint8_t num);
+
+/// @brief Name of a method, response or signaling code
+/// @param code Code
+/// @return Name, for example "GET" or "Not Found", NULL if unknown
+const char *coap_format_code_name(uint8_t code);
+
+/// @brief Renders a packet as JSON object or logfmt line, without line break or zero terminator
+/// @param[out] buf Buffer to write into
+/// @param[in,out] buflen Size of buf, set to the number of characters written
+/// @param pkt Packet, for example from coap_parse()
+/// @param config Style, value rendering and limits
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the line does not fit buf. buf then holds the
+/// fields before the one that did not fit. A field is only started with room for its longest form, so buf should
+/// have 128 characters plus the longest values expected.
+coap_error_t coap_format_packet(char *buf, size_t *buflen, const coap_packet_t *pkt, const coap_format_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_linkformat.h"
+
+enum
+{
+    COAP_LINKFORMAT_STATE_START,    // before '<' of a link
+    COAP_LINKFORMAT_STATE_HREF,     // inside <...>
+    COAP_LINKFORMAT_STATE_AFTER,    // behind '>', expecting ';' or ','
+    COAP_LINKFORMAT_STATE_PARAM     // inside an attribute, up to ';' or ',' outside of quotes
+};
+
+void coap_linkformat_init(coap_linkformat_parser_t *parser, coap_linkformat_cb cb, void *ctx)
+{
+    parser->state = COAP_LINKFORMAT_STATE_START;
+    parser->quoted = false;
+    parser->escaped = false;
+    parser->cb = cb;
+    parser->ctx = ctx;
+    parser->carry_len = 0;
+}
+
+// Returns the complete unit (href or attribute) ending at end. Its beginning is in the carry if it started in an
+// earlier chunk, then the rest is appended, otherwise the unit is returned as view into the chunk.
+static coap_error_t coap_linkformat_unit(coap_linkformat_parser_t *parser, const uint8_t *start, const uint8_t *end, coap_buffer_t *unit)
+{
+    size_t len = end - start;
+    if (0 == parser->carry_len)
+    {
+        unit->p = start;
+        unit->len = len;
+        return COAP_ERR_NONE;
+    }
+    if (len > COAP_LINKFORMAT_CARRY_SIZE - parser->carry_len)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    memcpy(parser->carry + parser->carry_len, start, len);
+    unit->p = parser->carry;
+    unit->len = parser->carry_len + len;
+    parser->carry_len = 0;
+    return COAP_ERR_NONE;
+}
+
+static void coap_linkformat_attr(coap_linkformat_parser_t *parser, const coap_buffer_t *unit)
+{
+    const uint8_t *eq;
+    coap_buffer_t name = *unit, value = {NULL, 0};
+
+    if (0 == unit->len)
+        return;
+    if (NULL != (eq = memchr(unit->p, '=', unit->len)))
+    {
+        name.len = eq - unit->p;
+        value.p = eq + 1;
+        value.len = unit->len - name.len - 1;
+        if (value.len >= 2 && value.p[0] == '"' && value.p[value.len - 1] == '"')
+        {
+            value.p++;
+            value.len -= 2;
+        }
+    }
+    parser->cb(parser->ctx, COAP_LINKFORMAT_ATTR, &name, &value);
+}
+
+coap_error_t coap_linkformat_feed(coap_linkformat_parser_t *parser, const coap_buffer_t *chunk, bool last)
+{
+    const uint8_t *p = chunk->p;
+    const uint8_t *end = chunk->p + chunk->len;
+    const uint8_t *start = p;   // beginning of the current unit in this chunk
+    coap_buffer_t unit;
+    coap_error_t err;
+
+    while (p < end)
+    {
+        switch (parser->state)
+        {
+        case COAP_LINKFORMAT_STATE_START:
+            if (*p == '<')
+            {
+                parser->state = COAP_LINKFORMAT_STATE_HREF;
+                start = p + 1;
+            }
+            else if (*p != ' ' && *p != '\r' && *p != '\n' && *p != '\t')
+                return COAP_ERR_LINKFORMAT_INVALID;
+            p++;
+            break;
+        case COAP_LINKFORMAT_STATE_HREF:
+        {
+            const uint8_t *close = memchr(p, '>', end - p);
+            if (NULL == close)
+            {
+                p = end;
+                break;
+            }
+            if (COAP_ERR_NONE != (err = coap_linkformat_unit(parser, start, close, &unit)))
+                return err;
+            parser->cb(parser->ctx, COAP_LINKFORMAT_LINK, &unit, NULL);
+            parser->state = COAP_LINKFORMAT_STATE_AFTER;
+            p = close + 1;
+            break;
+        }
+        case COAP_LINKFORMAT_STATE_AFTER:
+            if (*p == ';')
+            {
+                parser->state = COAP_LINKFORMAT_STATE_PARAM;
+                start = p + 1;
+            }
+            else if (*p == ',')
+            {
+                parser->cb(parser->ctx, COAP_LINKFORMAT_END, NULL, NULL);
+                parser->state = COAP_LINKFORMAT_STATE_START;
+            }
+            else
+                return COAP_ERR_LINKFORMAT_INVALID;
+            p++;
+            break;
+        case COAP_LINKFORMAT_STATE_PARAM:
+            if (parser->quoted)
+            {
+                if (parser->escaped)
+                    parser->escaped = false;
+                else if (*p == '\\')
+                    parser->escaped = true;
+                else if (*p == '"')
+                    parser->quoted = false;
+            }
+            else if (*p == '"')
+                parser->quoted = true;
+            else if (*p == ';' || *p == ',')
+            {
+                if (COAP_ERR_NONE != (err = coap_linkformat_unit(parser, start, p, &unit)))
+                    return err;
+                coap_linkformat_attr(parser, &unit);
+                if (*p == ',')
+                {
+                    parser->cb(parser->ctx, COAP_LINKFORMAT_END, NULL, NULL);
+                    parser->state = COAP_LINKFORMAT_STATE_START;
+                }
+                start = p + 1;
+            }
+            p++;
+            break;
+        }
+    }
+
+    if (last)
+    {
+        if (parser->state == COAP_LINKFORMAT_STATE_HREF || parser->quoted)
+            return COAP_ERR_LINKFORMAT_INVALID;
+        if (parser->state == COAP_LINKFORMAT_STATE_PARAM)
+        {
+            if (COAP_ERR_NONE != (err = coap_linkformat_unit(parser, start, end, &unit)))
+                return err;
+            coap_linkformat_attr(parser, &unit);
+        }
+        if (parser->state != COAP_LINKFORMAT_STATE_START)
+            parser->cb(parser->ctx, COAP_LINKFORMAT_END, NULL, NULL);
+        parser->state = COAP_LINKFORMAT_STATE_START;
+        return COAP_ERR_NONE;
+    }
+
+    // keep the part of an unfinished href or attribute for the next chunk
+    if (parser->state == COAP_LINKFORMAT_STATE_HREF || parser->state == COAP_LINKFORMAT_STATE_PARAM)
+    {
+        size_t len = end - start;
+        if (len > COAP_LINKFORMAT_CARRY_SIZE - parser->carry_len)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        if (len > 0)
+            memcpy(parser->carry + parser->carry_len, start, len);
+        parser->carry_len += len;
+    }
+    return COAP_ERR_NONE;
+}
@@ -0,0 +1,66 @@
+#ifndef COAP_LINKFORMAT_H
+#define COAP_LINKFORMAT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Longest href or attribute that can be split across two chunks. Only such split parts are copied, everything else
+// is passed on as view into the chunk.
+#ifndef COAP_LINKFORMAT_CARRY_SIZE
+#define COAP_LINKFORMAT_CARRY_SIZE 256
+#endif
+
+typedef enum
+{
+    COAP_LINKFORMAT_LINK,       /* A link starts, first buffer holds the href (without angle brackets) */
+    COAP_LINKFORMAT_ATTR,       /* Attribute of the current link: name and value. Quotes around the value are removed,
+                                 * escape sequences are kept. Value is empty with p == NULL if the attribute has none. */
+    COAP_LINKFORMAT_END         /* The current link is complete */
+} coap_linkformat_event_t;
+
+/// @brief Receives the parse results. Buffers are only valid during the call.
+/// @param ctx Context given to coap_linkformat_init()
+/// @param event Event type
+/// @param first href of COAP_LINKFORMAT_LINK or attribute name of COAP_LINKFORMAT_ATTR, NULL for COAP_LINKFORMAT_END
+/// @param second Attribute value of COAP_LINKFORMAT_ATTR, NULL otherwise
+typedef void (*coap_linkformat_cb)(void *ctx, coap_linkformat_event_t event, const coap_buffer_t *first, const coap_buffer_t *second);
+
+/// Incremental CoRE Link Format (http://tools.ietf.org/html/rfc6690#section-2) parser. The document is fed in
+/// arbitrary chunks, for example Block2 payloads as they arrive, and never has to be reassembled.
+typedef struct
+{
+    uint8_t state;
+    bool quoted;                /* Inside a quoted attribute value */
+    bool escaped;               /* Previous character was a backslash inside a quoted value */
+    coap_linkformat_cb cb;
+    void *ctx;
+    size_t carry_len;           /* Bytes of the current href or attribute seen in previous chunks */
+    uint8_t carry[COAP_LINKFORMAT_CARRY_SIZE];
+} coap_linkformat_parser_t;
+
+/// @brief Initializes a parser for a new document
+/// @param parser Parser to initialize
+/// @param cb Callback receiving links and attributes
+/// @param ctx Context passed to cb
+void coap_linkformat_init(coap_linkformat_parser_t *parser, coap_linkformat_cb cb, void *ctx);
+
+/// @brief Parses the next chunk of the document
+/// @param parser Parser
+/// @param chunk Next bytes of the document, may be empty
+/// @param last True if this is the last chunk (for example Block2 option without M flag)
+/// @return COAP_ERR_NONE on success, COAP_ERR_LINKFORMAT_INVALID if the document is malformed,
+/// COAP_ERR_BUFFER_TOO_SMALL if a split href or attribute exceeds COAP_LINKFORMAT_CARRY_SIZE. The parser must be
+/// initialized again after an error.
+coap_error_t coap_linkformat_feed(coap_linkformat_parser_t *parser, const coap_buffer_t *chunk, bool last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap_pool.h"
+
+// Freelist links are slot indices + 1, so 0 can terminate the list. The upper half of the head is a tag that is
+// incremented with every change, so a pop racing with pop/push of the same slot (ABA) fails its compare exchange.
+#define COAP_POOL_HEAD(tag, link) (((uint64_t)(tag) << 32) | (link))
+#define COAP_POOL_HEAD_LINK(head) ((uint32_t)((head) & 0xFFFFFFFFU))
+#define COAP_POOL_HEAD_TAG(head) ((uint32_t)((head) >> 32))
+
+void coap_pool_init(coap_pool_t *pool, coap_pool_slot_t *slots, uint32_t count)
+{
+    uint32_t i;
+    pool->slots = slots;
+    pool->count = count;
+    for (i = 0; i < count; i++)
+    {
+        coap_arena_init(&slots[i].arena, slots[i].arena_buf, sizeof(slots[i].arena_buf));
+        slots[i].len = 0;
+        atomic_init(&slots[i].next, (i + 1 < count) ? i + 2 : 0);
+    }
+    atomic_init(&pool->head, COAP_POOL_HEAD(0, count > 0 ? 1 : 0));
+}
+
+coap_pool_slot_t *coap_pool_get(coap_pool_t *pool)
+{
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uint64_t next_head;
+    uint32_t link;
+
+    do
+    {
+        link = COAP_POOL_HEAD_LINK(head);
+        if (0 == link)
+            return NULL;
+        // the slot may be popped and pushed concurrently, the tag check of the exchange catches that
+        next_head = COAP_POOL_HEAD(COAP_POOL_HEAD_TAG(head) + 1,
+                                   atomic_load_explicit(&pool->slots[link - 1].next, memory_order_relaxed));
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, next_head,
+                                                  memory_order_acq_rel, memory_order_acquire));
+    return &pool->slots[link - 1];
+}
+
+void coap_pool_put(coap_pool_t *pool, coap_pool_slot_t *slot)
+{
+    uint32_t link = (uint32_t)(slot - pool->slots) + 1;
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+    do
+    {
+        atomic_store_explicit(&slot->next, COAP_POOL_HEAD_LINK(head), memory_order_relaxed);
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, COAP_POOL_HEAD(COAP_POOL_HEAD_TAG(head) + 1, link),
+                                                  memory_order_release, memory_order_relaxed));
+}
+
+void coap_pool_cache_init(coap_pool_cache_t *cache, coap_pool_t *pool)
+{
+    cache->pool = pool;
+    cache->count = 0;
+}
+
+coap_pool_slot_t *coap_pool_acquire(coap_pool_cache_t *cache)
+{
+    coap_pool_slot_t *slot;
+
+    if (0 == cache->count)
+    {
+        // refill half of the cache, so alternating acquire/release does not hit the global freelist every time
+        while (cache->count < COAP_POOL_CACHE_SIZE / 2 && NULL != (slot = coap_pool_get(cache->pool)))
+            cache->slots[cache->count++] = slot;
+        if (0 == cache->count)
+            return NULL;
+    }
+    slot = cache->slots[--cache->count];
+    slot->len = 0;
+    slot->pkt.numopts = 0;
+    slot->pkt.scratch_len = 0;
+    coap_arena_reset(&slot->arena);
+    return slot;
+}
+
+void coap_pool_release(coap_pool_cache_t *cache, coap_pool_slot_t *slot)
+{
+    if (COAP_POOL_CACHE_SIZE == cache->count)
+    {
+        while (cache->count > COAP_POOL_CACHE_SIZE / 2)
+            coap_pool_put(cache->pool, cache->slots[--cache->count]);
+    }
+    cache->slots[cache->count++] = slot;
+}
+
+void coap_pool_cache_flush(coap_pool_cache_t *cache)
+{
+    while (cache->count > 0)
+        coap_pool_put(cache->pool, cache->slots[--cache->count]);
+}
@@ -0,0 +1,97 @@
+#ifndef COAP_POOL_H
+#define COAP_POOL_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap.h"
+
+// Largest datagram a slot can hold, see http://tools.ietf.org/html/rfc7252#section-4.6
+#ifndef COAP_POOL_DATAGRAM_SIZE
+#define COAP_POOL_DATAGRAM_SIZE 1280
+#endif
+
+// Size of the scratch arena of a slot
+#ifndef COAP_POOL_ARENA_SIZE
+#define COAP_POOL_ARENA_SIZE 1024
+#endif
+
+// Number of slots a per thread cache holds before it hands slots back to the pool
+#ifndef COAP_POOL_CACHE_SIZE
+#define COAP_POOL_CACHE_SIZE 16
+#endif
+
+/// Preallocated working set for one message: datagram buffer, parsed packet and scratch arena
+typedef struct
+{
+    uint8_t buf[COAP_POOL_DATAGRAM_SIZE];   /* Datagram buffer */
+    size_t len;                             /* Bytes used in buf */
+    coap_packet_t pkt;                      /* Packet, usually parsed from or built into buf */
+    coap_arena_t arena;                     /* Scratch arena on arena_buf */
+    uint8_t arena_buf[COAP_POOL_ARENA_SIZE];
+    _Atomic uint32_t next;                  /* Freelist link: index of next free slot + 1, 0 ends the list */
+} coap_pool_slot_t;
+
+/// Pool of slots with a lock-free global freelist. Threads access it through a coap_pool_cache_t each, slots may be
+/// acquired on one thread and released on another.
+typedef struct
+{
+    coap_pool_slot_t *slots;                /* Slot storage */
+    uint32_t count;                         /* Number of slots */
+    _Atomic uint64_t head;                  /* Freelist head: ABA tag in the upper, index + 1 in the lower 32 bit */
+} coap_pool_t;
+
+/// Per thread cache of free slots. Must only be used by one thread at a time.
+typedef struct
+{
+    coap_pool_t *pool;
+    uint32_t count;                         /* Number of slots in slots[] */
+    coap_pool_slot_t *slots[COAP_POOL_CACHE_SIZE];
+} coap_pool_cache_t;
+
+/// @brief Initializes a pool on caller provided slots, all slots are free afterwards
+/// @param pool Pool to initialize
+/// @param slots Slot storage, must stay valid as long as the pool is used
+/// @param count Number of slots, at most 0xFFFFFFFE
+void coap_pool_init(coap_pool_t *pool, coap_pool_slot_t *slots, uint32_t count);
+
+/// @brief Takes a slot from the global freelist, bypassing any cache. Lock-free, may be called from any thread.
+/// @param pool Pool to take slot from
+/// @return Slot, NULL if the pool is exhausted
+coap_pool_slot_t *coap_pool_get(coap_pool_t *pool);
+
+/// @brief Returns a slot to the global freelist, bypassing any cache. Lock-free, may be called from any thread.
+/// @param pool Pool the slot was taken from
+/// @param slot Slot to return
+void coap_pool_put(coap_pool_t *pool, coap_pool_slot_t *slot);
+
+/// @brief Initializes an empty per thread cache
+/// @param cache Cache to initialize
+/// @param pool Pool the cache takes slots from
+void coap_pool_cache_init(coap_pool_cache_t *cache, coap_pool_t *pool);
+
+/// @brief Acquires a slot, from the cache if possible, otherwise the cache is refilled from the global freelist.
+/// The slot is reset: len is 0, numopts of pkt is 0 and the arena is empty.
+/// @param cache Cache of the calling thread
+/// @return Slot, NULL if the pool is exhausted
+coap_pool_slot_t *coap_pool_acquire(coap_pool_cache_t *cache);
+
+/// @brief Releases a slot into the cache of the calling thread. The slot may have been acquired by another thread.
+/// If the cache is full, half of it is handed back to the global freelist.
+/// @param cache Cache of the calling thread
+/// @param slot Slot to release
+void coap_pool_release(coap_pool_cache_t *cache, coap_pool_slot_t *slot);
+
+/// @brief Hands all cached slots back to the global freelist, for example before the owning thread exits
+/// @param cache Cache to flush
+void coap_pool_cache_flush(coap_pool_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,290 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_qblock.h"
+#include "coap_cbor.h"
+
+static uint32_t coap_qblock_size(coap_blocksize_t szx)
+{
+    return 16U << szx;
+}
+
+void coap_qblock_tx_init(coap_qblock_tx_t *tx, const uint8_t *body, size_t len, coap_blocksize_t szx, uint32_t now)
+{
+    uint32_t size = coap_qblock_size(szx);
+
+    tx->body = body;
+    tx->len = len;
+    tx->szx = szx;
+    // an empty body is one empty block
+    tx->blocks = (0 == len) ? 1 : (uint32_t)((len + size - 1) / size);
+    tx->next = 0;
+    tx->budget = COAP_QBLOCK_MAX_PAYLOADS;
+    tx->resend_head = 0;
+    tx->resend_count = 0;
+    tx->last_tx = now;
+    tx->probes = 0;
+}
+
+static void coap_qblock_tx_queue(coap_qblock_tx_t *tx, uint32_t num)
+{
+    uint32_t i;
+
+    if (num >= tx->next)
+        return;
+    for (i = 0; i < tx->resend_count; i++)
+        if (tx->resend[tx->resend_head + i] == num)
+            return;
+    if (tx->resend_head + tx->resend_count == COAP_QBLOCK_MAX_MISSING)
+    {
+        memmove(tx->resend, tx->resend + tx->resend_head, tx->resend_count * sizeof(tx->resend[0]));
+        tx->resend_head = 0;
+    }
+    if (tx->resend_count < COAP_QBLOCK_MAX_MISSING)
+        tx->resend[tx->resend_head + tx->resend_count++] = num;
+}
+
+bool coap_qblock_tx_next(coap_qblock_tx_t *tx, uint32_t now, uint32_t *num)
+{
+    bool waited = (uint32_t)(now - tx->last_tx) >= COAP_QBLOCK_NON_TIMEOUT_MS;
+
+    // no word from the receiver after a payload set, go on with the next one
+    if (0 == tx->budget && waited)
+        tx->budget = COAP_QBLOCK_MAX_PAYLOADS;
+    if (tx->budget > 0 && tx->resend_count > 0)
+    {
+        *num = tx->resend[tx->resend_head++];
+        if (0 == --tx->resend_count)
+            tx->resend_head = 0;
+        tx->budget--;
+    }
+    else if (tx->budget > 0 && tx->next < tx->blocks)
+    {
+        *num = tx->next++;
+        tx->budget--;
+    }
+    else if (tx->next == tx->blocks && 0 == tx->resend_count && waited && tx->probes < COAP_QBLOCK_MAX_PROBES)
+    {
+        *num = tx->blocks - 1;
+        tx->probes++;
+    }
+    else
+        return false;
+    tx->last_tx = now;
+    return true;
+}
+
+coap_error_t coap_qblock_tx_add(const coap_qblock_tx_t *tx, coap_packet_t *pkt, coap_option_num_t option, uint32_t num, uint8_t *option_buf)
+{
+    uint32_t size = coap_qblock_size(tx->szx);
+    size_t offset = (size_t)num * size;
+    uint8_t len;
+
+    if (num >= tx->blocks || 0 == (len = coap_make_option_blockwise(option_buf, tx->szx, num + 1 < tx->blocks, num)))
+        return COAP_ERR_OPTION_TOO_BIG;
+    coap_add_option(pkt, option, option_buf, len);
+    pkt->payload.p = tx->body + offset;
+    pkt->payload.len = (tx->len - offset < size) ? tx->len - offset : size;
+    return COAP_ERR_NONE;
+}
+
+void coap_qblock_tx_continue(coap_qblock_tx_t *tx)
+{
+    tx->budget = COAP_QBLOCK_MAX_PAYLOADS;
+    tx->probes = 0;
+}
+
+coap_error_t coap_qblock_tx_missing(coap_qblock_tx_t *tx, const coap_buffer_t *payload)
+{
+    coap_cbor_reader_t reader;
+    coap_cbor_item_t item;
+    coap_error_t err = COAP_ERR_NONE;
+
+    coap_cbor_reader_init(&reader, payload);
+    while (!coap_cbor_at_end(&reader))
+    {
+        if (COAP_ERR_NONE != (err = coap_cbor_read(&reader, &item)) || COAP_CBOR_UINT != item.type)
+        {
+            err = COAP_ERR_CBOR_INVALID;
+            break;
+        }
+        if (item.val <= UINT32_MAX)
+            coap_qblock_tx_queue(tx, (uint32_t)item.val);
+    }
+    coap_qblock_tx_continue(tx);
+    return err;
+}
+
+uint32_t coap_qblock_tx_request(coap_qblock_tx_t *tx, const coap_packet_t *request)
+{
+    uint32_t queued = tx->resend_count;
+    uint8_t i;
+
+    for (i = 0; i < request->numopts; i++)
+        if (COAP_OPTION_Q_BLOCK_2 == request->opts[i].num)
+            coap_qblock_tx_queue(tx, coap_option_blockwise_get_num(&request->opts[i]));
+    coap_qblock_tx_continue(tx);
+    return tx->resend_count - queued;
+}
+
+void coap_qblock_rx_init(coap_qblock_rx_t *rx, uint8_t *body, size_t capacity, uint32_t *bitmap, uint32_t bitmap_words, uint32_t now)
+{
+    rx->body = body;
+    rx->capacity = capacity;
+    rx->bitmap = bitmap;
+    rx->max_blocks = bitmap_words * 32;
+    rx->szx = COAP_BLOCKSIZE_16;
+    rx->received = 0;
+    rx->highest = 0;
+    rx->total = 0;
+    rx->len = 0;
+    rx->last_rx = now;
+    memset(bitmap, 0, bitmap_words * sizeof(bitmap[0]));
+}
+
+bool coap_qblock_rx_complete(const coap_qblock_rx_t *rx)
+{
+    return 0 != rx->total && rx->received == rx->total;
+}
+
+coap_qblock_result_t coap_qblock_rx_put(coap_qblock_rx_t *rx, const coap_option_t *block, const coap_buffer_t *payload, uint32_t now)
+{
+    uint32_t num = coap_option_blockwise_get_num(block);
+    coap_blocksize_t szx = coap_option_blockwise_get_szx(block);
+    bool m = coap_option_blockwise_get_m(block);
+    uint32_t size = coap_qblock_size(szx), bit;
+    size_t offset;
+
+    // the block size is fixed by the first block, a last block must not be followed by others
+    if ((0 != rx->received && szx != rx->szx) || payload->len > size || (m && payload->len != size)
+        || (0 != rx->total && num >= rx->total) || (!m && num + 1 < rx->highest))
+        return COAP_QBLOCK_INVALID;
+    offset = (size_t)num * size;
+    if (num >= rx->max_blocks || offset + payload->len > rx->capacity)
+        return COAP_QBLOCK_TOO_LARGE;
+
+    bit = 1U << (num % 32);
+    if (0 != (rx->bitmap[num / 32] & bit))
+    {
+        if (coap_qblock_rx_complete(rx))
+            return COAP_QBLOCK_COMPLETE;
+        // a repeated last block asks what is missing
+        return m ? COAP_QBLOCK_DUPLICATE : COAP_QBLOCK_MISSING;
+    }
+    rx->bitmap[num / 32] |= bit;
+    rx->szx = szx;
+    memcpy(rx->body + offset, payload->p, payload->len);
+    rx->received++;
+    rx->last_rx = now;
+    if (num >= rx->highest)
+        rx->highest = num + 1;
+    if (!m)
+    {
+        rx->total = num + 1;
+        rx->len = offset + payload->len;
+    }
+
+    if (coap_qblock_rx_complete(rx))
+        return COAP_QBLOCK_COMPLETE;
+    if (m && 0 != (num + 1) % COAP_QBLOCK_MAX_PAYLOADS)
+        return COAP_QBLOCK_STORED;
+    // blocks are missing unless every block up to the highest one arrived
+    return (rx->received == rx->highest && m) ? COAP_QBLOCK_CONTINUE : COAP_QBLOCK_MISSING;
+}
+
+bool coap_qblock_rx_timeout(coap_qblock_rx_t *rx, uint32_t now)
+{
+    if (0 == rx->received || coap_qblock_rx_complete(rx) || (uint32_t)(now - rx->last_rx) < COAP_QBLOCK_NON_RECEIVE_TIMEOUT_MS)
+        return false;
+    rx->last_rx = now;
+    return true;
+}
+
+size_t coap_qblock_rx_missing(const coap_qblock_rx_t *rx, uint32_t *nums, size_t max)
+{
+    uint32_t end = (0 != rx->total) ? rx->total : rx->highest;
+    uint32_t num = 0;
+    size_t count = 0;
+
+    while (num < end && count < max)
+    {
+        uint32_t word = ~rx->bitmap[num / 32] >> (num % 32);
+        // skip complete words
+        if (0 == word)
+        {
+            num = (num | 31) + 1;
+            continue;
+        }
+        if (word & 1)
+            nums[count++] = num;
+        num++;
+    }
+    if (0 == rx->total && count < max && rx->highest < rx->max_blocks)
+        nums[count++] = rx->highest;
+    return count;
+}
+
+static size_t coap_qblock_cbor_uint_size(uint32_t value)
+{
+    return (value < 24) ? 1 : (value < 0x100) ? 2 : (value < 0x10000) ? 3 : 5;
+}
+
+coap_error_t coap_qblock_rx_make_response(const coap_qblock_rx_t *rx, coap_qblock_result_t result, const coap_packet_t *request, coap_packet_t *rsp, uint8_t *buf, size_t buflen)
+{
+    const coap_option_t *block;
+    coap_cbor_writer_t writer;
+    uint32_t nums[COAP_QBLOCK_MAX_MISSING];
+    size_t count, i;
+    uint8_t n;
+
+    switch (result)
+    {
+    case COAP_QBLOCK_CONTINUE:
+        // echoes the Q-Block1 option of the block that ended the payload set
+        if (NULL == (block = coap_findOptions(request, COAP_OPTION_Q_BLOCK_1, &n)) || block->buf.len > buflen)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        memcpy(buf, block->buf.p, block->buf.len);
+        coap_make_response(rsp, NULL, 0, request->hdr.id, &request->tok, COAP_CONTINUE, COAP_CONTENTTYPE_NONE);
+        coap_add_option(rsp, COAP_OPTION_Q_BLOCK_1, buf, block->buf.len);
+        break;
+    case COAP_QBLOCK_MISSING:
+        coap_make_response(rsp, NULL, 0, request->hdr.id, &request->tok, COAP_REQUEST_ENTITY_INCOMPLETE, COAP_CONTENTTYPE_APPLICATION_MISSING_BLOCKS_CBOR_SEQ);
+        coap_cbor_writer_init(&writer, buf, buflen);
+        // the list is cut to what fits, the sender learns about the rest with the next 4.08
+        count = coap_qblock_rx_missing(rx, nums, COAP_QBLOCK_MAX_MISSING);
+        for (i = 0; i < count && writer.used + coap_qblock_cbor_uint_size(nums[i]) <= buflen; i++)
+            coap_cbor_write_uint(&writer, nums[i]);
+        rsp->payload.p = buf;
+        rsp->payload.len = writer.used;
+        break;
+    case COAP_QBLOCK_TOO_LARGE:
+        coap_make_response(rsp, NULL, 0, request->hdr.id, &request->tok, COAP_REQUEST_ENTITY_TOO_LARGE, COAP_CONTENTTYPE_NONE);
+        break;
+    case COAP_QBLOCK_INVALID:
+        coap_make_response(rsp, NULL, 0, request->hdr.id, &request->tok, COAP_BAD_REQUEST, COAP_CONTENTTYPE_NONE);
+        break;
+    default:
+        return COAP_ERR_UNSUPPORTED;
+    }
+    rsp->hdr.t = COAP_TYPE_NONCON;
+    return COAP_ERR_NONE;
+}
+
+uint8_t coap_qblock_rx_add_missing(const coap_qblock_rx_t *rx, coap_packet_t *pkt, uint8_t *option_buf, size_t option_buf_len)
+{
+    uint32_t nums[MAXOPT];
+    size_t count, i, max = MAXOPT - pkt->numopts;
+    uint8_t len;
+
+    if (max > option_buf_len / 3)
+        max = option_buf_len / 3;
+    count = coap_qblock_rx_missing(rx, nums, max);
+    for (i = 0; i < count; i++)
+    {
+        len = coap_make_option_blockwise(option_buf, rx->szx, false, nums[i]);
+        coap_add_option(pkt, COAP_OPTION_Q_BLOCK_2, option_buf, len);
+        option_buf += len;
+    }
+    return (uint8_t)count;
+}
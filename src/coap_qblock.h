@@ -0,0 +1,201 @@
+#ifndef COAP_QBLOCK_H
+#define COAP_QBLOCK_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Q-Block1 and Q-Block2, see http://tools.ietf.org/html/rfc9177
+// A body is sent as NON messages in payload sets of COAP_QBLOCK_MAX_PAYLOADS blocks, without waiting for a response
+// per block. The receiver keeps a bitmap of the blocks it has and asks for the missing ones: the server of a
+// Q-Block1 request body with 4.08 Request Entity Incomplete, whose payload lists the missing block numbers as CBOR
+// sequence, the client of a Q-Block2 response body with a request carrying a Q-Block2 option per missing block.
+// Q-Block options are encoded like Block1 and Block2, see coap_make_option_blockwise().
+// Sender and receiver are transport agnostic state machines, the caller sends and receives the messages. Times are
+// milliseconds from a caller provided monotonic clock, they may wrap around.
+
+// Blocks sent in one go before waiting for the receiver, MAX_PAYLOADS of RFC 9177
+#ifndef COAP_QBLOCK_MAX_PAYLOADS
+#define COAP_QBLOCK_MAX_PAYLOADS 10
+#endif
+
+// Pause of the sender after a payload set without response from the receiver
+#ifndef COAP_QBLOCK_NON_TIMEOUT_MS
+#define COAP_QBLOCK_NON_TIMEOUT_MS 2000
+#endif
+
+// Time the receiver waits for further blocks before it asks for the missing ones
+#ifndef COAP_QBLOCK_NON_RECEIVE_TIMEOUT_MS
+#define COAP_QBLOCK_NON_RECEIVE_TIMEOUT_MS 4000
+#endif
+
+// Times the sender repeats the last block while the receiver stays silent, NON_MAX_RETRANSMIT of RFC 9177
+#ifndef COAP_QBLOCK_MAX_PROBES
+#define COAP_QBLOCK_MAX_PROBES 4
+#endif
+
+// Missing blocks the sender queues for resending, further ones are asked for again by the receiver
+#ifndef COAP_QBLOCK_MAX_MISSING
+#define COAP_QBLOCK_MAX_MISSING 64
+#endif
+
+// Words of the receive bitmap for a body of up to capacity bytes, for the smallest block size
+#define COAP_QBLOCK_BITMAP_WORDS(capacity) ((((capacity) + 15) / 16 + 31) / 32)
+
+/// Sender of a body
+typedef struct
+{
+    const uint8_t *body;
+    size_t len;
+    coap_blocksize_t szx;
+    uint32_t blocks;                    /* Number of blocks of the body */
+    uint32_t next;                      /* First block not sent yet */
+    uint32_t budget;                    /* Blocks left in the current payload set */
+    uint32_t resend[COAP_QBLOCK_MAX_MISSING]; /* Blocks reported missing, in the order to resend them */
+    uint32_t resend_head;
+    uint32_t resend_count;
+    uint32_t last_tx;                   /* Time the last block was sent */
+    uint8_t probes;                     /* Last block repeated since the receiver was heard */
+} coap_qblock_tx_t;
+
+/// Receiver of a body
+typedef struct
+{
+    uint8_t *body;                      /* Caller provided buffer the blocks are copied to */
+    size_t capacity;
+    uint32_t *bitmap;                   /* Received blocks, caller provided */
+    uint32_t max_blocks;                /* Blocks the bitmap can track */
+    coap_blocksize_t szx;               /* Block size, taken from the first block */
+    uint32_t received;                  /* Number of blocks received */
+    uint32_t highest;                   /* One past the highest block received */
+    uint32_t total;                     /* Number of blocks, 0 until the last block was received */
+    size_t len;                         /* Length of the body, valid once total is known */
+    uint32_t last_rx;                   /* Time a new block arrived or the receiver last timed out */
+} coap_qblock_rx_t;
+
+typedef enum
+{
+    COAP_QBLOCK_STORED,                 /* New block stored, more are on the way */
+    COAP_QBLOCK_DUPLICATE,              /* Block had been received before */
+    COAP_QBLOCK_CONTINUE,               /* Block ends a payload set and nothing is missing, answer Q-Block1 with
+                                         * 2.31 Continue */
+    COAP_QBLOCK_MISSING,                /* Block ends a payload set or the body, but blocks are missing */
+    COAP_QBLOCK_COMPLETE,               /* Body complete, also for repeated blocks of a complete body */
+    COAP_QBLOCK_TOO_LARGE,              /* Body exceeds the buffer or the bitmap */
+    COAP_QBLOCK_INVALID                 /* Block size changed, payload length does not match the block size or
+                                         * block beyond the last one */
+} coap_qblock_result_t;
+
+/// @brief Starts sending a body, the first payload set may be sent right away
+/// @param tx Sender to initialize
+/// @param body Body, must stay valid while the sender is used
+/// @param len Length of body
+/// @param szx Block size
+/// @param now Current time
+void coap_qblock_tx_init(coap_qblock_tx_t *tx, const uint8_t *body, size_t len, coap_blocksize_t szx, uint32_t now);
+
+/// @brief Picks the block to send next. Missing blocks go first, then the blocks not sent yet. After a payload set
+/// the sender waits for coap_qblock_tx_continue() or coap_qblock_tx_missing(), or COAP_QBLOCK_NON_TIMEOUT_MS.
+/// Once all blocks are sent, the last one is repeated every COAP_QBLOCK_NON_TIMEOUT_MS while the receiver stays
+/// silent, so it learns the size of the body and reports what is missing.
+/// @param tx Sender
+/// @param now Current time
+/// @param[out] num Block to send
+/// @return False if nothing is to be sent now
+bool coap_qblock_tx_next(coap_qblock_tx_t *tx, uint32_t now, uint32_t *num);
+
+/// @brief Adds the Q-Block option of a block to a message and sets its payload to the block
+/// @param tx Sender
+/// @param pkt Message, for example a NON request or response with all other options set
+/// @param option COAP_OPTION_Q_BLOCK_1 for a request body, COAP_OPTION_Q_BLOCK_2 for a response body
+/// @param num Block number from coap_qblock_tx_next()
+/// @param option_buf Buffer of 3 bytes for the option value, must stay valid until pkt is built
+/// @return COAP_ERR_OPTION_TOO_BIG if num is no block of the body
+coap_error_t coap_qblock_tx_add(const coap_qblock_tx_t *tx, coap_packet_t *pkt, coap_option_num_t option, uint32_t num, uint8_t *option_buf);
+
+/// @brief The receiver asked for the next payload set (2.31 Continue)
+/// @param tx Sender
+void coap_qblock_tx_continue(coap_qblock_tx_t *tx);
+
+/// @brief Queues the blocks listed in the payload of a 4.08 Request Entity Incomplete for resending, which also
+/// starts a new payload set. Numbers of blocks not sent yet are ignored.
+/// @param tx Sender
+/// @param payload CBOR sequence of block numbers
+/// @return COAP_ERR_CBOR_INVALID if the payload is no sequence of unsigned integers, the blocks before the error
+/// are queued
+coap_error_t coap_qblock_tx_missing(coap_qblock_tx_t *tx, const coap_buffer_t *payload);
+
+/// @brief Queues the blocks of the Q-Block2 options of a request for resending, which also starts a new payload set
+/// @param tx Sender of a response body
+/// @param request Request for missing blocks
+/// @return Number of blocks queued
+uint32_t coap_qblock_tx_request(coap_qblock_tx_t *tx, const coap_packet_t *request);
+
+/// @brief Starts receiving a body
+/// @param rx Receiver to initialize
+/// @param body Buffer for the body
+/// @param capacity Size of body
+/// @param bitmap Bitmap of received blocks, COAP_QBLOCK_BITMAP_WORDS(capacity) words for any block size
+/// @param bitmap_words Number of words of bitmap
+/// @param now Current time
+void coap_qblock_rx_init(coap_qblock_rx_t *rx, uint8_t *body, size_t capacity, uint32_t *bitmap, uint32_t bitmap_words, uint32_t now);
+
+/// @brief Stores a received block
+/// @param rx Receiver
+/// @param block Q-Block1 or Q-Block2 option of the message
+/// @param payload Payload of the message
+/// @param now Current time
+/// @return What to do next
+coap_qblock_result_t coap_qblock_rx_put(coap_qblock_rx_t *rx, const coap_option_t *block, const coap_buffer_t *payload, uint32_t now);
+
+/// @brief Checks whether all blocks are received
+/// @param rx Receiver
+/// @return True if the body is complete, its length is rx->len
+bool coap_qblock_rx_complete(const coap_qblock_rx_t *rx);
+
+/// @brief Checks whether the receiver waited COAP_QBLOCK_NON_RECEIVE_TIMEOUT_MS for further blocks, then it is to
+/// ask for the missing ones. Restarts the timeout, so it expires repeatedly while blocks do not arrive.
+/// @param rx Receiver
+/// @param now Current time
+/// @return True if the missing blocks are to be requested
+bool coap_qblock_rx_timeout(coap_qblock_rx_t *rx, uint32_t now);
+
+/// @brief Lists missing blocks in ascending order. While the size of the body is unknown the list ends with the
+/// block after the highest one received, senders ignore it if it does not exist or was not sent yet.
+/// @param rx Receiver
+/// @param[out] nums Missing block numbers
+/// @param max Size of nums
+/// @return Number of blocks listed, at most max
+size_t coap_qblock_rx_missing(const coap_qblock_rx_t *rx, uint32_t *nums, size_t max);
+
+/// @brief Makes the response of a server receiving a Q-Block1 body: 2.31 Continue for COAP_QBLOCK_CONTINUE,
+/// 4.08 Request Entity Incomplete with the missing blocks (as many as fit into buf) for COAP_QBLOCK_MISSING or after
+/// coap_qblock_rx_timeout(), 4.13 for COAP_QBLOCK_TOO_LARGE and 4.00 for COAP_QBLOCK_INVALID. A complete body is
+/// answered by the handler, stored and duplicate blocks are not answered.
+/// @param rx Receiver
+/// @param result Result of coap_qblock_rx_put(), or COAP_QBLOCK_MISSING after a timeout
+/// @param request Last request received, its token and message ID are used
+/// @param[out] rsp Response, NON
+/// @param buf Buffer for option value and payload, must stay valid until rsp is built
+/// @param buflen Size of buf, at least 4
+/// @return COAP_ERR_UNSUPPORTED if result needs no response from the receiver
+coap_error_t coap_qblock_rx_make_response(const coap_qblock_rx_t *rx, coap_qblock_result_t result, const coap_packet_t *request, coap_packet_t *rsp, uint8_t *buf, size_t buflen);
+
+/// @brief Adds a Q-Block2 option per missing block to a request of a client receiving a Q-Block2 body
+/// @param rx Receiver
+/// @param pkt Request, with all other options set
+/// @param option_buf Buffer for the option values, 3 bytes per option, must stay valid until pkt is built
+/// @param option_buf_len Size of option_buf
+/// @return Number of options added, limited by option_buf and MAXOPT
+uint8_t coap_qblock_rx_add_missing(const coap_qblock_rx_t *rx, coap_packet_t *pkt, uint8_t *option_buf, size_t option_buf_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef COAP_ROUTES_HPP
+#define COAP_ROUTES_HPP 1
+
+// Compile-time route table for a fixed set of endpoints. Each route is a path literal, a method and a handler with
+// the signature of coap_endpoint_func. The router keys every route by a hash over method and path segments and builds
+// an open addressing hash table at compile time, which ends up in read-only data. Dispatch hashes the Uri-Path options
+// of a request once, probes the table and confirms the match with a byte comparison, so there are neither string
+// comparisons against non-matching routes nor runtime table construction.
+//
+//     using api = coap::router<
+//         coap::route<"sensors/temp", COAP_GET, handle_get_temp>,
+//         coap::route<"fw", COAP_PUT, handle_put_fw>>;
+//     api::dispatch(arena, inpkt, outpkt);
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "coap.h"
+
+namespace coap
+{
+
+/// String literal usable as template argument
+template <size_t N>
+struct fixed_string
+{
+    char data[N] = {};
+    size_t len = 0;
+
+    constexpr fixed_string() = default;
+    constexpr fixed_string(const char (&str)[N])
+    {
+        for (size_t i = 0; i + 1 < N; i++)
+            data[i] = str[i];
+        len = N - 1;
+    }
+
+    constexpr std::string_view view() const { return {data, len}; }
+};
+
+namespace detail
+{
+
+// FNV-1a 64 over method and segments. Segments are separated by 0xFF, which cannot occur in UTF-8.
+constexpr uint64_t route_hash_init(uint8_t method)
+{
+    return (14695981039346656037ULL ^ method) * 1099511628211ULL;
+}
+
+constexpr uint64_t route_hash_step(uint64_t hash, uint8_t c)
+{
+    return (hash ^ c) * 1099511628211ULL;
+}
+
+constexpr std::string_view strip_slash(std::string_view path)
+{
+    return (!path.empty() && path.front() == '/') ? path.substr(1) : path;
+}
+
+constexpr uint64_t route_key(uint8_t method, std::string_view path)
+{
+    uint64_t hash = route_hash_init(method);
+    for (char c : path)
+        hash = route_hash_step(hash, (c == '/') ? 0xFF : static_cast<uint8_t>(c));
+    return hash;
+}
+
+constexpr size_t route_slot(uint64_t key, size_t mask)
+{
+    return static_cast<size_t>(key ^ (key >> 32)) & mask;
+}
+
+struct route_entry
+{
+    uint64_t key;
+    uint8_t method;
+    std::string_view path;      // segments joined by '/', no leading '/', empty for the root
+    coap_endpoint_func handler;
+};
+
+} // namespace detail
+
+/// Route of a router: path literal (leading '/' optional, "" for the root), method and handler
+template <fixed_string Path, coap_code_t Method, coap_endpoint_func Handler>
+struct route
+{
+    static constexpr std::string_view path = detail::strip_slash(Path.view());
+    static constexpr detail::route_entry entry{detail::route_key(Method, path), static_cast<uint8_t>(Method), path, Handler};
+};
+
+template <typename... Routes>
+class router
+{
+public:
+    static constexpr size_t size = sizeof...(Routes);
+
+    /// Routes sorted by key, so duplicates are adjacent
+    static constexpr std::array<detail::route_entry, size> table = []
+    {
+        std::array<detail::route_entry, size> t{Routes::entry...};
+        std::sort(t.begin(), t.end(), [](const detail::route_entry &a, const detail::route_entry &b) { return a.key < b.key; });
+        return t;
+    }();
+
+    static constexpr uint16_t no_route = 0xFFFF;
+    static constexpr size_t slot_mask = std::bit_ceil(2 * size + 1) - 1;
+    static_assert(size < no_route, "too many routes");
+
+    /// Open addressing index into table with at least twice as many slots as routes, built at compile time
+    static constexpr auto slots = []
+    {
+        std::array<uint16_t, slot_mask + 1> s{};
+        s.fill(no_route);
+        for (size_t i = 0; i < size; i++)
+        {
+            size_t slot = detail::route_slot(table[i].key, slot_mask);
+            while (no_route != s[slot])
+                slot = (slot + 1) & slot_mask;
+            s[slot] = static_cast<uint16_t>(i);
+        }
+        return s;
+    }();
+
+    static_assert([]
+    {
+        for (size_t i = 0; i + 1 < size; i++)
+        {
+            for (size_t j = i + 1; j < size && table[j].key == table[i].key; j++)
+            {
+                if (table[i].method == table[j].method && table[i].path == table[j].path)
+                    return false;
+            }
+        }
+        return true;
+    }(), "route declared twice");
+
+    /// @brief Finds the handler for a request
+    /// @return Handler, NULL if no route matches method and Uri-Path
+    static coap_endpoint_func find(const coap_packet_t *inpkt)
+    {
+        uint8_t count;
+        const coap_option_t *segs = coap_findOptions(inpkt, COAP_OPTION_URI_PATH, &count);
+        uint64_t key = detail::route_hash_init(inpkt->hdr.code);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (i > 0)
+                key = detail::route_hash_step(key, 0xFF);
+            for (size_t j = 0; j < segs[i].buf.len; j++)
+                key = detail::route_hash_step(key, segs[i].buf.p[j]);
+        }
+
+        for (size_t slot = detail::route_slot(key, slot_mask);; slot = (slot + 1) & slot_mask)
+        {
+            uint16_t i = slots[slot];
+            if (no_route == i)
+                break;
+            if (table[i].key == key && table[i].method == inpkt->hdr.code && matches(table[i].path, segs, count))
+                return table[i].handler;
+        }
+        return nullptr;
+    }
+
+    /// @brief Calls the handler of the matching route, or answers 4.04 like coap_handle_req()
+    /// @return Result of the handler, nonzero results must be answered by the caller as coap_server_handle() does
+    static int dispatch(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt)
+    {
+        coap_endpoint_func handler = find(inpkt);
+        if (nullptr != handler)
+            return handler(arena, inpkt, outpkt, static_cast<uint8_t>(inpkt->hdr.id >> 8), static_cast<uint8_t>(inpkt->hdr.id));
+        coap_make_response(outpkt, nullptr, 0, inpkt->hdr.id, &inpkt->tok, COAP_NOT_FOUND, COAP_CONTENTTYPE_NONE);
+        return 0;
+    }
+
+private:
+    static bool matches(std::string_view path, const coap_option_t *segs, uint8_t count)
+    {
+        size_t pos = 0;
+        if (0 == count)
+            return path.empty();
+        for (uint8_t i = 0; i < count; i++)
+        {
+            std::string_view seg(reinterpret_cast<const char *>(segs[i].buf.p), segs[i].buf.len);
+            if (i > 0)
+            {
+                if (pos >= path.size() || path[pos] != '/')
+                    return false;
+                pos++;
+            }
+            if (path.substr(pos, seg.size()) != seg)
+                return false;
+            pos += seg.size();
+        }
+        return pos == path.size();
+    }
+};
+
+} // namespace coap
+
+#endif
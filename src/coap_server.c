@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_server.h"
+#include "coap_deferred.h"
+
+// Request handled by the calling thread, lets handlers defer without a context argument
+typedef struct
+{
+    coap_server_t *server;
+    const coap_addr_t *peer;
+    const coap_packet_t *inpkt;
+    coap_deferred_t *deferred;
+} coap_server_request_t;
+
+static _Thread_local coap_server_request_t *coap_server_current;
+
+void coap_server_init(coap_server_t *server, const coap_endpoint_t *endpoints, uint8_t *arena_buf, size_t arena_len)
+{
+    server->endpoints = endpoints;
+    coap_arena_init(&server->arena, arena_buf, arena_len);
+    server->wellknown = NULL;
+    server->next_id = 0;
+    server->deferred = NULL;
+    server->admit = NULL;
+    server->etags = NULL;
+}
+
+static coap_error_t coap_server_process(coap_server_t *server, const coap_addr_t *peer, uint32_t now, const uint8_t *inbuf, size_t inlen, uint8_t *outbuf, size_t *outlen)
+{
+    coap_packet_t *inpkt, *outpkt;
+    coap_server_request_t request;
+    int rc;
+
+    if (NULL == (inpkt = coap_packet_alloc(&server->arena)))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    if (0 != (rc = coap_parse(inpkt, inbuf, inlen)))
+        return (coap_error_t)rc;
+
+    if (inpkt->hdr.code == COAP_EMPTY)
+    {
+        if ((inpkt->hdr.t == COAP_TYPE_ACK || inpkt->hdr.t == COAP_TYPE_RESET) && NULL != server->deferred && NULL != peer)
+            coap_deferred_ack(server->deferred, peer, inpkt->hdr.id, now);
+        if (inpkt->hdr.t != COAP_TYPE_CON || *outlen < 4)
+        {
+            *outlen = 0;
+            return COAP_ERR_NONE;
+        }
+        // ping, http://tools.ietf.org/html/rfc7252#section-4.3
+        outbuf[0] = 0x40 | (COAP_TYPE_RESET << 4);
+        outbuf[1] = COAP_EMPTY;
+        outbuf[2] = inbuf[2];
+        outbuf[3] = inbuf[3];
+        *outlen = 4;
+        return COAP_ERR_NONE;
+    }
+    if (inpkt->hdr.code > COAP_LASTMETHOD || (inpkt->hdr.t != COAP_TYPE_CON && inpkt->hdr.t != COAP_TYPE_NONCON))
+    {
+        *outlen = 0;
+        return COAP_ERR_NONE;
+    }
+
+    if (NULL == (outpkt = coap_packet_alloc(&server->arena)))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    if (NULL != server->wellknown && coap_wellknown_is_request(inpkt))
+    {
+        coap_error_t err = coap_wellknown_respond(server->wellknown, &server->arena, inpkt, outpkt);
+        if (COAP_ERR_NONE != err)
+            return err;
+    }
+    else
+    {
+        coap_etag_resource_t *resource = NULL;
+        coap_code_t code = COAP_EMPTY;
+
+        // preconditions and cached representations are settled without the handler
+        if (NULL != server->etags)
+            code = coap_etag_evaluate(server->etags, inpkt, &resource);
+        if (COAP_EMPTY != code)
+            coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, code, COAP_CONTENTTYPE_NONE);
+        else
+        {
+            request.server = server;
+            request.peer = peer;
+            request.inpkt = inpkt;
+            request.deferred = NULL;
+            coap_server_current = &request;
+            rc = coap_handle_req(&server->arena, server->endpoints, inpkt, outpkt);
+            coap_server_current = NULL;
+            if (NULL != request.deferred && 0 != rc)
+            {
+                coap_deferred_cancel(server->deferred, request.deferred);
+                request.deferred = NULL;
+            }
+            if (NULL != request.deferred)
+            {
+                if (*outlen < 4)
+                    return COAP_ERR_BUFFER_TOO_SMALL;
+                *outlen = coap_deferred_make_ack(inpkt, outbuf);
+                return COAP_ERR_NONE;
+            }
+            // a failed handler may have left outpkt half built or untouched
+            if (0 != rc)
+            {
+                memset(outpkt, 0, sizeof(coap_packet_t));
+                coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, COAP_INTERNAL_SERVER_ERROR, COAP_CONTENTTYPE_NONE);
+            }
+        }
+        if (NULL != resource && 0 != resource->etag && (COAP_VALID == outpkt->hdr.code || COAP_CONTENT == outpkt->hdr.code))
+        {
+            uint8_t etag[COAP_ETAG_SIZE], count;
+            coap_error_t err;
+            coap_etag_encode(resource->etag, etag);
+            if (NULL == coap_findOptions(outpkt, COAP_OPTION_ETAG, &count)
+                && COAP_ERR_NONE != (err = coap_add_option_copy(outpkt, &server->arena, COAP_OPTION_ETAG, etag, sizeof(etag))))
+                return err;
+        }
+    }
+    if (inpkt->hdr.t == COAP_TYPE_NONCON)
+    {
+        outpkt->hdr.t = COAP_TYPE_NONCON;
+        outpkt->hdr.id = server->next_id++;
+    }
+    return coap_build(outbuf, outlen, outpkt);
+}
+
+coap_error_t coap_server_handle(coap_server_t *server, const uint8_t *inbuf, size_t inlen, uint8_t *outbuf, size_t *outlen)
+{
+    return coap_server_handle_from(server, NULL, 0, inbuf, inlen, outbuf, outlen);
+}
+
+coap_error_t coap_server_handle_from(coap_server_t *server, const coap_addr_t *peer, uint32_t now, const uint8_t *inbuf, size_t inlen, uint8_t *outbuf, size_t *outlen)
+{
+    coap_arena_mark_t mark;
+    coap_error_t err;
+    size_t outsize = *outlen;
+
+    // admission only looks at the header, rejected requests never reach the parser
+    if (NULL != server->admit && NULL != peer)
+    {
+        uint8_t reply[COAP_ADMIT_REPLY_SIZE];
+        bool small = outsize < COAP_ADMIT_REPLY_SIZE;
+        if (COAP_ADMIT_ACCEPT != coap_admit(server->admit, peer, inbuf, inlen, now, small ? reply : outbuf, outlen))
+        {
+            // a 5.03 that does not fit into outbuf is not sent, the request is dropped
+            if (small)
+                *outlen = 0;
+            return COAP_ERR_NONE;
+        }
+    }
+    *outlen = outsize;
+    mark = coap_arena_mark(&server->arena);
+    err = coap_server_process(server, peer, now, inbuf, inlen, outbuf, outlen);
+    if (COAP_ERR_NONE != err)
+        *outlen = 0;
+    coap_arena_release(&server->arena, mark);
+    return err;
+}
+
+coap_deferred_t *coap_server_defer(const coap_packet_t *inpkt)
+{
+    coap_server_request_t *request = coap_server_current;
+    if (NULL == request || request->inpkt != inpkt || NULL == request->peer || NULL == request->server->deferred)
+        return NULL;
+    if (NULL == request->deferred)
+        request->deferred = coap_deferred_start(request->server->deferred, request->peer, inpkt);
+    return request->deferred;
+}
+
+void coap_server_poll(coap_server_t *server, uint32_t now, uint32_t random, coap_addr_t *peer, uint8_t *outbuf, size_t *outlen)
+{
+    coap_deferred_poll(server->deferred, &server->next_id, now, random, peer, outbuf, outlen);
+}
@@ -0,0 +1,97 @@
+#ifndef COAP_SERVER_H
+#define COAP_SERVER_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "coap.h"
+#include "coap_wellknown.h"
+#include "coap_cc.h"
+#include "coap_admit.h"
+#include "coap_etag.h"
+
+// See coap_deferred.h, which needs C11 atomics
+typedef struct coap_deferred coap_deferred_t;
+typedef struct coap_deferred_table coap_deferred_table_t;
+
+/// Request pipeline: parses a request datagram, dispatches it to the endpoint table and builds the response. All
+/// per request memory (parsed request, response packet and everything the handler allocates) comes from the
+/// pipeline's arena, which is reset after every response.
+typedef struct
+{
+    const coap_endpoint_t *endpoints;   /* Endpoint table, terminated by an entry with handler set to NULL */
+    coap_arena_t arena;                 /* Per request arena */
+    const coap_wellknown_t *wellknown;  /* Served on GET /.well-known/core if set. NULL after coap_server_init(). */
+    uint16_t next_id;                   /* Message ID of the next NON response. Initialized to 0, should be seeded
+                                         * with a random value, see http://tools.ietf.org/html/rfc7252#section-4.4 */
+    coap_deferred_table_t *deferred;    /* Separate responses, enables coap_server_defer(). The server must be the
+                                         * owner of the table. NULL after coap_server_init(). */
+    coap_admit_t *admit;                /* Admission control of coap_server_handle_from(), applied before the
+                                         * request is parsed. NULL after coap_server_init(). */
+    coap_etag_store_t *etags;           /* Conditional requests: 2.03 and 4.12 are answered before the handler runs,
+                                         * 2.05 responses get the ETag of the resource. NULL after coap_server_init(). */
+} coap_server_t;
+
+/// @brief Initializes a request pipeline
+/// @param server Pipeline to initialize
+/// @param endpoints Endpoint table, terminated by an entry with handler set to NULL
+/// @param arena_buf Memory of the per request arena. Must hold at least two coap_packet_t plus whatever the
+/// handlers allocate. Further memory can be chained with coap_arena_add_block() on server->arena.
+/// @param arena_len Size of arena_buf in bytes
+void coap_server_init(coap_server_t *server, const coap_endpoint_t *endpoints, uint8_t *arena_buf, size_t arena_len);
+
+/// @brief Handles one request datagram
+/// Confirmable requests are answered with a piggybacked ACK, non-confirmable requests with a NON response. An empty
+/// confirmable message (CoAP ping) is answered with a reset. Responses and other empty messages produce no output.
+/// A request whose handler returns nonzero is answered with 5.00, whatever the handler put into its response.
+/// @param server Pipeline
+/// @param inbuf Received datagram
+/// @param inlen Length of inbuf
+/// @param[out] outbuf Buffer to build the response into
+/// @param[in,out] outlen Size of outbuf, set to the length of the response. 0 if nothing is to be sent.
+/// @return COAP_ERR_NONE on success, the parse error if the datagram is malformed, or the build error of the
+/// response (COAP_ERR_BUFFER_TOO_SMALL also if the arena is exhausted)
+coap_error_t coap_server_handle(coap_server_t *server, const uint8_t *inbuf, size_t inlen, uint8_t *outbuf, size_t *outlen);
+
+/// @brief Handles one datagram of a known peer, like coap_server_handle(). Additionally handlers may defer their
+/// response with coap_server_defer(), and empty ACKs and RSTs end the exchanges of separate responses. With
+/// admission control, excess requests are answered with 5.03 or dropped (outlen 0) before they are parsed. With an
+/// outbuf smaller than COAP_ADMIT_REPLY_SIZE, excess requests are dropped instead of answered.
+/// @param server Pipeline
+/// @param peer Address of the sender
+/// @param now Current time in ms
+/// @param inbuf Received datagram
+/// @param inlen Length of inbuf
+/// @param[out] outbuf Buffer to build the response into
+/// @param[in,out] outlen Size of outbuf, set to the length of the response. 0 if nothing is to be sent.
+/// @return See coap_server_handle()
+coap_error_t coap_server_handle_from(coap_server_t *server, const coap_addr_t *peer, uint32_t now, const uint8_t *inbuf, size_t inlen, uint8_t *outbuf, size_t *outlen);
+
+/// @brief Defers the response to the request being handled, see coap_deferred_start(). Must be called by an
+/// endpoint handler running in coap_server_handle_from() on the same thread. The server answers a Confirmable
+/// request with an empty ACK and ignores outpkt, the response is sent later by coap_server_poll() once it was
+/// passed to coap_deferred_complete(). A handler that returns nonzero after deferring must not have handed the
+/// handle on: the server cancels it and answers 5.00.
+/// @param inpkt Request passed to the handler
+/// @return Continuation handle, NULL if the server has no deferred table, the table is full or the call is outside
+/// of a handler. The handler has to respond immediately then.
+coap_deferred_t *coap_server_defer(const coap_packet_t *inpkt);
+
+/// @brief Returns the next separate response or retransmission to send, see coap_deferred_poll(). Responses use the
+/// message IDs of the server.
+/// @param server Pipeline with a deferred table
+/// @param now Current time in ms
+/// @param random Random value, for example from rand()
+/// @param[out] peer Destination
+/// @param[out] outbuf Buffer of at least COAP_DEFERRED_RESPONSE_SIZE bytes
+/// @param[out] outlen Length of the datagram, 0 if nothing is to be sent
+void coap_server_poll(coap_server_t *server, uint32_t now, uint32_t random, coap_addr_t *peer, uint8_t *outbuf, size_t *outlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
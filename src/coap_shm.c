@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include "coap_shm.h"
+
+/// Header of a record in the ring
+typedef struct
+{
+    _Atomic uint32_t span;              /* Bytes of the record, 0 while not committed */
+    uint32_t len;                       /* Length of the message, 0 for padding or a cancelled message */
+} coap_shm_record_t;
+
+#define COAP_SHM_ALIGN(len) (((len) + 7) & ~(size_t)7)
+
+static coap_shm_record_t *coap_shm_record(const coap_shm_t *shm, uint64_t pos)
+{
+    return (coap_shm_record_t *)(shm->ring->data + (pos & (shm->size - 1)));
+}
+
+static size_t coap_shm_max_message(const coap_shm_t *shm)
+{
+    return shm->size / 2 - sizeof(coap_shm_record_t);
+}
+
+static coap_shm_result_t coap_shm_map(coap_shm_t *shm, int memfd, int eventfd, size_t map_len)
+{
+    void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+    if (MAP_FAILED == map)
+        return COAP_SHM_IO;
+    shm->ring = map;
+    shm->map_len = map_len;
+    shm->memfd = memfd;
+    shm->eventfd = eventfd;
+    shm->read = 0;
+    return COAP_SHM_OK;
+}
+
+coap_shm_result_t coap_shm_create(coap_shm_t *shm, uint32_t size, coap_shm_mode_t mode)
+{
+    size_t map_len = sizeof(coap_shm_ring_t) + size;
+    int memfd, efd;
+
+    if (size < 256 || 0 != (size & (size - 1)))
+        return COAP_SHM_INVALID;
+    if ((memfd = memfd_create("coap_shm", MFD_CLOEXEC)) < 0)
+        return COAP_SHM_IO;
+    // pages of a new memory fd are zero, as the ring needs its free space
+    if (0 != ftruncate(memfd, (off_t)map_len) || (efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+    {
+        close(memfd);
+        return COAP_SHM_IO;
+    }
+    if (COAP_SHM_OK != coap_shm_map(shm, memfd, efd, map_len))
+    {
+        close(memfd);
+        close(efd);
+        return COAP_SHM_IO;
+    }
+    shm->ring->size = shm->size = size;
+    shm->ring->mode = shm->mode = mode;
+    atomic_init(&shm->ring->head, 0);
+    atomic_init(&shm->ring->tail, 0);
+    atomic_init(&shm->ring->sleeping, 0);
+    // other processes get the fds through fork() or a unix socket, which orders these stores before their loads
+    shm->ring->magic = COAP_SHM_MAGIC;
+    return COAP_SHM_OK;
+}
+
+coap_shm_result_t coap_shm_attach(coap_shm_t *shm, int memfd, int eventfd)
+{
+    struct stat st;
+    coap_shm_result_t res;
+    uint32_t size, mode;
+
+    if (0 != fstat(memfd, &st))
+        return COAP_SHM_IO;
+    if ((size_t)st.st_size < sizeof(coap_shm_ring_t) + 256)
+        return COAP_SHM_INVALID;
+    if (COAP_SHM_OK != (res = coap_shm_map(shm, memfd, eventfd, (size_t)st.st_size)))
+        return res;
+    size = shm->ring->size;
+    mode = shm->ring->mode;
+    if (COAP_SHM_MAGIC != shm->ring->magic || 0 != (size & (size - 1)) || sizeof(coap_shm_ring_t) + size != shm->map_len
+        || (COAP_SHM_SPSC != mode && COAP_SHM_MPSC != mode))
+    {
+        munmap(shm->ring, shm->map_len);
+        shm->ring = NULL;
+        return COAP_SHM_INVALID;
+    }
+    shm->size = size;
+    shm->mode = mode;
+    shm->read = atomic_load_explicit(&shm->ring->tail, memory_order_acquire);
+    return COAP_SHM_OK;
+}
+
+void coap_shm_close(coap_shm_t *shm)
+{
+    if (NULL != shm->ring)
+        munmap(shm->ring, shm->map_len);
+    close(shm->memfd);
+    close(shm->eventfd);
+    shm->ring = NULL;
+}
+
+coap_shm_result_t coap_shm_reserve(coap_shm_t *shm, size_t len, coap_shm_slot_t *slot)
+{
+    coap_shm_ring_t *ring = shm->ring;
+    uint32_t need = (uint32_t)COAP_SHM_ALIGN(sizeof(coap_shm_record_t) + len);
+    uint64_t pos, tail;
+    uint32_t offset, pad;
+
+    if (len > coap_shm_max_message(shm))
+        return COAP_SHM_TOO_LARGE;
+    pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    do
+    {
+        // a record does not wrap, the rest of data is padded instead
+        offset = (uint32_t)(pos & (shm->size - 1));
+        pad = (offset + need > shm->size) ? shm->size - offset : 0;
+        tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (pos + pad + need - tail > shm->size)
+            return COAP_SHM_FULL;
+        if (COAP_SHM_SPSC == shm->mode)
+        {
+            atomic_store_explicit(&ring->head, pos + pad, memory_order_relaxed);
+            break;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + pad + need, memory_order_relaxed, memory_order_relaxed));
+
+    if (0 != pad)
+    {
+        coap_shm_record_t *padding = coap_shm_record(shm, pos);
+        padding->len = 0;
+        atomic_store_explicit(&padding->span, pad, memory_order_release);
+    }
+    slot->pos = pos + pad;
+    slot->span = need;
+    slot->p = (uint8_t *)(coap_shm_record(shm, slot->pos) + 1);
+    slot->len = len;
+    return COAP_SHM_OK;
+}
+
+void coap_shm_commit(coap_shm_t *shm, const coap_shm_slot_t *slot, size_t len)
+{
+    coap_shm_ring_t *ring = shm->ring;
+    coap_shm_record_t *record = coap_shm_record(shm, slot->pos);
+    uint32_t span = slot->span;
+    uint64_t one = 1;
+
+    if (COAP_SHM_SPSC == shm->mode)
+    {
+        // the space behind the message is free again, a cancelled message may have left bytes that must be zeroed
+        if (0 == len)
+        {
+            memset(slot->p, 0, slot->len);
+            return;
+        }
+        span = (uint32_t)COAP_SHM_ALIGN(sizeof(coap_shm_record_t) + len);
+        atomic_store_explicit(&ring->head, slot->pos + span, memory_order_relaxed);
+    }
+    record->len = (uint32_t)len;
+    atomic_store_explicit(&record->span, span, memory_order_release);
+
+    // pairs with the fence in coap_shm_wait(): either the consumer sees the record or the producer sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (0 != atomic_load_explicit(&ring->sleeping, memory_order_relaxed) && 0 != atomic_exchange(&ring->sleeping, 0))
+    {
+        // a failed write means the counter is saturated, the consumer wakes anyway
+        ssize_t written = write(shm->eventfd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+coap_shm_result_t coap_shm_send(coap_shm_t *shm, const uint8_t *msg, size_t len)
+{
+    coap_shm_slot_t slot;
+    coap_shm_result_t res;
+
+    if (COAP_SHM_OK != (res = coap_shm_reserve(shm, len, &slot)))
+        return res;
+    memcpy(slot.p, msg, len);
+    coap_shm_commit(shm, &slot, len);
+    return COAP_SHM_OK;
+}
+
+coap_shm_result_t coap_shm_send_packet(coap_shm_t *shm, const coap_packet_t *pkt)
+{
+    uint8_t buf[COAP_SHM_MESSAGE_SIZE];
+    size_t max = coap_shm_max_message(shm), len;
+    coap_shm_slot_t slot;
+    coap_error_t err;
+
+    if (max > COAP_SHM_MESSAGE_SIZE)
+        max = COAP_SHM_MESSAGE_SIZE;
+    if (COAP_SHM_SPSC == shm->mode && COAP_SHM_OK == coap_shm_reserve(shm, max, &slot))
+    {
+        len = slot.len;
+        err = coap_build(slot.p, &len, pkt);
+        coap_shm_commit(shm, &slot, (COAP_ERR_NONE == err) ? len : 0);
+    }
+    else
+    {
+        // without space for the largest message, or with other producers, the exact length is reserved
+        len = max;
+        if (COAP_ERR_NONE == (err = coap_build(buf, &len, pkt)))
+            return coap_shm_send(shm, buf, len);
+    }
+    if (COAP_ERR_BUFFER_TOO_SMALL == err)
+        return COAP_SHM_TOO_LARGE;
+    return (COAP_ERR_NONE == err) ? COAP_SHM_OK : COAP_SHM_INVALID;
+}
+
+// Checks a record header before the consumer follows it, the segment is shared and not trusted
+static bool coap_shm_record_valid(const coap_shm_t *shm, uint64_t pos, uint32_t span, uint32_t len)
+{
+    uint32_t offset = (uint32_t)(pos & (shm->size - 1));
+    return 0 == (span & 7) && span >= sizeof(coap_shm_record_t) && span <= shm->size - offset
+        && len <= span - sizeof(coap_shm_record_t);
+}
+
+size_t coap_shm_peek(coap_shm_t *shm, coap_buffer_t *msgs, size_t max)
+{
+    uint64_t pos = shm->read;
+    uint64_t end = atomic_load_explicit(&shm->ring->tail, memory_order_relaxed) + shm->size;
+    size_t count = 0;
+
+    // a full ring wraps onto records not released yet
+    while (count < max && pos < end)
+    {
+        coap_shm_record_t *record = coap_shm_record(shm, pos);
+        uint32_t span = atomic_load_explicit(&record->span, memory_order_acquire);
+        uint32_t len;
+        // the length is only written before the span is published
+        if (0 == span || !coap_shm_record_valid(shm, pos, span, len = record->len))
+            break;
+        if (0 != len)
+        {
+            msgs[count].p = (const uint8_t *)(record + 1);
+            msgs[count].len = len;
+            count++;
+        }
+        pos += span;
+    }
+    shm->read = pos;
+    return count;
+}
+
+void coap_shm_release(coap_shm_t *shm)
+{
+    coap_shm_ring_t *ring = shm->ring;
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t offset = (uint32_t)(tail & (shm->size - 1));
+    size_t len = (size_t)(shm->read - tail);
+
+    // records never wrap, but a batch may
+    if (offset + len > shm->size)
+    {
+        memset(ring->data + offset, 0, shm->size - offset);
+        memset(ring->data, 0, len - (shm->size - offset));
+    }
+    else
+        memset(ring->data + offset, 0, len);
+    atomic_store_explicit(&ring->tail, shm->read, memory_order_release);
+}
+
+static bool coap_shm_ready(const coap_shm_t *shm)
+{
+    uint64_t pos = shm->read;
+    uint64_t end = atomic_load_explicit(&shm->ring->tail, memory_order_relaxed) + shm->size;
+
+    // skips padding at the end of data and cancelled messages
+    while (pos < end)
+    {
+        const coap_shm_record_t *record = coap_shm_record(shm, pos);
+        uint32_t span = atomic_load_explicit(&record->span, memory_order_acquire);
+        uint32_t len;
+        // the length is only written before the span is published
+        if (0 == span || !coap_shm_record_valid(shm, pos, span, len = record->len))
+            return false;
+        if (0 != len)
+            return true;
+        pos += span;
+    }
+    return false;
+}
+
+static int64_t coap_shm_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+bool coap_shm_wait(coap_shm_t *shm, int timeout_ms)
+{
+    struct pollfd pfd = {shm->eventfd, POLLIN, 0};
+    int64_t deadline = (timeout_ms > 0) ? coap_shm_now_ms() + timeout_ms : 0;
+    uint64_t count;
+
+    if (coap_shm_ready(shm))
+        return true;
+    for (;;)
+    {
+        atomic_store(&shm->ring->sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!coap_shm_ready(shm) && poll(&pfd, 1, timeout_ms) > 0)
+        {
+            // resets the counter, wakeups meant for earlier waits are dropped with it
+            ssize_t got = read(shm->eventfd, &count, sizeof(count));
+            (void)got;
+        }
+        atomic_store(&shm->ring->sleeping, 0);
+        if (coap_shm_ready(shm))
+            return true;
+        // a wakeup left over from an earlier wait, whose message was already taken
+        if (timeout_ms > 0 && (timeout_ms = (int)(deadline - coap_shm_now_ms())) <= 0)
+            return false;
+        if (0 == timeout_ms)
+            return false;
+    }
+}
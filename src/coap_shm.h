@@ -0,0 +1,168 @@
+#ifndef COAP_SHM_H
+#define COAP_SHM_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "coap.h"
+
+// Shared memory transport between processes on one host (Linux only). A segment created with memfd_create() holds
+// a ring of length prefixed messages, written by one producer (SPSC) or several producer threads or processes
+// (MPSC) and read by one consumer. The consumer sleeps on an eventfd while the ring is empty, producers only write
+// to it when the consumer announced that it sleeps, so a busy consumer costs the producers no system call.
+//
+// Producers build messages directly into the ring with coap_shm_reserve() and coap_shm_commit(). The consumer
+// takes a batch of messages with coap_shm_peek(), parses them in place and hands the batch back with
+// coap_shm_release():
+//
+//     coap_buffer_t msgs[32];
+//     size_t i, n = coap_shm_peek(&shm, msgs, 32);
+//     for (i = 0; i < n; i++)
+//         if (0 == coap_parse(&pkt, msgs[i].p, msgs[i].len))
+//             ...                     // pkt points into the ring until coap_shm_release()
+//     coap_shm_release(&shm);
+//
+// Memory fd and eventfd reach the other process by fork() or as SCM_RIGHTS over a unix socket, it maps the segment
+// with coap_shm_attach(). The segment holds no pointers, so it may be mapped at different addresses.
+// The consumer zeroes released messages, producers rely on free space being zero.
+
+// Bytes a message may have at most when built by coap_shm_send_packet()
+#ifndef COAP_SHM_MESSAGE_SIZE
+#define COAP_SHM_MESSAGE_SIZE 1280
+#endif
+
+#define COAP_SHM_MAGIC 0x434F4150       /* "COAP" */
+#define COAP_SHM_CACHE_LINE 64
+
+typedef enum
+{
+    COAP_SHM_SPSC = 1,                  /* One producer */
+    COAP_SHM_MPSC = 2                   /* Producers on several threads or processes */
+} coap_shm_mode_t;
+
+typedef enum
+{
+    COAP_SHM_OK = 0,
+    COAP_SHM_FULL,                      /* Not enough free space, the consumer is behind */
+    COAP_SHM_TOO_LARGE,                 /* Message longer than half the ring minus the length prefix */
+    COAP_SHM_IO,                        /* Creating or mapping the segment failed, see errno */
+    COAP_SHM_INVALID                    /* Memory fd holds no ring, or the message could not be built */
+} coap_shm_result_t;
+
+/// Layout of a segment. Positions count bytes since creation and never wrap, offsets into data are positions
+/// modulo size. Producer and consumer positions are on separate cache lines.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t size;                      /* Bytes of data, a power of two */
+    uint32_t mode;                      /* coap_shm_mode_t */
+    uint8_t pad0[COAP_SHM_CACHE_LINE - 3 * sizeof(uint32_t)];
+    _Atomic uint64_t head;              /* Producers: end of the reserved space */
+    uint8_t pad1[COAP_SHM_CACHE_LINE - sizeof(uint64_t)];
+    _Atomic uint64_t tail;              /* Consumer: start of the space still in use */
+    _Atomic uint32_t sleeping;          /* The consumer waits on the eventfd */
+    uint8_t pad2[COAP_SHM_CACHE_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+    uint8_t data[];                     /* Records: 8 byte header (span and message length) and message, 8 byte
+                                         * aligned. A record of length 0 pads up to the end of data. */
+} coap_shm_ring_t;
+
+/// Handle of a process on a segment
+typedef struct
+{
+    coap_shm_ring_t *ring;              /* Mapping of the segment */
+    size_t map_len;
+    int memfd;
+    int eventfd;
+    uint32_t size;                      /* Ring size and mode, checked by coap_shm_attach() and kept here, as the
+                                         * segment may be written by a faulty process */
+    uint32_t mode;
+    uint64_t read;                      /* Consumer: end of the batch of the last coap_shm_peek() */
+} coap_shm_t;
+
+/// Space reserved for one message
+typedef struct
+{
+    uint8_t *p;                         /* Where to write the message */
+    size_t len;                         /* Bytes reserved */
+    uint64_t pos;                       /* Position of the record */
+    uint32_t span;                      /* Bytes of the record including header */
+} coap_shm_slot_t;
+
+/// @brief Creates a segment with an empty ring
+/// @param shm Handle to initialize
+/// @param size Ring size in bytes, a power of two from 256
+/// @param mode SPSC or MPSC
+/// @return COAP_SHM_OK, COAP_SHM_IO if memfd, eventfd or mapping fail, COAP_SHM_INVALID for a bad size
+coap_shm_result_t coap_shm_create(coap_shm_t *shm, uint32_t size, coap_shm_mode_t mode);
+
+/// @brief Maps the segment of another process
+/// @param shm Handle to initialize
+/// @param memfd Memory fd of the segment, owned by shm afterwards
+/// @param eventfd Eventfd of the segment, owned by shm afterwards
+/// @return COAP_SHM_OK, COAP_SHM_IO if the mapping fails, COAP_SHM_INVALID if memfd holds no ring or one with an
+/// unknown mode
+coap_shm_result_t coap_shm_attach(coap_shm_t *shm, int memfd, int eventfd);
+
+/// @brief Unmaps the segment and closes its file descriptors. The segment is freed once all processes closed it.
+/// @param shm Handle
+void coap_shm_close(coap_shm_t *shm);
+
+/// @brief Reserves space for a message, to be written and then published with coap_shm_commit()
+/// @param shm Handle of a producer
+/// @param len Bytes to reserve
+/// @param[out] slot Reserved space
+/// @return COAP_SHM_OK, COAP_SHM_FULL or COAP_SHM_TOO_LARGE
+coap_shm_result_t coap_shm_reserve(coap_shm_t *shm, size_t len, coap_shm_slot_t *slot);
+
+/// @brief Publishes a reserved message and wakes the consumer if it sleeps. Of an SPSC ring the unused space
+/// becomes free again, of an MPSC ring it stays part of the record.
+/// @param shm Handle of a producer
+/// @param slot Space from coap_shm_reserve()
+/// @param len Length of the message, at most slot->len. Bytes behind it must not have been written. 0 cancels the
+/// message, then any of slot->len may have been written.
+void coap_shm_commit(coap_shm_t *shm, const coap_shm_slot_t *slot, size_t len);
+
+/// @brief Copies a message into the ring
+/// @param shm Handle of a producer
+/// @param msg Message
+/// @param len Length of msg, not 0
+/// @return COAP_SHM_OK, COAP_SHM_FULL or COAP_SHM_TOO_LARGE
+coap_shm_result_t coap_shm_send(coap_shm_t *shm, const uint8_t *msg, size_t len);
+
+/// @brief Builds a packet into the ring. SPSC rings get it built in place, MPSC rings get it built on the stack and
+/// copied, so it takes no more space than needed while other producers reserve behind it.
+/// @param shm Handle of a producer
+/// @param pkt Packet
+/// @return COAP_SHM_OK, COAP_SHM_FULL, COAP_SHM_TOO_LARGE if the packet exceeds COAP_SHM_MESSAGE_SIZE or half the
+/// ring, COAP_SHM_INVALID if coap_build() fails otherwise
+coap_shm_result_t coap_shm_send_packet(coap_shm_t *shm, const coap_packet_t *pkt);
+
+/// @brief Takes the published messages in order, without copying. Messages stay valid until coap_shm_release().
+/// Stops at a message reserved but not yet committed, and at a record whose header does not fit the ring, which
+/// a producer that writes outside its reservations leaves behind. Such a record is never returned.
+/// @param shm Handle of the consumer
+/// @param[out] msgs Messages, pointing into the ring
+/// @param max Size of msgs
+/// @return Number of messages, 0 if the ring is empty
+size_t coap_shm_peek(coap_shm_t *shm, coap_buffer_t *msgs, size_t max);
+
+/// @brief Frees the messages of the last coap_shm_peek()
+/// @param shm Handle of the consumer
+void coap_shm_release(coap_shm_t *shm);
+
+/// @brief Waits until a message is published
+/// @param shm Handle of the consumer
+/// @param timeout_ms Longest wait, -1 for no limit
+/// @return True if a message is available, false once the timeout passed
+bool coap_shm_wait(coap_shm_t *shm, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
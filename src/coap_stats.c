@@ -0,0 +1,62 @@
+// clock_gettime()
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "coap_stats.h"
+
+#ifdef COAP_WITH_STATS
+
+_Thread_local coap_stats_thread_t *coap_stats_self;
+
+static coap_stats_thread_t *_Atomic coap_stats_head;
+
+void coap_stats_register(coap_stats_thread_t *block)
+{
+    size_t i;
+    coap_stats_thread_t *head;
+
+    for (i = 0; i < COAP_STATS_COUNTERS; i++)
+        atomic_init(&block->counters[i], 0);
+    // blocks are only ever pushed, so there is no ABA problem
+    head = atomic_load_explicit(&coap_stats_head, memory_order_relaxed);
+    do
+        atomic_store_explicit(&block->next, head, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&coap_stats_head, &head, block, memory_order_release, memory_order_relaxed));
+    coap_stats_self = block;
+}
+
+void coap_stats_snapshot(coap_stats_t *out)
+{
+    uint64_t *sum = (uint64_t *)out;
+    const coap_stats_thread_t *block;
+    size_t i;
+
+    for (i = 0; i < COAP_STATS_COUNTERS; i++)
+        sum[i] = 0;
+    for (block = atomic_load_explicit(&coap_stats_head, memory_order_acquire); NULL != block;
+         block = atomic_load_explicit(&block->next, memory_order_relaxed))
+    {
+        for (i = 0; i < COAP_STATS_COUNTERS; i++)
+            sum[i] += atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+    }
+}
+
+void coap_stats_merge(coap_stats_t *dst, const coap_stats_t *src)
+{
+    uint64_t *d = (uint64_t *)dst;
+    const uint64_t *s = (const uint64_t *)src;
+    size_t i;
+    for (i = 0; i < COAP_STATS_COUNTERS; i++)
+        d[i] += s[i];
+}
+
+uint64_t coap_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+#endif
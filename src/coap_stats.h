@@ -0,0 +1,117 @@
+#ifndef COAP_STATS_H
+#define COAP_STATS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Instrumentation of coap_parse(), coap_build() and coap_handle_req(). Only compiled in with COAP_WITH_STATS (CMake
+// option COAP_WITH_STATS), otherwise all COAP_STATS_* macros expand to nothing.
+
+// Number of log2 buckets of a histogram. Bucket 0 counts the value 0, bucket n the values [2^(n-1), 2^n).
+#define COAP_STATS_BUCKETS 32
+
+// Number of counted coap_error_t values, larger codes are counted in the last entry
+#define COAP_STATS_ERRORS 24
+
+/// Counters and histograms, all fields are uint64_t so a snapshot can be merged field by field
+typedef struct
+{
+    uint64_t parse_ok;                          /* Successfully parsed messages */
+    uint64_t parse_errors[COAP_STATS_ERRORS];   /* Failed parses by coap_error_t */
+    uint64_t parse_options;                     /* Parsed options */
+    uint64_t parse_truncated;                   /* Messages with more than MAXOPT options */
+    uint64_t parse_ext_headers;                 /* Parsed options with extended delta or length */
+    uint64_t build_ok;                          /* Successfully built messages */
+    uint64_t build_errors[COAP_STATS_ERRORS];   /* Failed builds by coap_error_t */
+    uint64_t build_bytes;                       /* Bytes encoded */
+    uint64_t build_ext_headers;                 /* Encoded options with extended delta or length */
+    uint64_t dispatch_ok;                       /* Requests handled by an endpoint */
+    uint64_t dispatch_not_found;                /* Requests without matching endpoint */
+    uint64_t parse_size[COAP_STATS_BUCKETS];    /* Size of parsed messages in bytes */
+    uint64_t build_size[COAP_STATS_BUCKETS];    /* Size of built messages in bytes */
+    uint64_t parse_ns[COAP_STATS_BUCKETS];      /* Duration of coap_parse() */
+    uint64_t build_ns[COAP_STATS_BUCKETS];      /* Duration of coap_build() */
+    uint64_t dispatch_ns[COAP_STATS_BUCKETS];   /* Duration of coap_handle_req() including the handler */
+} coap_stats_t;
+
+#define COAP_STATS_COUNTERS (sizeof(coap_stats_t) / sizeof(uint64_t))
+
+#ifdef COAP_WITH_STATS
+
+#include <stdatomic.h>
+
+/// Counters of one thread. Only the owning thread writes them, any thread may read them.
+typedef struct coap_stats_thread
+{
+    _Atomic uint64_t counters[COAP_STATS_COUNTERS];
+    struct coap_stats_thread *_Atomic next;     /* Registration list */
+} coap_stats_thread_t;
+
+extern _Thread_local coap_stats_thread_t *coap_stats_self;
+
+/// @brief Registers the counters of the calling thread. Threads that did not register are not counted.
+/// Lock-free, registrations are never removed.
+/// @param block Counters, cleared by the call. Must stay valid as long as snapshots are taken.
+void coap_stats_register(coap_stats_thread_t *block);
+
+/// @brief Sums the counters of all registered threads. Lock-free, may be called from any thread while the counters
+/// are updated, each counter is read atomically.
+/// @param[out] out Snapshot
+void coap_stats_snapshot(coap_stats_t *out);
+
+/// @brief Adds the counters of one snapshot to another, for example to aggregate several processes
+/// @param[in,out] dst Snapshot to add to
+/// @param src Snapshot to add
+void coap_stats_merge(coap_stats_t *dst, const coap_stats_t *src);
+
+/// @brief Returns a monotonic timestamp in ns
+uint64_t coap_stats_now(void);
+
+static inline unsigned coap_stats_log2(uint64_t value)
+{
+    unsigned bucket = 0;
+    while (value > 0 && bucket < COAP_STATS_BUCKETS - 1)
+    {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// single writer, so a relaxed load and store is enough and avoids a locked instruction
+static inline void coap_stats_add(size_t index, uint64_t n)
+{
+    coap_stats_thread_t *self = coap_stats_self;
+    if (NULL != self)
+        atomic_store_explicit(&self->counters[index], atomic_load_explicit(&self->counters[index], memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#define COAP_STATS_INDEX(field) (offsetof(coap_stats_t, field) / sizeof(uint64_t))
+#define COAP_STATS_ADD(field, n) coap_stats_add(COAP_STATS_INDEX(field), (n))
+#define COAP_STATS_ADD_AT(field, i, max, n) coap_stats_add(COAP_STATS_INDEX(field) + (((size_t)(i) < (max)) ? (size_t)(i) : (max) - 1), (n))
+#define COAP_STATS_HIST(field, value) coap_stats_add(COAP_STATS_INDEX(field) + coap_stats_log2(value), 1)
+#define COAP_STATS_TIME_START(var) uint64_t var = coap_stats_now()
+#define COAP_STATS_TIME_END(field, var) COAP_STATS_HIST(field, coap_stats_now() - (var))
+
+#else
+
+#define COAP_STATS_ADD(field, n) ((void)0)
+#define COAP_STATS_ADD_AT(field, i, max, n) ((void)0)
+#define COAP_STATS_HIST(field, value) ((void)0)
+#define COAP_STATS_TIME_START(var)
+#define COAP_STATS_TIME_END(field, var) ((void)0)
+
+#endif
+
+#define COAP_STATS_INC(field) COAP_STATS_ADD(field, 1)
+#define COAP_STATS_ERROR(field, err) COAP_STATS_ADD_AT(field, err, COAP_STATS_ERRORS, 1)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,302 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_tcp.h"
+#include "byte_order.h"
+
+// http://tools.ietf.org/html/rfc8323#section-3.2
+//   0 1 2 3 4 5 6 7
+//  +-+-+-+-+-+-+-+-+-------------------+------+---------+---------+-----+---------+
+//  |  Len  |  TKL  | Extended Length   | Code | Token   | Options | 0xFF| Payload |
+//  +-+-+-+-+-+-+-+-+-------------------+------+---------+---------+-----+---------+
+// Len counts options, payload marker and payload. 13, 14 and 15 announce 1, 2 and 4 bytes of extended length.
+
+// Size of the first byte and the extended length
+static size_t coap_tcp_length_size(uint8_t first)
+{
+    static const uint8_t ext[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4};
+    return 1U + ext[first >> 4];
+}
+
+// Determines the size of the message starting at buf, COAP_ERR_HEADER_TOO_SHORT if the length field is incomplete
+static coap_error_t coap_tcp_message_size(const uint8_t *buf, size_t buflen, size_t *size)
+{
+    size_t head;
+    uint64_t len;
+
+    if (buflen < 1 || buflen < (head = coap_tcp_length_size(buf[0])))
+        return COAP_ERR_HEADER_TOO_SHORT;
+    if ((buf[0] & 0x0F) > 8)
+        return COAP_ERR_TOKEN_TOO_LONG;
+    switch (buf[0] >> 4)
+    {
+    case 13:
+        len = buf[1] + 13U;
+        break;
+    case 14:
+        len = endian_load16(uint16_t, &buf[1]) + 269U;
+        break;
+    case 15:
+        len = endian_load32(uint32_t, &buf[1]) + 65805ULL;
+        break;
+    default:
+        len = buf[0] >> 4;
+        break;
+    }
+    len += head + 1 + (buf[0] & 0x0F);
+    if (len > SIZE_MAX)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    *size = (size_t)len;
+    return COAP_ERR_NONE;
+}
+
+coap_error_t coap_tcp_parse(coap_packet_t *pkt, const uint8_t *buf, size_t buflen, bool websocket)
+{
+    size_t head, size;
+    const uint8_t *p;
+    coap_error_t err;
+    int rc;
+
+    if (websocket)
+    {
+        if (buflen < 1)
+            return COAP_ERR_HEADER_TOO_SHORT;
+        if ((buf[0] >> 4) != 0)
+            return COAP_ERR_FRAME_LENGTH_MISMATCH;
+        if ((buf[0] & 0x0F) > 8)
+            return COAP_ERR_TOKEN_TOO_LONG;
+        head = 1;
+    }
+    else
+    {
+        if (COAP_ERR_NONE != (err = coap_tcp_message_size(buf, buflen, &size)))
+            return err;
+        if (size != buflen)
+            return COAP_ERR_FRAME_LENGTH_MISMATCH;
+        head = coap_tcp_length_size(buf[0]);
+    }
+
+    pkt->hdr.ver = 1;
+    pkt->hdr.t = 0;
+    pkt->hdr.id = 0;
+    pkt->hdr.tkl = buf[0] & 0x0F;
+    if (buflen < head + 1)
+        return COAP_ERR_HEADER_TOO_SHORT;
+    pkt->hdr.code = buf[head];
+    p = buf + head + 1;
+    if ((size_t)(buf + buflen - p) < pkt->hdr.tkl)
+        return COAP_ERR_TOKEN_TOO_SHORT;
+    pkt->tok.p = (pkt->hdr.tkl > 0) ? p : NULL;
+    pkt->tok.len = pkt->hdr.tkl;
+    p += pkt->hdr.tkl;
+
+    pkt->numopts = MAXOPT;
+    pkt->scratch_len = 0;
+    if (0 != (rc = coap_parse_options(pkt->opts, &pkt->numopts, &pkt->payload, p, buf + buflen - p)))
+        return (coap_error_t)rc;
+    return COAP_ERR_NONE;
+}
+
+void coap_tcp_decoder_init(coap_tcp_decoder_t *dec, uint8_t *buf, size_t size)
+{
+    dec->buf = buf;
+    dec->size = size;
+    dec->len = 0;
+    dec->msg_len = 0;
+    dec->release = false;
+    dec->in = NULL;
+    dec->in_end = NULL;
+}
+
+void coap_tcp_decoder_feed(coap_tcp_decoder_t *dec, const uint8_t *chunk, size_t len)
+{
+    dec->in = chunk;
+    dec->in_end = chunk + len;
+}
+
+coap_error_t coap_tcp_decoder_next(coap_tcp_decoder_t *dec, coap_packet_t *pkt, bool *available)
+{
+    coap_error_t err;
+    size_t size, want, n;
+
+    *available = false;
+    if (dec->release)
+    {
+        dec->len = 0;
+        dec->msg_len = 0;
+        dec->release = false;
+    }
+
+    // fast path, the message lies completely inside the chunk
+    if (0 == dec->len && dec->in < dec->in_end)
+    {
+        err = coap_tcp_message_size(dec->in, dec->in_end - dec->in, &size);
+        if (COAP_ERR_NONE == err && size <= (size_t)(dec->in_end - dec->in))
+        {
+            const uint8_t *msg = dec->in;
+            dec->in += size;
+            if (COAP_ERR_NONE != (err = coap_tcp_parse(pkt, msg, size, false)))
+                return err;
+            *available = true;
+            return COAP_ERR_NONE;
+        }
+        if (COAP_ERR_NONE != err && COAP_ERR_HEADER_TOO_SHORT != err)
+            return err;
+    }
+
+    // reassemble the length field first, then the rest of the message
+    while (true)
+    {
+        if (0 == dec->msg_len)
+        {
+            want = (0 == dec->len) ? 1 : coap_tcp_length_size(dec->buf[0]);
+            if (dec->len == want)
+            {
+                if (COAP_ERR_NONE != (err = coap_tcp_message_size(dec->buf, dec->len, &dec->msg_len)))
+                    return err;
+                if (dec->msg_len > dec->size)
+                    return COAP_ERR_BUFFER_TOO_SMALL;
+                continue;
+            }
+        }
+        else
+        {
+            want = dec->msg_len;
+            if (dec->len == want)
+            {
+                dec->release = true;
+                if (COAP_ERR_NONE != (err = coap_tcp_parse(pkt, dec->buf, dec->len, false)))
+                    return err;
+                *available = true;
+                return COAP_ERR_NONE;
+            }
+        }
+        n = want - dec->len;
+        if (n > (size_t)(dec->in_end - dec->in))
+            n = dec->in_end - dec->in;
+        if (0 == n)
+            return COAP_ERR_NONE;
+        if (want > dec->size)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        memcpy(dec->buf + dec->len, dec->in, n);
+        dec->len += n;
+        dec->in += n;
+    }
+}
+
+coap_error_t coap_tcp_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt, bool websocket)
+{
+    size_t optlen, len, ext = 0;
+    size_t head = 2U + pkt->hdr.tkl;   // without extended length
+    uint8_t nibble;
+    coap_error_t err;
+
+    if (pkt->hdr.tkl > 8)
+        return COAP_ERR_TOKEN_TOO_LONG;
+    if ((pkt->hdr.tkl > 0) && (pkt->hdr.tkl != pkt->tok.len))
+        return COAP_ERR_TOKEN_LENGTH_MISMATCH;
+    if (*buflen < head)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+
+    // the options are encoded behind the shortest header and moved if the length needs extended bytes
+    optlen = *buflen - head;
+    if (COAP_ERR_NONE != (err = coap_build_options(buf + head, &optlen, pkt)))
+        return err;
+    len = optlen + ((pkt->payload.len > 0) ? 1 + pkt->payload.len : 0);
+
+    if (websocket)
+        nibble = 0;
+    else if (len < 13)
+        nibble = (uint8_t)len;
+    else if (len < 269)
+    {
+        nibble = 13;
+        ext = 1;
+    }
+    else if (len < 65805)
+    {
+        nibble = 14;
+        ext = 2;
+    }
+    else
+    {
+        nibble = 15;
+        ext = 4;
+    }
+    if (*buflen < head + ext + len)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    if (ext > 0)
+        memmove(buf + head + ext, buf + head, optlen);
+
+    buf[0] = (uint8_t)((nibble << 4) | pkt->hdr.tkl);
+    if (ext == 1)
+        buf[1] = (uint8_t)(len - 13);
+    else if (ext == 2)
+        endian_store16(&buf[1], (uint16_t)(len - 269));
+    else if (ext == 4)
+        endian_store32(&buf[1], (uint32_t)(len - 65805));
+    buf[1 + ext] = pkt->hdr.code;
+    if (pkt->hdr.tkl > 0)
+        memcpy(buf + 2 + ext, pkt->tok.p, pkt->hdr.tkl);
+
+    if (pkt->payload.len > 0)
+    {
+        buf[head + ext + optlen] = 0xFF;  // payload marker
+        memcpy(buf + head + ext + optlen + 1, pkt->payload.p, pkt->payload.len);
+    }
+    *buflen = head + ext + len;
+    return COAP_ERR_NONE;
+}
+
+void coap_tcp_signal_init(coap_packet_t *pkt, coap_code_t code)
+{
+    pkt->hdr.ver = 1;
+    pkt->hdr.t = 0;
+    pkt->hdr.tkl = 0;
+    pkt->hdr.code = code;
+    pkt->hdr.id = 0;
+    pkt->tok.p = NULL;
+    pkt->tok.len = 0;
+    pkt->numopts = 0;
+    pkt->payload.p = NULL;
+    pkt->payload.len = 0;
+    pkt->scratch_len = 0;
+}
+
+coap_error_t coap_tcp_make_csm(coap_packet_t *pkt, uint32_t max_message_size, bool block_wise)
+{
+    coap_error_t err;
+
+    coap_tcp_signal_init(pkt, COAP_SIGNAL_CSM);
+    if (COAP_ERR_NONE != (err = coap_add_option_uint(pkt, (coap_option_num_t)COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE, max_message_size)))
+        return err;
+    if (block_wise)
+    {
+        if (pkt->numopts >= MAXOPT)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        coap_add_option(pkt, (coap_option_num_t)COAP_SIGNAL_OPTION_BLOCK_WISE_TRANSFER, NULL, 0);
+    }
+    return COAP_ERR_NONE;
+}
+
+void coap_tcp_read_csm(const coap_packet_t *csm, uint32_t *max_message_size, bool *block_wise)
+{
+    uint8_t count;
+
+    coap_option_get_uint(csm, COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE, max_message_size);
+    if (NULL != coap_findOptions(csm, COAP_SIGNAL_OPTION_BLOCK_WISE_TRANSFER, &count))
+        *block_wise = true;
+}
+
+void coap_tcp_make_pong(coap_packet_t *pong, const coap_packet_t *ping)
+{
+    uint8_t count;
+    const coap_option_t *custody;
+
+    coap_tcp_signal_init(pong, COAP_SIGNAL_PONG);
+    coap_header_add_token(pong, ping->tok.p, ping->tok.len);
+    custody = coap_findOptions(ping, COAP_SIGNAL_OPTION_CUSTODY, &count);
+    if (NULL != custody)
+        coap_add_option(pong, (coap_option_num_t)COAP_SIGNAL_OPTION_CUSTODY, (uint8_t *)custody->buf.p, custody->buf.len);
+}
@@ -0,0 +1,110 @@
+#ifndef COAP_TCP_H
+#define COAP_TCP_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Message format of CoAP over reliable transports (TCP, TLS, WebSockets), see http://tools.ietf.org/html/rfc8323
+// Messages are stored in the same coap_packet_t as datagrams. Type and message ID do not exist on the wire, they are
+// ignored when building and set to 0 when parsing.
+
+// Max-Message-Size assumed until the peer's CSM is received, see http://tools.ietf.org/html/rfc8323#section-5.3.1
+#define COAP_TCP_DEFAULT_MAX_MESSAGE_SIZE 1152
+
+// http://tools.ietf.org/html/rfc8323#section-11.2
+typedef enum
+{
+    COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE = 2,    // CSM
+    COAP_SIGNAL_OPTION_BLOCK_WISE_TRANSFER = 4, // CSM
+    COAP_SIGNAL_OPTION_CUSTODY = 2,             // Ping, Pong
+    COAP_SIGNAL_OPTION_ALTERNATIVE_ADDRESS = 2, // Release
+    COAP_SIGNAL_OPTION_HOLD_OFF = 4,            // Release
+    COAP_SIGNAL_OPTION_BAD_CSM_OPTION = 2       // Abort
+} coap_signal_option_t;
+
+typedef struct
+{
+    uint8_t *buf;           /* Reassembly buffer for messages split across chunks */
+    size_t size;            /* Size of buf, limits the size of split messages */
+    size_t len;             /* Bytes of the current message in buf */
+    size_t msg_len;         /* Size of the current message, 0 while its length field is incomplete */
+    bool release;           /* The last message was delivered from buf and is dropped on the next call */
+    const uint8_t *in;      /* Unconsumed part of the current chunk */
+    const uint8_t *in_end;
+} coap_tcp_decoder_t;
+
+/// @brief Initializes a stream decoder
+/// @param dec Decoder
+/// @param buf Reassembly buffer, should hold the Max-Message-Size announced in the own CSM
+/// @param size Size of buf
+void coap_tcp_decoder_init(coap_tcp_decoder_t *dec, uint8_t *buf, size_t size);
+
+/// @brief Passes the next chunk of the stream to the decoder. The chunk may hold any part of one or several
+/// messages. coap_tcp_decoder_next() must be called until it reports no message before feeding the next chunk.
+/// @param dec Decoder
+/// @param chunk Bytes read from the stream, must stay valid until the chunk is consumed
+/// @param len Length of chunk
+void coap_tcp_decoder_feed(coap_tcp_decoder_t *dec, const uint8_t *chunk, size_t len);
+
+/// @brief Returns the next complete message of the stream. Messages lying completely inside the current chunk are
+/// parsed in place, only messages split across chunks are copied to the reassembly buffer. The message stays valid
+/// until the next call.
+/// @param dec Decoder
+/// @param[out] pkt Packet to parse the message into
+/// @param[out] available Set to true if pkt holds a message, false if the chunk is consumed
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if a split message exceeds the reassembly buffer, or
+/// a parse error. Errors are not recoverable, the connection should be aborted.
+coap_error_t coap_tcp_decoder_next(coap_tcp_decoder_t *dec, coap_packet_t *pkt, bool *available);
+
+/// @brief Parses exactly one complete message
+/// @param[out] pkt Packet to parse into, token, options and payload point into buf
+/// @param buf Message
+/// @param buflen Length of the message
+/// @param websocket True for the WebSocket format, where the length is given by the frame and the length field is 0
+/// @return COAP_ERR_NONE on success, COAP_ERR_FRAME_LENGTH_MISMATCH if the length field does not match buflen,
+/// otherwise the same errors as coap_parse()
+coap_error_t coap_tcp_parse(coap_packet_t *pkt, const uint8_t *buf, size_t buflen, bool websocket);
+
+/// @brief Builds a message in the stream format
+/// @param[out] buf Buffer to build into
+/// @param[in,out] buflen Size of buf, set to the number of bytes written
+/// @param[in] pkt Packet to build
+/// @param websocket True for the WebSocket format, see coap_tcp_parse()
+/// @return COAP_ERR_NONE on success, otherwise the same errors as coap_build()
+coap_error_t coap_tcp_build(uint8_t *buf, size_t *buflen, const coap_packet_t *pkt, bool websocket);
+
+/// @brief Initializes a signaling message without token, options and payload
+/// @param pkt Packet to initialize
+/// @param code One of the COAP_SIGNAL_* codes
+void coap_tcp_signal_init(coap_packet_t *pkt, coap_code_t code);
+
+/// @brief Initializes a Capabilities and Settings Message, see http://tools.ietf.org/html/rfc8323#section-5.3
+/// @param pkt Packet to initialize
+/// @param max_message_size Largest message the own decoder accepts
+/// @param block_wise True if block-wise transfers are supported
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if MAXOPT is too small for the options
+coap_error_t coap_tcp_make_csm(coap_packet_t *pkt, uint32_t max_message_size, bool block_wise);
+
+/// @brief Reads the settings of a received CSM. Settings not contained in the CSM are left unchanged.
+/// @param csm Received CSM
+/// @param[in,out] max_message_size Max-Message-Size of the peer, COAP_TCP_DEFAULT_MAX_MESSAGE_SIZE initially
+/// @param[in,out] block_wise Block-wise transfer support of the peer, false initially
+void coap_tcp_read_csm(const coap_packet_t *csm, uint32_t *max_message_size, bool *block_wise);
+
+/// @brief Initializes the Pong answering a Ping, see http://tools.ietf.org/html/rfc8323#section-5.4
+/// Token and Custody option are taken over from the Ping, so it must stay valid until the Pong is built.
+/// @param pong Packet to initialize
+/// @param ping Received Ping
+void coap_tcp_make_pong(coap_packet_t *pong, const coap_packet_t *ping);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
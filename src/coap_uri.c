@@ -0,0 +1,327 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_uri.h"
+
+static int coap_uri_hex(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool coap_uri_prefix(const char *p, const char *end, const char *prefix)
+{
+    size_t i, len = strlen(prefix);
+    if ((size_t)(end - p) < len)
+        return false;
+    for (i = 0; i < len; i++)
+    {
+        char c = p[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != prefix[i])
+            return false;
+    }
+    return true;
+}
+
+// Adds one URI component as option. It is percent-decoded (and lower cased for Uri-Host) into the arena if
+// necessary, otherwise the option references the URI itself.
+static coap_error_t coap_uri_add_component(coap_packet_t *pkt, coap_arena_t *arena, coap_option_num_t num, const char *p, const char *end, bool lower)
+{
+    const char *q;
+    uint8_t *out;
+    size_t len = 0;
+    bool decode = false;
+
+    if (pkt->numopts >= MAXOPT)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    for (q = p; q < end && !decode; q++)
+        decode = (*q == '%') || (lower && *q >= 'A' && *q <= 'Z');
+    if (!decode)
+    {
+        coap_add_option(pkt, num, (uint8_t *)p, end - p);
+        return COAP_ERR_NONE;
+    }
+
+    if (NULL == (out = coap_arena_alloc(arena, end - p, 1)))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    for (q = p; q < end; q++)
+    {
+        uint8_t c = *q;
+        if (c == '%')
+        {
+            int hi, lo;
+            if (end - q < 3 || (hi = coap_uri_hex(q[1])) < 0 || (lo = coap_uri_hex(q[2])) < 0)
+                return COAP_ERR_URI_INVALID;
+            c = (uint8_t)((hi << 4) | lo);
+            q += 2;
+        }
+        else if (lower && c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        out[len++] = c;
+    }
+    coap_add_option(pkt, num, out, len);
+    return COAP_ERR_NONE;
+}
+
+static bool coap_uri_is_ipv4(const char *p, const char *end)
+{
+    int dots = 0, digits = 0, value = 0;
+    for (; p < end; p++)
+    {
+        if (*p == '.')
+        {
+            if (0 == digits)
+                return false;
+            dots++;
+            digits = 0;
+            value = 0;
+        }
+        else if (*p >= '0' && *p <= '9')
+        {
+            value = value * 10 + (*p - '0');
+            if (++digits > 3 || value > 255)
+                return false;
+        }
+        else
+            return false;
+    }
+    return dots == 3 && digits > 0;
+}
+
+coap_error_t coap_uri_to_options(coap_packet_t *pkt, coap_arena_t *arena, const char *uri, size_t len, bool *secure)
+{
+    const char *p = uri;
+    const char *end = uri + len;
+    const char *host, *host_end, *seg;
+    bool is_secure;
+    uint32_t port = 0;
+    coap_error_t err;
+
+    // http://tools.ietf.org/html/rfc7252#section-6.4, step 1 to 3
+    if (coap_uri_prefix(p, end, "coap://"))
+    {
+        is_secure = false;
+        p += 7;
+    }
+    else if (coap_uri_prefix(p, end, "coaps://"))
+    {
+        is_secure = true;
+        p += 8;
+    }
+    else
+        return COAP_ERR_URI_INVALID;
+    if (NULL != memchr(p, '#', end - p))
+        return COAP_ERR_URI_INVALID;
+    if (NULL != secure)
+        *secure = is_secure;
+
+    // step 4, host
+    host = p;
+    if (p < end && *p == '[')
+    {
+        const char *close = memchr(p, ']', end - p);
+        if (NULL == close)
+            return COAP_ERR_URI_INVALID;
+        p = close + 1;
+    }
+    else
+    {
+        while (p < end && *p != ':' && *p != '/' && *p != '?')
+            p++;
+    }
+    host_end = p;
+    if (host == host_end)
+        return COAP_ERR_URI_INVALID;
+    if (*host != '[' && !coap_uri_is_ipv4(host, host_end))
+    {
+        if (COAP_ERR_NONE != (err = coap_uri_add_component(pkt, arena, COAP_OPTION_URI_HOST, host, host_end, true)))
+            return err;
+    }
+
+    // step 5, port. An empty port is the default port.
+    if (p < end && *p == ':')
+    {
+        bool digits = false;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            port = port * 10 + (uint32_t)(*p - '0');
+            digits = true;
+            if (port > 0xFFFF)
+                return COAP_ERR_URI_INVALID;
+        }
+        if (!digits)
+            port = 0;
+    }
+    if (p < end && *p != '/' && *p != '?')
+        return COAP_ERR_URI_INVALID;
+    if (port != 0 && port != (is_secure ? COAP_DEFAULT_SECURE_PORT : COAP_DEFAULT_PORT))
+    {
+        if (COAP_ERR_NONE != (err = coap_add_option_uint(pkt, COAP_OPTION_URI_PORT, port)))
+            return err;
+    }
+
+    // step 8, path. Neither an empty path nor "/" produce an option.
+    if (p < end && *p == '/' && p + 1 < end && p[1] != '?')
+    {
+        p++;
+        seg = p;
+        while (true)
+        {
+            if (p == end || *p == '/' || *p == '?')
+            {
+                if (COAP_ERR_NONE != (err = coap_uri_add_component(pkt, arena, COAP_OPTION_URI_PATH, seg, p, false)))
+                    return err;
+                if (p == end || *p == '?')
+                    break;
+                seg = p + 1;
+            }
+            p++;
+        }
+    }
+    else if (p < end && *p == '/')
+        p++;
+
+    // step 9, query
+    if (p < end && *p == '?')
+    {
+        seg = ++p;
+        while (true)
+        {
+            if (p == end || *p == '&')
+            {
+                if (COAP_ERR_NONE != (err = coap_uri_add_component(pkt, arena, COAP_OPTION_URI_QUERY, seg, p, false)))
+                    return err;
+                if (p == end)
+                    break;
+                seg = p + 1;
+            }
+            p++;
+        }
+    }
+    return COAP_ERR_NONE;
+}
+
+// http://tools.ietf.org/html/rfc3986#section-2.3 and the sub-delimiters allowed in the given component
+static bool coap_uri_allowed(uint8_t c, const char *extra)
+{
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+        return true;
+    if (c == '-' || c == '.' || c == '_' || c == '~')
+        return true;
+    return c != 0 && NULL != strchr(extra, c);
+}
+
+static bool coap_uri_put(char *buf, size_t buflen, size_t *used, const char *str, size_t len)
+{
+    // one byte stays reserved for the terminator
+    if (len >= buflen - *used)
+        return false;
+    memcpy(buf + *used, str, len);
+    *used += len;
+    return true;
+}
+
+static bool coap_uri_put_encoded(char *buf, size_t buflen, size_t *used, const coap_buffer_t *value, const char *extra)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t i;
+    for (i = 0; i < value->len; i++)
+    {
+        uint8_t c = value->p[i];
+        if (coap_uri_allowed(c, extra))
+        {
+            if (!coap_uri_put(buf, buflen, used, (const char *)&c, 1))
+                return false;
+        }
+        else
+        {
+            char enc[3] = {'%', hex[c >> 4], hex[c & 0x0F]};
+            if (!coap_uri_put(buf, buflen, used, enc, 3))
+                return false;
+        }
+    }
+    return true;
+}
+
+coap_error_t coap_options_to_uri(const coap_packet_t *pkt, const char *default_host, bool secure, char *buf, size_t *buflen)
+{
+    // pchar without '/', query without '&', see http://tools.ietf.org/html/rfc3986#section-3.3
+    static const char path_extra[] = "!$&'()*+,;=:@";
+    static const char query_extra[] = "!$'()*+,;=:@/?";
+    size_t used = 0;
+    uint8_t count, i;
+    uint32_t port;
+    const coap_option_t *opt;
+
+    if (0 == *buflen)
+        return COAP_ERR_BUFFER_TOO_SMALL;
+
+    opt = coap_findOptions(pkt, COAP_OPTION_URI_HOST, &count);
+    if (NULL != opt || NULL != default_host)
+    {
+        char portbuf[6];
+        size_t portlen = 0;
+
+        if (!coap_uri_put(buf, *buflen, &used, secure ? "coaps://" : "coap://", secure ? 8 : 7))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        if (NULL != opt)
+        {
+            bool literal = NULL != memchr(opt->buf.p, ':', opt->buf.len);
+            if ((literal && !coap_uri_put(buf, *buflen, &used, "[", 1))
+                || !coap_uri_put_encoded(buf, *buflen, &used, &opt->buf, literal ? ":" : "!$&'()*+,;=")
+                || (literal && !coap_uri_put(buf, *buflen, &used, "]", 1)))
+                return COAP_ERR_BUFFER_TOO_SMALL;
+        }
+        else if (!coap_uri_put(buf, *buflen, &used, default_host, strlen(default_host)))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+
+        // a Uri-Port of a parsed packet may hold any value of up to 4 bytes
+        if (NULL != (opt = coap_findOptions(pkt, COAP_OPTION_URI_PORT, &count))
+            && (COAP_ERR_NONE != coap_decode_uint(&opt->buf, &port) || port > 65535))
+            return COAP_ERR_URI_INVALID;
+        if (NULL != opt && port != (secure ? COAP_DEFAULT_SECURE_PORT : COAP_DEFAULT_PORT))
+        {
+            char digits[5];
+            size_t n = 0;
+            portbuf[portlen++] = ':';
+            do
+            {
+                digits[n++] = (char)('0' + port % 10);
+                port /= 10;
+            }
+            while (port > 0);
+            while (n > 0)
+                portbuf[portlen++] = digits[--n];
+            if (!coap_uri_put(buf, *buflen, &used, portbuf, portlen))
+                return COAP_ERR_BUFFER_TOO_SMALL;
+        }
+    }
+
+    opt = coap_findOptions(pkt, COAP_OPTION_URI_PATH, &count);
+    if (0 == count && !coap_uri_put(buf, *buflen, &used, "/", 1))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    for (i = 0; i < count; i++)
+    {
+        if (!coap_uri_put(buf, *buflen, &used, "/", 1) || !coap_uri_put_encoded(buf, *buflen, &used, &opt[i].buf, path_extra))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+    }
+
+    opt = coap_findOptions(pkt, COAP_OPTION_URI_QUERY, &count);
+    for (i = 0; i < count; i++)
+    {
+        if (!coap_uri_put(buf, *buflen, &used, (0 == i) ? "?" : "&", 1) || !coap_uri_put_encoded(buf, *buflen, &used, &opt[i].buf, query_extra))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+    }
+
+    buf[used] = '\0';
+    *buflen = used;
+    return COAP_ERR_NONE;
+}
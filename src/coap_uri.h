@@ -0,0 +1,48 @@
+#ifndef COAP_URI_H
+#define COAP_URI_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+#define COAP_DEFAULT_PORT 5683
+#define COAP_DEFAULT_SECURE_PORT 5684
+
+/// @brief Decomposes a coap or coaps URI into Uri-Host, Uri-Port, Uri-Path and Uri-Query options, see
+/// http://tools.ietf.org/html/rfc7252#section-6.4
+/// Uri-Host is only added for registered names (not for IP literals), Uri-Port only for a port other than the
+/// default of the scheme. Components without percent-encoding and (for the host) upper case letters are referenced
+/// in place, so uri must stay valid until the packet is built. Only decoded components are written to the arena.
+/// @param pkt Packet to add the options to
+/// @param arena Arena for decoded components
+/// @param uri URI, for example coap://example.com/a/b?x=1
+/// @param len Length of uri
+/// @param[out] secure Set to true for coaps, may be NULL
+/// @return COAP_ERR_NONE on success, COAP_ERR_URI_INVALID if uri is malformed or has a fragment,
+/// COAP_ERR_BUFFER_TOO_SMALL if the packet has no room for the options or the arena is exhausted
+coap_error_t coap_uri_to_options(coap_packet_t *pkt, coap_arena_t *arena, const char *uri, size_t len, bool *secure);
+
+/// @brief Composes the canonical URI of a request from its options, for logging or as cache key, see
+/// http://tools.ietf.org/html/rfc7252#section-6.5
+/// Characters outside of the unreserved set and the sub-delimiters allowed in the component are percent-encoded with
+/// upper case hex digits, the default port is omitted.
+/// @param pkt Request
+/// @param default_host Host used if the request has no Uri-Host option (for example the destination IP address,
+/// IPv6 addresses with brackets). If NULL and no Uri-Host is present, only path and query are written.
+/// @param secure True for coaps
+/// @param[out] buf Buffer for the URI, zero terminated
+/// @param[in,out] buflen Size of buf, set to the length of the URI without terminator
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if buf is too small, COAP_ERR_URI_INVALID if the
+/// Uri-Port option is no port number
+coap_error_t coap_options_to_uri(const coap_packet_t *pkt, const char *default_host, bool secure, char *buf, size_t *buflen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
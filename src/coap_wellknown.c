@@ -0,0 +1,307 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "coap_wellknown.h"
+
+static uint32_t coap_wellknown_hash(const uint8_t *p, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    while (len--)
+    {
+        hash ^= *p++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static bool coap_wellknown_append(char *buf, size_t buflen, size_t *used, const char *str, size_t len)
+{
+    if (len > buflen - *used)
+        return false;
+    memcpy(buf + *used, str, len);
+    *used += len;
+    return true;
+}
+
+static bool coap_wellknown_append_attr(char *buf, size_t buflen, size_t *used, const char *name, const char *value)
+{
+    return coap_wellknown_append(buf, buflen, used, name, strlen(name))
+        && coap_wellknown_append(buf, buflen, used, value, strlen(value))
+        && coap_wellknown_append(buf, buflen, used, "\"", 1);
+}
+
+// Indexes the space separated values of an attribute written at doc + offset, the values of a link are
+// counted by num
+static bool coap_wellknown_index_values(coap_wellknown_link_t *link, const char *doc, size_t offset, size_t len, uint8_t *num)
+{
+    size_t end = offset + len, value_end;
+    while (offset < end)
+    {
+        coap_wellknown_value_t *value;
+        for (value_end = offset; value_end < end && doc[value_end] != ' '; value_end++)
+            ;
+        if (value_end > offset)
+        {
+            if (link->num_rt + link->num_if == COAP_WELLKNOWN_MAX_VALUES)
+                return false;
+            value = &link->values[link->num_rt + link->num_if];
+            value->hash = coap_wellknown_hash((const uint8_t *)doc + offset, value_end - offset);
+            value->offset = (uint32_t)offset;
+            value->len = (uint16_t)(value_end - offset);
+            (*num)++;
+        }
+        offset = value_end + 1;
+    }
+    return true;
+}
+
+coap_error_t coap_wellknown_init(coap_wellknown_t *wk, const coap_endpoint_t *endpoints, char *doc_buf, size_t doc_buf_len, coap_wellknown_link_t *links, size_t max_links)
+{
+    const coap_endpoint_t *ep;
+    size_t used = 0;
+    size_t num_links = 0;
+
+    for (ep = endpoints; NULL != ep->handler; ep++)
+    {
+        coap_wellknown_link_t link;
+        size_t start, href_start, href_len, i;
+        uint32_t hash;
+        bool duplicate = false;
+        int seg;
+
+        if (NULL == ep->path)
+            continue;
+        // separator is written speculatively, it is dropped again below if the resource is already listed
+        start = used;
+        if (num_links > 0 && !coap_wellknown_append(doc_buf, doc_buf_len, &used, ",", 1))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        if (!coap_wellknown_append(doc_buf, doc_buf_len, &used, "<", 1))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        href_start = used;
+        for (seg = 0; seg < ep->path->count; seg++)
+        {
+            if (!coap_wellknown_append(doc_buf, doc_buf_len, &used, "/", 1)
+                || !coap_wellknown_append(doc_buf, doc_buf_len, &used, ep->path->elems[seg], strlen(ep->path->elems[seg])))
+                return COAP_ERR_BUFFER_TOO_SMALL;
+        }
+
+        href_len = used - href_start;
+        hash = coap_wellknown_hash((const uint8_t *)doc_buf + href_start, href_len);
+        for (i = 0; i < num_links && !duplicate; i++)
+        {
+            duplicate = links[i].href_hash == hash && links[i].href_len == href_len
+                && 0 == memcmp(doc_buf + links[i].offset + 1, doc_buf + href_start, href_len);
+        }
+        if (duplicate)
+        {
+            used = start;
+            continue;
+        }
+
+        if (!coap_wellknown_append(doc_buf, doc_buf_len, &used, ">", 1))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        if (NULL != ep->core_attr && (!coap_wellknown_append(doc_buf, doc_buf_len, &used, ";", 1)
+            || !coap_wellknown_append(doc_buf, doc_buf_len, &used, ep->core_attr, strlen(ep->core_attr))))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        link.num_rt = 0;
+        link.num_if = 0;
+        if (NULL != ep->core_rt && (!coap_wellknown_append_attr(doc_buf, doc_buf_len, &used, ";rt=\"", ep->core_rt)
+            || !coap_wellknown_index_values(&link, doc_buf, used - 1 - strlen(ep->core_rt), strlen(ep->core_rt), &link.num_rt)))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        if (NULL != ep->core_if && (!coap_wellknown_append_attr(doc_buf, doc_buf_len, &used, ";if=\"", ep->core_if)
+            || !coap_wellknown_index_values(&link, doc_buf, used - 1 - strlen(ep->core_if), strlen(ep->core_if), &link.num_if)))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+
+        if (num_links == max_links)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        link.offset = (uint32_t)(href_start - 1);
+        link.len = (uint32_t)(used - href_start + 1);
+        link.href_hash = hash;
+        link.href_len = (uint16_t)href_len;
+        links[num_links++] = link;
+    }
+
+    wk->doc = doc_buf;
+    wk->doc_len = used;
+    wk->links = links;
+    wk->num_links = num_links;
+    return COAP_ERR_NONE;
+}
+
+bool coap_wellknown_is_request(const coap_packet_t *inpkt)
+{
+    uint8_t count;
+    const coap_option_t *path = coap_findOptions(inpkt, COAP_OPTION_URI_PATH, &count);
+    return inpkt->hdr.code == COAP_GET && count == 2
+        && coap_buffer_equals_string(&path[0].buf, ".well-known") && coap_buffer_equals_string(&path[1].buf, "core");
+}
+
+// Matches an attribute value against a filter, a trailing '*' in the filter matches any suffix
+static bool coap_wellknown_value_matches(const char *value, size_t len, const coap_buffer_t *filter)
+{
+    if (filter->len > 0 && filter->p[filter->len - 1] == '*')
+        return len >= filter->len - 1 && 0 == memcmp(value, filter->p, filter->len - 1);
+    return len == filter->len && 0 == memcmp(value, filter->p, len);
+}
+
+// rt and if may hold several space separated values, each of them is matched on its own. Exact filters compare
+// the hashes first.
+static bool coap_wellknown_values_match(const coap_wellknown_t *wk, const coap_wellknown_value_t *values, uint8_t num, const coap_buffer_t *filter, uint32_t hash)
+{
+    bool prefix = filter->len > 0 && filter->p[filter->len - 1] == '*';
+    uint8_t i;
+    for (i = 0; i < num; i++)
+    {
+        if ((prefix || values[i].hash == hash) && coap_wellknown_value_matches(wk->doc + values[i].offset, values[i].len, filter))
+            return true;
+    }
+    return false;
+}
+
+typedef enum
+{
+    COAP_WELLKNOWN_FILTER_NONE,
+    COAP_WELLKNOWN_FILTER_HREF,
+    COAP_WELLKNOWN_FILTER_RT,
+    COAP_WELLKNOWN_FILTER_IF
+} coap_wellknown_filter_t;
+
+static bool coap_wellknown_link_matches(const coap_wellknown_t *wk, const coap_wellknown_link_t *link, coap_wellknown_filter_t filter, const coap_buffer_t *value, uint32_t hash)
+{
+    switch (filter)
+    {
+    case COAP_WELLKNOWN_FILTER_HREF:
+        if (value->len > 0 && value->p[value->len - 1] == '*')
+            return coap_wellknown_value_matches(wk->doc + link->offset + 1, link->href_len, value);
+        return link->href_hash == hash && coap_wellknown_value_matches(wk->doc + link->offset + 1, link->href_len, value);
+    case COAP_WELLKNOWN_FILTER_RT:
+        return coap_wellknown_values_match(wk, link->values, link->num_rt, value, hash);
+    case COAP_WELLKNOWN_FILTER_IF:
+        return coap_wellknown_values_match(wk, link->values + link->num_rt, link->num_if, value, hash);
+    default:
+        return true;
+    }
+}
+
+coap_error_t coap_wellknown_respond(const coap_wellknown_t *wk, coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt)
+{
+    coap_wellknown_filter_t filter = COAP_WELLKNOWN_FILTER_NONE;
+    coap_buffer_t value = {NULL, 0};
+    uint32_t hash = 0;
+    uint8_t count;
+    const coap_option_t *opt;
+    coap_blocksize_t szx = COAP_WELLKNOWN_SZX;
+    uint32_t num = 0;
+    size_t block_size, total, start, len, matches = 0;
+    uint32_t *matched = NULL;
+    bool blockwise;
+
+    coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_LINKFORMAT);
+
+    if (NULL != (opt = coap_findOptions(inpkt, COAP_OPTION_URI_QUERY, &count)))
+    {
+        const uint8_t *eq = memchr(opt->buf.p, '=', opt->buf.len);
+        size_t name_len = (NULL != eq) ? (size_t)(eq - opt->buf.p) : opt->buf.len;
+        coap_buffer_t name = {opt->buf.p, name_len};
+        if (NULL != eq)
+        {
+            value.p = eq + 1;
+            value.len = opt->buf.len - name_len - 1;
+        }
+        if (coap_buffer_equals_string(&name, "href"))
+            filter = COAP_WELLKNOWN_FILTER_HREF;
+        else if (coap_buffer_equals_string(&name, "rt"))
+            filter = COAP_WELLKNOWN_FILTER_RT;
+        else if (coap_buffer_equals_string(&name, "if"))
+            filter = COAP_WELLKNOWN_FILTER_IF;
+        hash = coap_wellknown_hash(value.p, value.len);
+    }
+
+    if (NULL != (opt = coap_findOptions(inpkt, COAP_OPTION_BLOCK_2, &count)))
+    {
+        szx = coap_option_blockwise_get_szx(opt);
+        num = coap_option_blockwise_get_num(opt);
+        if (szx > COAP_BLOCKSIZE_1024)
+            szx = COAP_BLOCKSIZE_1024;
+    }
+    block_size = (size_t)16 << szx;
+
+    if (COAP_WELLKNOWN_FILTER_NONE == filter)
+    {
+        total = wk->doc_len;
+    }
+    else
+    {
+        // the matching links are recorded for assembling the slice below
+        size_t i;
+        if (NULL == (matched = coap_arena_alloc(arena, wk->num_links * sizeof(uint32_t), _Alignof(uint32_t))))
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        total = 0;
+        for (i = 0; i < wk->num_links; i++)
+        {
+            if (coap_wellknown_link_matches(wk, &wk->links[i], filter, &value, hash))
+            {
+                total += wk->links[i].len;
+                matched[matches++] = (uint32_t)i;
+            }
+        }
+        if (matches == 0)
+        {
+            coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, COAP_NOT_FOUND, COAP_CONTENTTYPE_NONE);
+            return COAP_ERR_NONE;
+        }
+        total += matches - 1;   // separating commas
+    }
+
+    blockwise = (NULL != opt) || total > block_size;
+    start = blockwise ? (size_t)num * block_size : 0;
+    if (blockwise && start >= total && !(start == 0 && total == 0))
+    {
+        coap_make_response(outpkt, NULL, 0, inpkt->hdr.id, &inpkt->tok, COAP_BAD_OPTION, COAP_CONTENTTYPE_NONE);
+        return COAP_ERR_NONE;
+    }
+    len = blockwise ? total - start : total;
+    if (len > block_size)
+        len = block_size;
+
+    if (blockwise)
+        coap_add_option_uint(outpkt, COAP_OPTION_BLOCK_2, (num << 4) | ((start + len < total) << 3) | szx);
+
+    if (COAP_WELLKNOWN_FILTER_NONE == filter)
+    {
+        outpkt->payload.p = (const uint8_t *)wk->doc + start;
+        outpkt->payload.len = len;
+    }
+    else
+    {
+        // assemble the requested slice of the filtered document, only the bytes of the block are copied
+        uint8_t *out = coap_payload_alloc(outpkt, arena, len);
+        size_t i, pos = 0, written = 0;
+        if (NULL == out)
+            return COAP_ERR_BUFFER_TOO_SMALL;
+        for (i = 0; i < matches && written < len; i++)
+        {
+            const coap_wellknown_link_t *link = &wk->links[matched[i]];
+            size_t from, to, link_start;
+            if (pos > 0)
+            {
+                if (pos >= start && written < len)
+                    out[written++] = ',';
+                pos++;
+            }
+            link_start = pos;
+            pos += link->len;
+            if (pos <= start)
+                continue;
+            from = (start > link_start) ? start - link_start : 0;
+            to = link->len;
+            if (to - from > len - written)
+                to = from + (len - written);
+            memcpy(out + written, wk->doc + link->offset + from, to - from);
+            written += to - from;
+        }
+    }
+    return COAP_ERR_NONE;
+}
@@ -0,0 +1,86 @@
+#ifndef COAP_WELLKNOWN_H
+#define COAP_WELLKNOWN_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "coap.h"
+
+// Block size /.well-known/core is served with if the client does not ask for one
+#ifndef COAP_WELLKNOWN_SZX
+#define COAP_WELLKNOWN_SZX COAP_BLOCKSIZE_1024
+#endif
+
+// rt and if values a link holds at most, together
+#ifndef COAP_WELLKNOWN_MAX_VALUES
+#define COAP_WELLKNOWN_MAX_VALUES 4
+#endif
+
+/// One of the space separated values of an rt or if attribute, for filtering
+typedef struct
+{
+    uint32_t hash;                  /* Hash of the value */
+    uint32_t offset;                /* Offset of the value in the document */
+    uint16_t len;                   /* Length of the value */
+} coap_wellknown_value_t;
+
+/// Index entry of one link of the generated document
+typedef struct
+{
+    uint32_t offset;                /* Offset of the link in the document */
+    uint32_t len;                   /* Length of the link, without separating comma */
+    uint32_t href_hash;             /* Hash of the href (without angle brackets), for href filtering */
+    uint16_t href_len;              /* Length of the href, it starts at offset + 1 */
+    uint8_t num_rt;                 /* rt values, they start at values[0] */
+    uint8_t num_if;                 /* if values, they start at values[num_rt] */
+    coap_wellknown_value_t values[COAP_WELLKNOWN_MAX_VALUES];
+} coap_wellknown_link_t;
+
+/// CoRE Link Format document (http://tools.ietf.org/html/rfc6690) of an endpoint table, generated once by
+/// coap_wellknown_init() and served by coap_wellknown_respond().
+typedef struct
+{
+    const char *doc;                /* Generated document */
+    size_t doc_len;                 /* Length of doc */
+    const coap_wellknown_link_t *links;
+    size_t num_links;
+} coap_wellknown_t;
+
+/// @brief Generates the link format document of an endpoint table. Endpoints sharing a path (for example GET and
+/// PUT of the same resource) result in one link, attributes are taken from the first of them. The values of the
+/// rt and if attributes are indexed for filtering.
+/// @param wk Document to initialize
+/// @param endpoints Endpoint table, terminated by an entry with handler set to NULL
+/// @param doc_buf Memory for the document, must stay valid as long as wk is used
+/// @param doc_buf_len Size of doc_buf
+/// @param links Memory for the link index, must stay valid as long as wk is used
+/// @param max_links Number of entries in links
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if doc_buf or links are too small or a resource has
+/// more than COAP_WELLKNOWN_MAX_VALUES rt and if values
+coap_error_t coap_wellknown_init(coap_wellknown_t *wk, const coap_endpoint_t *endpoints, char *doc_buf, size_t doc_buf_len, coap_wellknown_link_t *links, size_t max_links);
+
+/// @brief Checks whether a request targets /.well-known/core
+/// @return True for a GET with Uri-Path .well-known/core
+bool coap_wellknown_is_request(const coap_packet_t *inpkt);
+
+/// @brief Makes the response to a GET of /.well-known/core
+/// An href, rt or if query (http://tools.ietf.org/html/rfc6690#section-4.1, a trailing '*' matches a prefix) is
+/// evaluated against the link index. The response is sliced as requested by a Block2 option, or with
+/// COAP_WELLKNOWN_SZX if the document does not fit into one block. Unfiltered slices point into the document
+/// itself, filtered slices are assembled in the arena.
+/// @param wk Document
+/// @param arena Arena for filtered slices and the indices of the matching links
+/// @param inpkt Request
+/// @param outpkt Response to fill
+/// @return COAP_ERR_NONE on success, COAP_ERR_BUFFER_TOO_SMALL if the arena is exhausted
+coap_error_t coap_wellknown_respond(const coap_wellknown_t *wk, coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
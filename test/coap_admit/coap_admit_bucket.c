@@ -0,0 +1,231 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_admit.h"
+#include "coap_server.h"
+
+static const coap_admit_limit_t peer_limit = {10, 3};
+static const coap_admit_limit_t global_limit = {1000, 100};
+
+static coap_admit_peer_t peers[64];
+static coap_admit_t adm;
+static uint8_t inbuf[64];
+static size_t inlen;
+static uint8_t outbuf[COAP_ADMIT_REPLY_SIZE];
+static size_t outlen;
+
+static coap_addr_t peer_addr(uint8_t n)
+{
+    coap_addr_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.len = 4;
+    addr.addr[3] = n;
+    return addr;
+}
+
+static void build(coap_msgtype_t type, coap_code_t code)
+{
+    coap_packet_t pkt = {};
+    const uint8_t token[3] = {0xCA, 0xFE, 0x01};
+    coap_header_init(&pkt, type, code, 0x1234);
+    coap_header_add_token(&pkt, token, sizeof(token));
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "temp");
+    inlen = sizeof(inbuf);
+    coap_build(inbuf, &inlen, &pkt);
+}
+
+static coap_admit_verdict_t admit(uint8_t peer, uint32_t now)
+{
+    coap_addr_t addr = peer_addr(peer);
+    return coap_admit(&adm, &addr, inbuf, inlen, now, outbuf, &outlen);
+}
+
+void setUp(void)
+{
+    coap_admit_init(&adm, peers, 64, peer_limit, global_limit, 30, 0);
+    build(COAP_TYPE_CON, COAP_GET);
+}
+
+void tearDown(void) {}
+
+void excess_confirmable_request_gets_service_unavailable(void)
+{
+    coap_packet_t rsp = {};
+    uint32_t max_age;
+
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(1, 0));
+
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_ACK, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_SERVICE_UNAVAILABLE, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, rsp.hdr.id);
+    TEST_ASSERT_EQUAL_size_t(3, rsp.tok.len);
+    TEST_ASSERT_EQUAL_MEMORY(&inbuf[4], rsp.tok.p, 3);
+    TEST_ASSERT_TRUE(coap_option_get_uint(&rsp, COAP_OPTION_MAX_AGE, &max_age));
+    TEST_ASSERT_EQUAL_UINT32(30, max_age);
+    TEST_ASSERT_EQUAL_size_t(0, rsp.payload.len);
+
+    // other peers have their own bucket
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(2, 0));
+    TEST_ASSERT_EQUAL_UINT64(4, adm.accepted);
+    TEST_ASSERT_EQUAL_UINT64(1, adm.rejected);
+}
+
+void bucket_refills_at_rate(void)
+{
+    int i;
+    for (i = 0; i < 3; i++)
+        admit(1, 0);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(1, 99));
+    // 10 requests per second
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 100));
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(1, 100));
+    // never more than the burst
+    for (i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 60000));
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(1, 60000));
+}
+
+void excess_non_confirmable_request_is_dropped(void)
+{
+    int i;
+    build(COAP_TYPE_NONCON, COAP_POST);
+    for (i = 0; i < 3; i++)
+        admit(1, 0);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_DROP, admit(1, 0));
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    TEST_ASSERT_EQUAL_UINT64(1, adm.dropped);
+}
+
+void global_limit_applies_to_all_peers(void)
+{
+    const coap_admit_limit_t global = {1000, 5};
+    int i;
+    coap_admit_init(&adm, peers, 64, peer_limit, global, 30, 0);
+    for (i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit((uint8_t)i, 0));
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(5, 0));
+    // the global bucket refills faster, the rejection did not take a token of peer 5
+    for (i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(5, 10));
+}
+
+void responses_and_empty_messages_always_pass(void)
+{
+    int i;
+    for (i = 0; i < 3; i++)
+        admit(1, 0);
+    build(COAP_TYPE_ACK, COAP_CONTENT);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    build(COAP_TYPE_CON, COAP_EMPTY);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    build(COAP_TYPE_RESET, COAP_EMPTY);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+    // malformed headers are left to the parser
+    inlen = 3;
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 0));
+}
+
+void least_recently_seen_peer_is_replaced(void)
+{
+    coap_admit_peer_t small[4];
+    int i;
+    coap_admit_init(&adm, small, 4, peer_limit, global_limit, 30, 0);
+    for (i = 0; i < 3; i++)
+        admit(1, 0);
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_REJECT, admit(1, 0));
+    for (i = 2; i <= 5; i++)
+        admit((uint8_t)i, 1);
+    // peer 1 was replaced and starts with a full bucket again
+    TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, 2));
+}
+
+void oversized_address_is_not_metered(void)
+{
+    coap_addr_t addr;
+    int i;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.len = COAP_ADDR_SIZE + 1;
+    for (i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, coap_admit(&adm, &addr, inbuf, inlen, 0, outbuf, &outlen));
+    for (i = 0; i < 64; i++)
+        TEST_ASSERT_EQUAL_UINT8(0, peers[i].addr.len);
+}
+
+void large_burst_does_not_overflow(void)
+{
+    const coap_admit_limit_t huge = {1000, 4294968};   // burst * COAP_ADMIT_COST wraps to 704 in 32 bits
+    int i;
+
+    coap_admit_init(&adm, peers, 64, huge, huge, 30, 0);
+    for (i = 0; i < 100; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ADMIT_ACCEPT, admit(1, (uint32_t)i));
+}
+
+void server_rejects_before_parsing(void)
+{
+    static const coap_endpoint_t endpoints[] = {{(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}};
+    static uint8_t arena_memory[1024];
+    coap_server_t server;
+    coap_addr_t addr = peer_addr(1);
+    uint8_t buf[64];
+    size_t len;
+    int i;
+
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    server.admit = &adm;
+    for (i = 0; i < 3; i++)
+    {
+        len = sizeof(buf);
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle_from(&server, &addr, 0, inbuf, inlen, buf, &len));
+        TEST_ASSERT_EQUAL_HEX8(COAP_NOT_FOUND, buf[1]);
+    }
+    len = sizeof(buf);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle_from(&server, &addr, 0, inbuf, inlen, buf, &len));
+    TEST_ASSERT_EQUAL_HEX8(COAP_SERVICE_UNAVAILABLE, buf[1]);
+}
+
+void small_output_buffer_still_sheds_load(void)
+{
+    static const coap_endpoint_t endpoints[] = {{(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}};
+    static uint8_t arena_memory[1024];
+    coap_server_t server;
+    coap_addr_t addr = peer_addr(1);
+    uint8_t buf[COAP_ADMIT_REPLY_SIZE - 1];
+    size_t len;
+    int i;
+
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    server.admit = &adm;
+    for (i = 0; i < 3; i++)
+    {
+        len = sizeof(buf);
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle_from(&server, &addr, 0, inbuf, inlen, buf, &len));
+        TEST_ASSERT_EQUAL_HEX8(COAP_NOT_FOUND, buf[1]);
+    }
+    // the 5.03 does not fit, the request is dropped rather than processed
+    len = sizeof(buf);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle_from(&server, &addr, 0, inbuf, inlen, buf, &len));
+    TEST_ASSERT_EQUAL_size_t(0, len);
+    TEST_ASSERT_EQUAL_UINT64(1, adm.rejected);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(excess_confirmable_request_gets_service_unavailable);
+    RUN_TEST(bucket_refills_at_rate);
+    RUN_TEST(excess_non_confirmable_request_is_dropped);
+    RUN_TEST(global_limit_applies_to_all_peers);
+    RUN_TEST(responses_and_empty_messages_always_pass);
+    RUN_TEST(least_recently_seen_peer_is_replaced);
+    RUN_TEST(oversized_address_is_not_metered);
+    RUN_TEST(large_burst_does_not_overflow);
+    RUN_TEST(server_rejects_before_parsing);
+    RUN_TEST(small_output_buffer_still_sheds_load);
+    return UNITY_END();
+}
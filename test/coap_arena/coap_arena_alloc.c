@@ -0,0 +1,80 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_arena.h"
+
+static uint8_t memory[64];
+static uint8_t overflow_memory[32];
+static coap_arena_block_t overflow_block;
+static coap_arena_t arena;
+
+void setUp(void)
+{
+    coap_arena_init(&arena, memory, sizeof(memory));
+}
+
+void tearDown(void) {}
+
+void allocations_are_consecutive(void)
+{
+    uint8_t *a = coap_arena_alloc(&arena, 3, 1);
+    uint8_t *b = coap_arena_alloc(&arena, 5, 1);
+    TEST_ASSERT_EQUAL_PTR(memory, a);
+    TEST_ASSERT_EQUAL_PTR(memory + 3, b);
+}
+
+void allocations_are_aligned(void)
+{
+    coap_arena_alloc(&arena, 1, 1);
+    uint32_t *word = coap_arena_alloc(&arena, sizeof(uint32_t), 4);
+    TEST_ASSERT_NOT_NULL(word);
+    TEST_ASSERT_EQUAL_UINT32(0, (uintptr_t)word & 3);
+}
+
+void exhausted_arena_returns_null(void)
+{
+    TEST_ASSERT_NOT_NULL(coap_arena_alloc(&arena, 60, 1));
+    TEST_ASSERT_NULL(coap_arena_alloc(&arena, 5, 1));
+    TEST_ASSERT_NOT_NULL(coap_arena_alloc(&arena, 4, 1));
+}
+
+void overflow_block_is_used_when_first_block_is_exhausted(void)
+{
+    coap_arena_add_block(&arena, &overflow_block, overflow_memory, sizeof(overflow_memory));
+    TEST_ASSERT_NOT_NULL(coap_arena_alloc(&arena, 60, 1));
+    uint8_t *spilled = coap_arena_alloc(&arena, 16, 1);
+    TEST_ASSERT_EQUAL_PTR(overflow_memory, spilled);
+    TEST_ASSERT_NULL(coap_arena_alloc(&arena, 17, 1));
+}
+
+void release_restores_mark(void)
+{
+    coap_arena_add_block(&arena, &overflow_block, overflow_memory, sizeof(overflow_memory));
+    coap_arena_alloc(&arena, 10, 1);
+    coap_arena_mark_t mark = coap_arena_mark(&arena);
+    coap_arena_alloc(&arena, 60, 1);
+    coap_arena_release(&arena, mark);
+    TEST_ASSERT_EQUAL_PTR(memory + 10, coap_arena_alloc(&arena, 1, 1));
+
+    coap_arena_reset(&arena);
+    TEST_ASSERT_EQUAL_PTR(memory, coap_arena_alloc(&arena, 1, 1));
+}
+
+void dup_copies_bytes(void)
+{
+    const uint8_t src[4] = {1, 2, 3, 4};
+    uint8_t *copy = coap_arena_dup(&arena, src, sizeof(src));
+    TEST_ASSERT_EQUAL_PTR(memory, copy);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(src, copy, sizeof(src));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(allocations_are_consecutive);
+    RUN_TEST(allocations_are_aligned);
+    RUN_TEST(exhausted_arena_returns_null);
+    RUN_TEST(overflow_block_is_used_when_first_block_is_exhausted);
+    RUN_TEST(release_restores_mark);
+    RUN_TEST(dup_copies_bytes);
+    return UNITY_END();
+}
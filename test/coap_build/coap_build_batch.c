@@ -0,0 +1,79 @@
+#include "unity.h"
+#include "coap.h"
+#include <string.h>
+
+#define COUNT 5
+
+static coap_packet_t pkts[COUNT];
+static coap_batch_msg_t msgs[COUNT];
+static uint8_t arena[256];
+static uint8_t payload[100];
+static const uint8_t token[4] = {1, 2, 3, 4};
+
+void setUp(void)
+{
+    size_t i;
+
+    memset(arena, 0, sizeof(arena));
+    memset(payload, 'p', sizeof(payload));
+    for (i = 0; i < COUNT; i++)
+    {
+        memset(&pkts[i], 0, sizeof(pkts[i]));
+        coap_header_init(&pkts[i], COAP_TYPE_NONCON, COAP_CONTENT, (uint16_t)(0x100 + i));
+        coap_header_add_token(&pkts[i], token, sizeof(token));
+        coap_add_option_string(&pkts[i], COAP_OPTION_URI_PATH, "sensors");
+        pkts[i].payload.p = payload;
+        pkts[i].payload.len = 10 * i;
+    }
+}
+
+void tearDown(void) {}
+
+void messages_are_back_to_back_and_equal_single_builds(void)
+{
+    uint8_t single[128];
+    size_t i, len, offset = 0;
+
+    TEST_ASSERT_EQUAL_size_t(COUNT, coap_build_batch(arena, sizeof(arena), pkts, COUNT, msgs));
+    for (i = 0; i < COUNT; i++)
+    {
+        len = sizeof(single);
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(single, &len, &pkts[i]));
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, msgs[i].err);
+        TEST_ASSERT_EQUAL_size_t(offset, msgs[i].offset);
+        TEST_ASSERT_EQUAL_size_t(len, msgs[i].len);
+        TEST_ASSERT_EQUAL_MEMORY(single, arena + msgs[i].offset, len);
+        offset += len;
+    }
+}
+
+void failed_messages_take_no_space(void)
+{
+    // the token length does not match, then a payload larger than the rest of the arena
+    pkts[1].hdr.tkl = 2;
+    pkts[3].payload.len = sizeof(payload);
+
+    TEST_ASSERT_EQUAL_size_t(3, coap_build_batch(arena, 120, pkts, COUNT, msgs));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_TOKEN_LENGTH_MISMATCH, msgs[1].err);
+    TEST_ASSERT_EQUAL_size_t(0, msgs[1].len);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, msgs[3].err);
+    TEST_ASSERT_EQUAL_size_t(0, msgs[3].len);
+    TEST_ASSERT_EQUAL_size_t(msgs[0].len, msgs[2].offset);
+    TEST_ASSERT_EQUAL_size_t(msgs[2].offset + msgs[2].len, msgs[4].offset);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, msgs[4].err);
+    TEST_ASSERT_EQUAL_UINT16(0x104, (uint16_t)(arena[msgs[4].offset + 2] << 8 | arena[msgs[4].offset + 3]));
+}
+
+void empty_batch_builds_nothing(void)
+{
+    TEST_ASSERT_EQUAL_size_t(0, coap_build_batch(arena, sizeof(arena), pkts, 0, msgs));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(messages_are_back_to_back_and_equal_single_builds);
+    RUN_TEST(failed_messages_take_no_space);
+    RUN_TEST(empty_batch_builds_nothing);
+    return UNITY_END();
+}
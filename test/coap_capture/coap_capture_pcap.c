@@ -0,0 +1,158 @@
+#include <string.h>
+#include <pthread.h>
+#include "unity.h"
+#include "coap_capture.h"
+
+#define NUM_SLOTS 1024
+#define NUM_THREADS 4
+#define PER_THREAD 200
+
+static coap_capture_slot_t slots[NUM_SLOTS];
+static coap_capture_t cap;
+static uint8_t out[64 * 1024];
+static size_t out_len;
+static uint8_t get[32];
+static size_t get_len;
+static uint8_t put[32];
+static size_t put_len;
+
+static bool write_mem(void *ctx, const void *data, size_t len)
+{
+    (void)ctx;
+    if (len > sizeof(out) - out_len)
+        return false;
+    memcpy(out + out_len, data, len);
+    out_len += len;
+    return true;
+}
+
+static size_t build(uint8_t *buf, size_t size, coap_code_t code, bool observe)
+{
+    coap_packet_t pkt = {};
+    coap_header_init(&pkt, COAP_TYPE_CON, code, 0x1234);
+    if (observe)
+        coap_add_option(&pkt, COAP_OPTION_OBSERVE, NULL, 0);
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "temp");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(buf, &size, &pkt));
+    return size;
+}
+
+void setUp(void)
+{
+    coap_capture_init(&cap, slots, NUM_SLOTS);
+    out_len = 0;
+    get_len = build(get, sizeof(get), COAP_GET, true);
+    put_len = build(put, sizeof(put), COAP_PUT, false);
+}
+
+void tearDown(void) {}
+
+static uint32_t load32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+void records_are_written_with_udp_header(void)
+{
+    uint32_t sum = 0;
+    int i;
+    const uint8_t *rec, *ip;
+
+    TEST_ASSERT_TRUE(coap_capture_record(&cap, get, get_len, COAP_CAPTURE_IN, 1500000000123456789ULL));
+    TEST_ASSERT_TRUE(coap_capture_write_header(write_mem, NULL));
+    TEST_ASSERT_EQUAL_size_t(1, coap_capture_drain(&cap, write_mem, NULL));
+    TEST_ASSERT_EQUAL_size_t(24 + 16 + 28 + get_len, out_len);
+
+    TEST_ASSERT_EQUAL_HEX32(0xA1B23C4D, load32(out));
+    TEST_ASSERT_EQUAL_UINT32(228, load32(out + 20));
+    rec = out + 24;
+    TEST_ASSERT_EQUAL_UINT32(1500000000, load32(rec));
+    TEST_ASSERT_EQUAL_UINT32(123456789, load32(rec + 4));
+    TEST_ASSERT_EQUAL_UINT32(28 + get_len, load32(rec + 8));
+    TEST_ASSERT_EQUAL_UINT32(28 + get_len, load32(rec + 12));
+
+    ip = rec + 16;
+    TEST_ASSERT_EQUAL_HEX8(0x45, ip[0]);
+    TEST_ASSERT_EQUAL_UINT8(17, ip[9]);
+    TEST_ASSERT_EQUAL_UINT8(2, ip[15]);     // from the peer
+    TEST_ASSERT_EQUAL_UINT8(1, ip[19]);
+    for (i = 0; i < 20; i += 2)
+        sum += ((uint32_t)ip[i] << 8) | ip[i + 1];
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFF, sum);
+    TEST_ASSERT_EQUAL_HEX8(0x16, ip[22]);   // port 5683
+    TEST_ASSERT_EQUAL_HEX8(0x33, ip[23]);
+    TEST_ASSERT_EQUAL_MEMORY(get, ip + 28, get_len);
+
+    // nothing left
+    TEST_ASSERT_EQUAL_size_t(0, coap_capture_drain(&cap, write_mem, NULL));
+}
+
+void filter_by_code_and_option(void)
+{
+    coap_capture_filter(&cap, 1, COAP_PUT, 0);
+    TEST_ASSERT_FALSE(coap_capture_record(&cap, get, get_len, COAP_CAPTURE_IN, 0));
+    TEST_ASSERT_TRUE(coap_capture_record(&cap, put, put_len, COAP_CAPTURE_IN, 0));
+
+    coap_capture_filter(&cap, 1, -1, COAP_OPTION_OBSERVE);
+    TEST_ASSERT_TRUE(coap_capture_record(&cap, get, get_len, COAP_CAPTURE_OUT, 0));
+    TEST_ASSERT_FALSE(coap_capture_record(&cap, put, put_len, COAP_CAPTURE_OUT, 0));
+    TEST_ASSERT_EQUAL_size_t(2, coap_capture_drain(&cap, write_mem, NULL));
+}
+
+void sampling_keeps_every_nth(void)
+{
+    int i;
+    coap_capture_filter(&cap, 10, -1, 0);
+    for (i = 0; i < 100; i++)
+        coap_capture_record(&cap, get, get_len, COAP_CAPTURE_IN, 0);
+    TEST_ASSERT_EQUAL_size_t(10, coap_capture_drain(&cap, write_mem, NULL));
+}
+
+void full_ring_drops_and_counts(void)
+{
+    int i;
+    for (i = 0; i < NUM_SLOTS; i++)
+        TEST_ASSERT_TRUE(coap_capture_record(&cap, get, get_len, COAP_CAPTURE_IN, 0));
+    TEST_ASSERT_FALSE(coap_capture_record(&cap, get, get_len, COAP_CAPTURE_IN, 0));
+    TEST_ASSERT_EQUAL_UINT64(1, cap.dropped);
+    TEST_ASSERT_EQUAL_size_t(NUM_SLOTS, coap_capture_drain(&cap, write_mem, NULL));
+}
+
+static void *producer(void *arg)
+{
+    int i;
+    for (i = 0; i < PER_THREAD; i++)
+        coap_capture_record(&cap, (i & 1) ? get : put, (i & 1) ? get_len : put_len, COAP_CAPTURE_IN, (uint64_t)(size_t)arg);
+    return NULL;
+}
+
+void concurrent_producers_lose_nothing(void)
+{
+    pthread_t threads[NUM_THREADS];
+    size_t i, drained = 0;
+
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    // drain while producing
+    for (i = 0; i < 1000 && drained < NUM_THREADS * PER_THREAD; i++)
+        drained += coap_capture_drain(&cap, write_mem, NULL);
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    drained += coap_capture_drain(&cap, write_mem, NULL);
+    TEST_ASSERT_EQUAL_size_t(NUM_THREADS * PER_THREAD, drained);
+    TEST_ASSERT_EQUAL_UINT64(0, cap.dropped);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(records_are_written_with_udp_header);
+    RUN_TEST(filter_by_code_and_option);
+    RUN_TEST(sampling_keeps_every_nth);
+    RUN_TEST(full_ring_drops_and_counts);
+    RUN_TEST(concurrent_producers_lose_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,221 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_cbor.h"
+
+#define RECORDS 8
+
+static uint8_t buf[512];
+static coap_cbor_writer_t writer;
+static coap_cbor_reader_t reader;
+static coap_cbor_item_t item;
+
+void setUp(void)
+{
+    memset(buf, 0, sizeof(buf));
+    coap_cbor_writer_init(&writer, buf, sizeof(buf));
+}
+
+void tearDown(void) {}
+
+static void read_from(const uint8_t *data, size_t len)
+{
+    coap_buffer_t view = {data, len};
+    coap_cbor_reader_init(&reader, &view);
+}
+
+//http://tools.ietf.org/html/rfc8949#appendix-A
+void integers_from_rfc_examples_are_decoded(void)
+{
+    const uint8_t data[] = {0x17, 0x19, 0x03, 0xE8, 0x39, 0x03, 0xE7, 0x1B, 0x00, 0x00, 0x00, 0xE8, 0xD4, 0xA5, 0x10, 0x00};
+    int64_t value;
+    read_from(data, sizeof(data));
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(coap_cbor_get_int(&item, &value));
+    TEST_ASSERT_EQUAL_INT64(23, value);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(coap_cbor_get_int(&item, &value));
+    TEST_ASSERT_EQUAL_INT64(1000, value);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(coap_cbor_get_int(&item, &value));
+    TEST_ASSERT_EQUAL_INT64(-1000, value);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_EQUAL_UINT64(1000000000000ULL, item.val);
+    TEST_ASSERT_TRUE(coap_cbor_at_end(&reader));
+}
+
+void floats_from_rfc_examples_are_decoded(void)
+{
+    const uint8_t data[] = {0xF9, 0x3C, 0x00, 0xF9, 0xC4, 0x00, 0xFA, 0x47, 0xC3, 0x50, 0x00,
+                            0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A};
+    read_from(data, sizeof(data));
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(item.type == COAP_CBOR_FLOAT && item.f == 1.0);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(item.f == -4.0);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(item.f == 100000.0);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_TRUE(item.f == 1.1);
+}
+
+void strings_are_views_into_the_buffer(void)
+{
+    const uint8_t data[] = {0x64, 'I', 'E', 'T', 'F', 0x44, 0x01, 0x02, 0x03, 0x04};
+    read_from(data, sizeof(data));
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_EQUAL_INT(COAP_CBOR_TEXT, item.type);
+    TEST_ASSERT_EQUAL_PTR(data + 1, item.str.p);
+    TEST_ASSERT_EQUAL_size_t(4, item.str.len);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_EQUAL_INT(COAP_CBOR_BYTES, item.type);
+    TEST_ASSERT_EQUAL_PTR(data + 6, item.str.p);
+}
+
+void truncated_data_is_rejected(void)
+{
+    const uint8_t data[] = {0x65, 'I', 'E', 'T', 'F'};
+    read_from(data, sizeof(data));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_CBOR_INVALID, coap_cbor_read(&reader, &item));
+
+    read_from(data, 0);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_CBOR_INVALID, coap_cbor_read(&reader, &item));
+
+    const uint8_t huge_array[] = {0x9A, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    read_from(huge_array, sizeof(huge_array));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_CBOR_INVALID, coap_cbor_read(&reader, &item));
+}
+
+void skip_steps_over_nested_indefinite_items(void)
+{
+    // [_ 1, [2, 3], [_ 4, 5]], 6
+    const uint8_t data[] = {0x9F, 0x01, 0x82, 0x02, 0x03, 0x9F, 0x04, 0x05, 0xFF, 0xFF, 0x06};
+    read_from(data, sizeof(data));
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_skip(&reader));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_EQUAL_UINT64(6, item.val);
+    TEST_ASSERT_TRUE(coap_cbor_at_end(&reader));
+}
+
+void writer_produces_shortest_encoding(void)
+{
+    const uint8_t expected[] = {0x17, 0x18, 0x18, 0x39, 0x03, 0xE7, 0xFA, 0x47, 0xC3, 0x50, 0x00, 0xF5, 0xF6};
+    coap_cbor_write_uint(&writer, 23);
+    coap_cbor_write_uint(&writer, 24);
+    coap_cbor_write_int(&writer, -1000);
+    coap_cbor_write_double(&writer, 100000.0);
+    coap_cbor_write_bool(&writer, true);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_write_null(&writer));
+    TEST_ASSERT_EQUAL_size_t(sizeof(expected), writer.used);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, sizeof(expected));
+}
+
+void writer_errors_are_sticky(void)
+{
+    coap_cbor_writer_init(&writer, buf, 3);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_cbor_write_text(&writer, "IETF", 4));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_cbor_write_uint(&writer, 1));
+}
+
+void senml_pack_is_decoded_without_copies(void)
+{
+    static const char *names[RECORDS] = {"voltage", "current", "power", "energy", "temp", "humidity", "pressure", "co2"};
+    size_t i, fields = 0, strings = 0;
+
+    // 8 records with 5 fields each
+    coap_cbor_write_array(&writer, RECORDS);
+    for (i = 0; i < RECORDS; i++)
+    {
+        coap_cbor_write_map(&writer, 5);
+        coap_cbor_write_int(&writer, COAP_SENML_BASE_NAME);
+        coap_cbor_write_text(&writer, "urn:dev:ow:10e2073a01080063:", 28);
+        coap_cbor_write_int(&writer, COAP_SENML_NAME);
+        coap_cbor_write_text(&writer, names[i], strlen(names[i]));
+        coap_cbor_write_int(&writer, COAP_SENML_UNIT);
+        coap_cbor_write_text(&writer, "V", 1);
+        coap_cbor_write_int(&writer, COAP_SENML_VALUE);
+        coap_cbor_write_double(&writer, 120.1 + (double)i);
+        coap_cbor_write_int(&writer, COAP_SENML_TIME);
+        coap_cbor_write_int(&writer, -5 * (int64_t)i);
+    }
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, writer.err);
+
+    read_from(buf, writer.used);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+    TEST_ASSERT_EQUAL_INT(COAP_CBOR_ARRAY, item.type);
+    TEST_ASSERT_EQUAL_UINT64(RECORDS, item.val);
+    for (i = 0; i < RECORDS; i++)
+    {
+        uint64_t pair, pairs;
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+        TEST_ASSERT_EQUAL_INT(COAP_CBOR_MAP, item.type);
+        pairs = item.val;
+        for (pair = 0; pair < pairs; pair++)
+        {
+            int64_t label;
+            double value;
+            TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+            TEST_ASSERT_TRUE(coap_cbor_get_int(&item, &label));
+            TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_read(&reader, &item));
+            if (label == COAP_SENML_NAME)
+                TEST_ASSERT_TRUE(item.str.len == strlen(names[i]) && 0 == memcmp(item.str.p, names[i], item.str.len));
+            if (label == COAP_SENML_VALUE)
+            {
+                TEST_ASSERT_TRUE(coap_cbor_get_double(&item, &value));
+                TEST_ASSERT_TRUE(value == 120.1 + (double)i);
+            }
+            if (item.type == COAP_CBOR_TEXT)
+            {
+                // views point into the payload itself
+                TEST_ASSERT_TRUE(item.str.p > buf && item.str.p + item.str.len <= buf + writer.used);
+                strings++;
+            }
+            fields++;
+        }
+    }
+    TEST_ASSERT_TRUE(coap_cbor_at_end(&reader));
+    TEST_ASSERT_EQUAL_size_t(RECORDS * 5, fields);
+    TEST_ASSERT_EQUAL_size_t(RECORDS * 3, strings);
+}
+
+void payload_is_serialized_into_build_output(void)
+{
+    coap_packet_t pkt = {};
+    coap_packet_t parsed = {};
+    size_t msglen = 0;
+
+    coap_make_response(&pkt, NULL, 0, 7, NULL, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_SENML_CBOR);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_build_begin(&writer, buf, sizeof(buf), &pkt));
+    coap_cbor_write_array(&writer, 1);
+    coap_cbor_write_uint(&writer, 42);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_build_end(&writer, &msglen));
+
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&parsed, buf, msglen));
+    TEST_ASSERT_EQUAL_size_t(3, parsed.payload.len);
+    read_from(parsed.payload.p, parsed.payload.len);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_skip(&reader));
+    TEST_ASSERT_TRUE(coap_cbor_at_end(&reader));
+
+    // no payload, no payload marker
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_build_begin(&writer, buf, sizeof(buf), &pkt));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_cbor_build_end(&writer, &msglen));
+    TEST_ASSERT_EQUAL_size_t(6, msglen);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(integers_from_rfc_examples_are_decoded);
+    RUN_TEST(floats_from_rfc_examples_are_decoded);
+    RUN_TEST(strings_are_views_into_the_buffer);
+    RUN_TEST(truncated_data_is_rejected);
+    RUN_TEST(skip_steps_over_nested_indefinite_items);
+    RUN_TEST(writer_produces_shortest_encoding);
+    RUN_TEST(writer_errors_are_sticky);
+    RUN_TEST(senml_pack_is_decoded_without_copies);
+    RUN_TEST(payload_is_serialized_into_build_output);
+    return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_cc.h"
+
+static coap_peer_t peers[2];
+static coap_cc_t cc;
+
+void setUp(void)
+{
+    coap_cc_init(&cc, peers, 2, COAP_NSTART);
+}
+
+void tearDown(void) {}
+
+static coap_addr_t make_addr(uint8_t last)
+{
+    coap_addr_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.len = 4;
+    addr.addr[0] = 192;
+    addr.addr[1] = 0;
+    addr.addr[2] = 2;
+    addr.addr[3] = last;
+    return addr;
+}
+
+void new_peer_starts_with_ack_timeout(void)
+{
+    coap_addr_t addr = make_addr(1);
+    coap_peer_t *peer = coap_cc_peer(&cc, &addr, 0);
+    TEST_ASSERT_NOT_NULL(peer);
+    TEST_ASSERT_EQUAL_UINT32(COAP_ACK_TIMEOUT_MS, coap_cc_initial_timeout(peer, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(COAP_ACK_TIMEOUT_MS * 3 / 2 - 1, coap_cc_initial_timeout(peer, 0, 1023));
+    TEST_ASSERT_EQUAL_PTR(peer, coap_cc_peer(&cc, &addr, 0));
+}
+
+void strong_and_weak_samples_update_rto(void)
+{
+    coap_addr_t addr = make_addr(1);
+    coap_peer_t *peer = coap_cc_peer(&cc, &addr, 0);
+    bool send_now;
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, NULL, &send_now));
+    // RTO_strong = 100 + 4 * 50, overall = (300 + 2000) / 2
+    coap_cc_complete(peer, 100, 0, 10);
+    TEST_ASSERT_EQUAL_UINT32(1150, peer->rto);
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, NULL, &send_now));
+    // RTO_weak = 400 + 200, overall = (600 + 3 * 1150) / 4
+    coap_cc_complete(peer, 400, 1, 20);
+    TEST_ASSERT_EQUAL_UINT32(1012, peer->rto);
+
+    // three retransmissions are ignored
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, NULL, &send_now));
+    coap_cc_complete(peer, 9000, 3, 30);
+    TEST_ASSERT_EQUAL_UINT32(1012, peer->rto);
+}
+
+void fast_link_gets_short_timeouts_and_large_backoff(void)
+{
+    coap_addr_t addr = make_addr(1);
+    coap_peer_t *peer = coap_cc_peer(&cc, &addr, 0);
+    uint32_t now, timeout;
+    bool send_now;
+
+    for (now = 0; now < 20; now++)
+    {
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, NULL, &send_now));
+        coap_cc_complete(peer, 20, 0, now);
+    }
+    timeout = coap_cc_initial_timeout(peer, now, 0);
+    TEST_ASSERT_TRUE(timeout < 200);
+    TEST_ASSERT_EQUAL_UINT32(3 * timeout, coap_cc_backoff(timeout, timeout));
+    TEST_ASSERT_EQUAL_UINT32(2 * 2000, coap_cc_backoff(2000, 2000));
+    TEST_ASSERT_EQUAL_UINT32(6000, coap_cc_backoff(4000, 4000));
+    TEST_ASSERT_EQUAL_UINT32(COAP_CC_MAX_RTO_MS, coap_cc_backoff(2000, 40000));
+
+    // aging doubles a small RTO that was not updated for 16 times its value
+    TEST_ASSERT_EQUAL_UINT32(2 * timeout, coap_cc_initial_timeout(peer, now + 16 * timeout + 1, 0));
+}
+
+void requests_over_nstart_are_queued(void)
+{
+    coap_addr_t addr = make_addr(1);
+    coap_peer_t *peer = coap_cc_peer(&cc, &addr, 0);
+    int requests[COAP_CC_QUEUE_SIZE + 2];
+    bool send_now;
+    int i;
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, &requests[0], &send_now));
+    TEST_ASSERT_TRUE(send_now);
+    for (i = 1; i <= COAP_CC_QUEUE_SIZE; i++)
+    {
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, peer, &requests[i], &send_now));
+        TEST_ASSERT_FALSE(send_now);
+    }
+    TEST_ASSERT_EQUAL(COAP_ERR_BUFFER_TOO_SMALL, coap_cc_start(&cc, peer, &requests[i], &send_now));
+
+    TEST_ASSERT_EQUAL_PTR(&requests[1], coap_cc_complete(peer, 50, 0, 0));
+    TEST_ASSERT_EQUAL_PTR(&requests[2], coap_cc_fail(peer));
+    for (i = 3; i <= COAP_CC_QUEUE_SIZE; i++)
+        TEST_ASSERT_EQUAL_PTR(&requests[i], coap_cc_complete(peer, 50, 0, 0));
+    TEST_ASSERT_NULL(coap_cc_complete(peer, 50, 0, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, peer->outstanding);
+}
+
+void idle_peers_are_evicted_in_lru_order(void)
+{
+    coap_addr_t a = make_addr(1), b = make_addr(2), c = make_addr(3), d = make_addr(4);
+    coap_peer_t *pa = coap_cc_peer(&cc, &a, 0);
+    coap_peer_t *pb = coap_cc_peer(&cc, &b, 0);
+    coap_peer_t *pc;
+    bool send_now;
+
+    // a is used again, so b is the least recently used one
+    TEST_ASSERT_EQUAL_PTR(pa, coap_cc_peer(&cc, &a, 0));
+    pc = coap_cc_peer(&cc, &c, 0);
+    TEST_ASSERT_EQUAL_PTR(pb, pc);
+    TEST_ASSERT_EQUAL_PTR(pa, coap_cc_peer(&cc, &a, 0));
+    TEST_ASSERT_EQUAL_PTR(pc, coap_cc_peer(&cc, &c, 0));
+
+    // busy peers are never evicted
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, pa, NULL, &send_now));
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_cc_start(&cc, pc, NULL, &send_now));
+    TEST_ASSERT_NULL(coap_cc_peer(&cc, &d, 0));
+    coap_cc_fail(pa);
+    TEST_ASSERT_EQUAL_PTR(pa, coap_cc_peer(&cc, &d, 0));
+    TEST_ASSERT_EQUAL_UINT32(COAP_ACK_TIMEOUT_MS, pa->rto);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(new_peer_starts_with_ack_timeout);
+    RUN_TEST(strong_and_weak_samples_update_rto);
+    RUN_TEST(fast_link_gets_short_timeouts_and_large_backoff);
+    RUN_TEST(requests_over_nstart_are_queued);
+    RUN_TEST(idle_peers_are_evicted_in_lru_order);
+    return UNITY_END();
+}
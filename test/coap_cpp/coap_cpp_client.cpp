@@ -0,0 +1,265 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include "unity.h"
+#include "coap_client.hpp"
+
+static std::vector<std::vector<uint8_t>> sent;
+static std::vector<coap::outcome> outcomes;
+static std::string payloads;
+
+static void record(void *, coap::bytes datagram)
+{
+    sent.emplace_back(datagram.begin(), datagram.end());
+}
+
+static coap::task fetch(coap::client &c, const char *uri, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        coap::reply rsp = co_await c.get(uri);
+        outcomes.push_back(rsp.result);
+        if (rsp)
+            payloads += std::string(rsp.view().payload().begin(), rsp.view().payload().end());
+        else if (coap::outcome::invalid == rsp.result)
+            payloads += std::to_string(rsp.err);
+    }
+}
+
+// answers the last sent request
+static std::vector<uint8_t> answer(coap_msgtype_t type, uint16_t id, coap_code_t code, const char *payload)
+{
+    coap::packet req, rsp;
+    uint8_t buf[64];
+    req.parse(sent.back());
+    coap::message(rsp, type, code, id, req.view().token()).payload(std::string_view(payload));
+    auto built = rsp.build(buf);
+    return std::vector<uint8_t>(built->begin(), built->end());
+}
+
+static uint16_t last_id()
+{
+    return static_cast<uint16_t>((sent.back()[2] << 8) | sent.back()[3]);
+}
+
+void setUp(void)
+{
+    sent.clear();
+    outcomes.clear();
+    payloads.clear();
+}
+
+void tearDown(void) {}
+
+void piggybacked_response_resumes_coroutine(void)
+{
+    coap::client c(record, nullptr, {});
+    coap::packet req;
+
+    fetch(c, "coap://example.com/temp", 1);
+    TEST_ASSERT_EQUAL_size_t(1, sent.size());
+    TEST_ASSERT_EQUAL_size_t(1, c.in_flight());
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, req.parse(sent[0]));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_CON, req.view().type());
+    TEST_ASSERT_EQUAL_UINT8(COAP_GET, req.view().code());
+    TEST_ASSERT_EQUAL_size_t(4, req.view().token().size());
+    TEST_ASSERT_TRUE(req.view().string_option(COAP_OPTION_URI_HOST) == "example.com");
+    TEST_ASSERT_TRUE(req.view().string_option(COAP_OPTION_URI_PATH) == "temp");
+
+    c.receive(answer(COAP_TYPE_ACK, last_id(), COAP_CONTENT, "21.5"));
+    TEST_ASSERT_EQUAL_size_t(1, outcomes.size());
+    TEST_ASSERT_TRUE(coap::outcome::ok == outcomes[0]);
+    TEST_ASSERT_EQUAL_STRING("21.5", payloads.c_str());
+    TEST_ASSERT_EQUAL_size_t(0, c.in_flight());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, c.next_timeout());
+}
+
+void unanswered_request_is_retransmitted_then_times_out(void)
+{
+    coap::client c(record, nullptr, {});
+    uint32_t now = 0;
+
+    fetch(c, "coap://example.com/temp", 1);
+    while (outcomes.empty())
+    {
+        now += c.next_timeout();
+        c.tick(now);
+    }
+    TEST_ASSERT_TRUE(coap::outcome::timeout == outcomes[0]);
+    TEST_ASSERT_EQUAL_size_t(1 + COAP_MAX_RETRANSMIT, sent.size());
+    for (const auto &datagram : sent)
+        TEST_ASSERT_TRUE(datagram == sent[0]);
+    // 31 initial timeouts, which are dithered to [2 s, 3 s]
+    TEST_ASSERT_TRUE(now >= 31 * COAP_ACK_TIMEOUT_MS && now <= 93000);
+}
+
+void separate_response_is_acknowledged(void)
+{
+    coap::client c(record, nullptr, {});
+    uint16_t id;
+    uint8_t ack[4];
+
+    fetch(c, "coap://example.com/slow", 1);
+    id = last_id();
+    ack[0] = 0x60;
+    ack[1] = COAP_EMPTY;
+    ack[2] = static_cast<uint8_t>(id >> 8);
+    ack[3] = static_cast<uint8_t>(id);
+    c.receive(coap::bytes(ack));
+    TEST_ASSERT_TRUE(outcomes.empty());
+    // no retransmission after the empty ACK
+    TEST_ASSERT_EQUAL_UINT32(93000, c.next_timeout());
+
+    c.receive(answer(COAP_TYPE_CON, 0x7777, COAP_CONTENT, "late"));
+    TEST_ASSERT_EQUAL_size_t(2, sent.size());
+    TEST_ASSERT_EQUAL_size_t(4, sent[1].size());
+    TEST_ASSERT_EQUAL_HEX8(0x60, sent[1][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x77, sent[1][2]);
+    TEST_ASSERT_EQUAL_STRING("late", payloads.c_str());
+}
+
+void reset_ends_request_and_late_response_is_acknowledged(void)
+{
+    coap::client c(record, nullptr, {});
+    uint16_t id;
+
+    fetch(c, "coap://example.com/temp", 1);
+    std::vector<uint8_t> stale = answer(COAP_TYPE_CON, 0x4242, COAP_CONTENT, "x");
+    id = last_id();
+    uint8_t rst[4] = {0x70, COAP_EMPTY, static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)};
+    c.receive(coap::bytes(rst));
+    TEST_ASSERT_TRUE(coap::outcome::reset == outcomes[0]);
+
+    // the token belongs to the finished request, the response is acknowledged but not delivered
+    c.receive(stale);
+    TEST_ASSERT_EQUAL_size_t(1, outcomes.size());
+    TEST_ASSERT_EQUAL_HEX8(0x60, sent.back()[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x42, sent.back()[3]);
+}
+
+void retransmitted_response_is_acknowledged_again(void)
+{
+    coap::client c(record, nullptr, {});
+
+    fetch(c, "coap://example.com/slow", 1);
+    std::vector<uint8_t> rsp = answer(COAP_TYPE_CON, 0x5151, COAP_CONTENT, "late");
+    c.receive(rsp);
+    c.receive(rsp);
+    TEST_ASSERT_EQUAL_size_t(1, outcomes.size());
+    TEST_ASSERT_EQUAL_size_t(3, sent.size());
+    TEST_ASSERT_TRUE(sent[1] == sent[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x60, sent[2][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x51, sent[2][3]);
+}
+
+void request_and_malformed_message_are_rejected(void)
+{
+    coap::client c(record, nullptr, {});
+    uint8_t request[4] = {0x40, COAP_GET, 0x12, 0x34};
+    uint8_t malformed[4] = {0x49, COAP_CONTENT, 0x56, 0x78};   // token length 9 is reserved
+
+    c.receive(coap::bytes(request));
+    TEST_ASSERT_EQUAL_size_t(1, sent.size());
+    TEST_ASSERT_EQUAL_HEX8(0x70, sent[0][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, sent[0][3]);
+    c.receive(coap::bytes(malformed));
+    TEST_ASSERT_EQUAL_size_t(2, sent.size());
+    TEST_ASSERT_EQUAL_HEX8(0x70, sent[1][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x78, sent[1][3]);
+}
+
+void capacity_is_clamped_to_token_index(void)
+{
+    coap::client::config cfg;
+    cfg.type = COAP_TYPE_NONCON;
+    cfg.capacity = (1U << 20) + 1;
+    coap::client c(record, nullptr, cfg);
+    TEST_ASSERT_EQUAL_UINT32(1U << 20, c.capacity());
+}
+
+void confirmable_capacity_is_clamped_to_message_ids(void)
+{
+    coap::client::config cfg;
+    cfg.capacity = 0x10001;
+    coap::client c(record, nullptr, cfg);
+    TEST_ASSERT_EQUAL_UINT32(0x10000, c.capacity());
+}
+
+void wrapped_message_id_skips_request_in_flight(void)
+{
+    coap::client::config cfg;
+    cfg.capacity = 2;
+    cfg.first_id = 0xFFFF;
+    coap::client c(record, nullptr, cfg);
+
+    fetch(c, "coap://example.com/slow", 1);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, last_id());
+    // IDs 0 to 0xFFFE are used once each, the next request would get 0xFFFF again
+    fetch(c, "coap://example.com/fast", 0x10000);
+    for (uint32_t i = 0; i < 0xFFFF; i++)
+        c.receive(answer(COAP_TYPE_ACK, last_id(), COAP_CONTENT, ""));
+    TEST_ASSERT_EQUAL_HEX16(0x0000, last_id());
+    TEST_ASSERT_EQUAL_size_t(2, c.in_flight());
+
+    // the RST of the first request still ends it
+    uint8_t rst[4] = {0x70, COAP_EMPTY, 0xFF, 0xFF};
+    c.receive(coap::bytes(rst));
+    TEST_ASSERT_TRUE(coap::outcome::reset == outcomes.back());
+    TEST_ASSERT_EQUAL_size_t(1, c.in_flight());
+}
+
+void invalid_uri_completes_without_suspending(void)
+{
+    coap::client c(record, nullptr, {});
+    fetch(c, "http://example.com/temp", 1);
+    TEST_ASSERT_TRUE(coap::outcome::invalid == outcomes[0]);
+    TEST_ASSERT_EQUAL_STRING(std::to_string(COAP_ERR_URI_INVALID).c_str(), payloads.c_str());
+    TEST_ASSERT_EQUAL_size_t(0, sent.size());
+    TEST_ASSERT_EQUAL_size_t(0, c.in_flight());
+}
+
+void coroutine_issues_requests_one_after_another(void)
+{
+    coap::client::config cfg;
+    cfg.type = COAP_TYPE_NONCON;
+    cfg.capacity = 1;
+    coap::client c(record, nullptr, cfg);
+    std::vector<uint8_t> first_token;
+
+    fetch(c, "coap://example.com/n", 3);
+    fetch(c, "coap://example.com/n", 1);
+    TEST_ASSERT_TRUE(coap::outcome::busy == outcomes[0]);
+
+    for (int i = 0; i < 3; i++)
+    {
+        coap::packet req;
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, req.parse(sent.back()));
+        TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_NONCON, req.view().type());
+        std::vector<uint8_t> token(req.view().token().begin(), req.view().token().end());
+        if (0 == i)
+            first_token = token;
+        else
+            TEST_ASSERT_FALSE(token == first_token);
+        c.receive(answer(COAP_TYPE_NONCON, static_cast<uint16_t>(0x100 + i), COAP_CONTENT, "."));
+    }
+    TEST_ASSERT_EQUAL_size_t(4, outcomes.size());
+    TEST_ASSERT_EQUAL_STRING("...", payloads.c_str());
+    TEST_ASSERT_EQUAL_size_t(3, sent.size());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(piggybacked_response_resumes_coroutine);
+    RUN_TEST(unanswered_request_is_retransmitted_then_times_out);
+    RUN_TEST(separate_response_is_acknowledged);
+    RUN_TEST(reset_ends_request_and_late_response_is_acknowledged);
+    RUN_TEST(retransmitted_response_is_acknowledged_again);
+    RUN_TEST(request_and_malformed_message_are_rejected);
+    RUN_TEST(capacity_is_clamped_to_token_index);
+    RUN_TEST(confirmable_capacity_is_clamped_to_message_ids);
+    RUN_TEST(wrapped_message_id_skips_request_in_flight);
+    RUN_TEST(invalid_uri_completes_without_suspending);
+    RUN_TEST(coroutine_issues_requests_one_after_another);
+    return UNITY_END();
+}
@@ -0,0 +1,86 @@
+#include <cstring>
+#include "unity.h"
+#include "coap.hpp"
+#include "coap_routes.hpp"
+
+static int last_handler;
+
+template <int Id>
+static int handler(coap_arena_t *, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t, uint8_t)
+{
+    last_handler = Id;
+    return coap_make_response(outpkt, nullptr, 0, inpkt->hdr.id, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_NONE);
+}
+
+using routes = coap::router<
+    coap::route<"sensors/temp", COAP_GET, handler<1>>,
+    coap::route<"/sensors/temp", COAP_PUT, handler<2>>,
+    coap::route<"sensors", COAP_GET, handler<3>>,
+    coap::route<"", COAP_GET, handler<4>>,
+    coap::route<"a//b", COAP_GET, handler<5>>,
+    coap::route<"fw/image/current", COAP_POST, handler<6>>>;
+
+// the table is sorted at compile time
+static_assert(routes::size == 6);
+static_assert(routes::table[0].key <= routes::table[1].key && routes::table[4].key <= routes::table[5].key);
+
+void setUp(void)
+{
+    last_handler = 0;
+}
+
+void tearDown(void) {}
+
+static int dispatch(coap_code_t method, std::initializer_list<const char *> path)
+{
+    coap::packet req, rsp;
+    coap::message(req, COAP_TYPE_CON, method, 0x4242);
+    for (const char *seg : path)
+        coap_add_option_string(req.c(), COAP_OPTION_URI_PATH, seg);
+    routes::dispatch(nullptr, req.c(), rsp.c());
+    return rsp.view().code();
+}
+
+void routes_are_found_by_method_and_path(void)
+{
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_GET, {"sensors", "temp"}));
+    TEST_ASSERT_EQUAL_INT(1, last_handler);
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_PUT, {"sensors", "temp"}));
+    TEST_ASSERT_EQUAL_INT(2, last_handler);
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_GET, {"sensors"}));
+    TEST_ASSERT_EQUAL_INT(3, last_handler);
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_GET, {}));
+    TEST_ASSERT_EQUAL_INT(4, last_handler);
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_GET, {"a", "", "b"}));
+    TEST_ASSERT_EQUAL_INT(5, last_handler);
+    TEST_ASSERT_EQUAL(COAP_CONTENT, dispatch(COAP_POST, {"fw", "image", "current"}));
+    TEST_ASSERT_EQUAL_INT(6, last_handler);
+}
+
+void unknown_requests_get_not_found(void)
+{
+    TEST_ASSERT_EQUAL(COAP_NOT_FOUND, dispatch(COAP_DELETE, {"sensors", "temp"}));
+    TEST_ASSERT_EQUAL(COAP_NOT_FOUND, dispatch(COAP_GET, {"sensors", "tem"}));
+    TEST_ASSERT_EQUAL(COAP_NOT_FOUND, dispatch(COAP_GET, {"sensors/temp"}));
+    TEST_ASSERT_EQUAL(COAP_NOT_FOUND, dispatch(COAP_GET, {"sensors", "temp", ""}));
+    TEST_ASSERT_EQUAL(COAP_NOT_FOUND, dispatch(COAP_GET, {"a", "b"}));
+    TEST_ASSERT_EQUAL_INT(0, last_handler);
+}
+
+void find_returns_the_handler(void)
+{
+    coap::packet req;
+    coap::message(req, COAP_TYPE_NONCON, COAP_GET, 1).string<COAP_OPTION_URI_PATH>("sensors");
+    TEST_ASSERT_TRUE(routes::find(req.c()) == &handler<3>);
+    req.c()->hdr.code = COAP_PUT;
+    TEST_ASSERT_TRUE(routes::find(req.c()) == nullptr);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(routes_are_found_by_method_and_path);
+    RUN_TEST(unknown_requests_get_not_found);
+    RUN_TEST(find_returns_the_handler);
+    return UNITY_END();
+}
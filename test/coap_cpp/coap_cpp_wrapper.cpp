@@ -0,0 +1,146 @@
+#include <cstring>
+#include <string>
+#include "unity.h"
+#include "coap.hpp"
+
+static const uint8_t token[] = {0xCA, 0xFE};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// the encodings are constant expressions
+static_assert(coap::encode_uint(0).len == 0);
+static_assert(coap::encode_uint(60).len == 1 && coap::encode_uint(60).value[0] == 60);
+static_assert(coap::encode_uint(0x10000).len == 3);
+static_assert(coap::encode_block(COAP_BLOCKSIZE_1024, true, 2).value[0] == 0x2E);
+
+static size_t build_with_c(uint8_t *buf, size_t len)
+{
+    coap_packet_t pkt = {};
+    uint8_t block[3];
+    coap_header_init(&pkt, COAP_TYPE_ACK, COAP_CONTENT, 0x1234);
+    coap_header_add_token(&pkt, token, sizeof(token));
+    coap_add_option_uint(&pkt, COAP_OPTION_OBSERVE, 7);
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "sensors");
+    coap_add_option_uint(&pkt, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_CBOR);
+    coap_add_option(&pkt, COAP_OPTION_BLOCK_2, block, coap_make_option_blockwise(block, COAP_BLOCKSIZE_64, true, 1));
+    pkt.payload.p = (const uint8_t *)"hello";
+    pkt.payload.len = 5;
+    coap_build(buf, &len, &pkt);
+    return len;
+}
+
+void builder_matches_c_api(void)
+{
+    uint8_t expected[64], out[64];
+    size_t expected_len = build_with_c(expected, sizeof(expected));
+    coap::packet pkt;
+
+    coap_error_t err = coap::message(pkt, COAP_TYPE_ACK, COAP_CONTENT, 0x1234, token)
+        .uint<COAP_OPTION_OBSERVE>(7)
+        .string<COAP_OPTION_URI_PATH>("sensors")
+        .uint<COAP_OPTION_CONTENT_FORMAT, COAP_CONTENTTYPE_APPLICATION_CBOR>()
+        .block<COAP_OPTION_BLOCK_2, COAP_BLOCKSIZE_64, true, 1>()
+        .payload(std::string_view("hello"))
+        .done();
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, err);
+
+    auto built = pkt.build(out);
+    TEST_ASSERT_TRUE(built.has_value());
+    TEST_ASSERT_EQUAL_size_t(expected_len, built->size());
+    TEST_ASSERT_EQUAL_MEMORY(expected, built->data(), expected_len);
+}
+
+void views_and_range_for(void)
+{
+    uint8_t buf[64];
+    size_t len = build_with_c(buf, sizeof(buf));
+    coap::packet pkt;
+    std::string numbers;
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, pkt.parse(coap::bytes(buf, len)));
+    coap::packet_view v = pkt;
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, v.code());
+    TEST_ASSERT_EQUAL_UINT16(0x1234, v.id());
+    TEST_ASSERT_EQUAL_size_t(2, v.token().size());
+    TEST_ASSERT_TRUE(coap::string_view(v.c().payload) == "hello");
+    TEST_ASSERT_TRUE(v.string_option(COAP_OPTION_URI_PATH) == "sensors");
+    TEST_ASSERT_EQUAL_UINT32(60, v.uint_option(COAP_OPTION_CONTENT_FORMAT).value());
+    TEST_ASSERT_FALSE(v.find(COAP_OPTION_ETAG).has_value());
+
+    for (coap::option opt : v.options())
+        numbers += std::to_string(opt.number()) + ",";
+    TEST_ASSERT_EQUAL_STRING("6,11,12,23,", numbers.c_str());
+    TEST_ASSERT_EQUAL_size_t(1, v.options(COAP_OPTION_URI_PATH).size());
+}
+
+void response_takes_id_and_token(void)
+{
+    uint8_t buf[64];
+    size_t len = build_with_c(buf, sizeof(buf));
+    coap::packet req, rsp;
+    uint8_t out[64];
+
+    buf[0] = (buf[0] & 0xCF) | (COAP_TYPE_CON << 4);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, req.parse(coap::bytes(buf, len)));
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap::response(rsp, req, COAP_NOT_FOUND, 0xBEEF).done());
+    auto built = rsp.build(out);
+    TEST_ASSERT_TRUE(built.has_value());
+    TEST_ASSERT_EQUAL_size_t(4 + 2, built->size());
+    TEST_ASSERT_EQUAL_HEX8(0x62, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, out[2]);
+    TEST_ASSERT_EQUAL_MEMORY(token, out + 4, 2);
+}
+
+void non_response_takes_new_id(void)
+{
+    uint8_t buf[64];
+    size_t len = build_with_c(buf, sizeof(buf));
+    coap::packet req, rsp;
+    uint8_t out[64];
+
+    buf[0] = (buf[0] & 0xCF) | (COAP_TYPE_NONCON << 4);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, req.parse(coap::bytes(buf, len)));
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap::response(rsp, req, COAP_CONTENT, 0xBEEF).done());
+    auto built = rsp.build(out);
+    TEST_ASSERT_TRUE(built.has_value());
+    TEST_ASSERT_EQUAL_HEX8(0x52, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBE, out[2]);
+    TEST_ASSERT_EQUAL_HEX8(0xEF, out[3]);
+    TEST_ASSERT_EQUAL_MEMORY(token, out + 4, 2);
+}
+
+void too_many_options_are_reported(void)
+{
+    coap::packet pkt;
+    auto b = coap::message(pkt, COAP_TYPE_CON, COAP_GET, 1).empty<COAP_OPTION_URI_PATH>();
+    for (int i = 0; i < MAXOPT; i++)
+        b = b.string<COAP_OPTION_URI_PATH>("a");
+    TEST_ASSERT_EQUAL(COAP_ERR_BUFFER_TOO_SMALL, b.done());
+}
+
+void arena_scope_releases(void)
+{
+    uint8_t mem[64];
+    coap_arena_t arena;
+    coap_arena_init(&arena, mem, sizeof(mem));
+    {
+        coap::arena_scope scope(arena);
+        coap_arena_alloc(&arena, 32, 1);
+        TEST_ASSERT_EQUAL_size_t(32, arena.used);
+    }
+    TEST_ASSERT_EQUAL_size_t(0, arena.used);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(builder_matches_c_api);
+    RUN_TEST(views_and_range_for);
+    RUN_TEST(response_takes_id_and_token);
+    RUN_TEST(non_response_takes_new_id);
+    RUN_TEST(too_many_options_are_reported);
+    RUN_TEST(arena_scope_releases);
+    return UNITY_END();
+}
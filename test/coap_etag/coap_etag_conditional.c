@@ -0,0 +1,184 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_etag.h"
+#include "coap_server.h"
+
+static char config[32] = "{\"interval\":10}";
+static int handler_calls;
+
+static const coap_endpoint_path_t path_config = {1, {"config"}};
+static const coap_endpoint_path_t path_log = {1, {"log"}};
+static coap_etag_resource_t resources[] = {{&path_config, 0}, {&path_log, 0}};
+static coap_etag_store_t store = {resources, 2};
+
+static int handle_get_config(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    (void)arena;
+    handler_calls++;
+    return coap_make_response(outpkt, (const uint8_t *)config, strlen(config), ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_JSON);
+}
+
+static int handle_put_config(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    (void)arena;
+    handler_calls++;
+    memcpy(config, inpkt->payload.p, inpkt->payload.len);
+    config[inpkt->payload.len] = '\0';
+    coap_etag_set(&resources[0], config, strlen(config));
+    return coap_make_response(outpkt, NULL, 0, ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CHANGED, COAP_CONTENTTYPE_NONE);
+}
+
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get_config, &path_config, NULL, NULL, NULL},
+    {COAP_PUT, handle_put_config, &path_config, NULL, NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static uint8_t arena_memory[2048];
+static coap_server_t server;
+static coap_packet_t req;
+static coap_packet_t rsp;
+static uint8_t outbuf[128];
+static uint8_t etag_value[COAP_ETAG_SIZE];
+
+static void start(coap_code_t method, const char *path)
+{
+    static const uint8_t token[1] = {0x77};
+    memset(&req, 0, sizeof(req));
+    coap_header_init(&req, COAP_TYPE_CON, method, 0x1001);
+    coap_header_add_token(&req, token, sizeof(token));
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, path);
+}
+
+static coap_code_t send_request(void)
+{
+    static uint8_t inbuf[128];
+    size_t inlen = sizeof(inbuf), outlen = sizeof(outbuf);
+    coap_build(inbuf, &inlen, &req);
+    if (COAP_ERR_NONE != coap_server_handle(&server, inbuf, inlen, outbuf, &outlen) || 0 != coap_parse(&rsp, outbuf, outlen))
+        return COAP_UNDEFINED_CODE;
+    return (coap_code_t)rsp.hdr.code;
+}
+
+void setUp(void)
+{
+    strcpy(config, "{\"interval\":10}");
+    coap_etag_set(&resources[0], config, strlen(config));
+    resources[1].etag = 0;
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    server.etags = &store;
+    handler_calls = 0;
+    coap_etag_encode(resources[0].etag, etag_value);
+}
+
+void tearDown(void) {}
+
+void hash_is_chainable_and_never_zero(void)
+{
+    const uint8_t data[13] = "hello, world";
+    uint64_t whole = coap_etag_hash(0, data, sizeof(data));
+    TEST_ASSERT_TRUE(0 != whole);
+    TEST_ASSERT_TRUE(whole == coap_etag_hash(0, data, sizeof(data)));
+    TEST_ASSERT_TRUE(whole != coap_etag_hash(0, data, sizeof(data) - 1));
+    TEST_ASSERT_TRUE(0 != coap_etag_hash(0, NULL, 0));
+    // an incremental write changes the ETag without hashing earlier data again
+    TEST_ASSERT_TRUE(whole != coap_etag_hash(whole, data, 1));
+    TEST_ASSERT_TRUE(coap_etag_hash(coap_etag_hash(0, data, 5), data + 5, 8) == coap_etag_hash(coap_etag_hash(0, data, 5), data + 5, 8));
+}
+
+void get_response_carries_current_etag(void)
+{
+    const coap_option_t *etag;
+    uint8_t count;
+
+    start(COAP_GET, "config");
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, send_request());
+    etag = coap_findOptions(&rsp, COAP_OPTION_ETAG, &count);
+    TEST_ASSERT_NOT_NULL(etag);
+    TEST_ASSERT_EQUAL_MEMORY(etag_value, etag->buf.p, COAP_ETAG_SIZE);
+    TEST_ASSERT_EQUAL_INT(1, handler_calls);
+}
+
+void current_etag_gets_valid_without_handler(void)
+{
+    const coap_option_t *etag;
+    uint8_t stale[COAP_ETAG_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8}, count;
+
+    start(COAP_GET, "config");
+    coap_add_option(&req, COAP_OPTION_ETAG, stale, sizeof(stale));
+    coap_add_option(&req, COAP_OPTION_ETAG, etag_value, sizeof(etag_value));
+    TEST_ASSERT_EQUAL_UINT8(COAP_VALID, send_request());
+    TEST_ASSERT_EQUAL_INT(0, handler_calls);
+    TEST_ASSERT_EQUAL_size_t(0, rsp.payload.len);
+    etag = coap_findOptions(&rsp, COAP_OPTION_ETAG, &count);
+    TEST_ASSERT_EQUAL_MEMORY(etag_value, etag->buf.p, COAP_ETAG_SIZE);
+
+    // after a write the cached representation is stale
+    coap_etag_write(&resources[0], "x", 1);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, send_request());
+    TEST_ASSERT_EQUAL_INT(1, handler_calls);
+}
+
+void if_match_guards_updates(void)
+{
+    uint8_t other[COAP_ETAG_SIZE] = {0};
+
+    start(COAP_PUT, "config");
+    coap_add_option(&req, COAP_OPTION_IF_MATCH, other, sizeof(other));
+    req.payload.p = (const uint8_t *)"{}";
+    req.payload.len = 2;
+    TEST_ASSERT_EQUAL_UINT8(COAP_PRECONDITION_FAILED, send_request());
+    TEST_ASSERT_EQUAL_INT(0, handler_calls);
+    TEST_ASSERT_EQUAL_size_t(0, rsp.payload.len);
+
+    // one matching ETag is enough
+    coap_add_option(&req, COAP_OPTION_IF_MATCH, etag_value, sizeof(etag_value));
+    TEST_ASSERT_EQUAL_UINT8(COAP_CHANGED, send_request());
+    TEST_ASSERT_EQUAL_STRING("{}", config);
+    // the handler updated the ETag, the same request fails now
+    TEST_ASSERT_EQUAL_UINT8(COAP_PRECONDITION_FAILED, send_request());
+    TEST_ASSERT_EQUAL_INT(1, handler_calls);
+}
+
+void empty_if_match_and_if_none_match_test_existence(void)
+{
+    // log has no representation yet
+    start(COAP_PUT, "log");
+    coap_add_option(&req, COAP_OPTION_IF_MATCH, NULL, 0);
+    TEST_ASSERT_EQUAL_UINT8(COAP_PRECONDITION_FAILED, send_request());
+
+    start(COAP_PUT, "config");
+    coap_add_option(&req, COAP_OPTION_IF_NONE_MATCH, NULL, 0);
+    TEST_ASSERT_EQUAL_UINT8(COAP_PRECONDITION_FAILED, send_request());
+    TEST_ASSERT_EQUAL_INT(0, handler_calls);
+
+    start(COAP_PUT, "config");
+    coap_add_option(&req, COAP_OPTION_IF_MATCH, NULL, 0);
+    req.payload.p = (const uint8_t *)"{}";
+    req.payload.len = 2;
+    TEST_ASSERT_EQUAL_UINT8(COAP_CHANGED, send_request());
+    TEST_ASSERT_EQUAL_INT(1, handler_calls);
+}
+
+void unknown_resources_go_to_the_handler(void)
+{
+    coap_etag_resource_t *resource;
+    start(COAP_GET, "other");
+    coap_add_option(&req, COAP_OPTION_IF_MATCH, etag_value, sizeof(etag_value));
+    TEST_ASSERT_EQUAL_UINT8(COAP_EMPTY, coap_etag_evaluate(&store, &req, &resource));
+    TEST_ASSERT_NULL(resource);
+    TEST_ASSERT_EQUAL_UINT8(COAP_NOT_FOUND, send_request());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(hash_is_chainable_and_never_zero);
+    RUN_TEST(get_response_carries_current_etag);
+    RUN_TEST(current_etag_gets_valid_without_handler);
+    RUN_TEST(if_match_guards_updates);
+    RUN_TEST(empty_if_match_and_if_none_match_test_existence);
+    RUN_TEST(unknown_resources_go_to_the_handler);
+    return UNITY_END();
+}
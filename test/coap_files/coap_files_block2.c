@@ -0,0 +1,294 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "unity.h"
+#include "coap_files.h"
+#include "coap_etag.h"
+
+#define FIRMWARE_SIZE 3000
+
+static coap_file_t storage[2 * 4];
+static coap_files_t files;
+static char config_path[] = "/tmp/coap_files_configXXXXXX";
+static char firmware_path[] = "/tmp/coap_files_firmwareXXXXXX";
+static coap_file_source_t sources[2];
+
+static uint8_t head[COAP_FILES_HEAD_SIZE];
+static size_t headlen;
+static coap_buffer_t payload;
+static coap_file_set_t *pin;
+static coap_packet_t rsp;
+
+static void write_file(char *path, char fill, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    size_t i;
+    for (i = 0; i < len; i++)
+        fputc(fill + (char)(i % 7), f);
+    fclose(f);
+}
+
+// replaced by rename, like a deployment would do, a mapped file must not be truncated
+static void replace_file(char *path, char fill, size_t len)
+{
+    char next[] = "/tmp/coap_files_nextXXXXXX";
+    close(mkstemp(next));
+    write_file(next, fill, len);
+    rename(next, path);
+}
+
+static void request(coap_code_t method, const char *segment1, const char *segment2, int szx, uint32_t num, const uint8_t *etag)
+{
+    coap_packet_t req = {};
+    const uint8_t token[2] = {0xAB, 0xCD};
+    static uint8_t block_option[3];
+    static uint8_t datagram[1200];
+    size_t len;
+
+    coap_header_init(&req, COAP_TYPE_CON, method, 0x4242);
+    coap_header_add_token(&req, token, sizeof(token));
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, segment1);
+    if (NULL != segment2)
+        coap_add_option_string(&req, COAP_OPTION_URI_PATH, segment2);
+    if (szx >= 0)
+        coap_add_option(&req, COAP_OPTION_BLOCK_2, block_option, coap_make_option_blockwise(block_option, (coap_blocksize_t)szx, false, num));
+    if (NULL != etag)
+        coap_add_option(&req, COAP_OPTION_ETAG, (uint8_t *)etag, COAP_ETAG_SIZE);
+
+    headlen = sizeof(head);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_files_respond(&files, &req, head, &headlen, &payload, &pin));
+    if (NULL == pin)
+        return;
+    // what a sendmsg() with both parts puts on the wire
+    memcpy(datagram, head, headlen);
+    memcpy(datagram + headlen, payload.p, payload.len);
+    len = headlen + payload.len;
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, datagram, len));
+}
+
+void setUp(void)
+{
+    int fd;
+    fd = mkstemp(config_path);
+    close(fd);
+    fd = mkstemp(firmware_path);
+    close(fd);
+    write_file(config_path, 'a', 100);
+    write_file(firmware_path, 'A', FIRMWARE_SIZE);
+    sources[0] = (coap_file_source_t){"config", config_path, COAP_CONTENTTYPE_APPLICATION_JSON};
+    sources[1] = (coap_file_source_t){"fw/image.bin", firmware_path, COAP_CONTENTTYPE_APPLICATION_OCTECT_STREAM};
+    coap_files_init(&files, storage, 4);
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_OK, coap_files_reload(&files, sources, 2));
+}
+
+void tearDown(void)
+{
+    coap_files_destroy(&files);
+    unlink(config_path);
+    unlink(firmware_path);
+    strcpy(config_path + strlen(config_path) - 6, "XXXXXX");
+    strcpy(firmware_path + strlen(firmware_path) - 6, "XXXXXX");
+}
+
+void small_file_is_sent_whole_from_the_mapping(void)
+{
+    uint32_t value;
+    uint8_t count;
+
+    request(COAP_GET, "config", NULL, -1, 0, NULL);
+    TEST_ASSERT_NOT_NULL(pin);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_ACK, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT16(0x4242, rsp.hdr.id);
+    TEST_ASSERT_EQUAL_size_t(2, rsp.tok.len);
+    TEST_ASSERT_EQUAL_size_t(100, payload.len);
+    // zero-copy: the payload is the mapping itself
+    TEST_ASSERT_TRUE(payload.p == files.sets[files.current].files[0].data);
+    TEST_ASSERT_EQUAL_MEMORY("abcdefga", payload.p, 8);
+    TEST_ASSERT_TRUE(coap_option_get_uint(&rsp, COAP_OPTION_CONTENT_FORMAT, &value));
+    TEST_ASSERT_EQUAL_UINT32(COAP_CONTENTTYPE_APPLICATION_JSON, value);
+    TEST_ASSERT_NULL(coap_findOptions(&rsp, COAP_OPTION_BLOCK_2, &count));
+    TEST_ASSERT_NOT_NULL(coap_findOptions(&rsp, COAP_OPTION_ETAG, &count));
+    coap_files_release(pin);
+}
+
+void large_file_is_split_into_blocks(void)
+{
+    const coap_option_t *block;
+    const uint8_t *mapping;
+    uint32_t size2;
+    uint8_t count;
+
+    // no Block2 in the request, the server splits at COAP_FILES_BLOCK_SIZE
+    request(COAP_GET, "fw", "image.bin", -1, 0, NULL);
+    mapping = files.sets[files.current].files[1].data;
+    TEST_ASSERT_EQUAL_size_t(1024, payload.len);
+    TEST_ASSERT_TRUE(payload.p == mapping);
+    block = coap_findOptions(&rsp, COAP_OPTION_BLOCK_2, &count);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_TRUE(coap_option_blockwise_get_m(block));
+    TEST_ASSERT_TRUE(coap_option_get_uint(&rsp, COAP_OPTION_SIZE2, &size2));
+    TEST_ASSERT_EQUAL_UINT32(FIRMWARE_SIZE, size2);
+    coap_files_release(pin);
+
+    // the client asks for smaller blocks
+    request(COAP_GET, "fw", "image.bin", COAP_BLOCKSIZE_512, 5, NULL);
+    block = coap_findOptions(&rsp, COAP_OPTION_BLOCK_2, &count);
+    TEST_ASSERT_EQUAL_UINT32(5, coap_option_blockwise_get_num(block));
+    TEST_ASSERT_EQUAL_UINT8(COAP_BLOCKSIZE_512, coap_option_blockwise_get_szx(block));
+    TEST_ASSERT_FALSE(coap_option_blockwise_get_m(block));
+    TEST_ASSERT_EQUAL_size_t(FIRMWARE_SIZE - 5 * 512, payload.len);
+    TEST_ASSERT_TRUE(payload.p == mapping + 5 * 512);
+    TEST_ASSERT_FALSE(coap_option_get_uint(&rsp, COAP_OPTION_SIZE2, &size2));
+    coap_files_release(pin);
+
+    request(COAP_GET, "fw", "image.bin", COAP_BLOCKSIZE_512, 6, NULL);
+    TEST_ASSERT_EQUAL_UINT8(COAP_BAD_OPTION, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_size_t(0, payload.len);
+    coap_files_release(pin);
+}
+
+void current_etag_is_validated(void)
+{
+    const coap_option_t *etag;
+    uint8_t value[COAP_ETAG_SIZE], count;
+
+    request(COAP_GET, "config", NULL, -1, 0, NULL);
+    etag = coap_findOptions(&rsp, COAP_OPTION_ETAG, &count);
+    TEST_ASSERT_EQUAL_size_t(COAP_ETAG_SIZE, etag->buf.len);
+    memcpy(value, etag->buf.p, sizeof(value));
+    coap_files_release(pin);
+
+    request(COAP_GET, "config", NULL, -1, 0, value);
+    TEST_ASSERT_EQUAL_UINT8(COAP_VALID, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_size_t(0, payload.len);
+    TEST_ASSERT_EQUAL_size_t(headlen, 4 + 2 + 1 + COAP_ETAG_SIZE);
+    coap_files_release(pin);
+
+    value[0] ^= 1;
+    request(COAP_GET, "config", NULL, -1, 0, value);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    coap_files_release(pin);
+}
+
+void other_paths_and_methods(void)
+{
+    request(COAP_GET, "fw", NULL, -1, 0, NULL);
+    TEST_ASSERT_NULL(pin);
+    request(COAP_GET, "config", "x", -1, 0, NULL);
+    TEST_ASSERT_NULL(pin);
+    request(COAP_PUT, "config", NULL, -1, 0, NULL);
+    TEST_ASSERT_NOT_NULL(pin);
+    TEST_ASSERT_EQUAL_UINT8(COAP_METHOD_NOT_ALLOWED, rsp.hdr.code);
+    coap_files_release(pin);
+}
+
+void reload_keeps_pinned_generation_mapped(void)
+{
+    const coap_option_t *etag;
+    uint8_t old_etag[COAP_ETAG_SIZE], count;
+    coap_file_set_t *old_pin;
+    coap_buffer_t old_payload;
+
+    request(COAP_GET, "config", NULL, -1, 0, NULL);
+    old_pin = pin;
+    old_payload = payload;
+    etag = coap_findOptions(&rsp, COAP_OPTION_ETAG, &count);
+    memcpy(old_etag, etag->buf.p, sizeof(old_etag));
+
+    replace_file(config_path, 'k', 50);
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_OK, coap_files_reload(&files, sources, 2));
+
+    // the response in flight still reads the old content
+    TEST_ASSERT_EQUAL_MEMORY("abcdefga", old_payload.p, 8);
+    request(COAP_GET, "config", NULL, -1, 0, old_etag);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_size_t(50, payload.len);
+    TEST_ASSERT_EQUAL_MEMORY("klmnopqk", payload.p, 8);
+    coap_files_release(pin);
+
+    // the old generation cannot be reused before the response was sent
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_BUSY, coap_files_reload(&files, sources, 2));
+    coap_files_release(old_pin);
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_OK, coap_files_reload(&files, sources, 2));
+}
+
+void failed_reload_keeps_current_generation(void)
+{
+    coap_file_source_t broken[2] = {sources[0], {"missing", "/nonexistent/file", COAP_CONTENTTYPE_NONE}};
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_IO, coap_files_reload(&files, broken, 2));
+    TEST_ASSERT_EQUAL_INT(COAP_FILES_TOO_MANY, coap_files_reload(&files, sources, 5));
+    request(COAP_GET, "fw", "image.bin", -1, 0, NULL);
+    TEST_ASSERT_NOT_NULL(pin);
+    coap_files_release(pin);
+}
+
+static atomic_bool stop;
+
+static void *serve_concurrently(void *arg)
+{
+    coap_packet_t req = {};
+    uint8_t thread_head[COAP_FILES_HEAD_SIZE];
+    coap_buffer_t thread_payload;
+    coap_file_set_t *thread_pin;
+    size_t len, i;
+    long *errors = arg;
+
+    coap_header_init(&req, COAP_TYPE_NONCON, COAP_GET, 1);
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, "config");
+    while (!atomic_load(&stop))
+    {
+        len = sizeof(thread_head);
+        if (COAP_ERR_NONE != coap_files_respond(&files, &req, thread_head, &len, &thread_payload, &thread_pin) || NULL == thread_pin)
+        {
+            (*errors)++;
+            continue;
+        }
+        // every response comes from one consistent mapping
+        for (i = 0; i < thread_payload.len; i++)
+            if (thread_payload.p[i] != thread_payload.p[0] + (uint8_t)(i % 7))
+                (*errors)++;
+        coap_files_release(thread_pin);
+    }
+    return NULL;
+}
+
+void reload_while_serving(void)
+{
+    pthread_t threads[2];
+    long errors[2] = {0, 0};
+    int i, reloads = 0;
+
+    atomic_store(&stop, false);
+    for (i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, serve_concurrently, &errors[i]);
+    for (i = 0; i < 200; i++)
+    {
+        replace_file(config_path, (i & 1) ? 'a' : 'k', 100);
+        reloads += (COAP_FILES_OK == coap_files_reload(&files, sources, 2));
+        nanosleep(&(struct timespec){0, 100000}, NULL);
+    }
+    atomic_store(&stop, true);
+    for (i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_INT(0, errors[0] + errors[1]);
+    TEST_ASSERT_TRUE(reloads > 0);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(small_file_is_sent_whole_from_the_mapping);
+    RUN_TEST(large_file_is_split_into_blocks);
+    RUN_TEST(current_etag_is_validated);
+    RUN_TEST(other_paths_and_methods);
+    RUN_TEST(reload_keeps_pinned_generation_mapped);
+    RUN_TEST(failed_reload_keeps_current_generation);
+    RUN_TEST(reload_while_serving);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+#include "unity.h"
+#include "coap_format.h"
+#include <string.h>
+
+static const uint8_t token[2] = {0x12, 0xAB};
+static coap_format_config_t json = {COAP_FORMAT_JSON, COAP_FORMAT_VALUES_AUTO, 32, 64};
+static coap_format_config_t logfmt = {COAP_FORMAT_LOGFMT, COAP_FORMAT_VALUES_AUTO, 32, 64};
+static coap_packet_t pkt;
+static char out[512];
+static size_t len;
+
+static void make_request(void)
+{
+    uint8_t block[1];
+
+    memset(&pkt, 0, sizeof(pkt));
+    coap_header_init(&pkt, COAP_TYPE_CON, COAP_GET, 4660);
+    coap_header_add_token(&pkt, token, sizeof(token));
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "sensors");
+    coap_add_option_uint(&pkt, COAP_OPTION_ACCEPT, COAP_CONTENTTYPE_APPLICATION_JSON);
+    coap_make_option_blockwise(block, COAP_BLOCKSIZE_64, false, 2);
+    coap_add_option_uint(&pkt, COAP_OPTION_BLOCK_2, block[0]);
+}
+
+static void assert_output(const char *expected, const coap_format_config_t *config)
+{
+    len = sizeof(out);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_format_packet(out, &len, &pkt, config));
+    out[len] = 0;
+    TEST_ASSERT_EQUAL_STRING(expected, out);
+}
+
+void setUp(void)
+{
+    make_request();
+}
+
+void tearDown(void) {}
+
+void request_is_rendered_with_names(void)
+{
+    assert_output("{\"type\":\"CON\",\"code\":\"0.01\",\"name\":\"GET\",\"id\":4660,\"token\":\"0x12ab\",\"options\":"
+        "[[\"Uri-Path\",\"sensors\"],[\"Accept\",50],[\"Block2\",\"2/0/64\"]],\"payload_len\":0}", &json);
+    assert_output("type=CON code=0.01 name=GET id=4660 token=0x12ab Uri-Path=sensors Accept=50 Block2=2/0/64 payload_len=0",
+        &logfmt);
+}
+
+void text_is_escaped_and_binary_is_hex(void)
+{
+    static const uint8_t etag[3] = {0x01, 0x02, 0xFF};
+    static const uint8_t cbor[3] = {0xA1, 0x01, 0x02};
+
+    memset(&pkt, 0, sizeof(pkt));
+    coap_header_init(&pkt, COAP_TYPE_ACK, COAP_NOT_FOUND, 7);
+    coap_add_option(&pkt, COAP_OPTION_ETAG, (uint8_t *)etag, sizeof(etag));
+    coap_add_option_string(&pkt, COAP_OPTION_LOCATION_PATH, "a \"b\"=\xC3\xA4");
+    coap_add_option(&pkt, 65, (uint8_t *)"x", 1);
+    pkt.payload.p = (const uint8_t *)"line\none";
+    pkt.payload.len = 8;
+    assert_output("{\"type\":\"ACK\",\"code\":\"4.04\",\"name\":\"Not Found\",\"id\":7,\"options\":[[\"ETag\",\"0x0102ff\"],"
+        "[\"Location-Path\",\"a \\\"b\\\"=\xC3\xA4\"],[\"65\",\"0x78\"]],\"payload_len\":8,\"payload\":\"line\\none\"}", &json);
+    assert_output("type=ACK code=4.04 name=\"Not Found\" id=7 ETag=0x0102ff Location-Path=\"a \\\"b\\\"=\xC3\xA4\" 65=0x78 "
+        "payload_len=8 payload=\"line\\none\"", &logfmt);
+
+    // control characters and invalid UTF-8 make text hex
+    pkt.payload.p = cbor;
+    pkt.payload.len = sizeof(cbor);
+    pkt.numopts = 0;
+    assert_output("type=ACK code=4.04 name=\"Not Found\" id=7 payload_len=3 payload=0xa10102", &logfmt);
+    logfmt.values = COAP_FORMAT_VALUES_HEX;
+    pkt.payload.p = (const uint8_t *)"ok";
+    pkt.payload.len = 2;
+    assert_output("type=ACK code=4.04 name=\"Not Found\" id=7 payload_len=2 payload=0x6f6b", &logfmt);
+    logfmt.values = COAP_FORMAT_VALUES_AUTO;
+}
+
+void long_values_are_cut(void)
+{
+    coap_format_config_t config = {COAP_FORMAT_LOGFMT, COAP_FORMAT_VALUES_AUTO, 4, 3};
+
+    pkt.numopts = 1;
+    // the cut does not split the two byte character
+    pkt.payload.p = (const uint8_t *)"ab\xC3\xA4x";
+    pkt.payload.len = 5;
+    assert_output("type=CON code=0.01 name=GET id=4660 token=0x12ab Uri-Path=sens... payload_len=5 payload=ab...", &config);
+    config.max_payload = 0;
+    assert_output("type=CON code=0.01 name=GET id=4660 token=0x12ab Uri-Path=sens... payload_len=5", &config);
+}
+
+void too_small_buffer_is_reported(void)
+{
+    char small[20];
+
+    len = sizeof(small);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_format_packet(small, &len, &pkt, &json));
+    TEST_ASSERT_EQUAL_size_t(0, len);
+
+    // the line ends after the last field that fitted
+    len = 110;
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_format_packet(out, &len, &pkt, &logfmt));
+    out[len] = 0;
+    TEST_ASSERT_EQUAL_STRING("type=CON code=0.01 name=GET id=4660 token=0x12ab Uri-Path=sensors Accept=50 Block2=2/0/64", out);
+    len = 120;
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_format_packet(out, &len, &pkt, &logfmt));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(request_is_rendered_with_names);
+    RUN_TEST(text_is_escaped_and_binary_is_hex);
+    RUN_TEST(long_values_are_cut);
+    RUN_TEST(too_small_buffer_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_linkformat.h"
+
+static const char doc[] = "</sensors/temp>;ct=0;rt=\"temperature-c\";if=\"sensor\","
+                          "</light>;ct=50;rt=\"light-lux, dimmer\";obs,"
+                          "</fw>";
+static const char expected_log[] = "L(/sensors/temp)A(ct=0)A(rt=temperature-c)A(if=sensor)E"
+                                   "L(/light)A(ct=50)A(rt=light-lux, dimmer)A(obs)E"
+                                   "L(/fw)E";
+
+static char log_buf[512];
+static size_t log_len;
+static size_t views_into_chunk;
+static coap_buffer_t current_chunk;
+static coap_linkformat_parser_t parser;
+
+static void log_append(const char *str, size_t len)
+{
+    memcpy(log_buf + log_len, str, len);
+    log_len += len;
+}
+
+static void log_event(void *ctx, coap_linkformat_event_t event, const coap_buffer_t *first, const coap_buffer_t *second)
+{
+    (void)ctx;
+    if (NULL != first && first->p >= current_chunk.p && first->p < current_chunk.p + current_chunk.len)
+        views_into_chunk++;
+    switch (event)
+    {
+    case COAP_LINKFORMAT_LINK:
+        log_append("L(", 2);
+        log_append((const char *)first->p, first->len);
+        log_append(")", 1);
+        break;
+    case COAP_LINKFORMAT_ATTR:
+        log_append("A(", 2);
+        log_append((const char *)first->p, first->len);
+        if (NULL != second->p)
+        {
+            log_append("=", 1);
+            log_append((const char *)second->p, second->len);
+        }
+        log_append(")", 1);
+        break;
+    case COAP_LINKFORMAT_END:
+        log_append("E", 1);
+        break;
+    }
+}
+
+void setUp(void)
+{
+    log_len = 0;
+    views_into_chunk = 0;
+    coap_linkformat_init(&parser, log_event, NULL);
+}
+
+void tearDown(void) {}
+
+void single_chunk_is_parsed_without_copies(void)
+{
+    current_chunk.p = (const uint8_t *)doc;
+    current_chunk.len = strlen(doc);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_linkformat_feed(&parser, &current_chunk, true));
+    TEST_ASSERT_EQUAL_size_t(strlen(expected_log), log_len);
+    TEST_ASSERT_EQUAL_STRING_LEN(expected_log, log_buf, log_len);
+    // 3 links and 6 attributes
+    TEST_ASSERT_EQUAL_size_t(9, views_into_chunk);
+}
+
+void every_chunk_size_gives_the_same_result(void)
+{
+    size_t chunk_size, offset;
+    for (chunk_size = 1; chunk_size <= strlen(doc); chunk_size++)
+    {
+        setUp();
+        for (offset = 0; offset < strlen(doc); offset += chunk_size)
+        {
+            size_t len = strlen(doc) - offset < chunk_size ? strlen(doc) - offset : chunk_size;
+            current_chunk.p = (const uint8_t *)doc + offset;
+            current_chunk.len = len;
+            TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_linkformat_feed(&parser, &current_chunk, offset + len == strlen(doc)));
+        }
+        TEST_ASSERT_EQUAL_size_t(strlen(expected_log), log_len);
+        TEST_ASSERT_EQUAL_STRING_LEN(expected_log, log_buf, log_len);
+    }
+}
+
+void unterminated_href_is_rejected(void)
+{
+    const char broken[] = "</sensors";
+    current_chunk.p = (const uint8_t *)broken;
+    current_chunk.len = strlen(broken);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_LINKFORMAT_INVALID, coap_linkformat_feed(&parser, &current_chunk, true));
+}
+
+void garbage_between_links_is_rejected(void)
+{
+    const char broken[] = "</a>x</b>";
+    current_chunk.p = (const uint8_t *)broken;
+    current_chunk.len = strlen(broken);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_LINKFORMAT_INVALID, coap_linkformat_feed(&parser, &current_chunk, true));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(single_chunk_is_parsed_without_copies);
+    RUN_TEST(every_chunk_size_gives_the_same_result);
+    RUN_TEST(unterminated_href_is_rejected);
+    RUN_TEST(garbage_between_links_is_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "unity.h"
+#include "coap.h"
+
+static coap_packet_t packet = {};
+static uint8_t obuf[64] = {0};
+static size_t obuf_size = sizeof(obuf);
+
+void setUp(void)
+{
+    coap_header_init(&packet, COAP_TYPE_CON, COAP_GET, 1);
+}
+
+void tearDown(void)
+{
+    const coap_packet_t zero_packet = {};
+    packet = zero_packet;
+    memset(obuf, 0, sizeof(obuf));
+    obuf_size = sizeof(obuf);
+}
+
+void zero_is_encoded_with_zero_bytes(void)
+{
+    uint8_t buf[4] = {0xAA, 0xAA, 0xAA, 0xAA};
+    TEST_ASSERT_EQUAL_UINT8(0, coap_encode_uint(buf, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xAA, buf[0]);
+}
+
+void values_are_encoded_with_minimal_length(void)
+{
+    uint8_t buf[4] = {0};
+
+    TEST_ASSERT_EQUAL_UINT8(1, coap_encode_uint(buf, 0x32));
+    TEST_ASSERT_EQUAL_HEX8(0x32, buf[0]);
+
+    TEST_ASSERT_EQUAL_UINT8(2, coap_encode_uint(buf, 0x0100));
+    uint8_t expected_two[2] = {0x01, 0x00};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_two, buf, 2);
+
+    TEST_ASSERT_EQUAL_UINT8(3, coap_encode_uint(buf, 0x012345));
+    uint8_t expected_three[3] = {0x01, 0x23, 0x45};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_three, buf, 3);
+
+    TEST_ASSERT_EQUAL_UINT8(4, coap_encode_uint(buf, 0xDEADBEEF));
+    uint8_t expected_four[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_four, buf, 4);
+}
+
+void decode_reverses_encode(void)
+{
+    uint32_t values[] = {0, 1, 0xFF, 0x100, 0xFFFF, 0x10000, 0xFFFFFF, 0x1000000, 0xFFFFFFFF};
+    size_t i;
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        uint8_t buf[4];
+        coap_buffer_t view = {buf, coap_encode_uint(buf, values[i])};
+        uint32_t decoded = 0xA5A5A5A5;
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_decode_uint(&view, &decoded));
+        TEST_ASSERT_EQUAL_UINT32(values[i], decoded);
+    }
+}
+
+void decode_rejects_values_longer_than_four_bytes(void)
+{
+    uint8_t buf[5] = {1, 2, 3, 4, 5};
+    coap_buffer_t view = {buf, 5};
+    uint32_t decoded = 0;
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_OPTION_LEN_INVALID, coap_decode_uint(&view, &decoded));
+}
+
+void uint_options_are_stored_in_packet_scratch(void)
+{
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_add_option_uint(&packet, COAP_OPTION_MAX_AGE, 3600));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_add_option_uint(&packet, COAP_OPTION_ACCEPT, 0));
+
+    TEST_ASSERT_EQUAL_UINT8(2, packet.numopts);
+    TEST_ASSERT_EQUAL_PTR(packet.scratch, packet.opts[0].buf.p);
+    TEST_ASSERT_EQUAL_size_t(2, packet.opts[0].buf.len);
+    TEST_ASSERT_EQUAL_size_t(0, packet.opts[1].buf.len);
+    TEST_ASSERT_EQUAL_UINT8(2, packet.scratch_len);
+}
+
+void uint_option_fails_when_scratch_is_exhausted(void)
+{
+    size_t i;
+    for (i = 0; i < COAP_OPTION_SCRATCH_SIZE / 4; i++)
+        TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_add_option_uint(&packet, COAP_OPTION_SIZE1, 0xFFFFFFFF));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_add_option_uint(&packet, COAP_OPTION_SIZE1, 1));
+}
+
+void uint_and_string_options_survive_build_and_parse(void)
+{
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_add_option_string(&packet, COAP_OPTION_URI_PATH, "sensors"));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_add_option_uint(&packet, COAP_OPTION_OBSERVE, 0x1234));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(obuf, &obuf_size, &packet));
+
+    coap_packet_t read_packet = {};
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&read_packet, obuf, obuf_size));
+    uint32_t observe = 0;
+    TEST_ASSERT_TRUE(coap_option_get_uint(&read_packet, COAP_OPTION_OBSERVE, &observe));
+    TEST_ASSERT_EQUAL_UINT32(0x1234, observe);
+
+    uint8_t count = 0;
+    const coap_option_t *path = coap_findOptions(&read_packet, COAP_OPTION_URI_PATH, &count);
+    TEST_ASSERT_EQUAL_UINT8(1, count);
+    TEST_ASSERT_TRUE(coap_buffer_equals_string(&path->buf, "sensors"));
+    TEST_ASSERT_FALSE(coap_buffer_equals_string(&path->buf, "sensor"));
+}
+
+void response_content_format_uses_minimal_length(void)
+{
+    coap_packet_t response = {};
+    coap_make_response(&response, NULL, 0, 1, NULL, COAP_CONTENT, COAP_CONTENTTYPE_TEXT_PLAIN);
+    TEST_ASSERT_EQUAL_UINT8(1, response.numopts);
+    TEST_ASSERT_EQUAL_size_t(0, response.opts[0].buf.len);
+
+    coap_make_response(&response, NULL, 0, 1, NULL, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_JSON);
+    TEST_ASSERT_EQUAL_UINT8(1, response.numopts);
+    TEST_ASSERT_EQUAL_size_t(1, response.opts[0].buf.len);
+    TEST_ASSERT_EQUAL_HEX8(50, response.opts[0].buf.p[0]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(zero_is_encoded_with_zero_bytes);
+    RUN_TEST(values_are_encoded_with_minimal_length);
+    RUN_TEST(decode_reverses_encode);
+    RUN_TEST(decode_rejects_values_longer_than_four_bytes);
+    RUN_TEST(uint_options_are_stored_in_packet_scratch);
+    RUN_TEST(uint_option_fails_when_scratch_is_exhausted);
+    RUN_TEST(uint_and_string_options_survive_build_and_parse);
+    RUN_TEST(response_content_format_uses_minimal_length);
+    return UNITY_END();
+}
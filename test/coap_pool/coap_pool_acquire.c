@@ -0,0 +1,77 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_pool.h"
+
+#define SLOT_COUNT (COAP_POOL_CACHE_SIZE * 2)
+
+static coap_pool_slot_t slots[SLOT_COUNT];
+static coap_pool_t pool;
+static coap_pool_cache_t receiver;
+static coap_pool_cache_t worker;
+
+void setUp(void)
+{
+    coap_pool_init(&pool, slots, SLOT_COUNT);
+    coap_pool_cache_init(&receiver, &pool);
+    coap_pool_cache_init(&worker, &pool);
+}
+
+void tearDown(void) {}
+
+void every_slot_can_be_acquired_once(void)
+{
+    coap_pool_slot_t *acquired[SLOT_COUNT];
+    size_t i, j;
+    for (i = 0; i < SLOT_COUNT; i++)
+    {
+        acquired[i] = coap_pool_acquire(&receiver);
+        TEST_ASSERT_NOT_NULL(acquired[i]);
+        for (j = 0; j < i; j++)
+            TEST_ASSERT_TRUE(acquired[i] != acquired[j]);
+    }
+    TEST_ASSERT_NULL(coap_pool_acquire(&receiver));
+    TEST_ASSERT_NULL(coap_pool_get(&pool));
+}
+
+void acquired_slot_is_reset(void)
+{
+    coap_pool_slot_t *slot = coap_pool_acquire(&receiver);
+    slot->len = 100;
+    slot->pkt.numopts = 3;
+    TEST_ASSERT_NOT_NULL(coap_arena_alloc(&slot->arena, COAP_POOL_ARENA_SIZE, 1));
+    coap_pool_release(&receiver, slot);
+
+    slot = coap_pool_acquire(&receiver);
+    TEST_ASSERT_EQUAL_size_t(0, slot->len);
+    TEST_ASSERT_EQUAL_UINT8(0, slot->pkt.numopts);
+    TEST_ASSERT_EQUAL_PTR(slot->arena_buf, coap_arena_alloc(&slot->arena, 1, 1));
+}
+
+void slots_move_between_caches(void)
+{
+    coap_pool_slot_t *acquired[SLOT_COUNT];
+    size_t i;
+    for (i = 0; i < SLOT_COUNT; i++)
+        acquired[i] = coap_pool_acquire(&receiver);
+    // worker responds and releases, its cache overflows back into the global freelist
+    for (i = 0; i < SLOT_COUNT; i++)
+        coap_pool_release(&worker, acquired[i]);
+    TEST_ASSERT_LESS_OR_EQUAL(COAP_POOL_CACHE_SIZE, worker.count);
+
+    // the receiver gets the spilled slots back
+    TEST_ASSERT_NOT_NULL(coap_pool_acquire(&receiver));
+    coap_pool_cache_flush(&worker);
+    TEST_ASSERT_EQUAL_UINT32(0, worker.count);
+    for (i = 1; i < SLOT_COUNT; i++)
+        TEST_ASSERT_NOT_NULL(coap_pool_acquire(&receiver));
+    TEST_ASSERT_NULL(coap_pool_acquire(&receiver));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(every_slot_can_be_acquired_once);
+    RUN_TEST(acquired_slot_is_reset);
+    RUN_TEST(slots_move_between_caches);
+    return UNITY_END();
+}
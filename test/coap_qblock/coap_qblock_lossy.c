@@ -0,0 +1,395 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_qblock.h"
+
+// Lossy loopback: datagrams are delayed by a fixed latency and dropped at random or by index
+#define QUEUE_SIZE 128
+#define LATENCY_MS 100
+#define BODY_SIZE (64 * 256)
+#define GIVE_UP_MS 120000
+
+typedef struct
+{
+    uint8_t buf[512];
+    size_t len;
+    uint32_t at;
+} datagram_t;
+
+typedef struct
+{
+    datagram_t queue[QUEUE_SIZE];
+    uint32_t head;
+    uint32_t count;
+    uint32_t loss_percent;
+    uint64_t drop_mask;                 /* Datagrams with these indices are dropped */
+    uint32_t random;
+    uint32_t sent;
+    uint32_t dropped;
+} channel_t;
+
+static channel_t up, down;
+static uint8_t body[BODY_SIZE];
+static uint8_t received[BODY_SIZE];
+static uint32_t bitmap[COAP_QBLOCK_BITMAP_WORDS(BODY_SIZE)];
+static const uint8_t token[2] = {0xAB, 0xCD};
+static uint16_t next_id;
+
+static void channel_init(channel_t *ch, uint32_t loss_percent, uint64_t drop_mask, uint32_t seed)
+{
+    memset(ch, 0, sizeof(*ch));
+    ch->loss_percent = loss_percent;
+    ch->drop_mask = drop_mask;
+    ch->random = seed;
+}
+
+static void channel_send(channel_t *ch, const coap_packet_t *pkt, uint32_t now)
+{
+    uint32_t index = ch->sent++;
+    datagram_t *d;
+
+    ch->random = ch->random * 1103515245U + 12345U;
+    if ((index < 64 && 0 != ((ch->drop_mask >> index) & 1)) || (ch->random >> 16) % 100 < ch->loss_percent
+        || QUEUE_SIZE == ch->count)
+    {
+        ch->dropped++;
+        return;
+    }
+    d = &ch->queue[(ch->head + ch->count++) % QUEUE_SIZE];
+    d->len = sizeof(d->buf);
+    coap_build(d->buf, &d->len, pkt);
+    d->at = now + LATENCY_MS;
+}
+
+// the packet points into the queue until the next send overwrites the slot
+static bool channel_recv(channel_t *ch, coap_packet_t *pkt, uint32_t now)
+{
+    datagram_t *d = &ch->queue[ch->head];
+
+    if (0 == ch->count || (int32_t)(now - d->at) < 0)
+        return false;
+    ch->head = (ch->head + 1) % QUEUE_SIZE;
+    ch->count--;
+    return 0 == coap_parse(pkt, d->buf, d->len);
+}
+
+static void make_request(coap_packet_t *pkt, coap_code_t method, const char *path)
+{
+    memset(pkt, 0, sizeof(*pkt));
+    coap_header_init(pkt, COAP_TYPE_NONCON, method, next_id++);
+    coap_header_add_token(pkt, token, sizeof(token));
+    coap_add_option_string(pkt, COAP_OPTION_URI_PATH, path);
+}
+
+// client sends body with Q-Block1, the server answers 2.31, 4.08 and finally 2.04, returns the transfer time
+static uint32_t upload(coap_qblock_rx_t *rx, uint32_t *responses)
+{
+    coap_qblock_tx_t tx;
+    coap_packet_t pkt, rsp, last;
+    uint8_t option[3], rsp_buf[128], last_token[8], count;
+    uint32_t now, num;
+    bool done = false;
+
+    coap_qblock_tx_init(&tx, body, sizeof(body), COAP_BLOCKSIZE_256, 0);
+    coap_qblock_rx_init(rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    memset(&last, 0, sizeof(last));
+    *responses = 0;
+    for (now = 0; now < GIVE_UP_MS && !done; now++)
+    {
+        while (coap_qblock_tx_next(&tx, now, &num))
+        {
+            make_request(&pkt, COAP_PUT, "upload");
+            coap_qblock_tx_add(&tx, &pkt, COAP_OPTION_Q_BLOCK_1, num, option);
+            channel_send(&up, &pkt, now);
+        }
+
+        while (channel_recv(&up, &pkt, now))
+        {
+            coap_qblock_result_t result = coap_qblock_rx_put(rx, coap_findOptions(&pkt, COAP_OPTION_Q_BLOCK_1, &count), &pkt.payload, now);
+            // token and message ID of the last request answer a timeout
+            last = pkt;
+            memcpy(last_token, pkt.tok.p, pkt.tok.len);
+            last.tok.p = last_token;
+            if (COAP_QBLOCK_COMPLETE == result)
+            {
+                coap_make_response(&rsp, NULL, 0, pkt.hdr.id, &pkt.tok, COAP_CHANGED, COAP_CONTENTTYPE_NONE);
+                rsp.hdr.t = COAP_TYPE_NONCON;
+                channel_send(&down, &rsp, now);
+            }
+            else if (COAP_ERR_NONE == coap_qblock_rx_make_response(rx, result, &pkt, &rsp, rsp_buf, sizeof(rsp_buf)))
+                channel_send(&down, &rsp, now);
+        }
+        if (coap_qblock_rx_timeout(rx, now) && COAP_ERR_NONE == coap_qblock_rx_make_response(rx, COAP_QBLOCK_MISSING, &last, &rsp, rsp_buf, sizeof(rsp_buf)))
+            channel_send(&down, &rsp, now);
+
+        while (channel_recv(&down, &rsp, now))
+        {
+            (*responses)++;
+            if (COAP_CONTINUE == rsp.hdr.code)
+                coap_qblock_tx_continue(&tx);
+            else if (COAP_REQUEST_ENTITY_INCOMPLETE == rsp.hdr.code)
+                coap_qblock_tx_missing(&tx, &rsp.payload);
+            else if (COAP_CHANGED == rsp.hdr.code)
+                done = true;
+        }
+    }
+    return done ? now : GIVE_UP_MS;
+}
+
+// server sends body with Q-Block2, the client asks for missing blocks with Q-Block2 options
+static uint32_t download(coap_qblock_rx_t *rx, uint32_t *requests)
+{
+    coap_qblock_tx_t tx;
+    coap_packet_t pkt, rsp;
+    uint8_t option[3], options[MAXOPT * 3], count;
+    uint32_t now, num;
+    bool started = false;
+
+    coap_qblock_rx_init(rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    make_request(&pkt, COAP_GET, "download");
+    channel_send(&up, &pkt, 0);
+    *requests = 1;
+    for (now = 0; now < GIVE_UP_MS && !coap_qblock_rx_complete(rx); now++)
+    {
+        while (channel_recv(&up, &pkt, now))
+        {
+            if (!started)
+            {
+                coap_qblock_tx_init(&tx, body, sizeof(body), COAP_BLOCKSIZE_256, now);
+                started = true;
+            }
+            else
+                coap_qblock_tx_request(&tx, &pkt);
+        }
+        while (started && coap_qblock_tx_next(&tx, now, &num))
+        {
+            coap_make_response(&rsp, NULL, 0, next_id++, &pkt.tok, COAP_CONTENT, COAP_CONTENTTYPE_APPLICATION_OCTECT_STREAM);
+            rsp.hdr.t = COAP_TYPE_NONCON;
+            coap_qblock_tx_add(&tx, &rsp, COAP_OPTION_Q_BLOCK_2, num, option);
+            channel_send(&down, &rsp, now);
+        }
+
+        while (channel_recv(&down, &rsp, now))
+        {
+            coap_qblock_result_t result = coap_qblock_rx_put(rx, coap_findOptions(&rsp, COAP_OPTION_Q_BLOCK_2, &count), &rsp.payload, now);
+            // Continue and missing blocks are both asked for with Q-Block2 options
+            if (COAP_QBLOCK_CONTINUE == result || COAP_QBLOCK_MISSING == result)
+            {
+                make_request(&pkt, COAP_GET, "download");
+                coap_qblock_rx_add_missing(rx, &pkt, options, sizeof(options));
+                channel_send(&up, &pkt, now);
+                (*requests)++;
+            }
+        }
+        // the request is repeated until the first block arrives, then the receiver asks for missing blocks
+        if ((0 == rx->received && now > 0 && 0 == now % COAP_QBLOCK_NON_TIMEOUT_MS) || coap_qblock_rx_timeout(rx, now))
+        {
+            make_request(&pkt, COAP_GET, "download");
+            coap_qblock_rx_add_missing(rx, &pkt, options, sizeof(options));
+            channel_send(&up, &pkt, now);
+            (*requests)++;
+        }
+    }
+    return now;
+}
+
+void setUp(void)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(body); i++)
+        body[i] = (uint8_t)(i * 2654435761U >> 24);
+    memset(received, 0, sizeof(received));
+    next_id = 1;
+}
+
+void tearDown(void) {}
+
+void sender_bursts_payload_sets(void)
+{
+    coap_qblock_tx_t tx;
+    uint32_t num, i;
+
+    coap_qblock_tx_init(&tx, body, 25 * 256 + 1, COAP_BLOCKSIZE_256, 0);
+    TEST_ASSERT_EQUAL_UINT32(26, tx.blocks);
+    for (i = 0; i < COAP_QBLOCK_MAX_PAYLOADS; i++)
+    {
+        TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 0, &num));
+        TEST_ASSERT_EQUAL_UINT32(i, num);
+    }
+    // the payload set is out, wait for the receiver
+    TEST_ASSERT_FALSE(coap_qblock_tx_next(&tx, COAP_QBLOCK_NON_TIMEOUT_MS - 1, &num));
+    coap_qblock_tx_continue(&tx);
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 1, &num));
+    TEST_ASSERT_EQUAL_UINT32(10, num);
+    for (i = 11; i < 20; i++)
+        TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 1, &num));
+    // silence continues after NON_TIMEOUT
+    TEST_ASSERT_FALSE(coap_qblock_tx_next(&tx, 2, &num));
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 1 + COAP_QBLOCK_NON_TIMEOUT_MS, &num));
+    TEST_ASSERT_EQUAL_UINT32(20, num);
+    for (i = 21; i < 26; i++)
+        TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 1 + COAP_QBLOCK_NON_TIMEOUT_MS, &num));
+    // all sent, the last block is probed while the receiver stays silent
+    TEST_ASSERT_FALSE(coap_qblock_tx_next(&tx, 2 + COAP_QBLOCK_NON_TIMEOUT_MS, &num));
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 1 + 2 * COAP_QBLOCK_NON_TIMEOUT_MS, &num));
+    TEST_ASSERT_EQUAL_UINT32(25, num);
+}
+
+void missing_blocks_round_trip_as_cbor_sequence(void)
+{
+    coap_qblock_tx_t tx;
+    coap_qblock_rx_t rx;
+    coap_packet_t pkt, rsp, parsed;
+    uint8_t option[3], rsp_buf[64], datagram[128], count;
+    size_t len = sizeof(datagram);
+    uint32_t num, nums[8];
+    coap_qblock_result_t result = COAP_QBLOCK_STORED;
+
+    coap_qblock_tx_init(&tx, body, 10 * 64, COAP_BLOCKSIZE_64, 0);
+    coap_qblock_rx_init(&rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    while (coap_qblock_tx_next(&tx, 0, &num))
+    {
+        make_request(&pkt, COAP_PUT, "upload");
+        coap_qblock_tx_add(&tx, &pkt, COAP_OPTION_Q_BLOCK_1, num, option);
+        // blocks 2, 3 and 7 get lost
+        if (2 != num && 3 != num && 7 != num)
+            result = coap_qblock_rx_put(&rx, coap_findOptions(&pkt, COAP_OPTION_Q_BLOCK_1, &count), &pkt.payload, 0);
+    }
+    // the last block arrived with gaps
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_MISSING, result);
+    TEST_ASSERT_EQUAL_size_t(3, coap_qblock_rx_missing(&rx, nums, 8));
+    TEST_ASSERT_EQUAL_UINT32(7, nums[2]);
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_qblock_rx_make_response(&rx, result, &pkt, &rsp, rsp_buf, sizeof(rsp_buf)));
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_build(datagram, &len, &rsp));
+    TEST_ASSERT_EQUAL(0, coap_parse(&parsed, datagram, len));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_NONCON, parsed.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_REQUEST_ENTITY_INCOMPLETE, parsed.hdr.code);
+    TEST_ASSERT_EQUAL_size_t(3, parsed.payload.len);
+    TEST_ASSERT_EQUAL_UINT8(0x02, parsed.payload.p[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x07, parsed.payload.p[2]);
+    TEST_ASSERT_EQUAL_UINT8(272 >> 8, coap_findOptions(&parsed, COAP_OPTION_CONTENT_FORMAT, &count)->buf.p[0]);
+
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_qblock_tx_missing(&tx, &parsed.payload));
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 0, &num));
+    TEST_ASSERT_EQUAL_UINT32(2, num);
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 0, &num));
+    TEST_ASSERT_EQUAL_UINT32(3, num);
+    TEST_ASSERT_TRUE(coap_qblock_tx_next(&tx, 0, &num));
+    TEST_ASSERT_EQUAL_UINT32(7, num);
+    TEST_ASSERT_FALSE(coap_qblock_tx_next(&tx, 0, &num));
+}
+
+void complete_payload_set_gets_continue(void)
+{
+    coap_qblock_tx_t tx;
+    coap_qblock_rx_t rx;
+    coap_packet_t pkt, rsp;
+    uint8_t option[3], rsp_buf[8], count;
+    uint32_t num;
+    coap_qblock_result_t result = COAP_QBLOCK_STORED;
+
+    coap_qblock_tx_init(&tx, body, 30 * 16, COAP_BLOCKSIZE_16, 0);
+    coap_qblock_rx_init(&rx, received, sizeof(received), bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    while (coap_qblock_tx_next(&tx, 0, &num))
+    {
+        make_request(&pkt, COAP_PUT, "upload");
+        coap_qblock_tx_add(&tx, &pkt, COAP_OPTION_Q_BLOCK_1, num, option);
+        result = coap_qblock_rx_put(&rx, coap_findOptions(&pkt, COAP_OPTION_Q_BLOCK_1, &count), &pkt.payload, 0);
+        TEST_ASSERT_EQUAL(9 == num ? COAP_QBLOCK_CONTINUE : COAP_QBLOCK_STORED, result);
+    }
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_qblock_rx_make_response(&rx, result, &pkt, &rsp, rsp_buf, sizeof(rsp_buf)));
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTINUE, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT32(9, coap_option_blockwise_get_num(coap_findOptions(&rsp, COAP_OPTION_Q_BLOCK_1, &count)));
+    // a repeated block is no news
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_DUPLICATE, coap_qblock_rx_put(&rx, coap_findOptions(&pkt, COAP_OPTION_Q_BLOCK_1, &count), &pkt.payload, 0));
+    TEST_ASSERT_EQUAL(COAP_ERR_UNSUPPORTED, coap_qblock_rx_make_response(&rx, COAP_QBLOCK_DUPLICATE, &pkt, &rsp, rsp_buf, sizeof(rsp_buf)));
+}
+
+void invalid_and_oversized_blocks_are_rejected(void)
+{
+    coap_qblock_rx_t rx;
+    coap_option_t block;
+    coap_buffer_t payload = {body, 64};
+    uint8_t option[3];
+
+    coap_qblock_rx_init(&rx, received, 1024, bitmap, sizeof(bitmap) / sizeof(bitmap[0]), 0);
+    block.num = COAP_OPTION_Q_BLOCK_1;
+    block.buf.p = option;
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_64, true, 0);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_STORED, coap_qblock_rx_put(&rx, &block, &payload, 0));
+    // other block size
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_32, true, 2);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_INVALID, coap_qblock_rx_put(&rx, &block, &payload, 0));
+    // short block with more to come
+    payload.len = 63;
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_64, true, 1);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_INVALID, coap_qblock_rx_put(&rx, &block, &payload, 0));
+    // beyond the buffer
+    payload.len = 64;
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_64, true, 16);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_TOO_LARGE, coap_qblock_rx_put(&rx, &block, &payload, 0));
+    // a last block sets the size, later blocks are invalid
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_64, false, 3);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_MISSING, coap_qblock_rx_put(&rx, &block, &payload, 0));
+    block.buf.len = coap_make_option_blockwise(option, COAP_BLOCKSIZE_64, true, 4);
+    TEST_ASSERT_EQUAL(COAP_QBLOCK_INVALID, coap_qblock_rx_put(&rx, &block, &payload, 0));
+}
+
+void upload_recovers_from_targeted_loss(void)
+{
+    coap_qblock_rx_t rx;
+    uint32_t responses, elapsed;
+
+    // blocks 3 and 9 (the end of the first payload set), the 64th datagram and the first response are lost
+    channel_init(&up, 0, (1ULL << 3) | (1ULL << 9) | (1ULL << 63), 1);
+    channel_init(&down, 0, 1ULL << 0, 2);
+    elapsed = upload(&rx, &responses);
+    TEST_ASSERT_TRUE(coap_qblock_rx_complete(&rx));
+    TEST_ASSERT_EQUAL_size_t(BODY_SIZE, rx.len);
+    TEST_ASSERT_EQUAL_MEMORY(body, received, BODY_SIZE);
+    // lock-step Block1 needs 64 round trips of 200 ms without any loss
+    TEST_ASSERT_TRUE(elapsed < 64 * 2 * LATENCY_MS);
+}
+
+void upload_survives_random_loss(void)
+{
+    coap_qblock_rx_t rx;
+    uint32_t responses, elapsed;
+
+    channel_init(&up, 20, 0, 7);
+    channel_init(&down, 20, 0, 8);
+    elapsed = upload(&rx, &responses);
+    TEST_ASSERT_TRUE(elapsed < GIVE_UP_MS);
+    TEST_ASSERT_TRUE(up.dropped > 0 && down.dropped > 0);
+    TEST_ASSERT_EQUAL_MEMORY(body, received, BODY_SIZE);
+}
+
+void download_survives_random_loss(void)
+{
+    coap_qblock_rx_t rx;
+    uint32_t requests, elapsed;
+
+    channel_init(&up, 20, 0, 3);
+    channel_init(&down, 20, 0, 4);
+    elapsed = download(&rx, &requests);
+    TEST_ASSERT_TRUE(elapsed < GIVE_UP_MS);
+    TEST_ASSERT_TRUE(coap_qblock_rx_complete(&rx));
+    TEST_ASSERT_TRUE(down.dropped > 0);
+    TEST_ASSERT_EQUAL_size_t(BODY_SIZE, rx.len);
+    TEST_ASSERT_EQUAL_MEMORY(body, received, BODY_SIZE);
+    // far fewer requests than blocks
+    TEST_ASSERT_TRUE(requests < 64);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(sender_bursts_payload_sets);
+    RUN_TEST(missing_blocks_round_trip_as_cbor_sequence);
+    RUN_TEST(complete_payload_set_gets_continue);
+    RUN_TEST(invalid_and_oversized_blocks_are_rejected);
+    RUN_TEST(upload_recovers_from_targeted_loss);
+    RUN_TEST(upload_survives_random_loss);
+    RUN_TEST(download_survives_random_loss);
+    return UNITY_END();
+}
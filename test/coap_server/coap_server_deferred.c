@@ -0,0 +1,322 @@
+#include <string.h>
+#include <pthread.h>
+#include "unity.h"
+#include "coap_server.h"
+#include "coap_deferred.h"
+
+#define MANY 1000
+#define THREADS 4
+
+static const char done[] = "done";
+static const uint8_t token[2] = {0xCA, 0xFE};
+
+static coap_deferred_t *handles[MANY];
+static size_t num_handles;
+
+static int handle_get_slow(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    coap_deferred_t *d = coap_server_defer(inpkt);
+    (void)arena;
+    if (NULL == d)
+        return coap_make_response(outpkt, NULL, 0, ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_SERVICE_UNAVAILABLE, COAP_CONTENTTYPE_NONE);
+    handles[num_handles++] = d;
+    return 0;
+}
+
+static const coap_endpoint_path_t path_slow = {1, {"slow"}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get_slow, &path_slow, NULL, NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static uint8_t arena_memory[1024];
+static coap_peer_t peers[MANY];
+static coap_cc_t cc;
+static coap_deferred_t slots[MANY];
+static coap_deferred_table_t table;
+static coap_server_t server;
+static uint8_t inbuf[64];
+static size_t inlen;
+static uint8_t outbuf[COAP_DEFERRED_RESPONSE_SIZE];
+static size_t outlen;
+static coap_addr_t from;
+
+static coap_addr_t peer_addr(uint16_t n)
+{
+    coap_addr_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.len = 2;
+    addr.addr[0] = (uint8_t)(n >> 8);
+    addr.addr[1] = (uint8_t)n;
+    return addr;
+}
+
+static coap_error_t receive(coap_msgtype_t type, coap_code_t code, uint16_t id, const coap_addr_t *peer, uint32_t now)
+{
+    coap_packet_t req = {};
+    coap_header_init(&req, type, code, id);
+    if (COAP_EMPTY != code)
+    {
+        coap_header_add_token(&req, token, sizeof(token));
+        coap_add_option_string(&req, COAP_OPTION_URI_PATH, "slow");
+    }
+    inlen = sizeof(inbuf);
+    coap_build(inbuf, &inlen, &req);
+    outlen = sizeof(outbuf);
+    return coap_server_handle_from(&server, peer, now, inbuf, inlen, outbuf, &outlen);
+}
+
+static coap_error_t complete(coap_deferred_t *d)
+{
+    coap_packet_t rsp = {};
+    rsp.hdr.code = COAP_CONTENT;
+    rsp.payload.p = (const uint8_t *)done;
+    rsp.payload.len = strlen(done);
+    return coap_deferred_complete(&table, d, &rsp);
+}
+
+static void poll_at(uint32_t now)
+{
+    coap_server_poll(&server, now, 0, &from, outbuf, &outlen);
+}
+
+void setUp(void)
+{
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    coap_cc_init(&cc, peers, MANY, COAP_NSTART);
+    coap_deferred_init(&table, slots, MANY, &cc);
+    server.deferred = &table;
+    server.next_id = 0x100;
+    num_handles = 0;
+}
+
+void tearDown(void) {}
+
+static coap_error_t thread_result;
+
+static void *complete_first(void *arg)
+{
+    (void)arg;
+    thread_result = complete(handles[0]);
+    return NULL;
+}
+
+void confirmable_request_gets_empty_ack_then_separate_response(void)
+{
+    coap_addr_t peer = peer_addr(1);
+    coap_packet_t rsp = {};
+    uint8_t first[COAP_DEFERRED_RESPONSE_SIZE];
+    size_t first_len;
+    pthread_t thread;
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_CON, COAP_GET, 0x1234, &peer, 0));
+    TEST_ASSERT_EQUAL_size_t(4, outlen);
+    TEST_ASSERT_EQUAL_HEX8(0x60, outbuf[0]);
+    TEST_ASSERT_EQUAL_HEX8(COAP_EMPTY, outbuf[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, outbuf[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, outbuf[3]);
+    TEST_ASSERT_EQUAL_size_t(1, num_handles);
+
+    poll_at(10);
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+
+    // complete from another thread
+    pthread_create(&thread, NULL, complete_first, NULL);
+    pthread_join(thread, NULL);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, thread_result);
+    TEST_ASSERT_EQUAL_UINT32(0, coap_deferred_timeout(&table, 20));
+
+    poll_at(20);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_MEMORY(&peer, &from, sizeof(peer));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_CON, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT16(0x100, rsp.hdr.id);
+    TEST_ASSERT_EQUAL_MEMORY(token, rsp.tok.p, sizeof(token));
+    TEST_ASSERT_EQUAL_STRING_LEN(done, rsp.payload.p, rsp.payload.len);
+    memcpy(first, outbuf, outlen);
+    first_len = outlen;
+
+    // not acknowledged in time, the same message is sent again
+    poll_at(21);
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    uint32_t timeout = coap_deferred_timeout(&table, 21);
+    TEST_ASSERT_TRUE(timeout >= COAP_ACK_TIMEOUT_MS - 1 && timeout <= 3 * COAP_ACK_TIMEOUT_MS / 2);
+    poll_at(21 + timeout);
+    TEST_ASSERT_EQUAL_size_t(first_len, outlen);
+    TEST_ASSERT_EQUAL_MEMORY(first, outbuf, first_len);
+
+    // an ACK of another peer does not match, the one of the peer ends the exchange
+    coap_addr_t other = peer_addr(2);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_ACK, COAP_EMPTY, 0x100, &other, 2500));
+    TEST_ASSERT_TRUE(UINT32_MAX != coap_deferred_timeout(&table, 2500));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_ACK, COAP_EMPTY, 0x100, &peer, 2500));
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coap_deferred_timeout(&table, 2500));
+    poll_at(100000);
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+}
+
+void non_confirmable_request_gets_non_response(void)
+{
+    coap_addr_t peer = peer_addr(1);
+    coap_packet_t rsp = {};
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_NONCON, COAP_GET, 0x1234, &peer, 0));
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, complete(handles[0]));
+    poll_at(0);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_NONCON, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    // nothing to acknowledge or retransmit
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coap_deferred_timeout(&table, 0));
+}
+
+void responses_to_one_peer_respect_nstart(void)
+{
+    coap_addr_t peer = peer_addr(1);
+    coap_packet_t rsp = {};
+
+    receive(COAP_TYPE_CON, COAP_GET, 1, &peer, 0);
+    receive(COAP_TYPE_CON, COAP_GET, 2, &peer, 0);
+    TEST_ASSERT_EQUAL_size_t(2, num_handles);
+    complete(handles[0]);
+    complete(handles[1]);
+
+    poll_at(0);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT16(0x100, rsp.hdr.id);
+    poll_at(0);
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+
+    receive(COAP_TYPE_ACK, COAP_EMPTY, 0x100, &peer, 100);
+    poll_at(100);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT16(0x101, rsp.hdr.id);
+}
+
+void unacknowledged_response_is_dropped(void)
+{
+    coap_addr_t peer = peer_addr(1);
+    uint32_t now = 0;
+    int transmissions = 0;
+
+    receive(COAP_TYPE_CON, COAP_GET, 1, &peer, 0);
+    complete(handles[0]);
+    for (;;)
+    {
+        poll_at(now);
+        if (0 == outlen)
+            break;
+        transmissions++;
+        now += coap_deferred_timeout(&table, now);
+    }
+    TEST_ASSERT_EQUAL_INT(1 + COAP_MAX_RETRANSMIT, transmissions);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coap_deferred_timeout(&table, now));
+    // the slot is free again
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_CON, COAP_GET, 2, &peer, now));
+    TEST_ASSERT_EQUAL_size_t(2, num_handles);
+}
+
+void handler_responds_itself_without_deferred_table(void)
+{
+    coap_addr_t peer = peer_addr(1);
+    coap_packet_t rsp = {};
+
+    server.deferred = NULL;
+    receive(COAP_TYPE_CON, COAP_GET, 1, &peer, 0);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_SERVICE_UNAVAILABLE, rsp.hdr.code);
+    TEST_ASSERT_NULL(coap_server_defer(&rsp));
+}
+
+static void *complete_share(void *arg)
+{
+    size_t i;
+    for (i = (size_t)arg; i < MANY; i += THREADS)
+        complete(handles[i]);
+    return NULL;
+}
+
+void many_requests_are_completed_concurrently(void)
+{
+    pthread_t threads[THREADS];
+    static bool seen[MANY];
+    size_t i, sent = 0;
+
+    for (i = 0; i < MANY; i++)
+    {
+        coap_addr_t peer = peer_addr((uint16_t)i);
+        receive(COAP_TYPE_CON, COAP_GET, (uint16_t)i, &peer, 0);
+    }
+    TEST_ASSERT_EQUAL_size_t(MANY, num_handles);
+
+    for (i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, complete_share, (void *)i);
+    // the owner sends while the other threads complete
+    while (sent < MANY)
+    {
+        poll_at(1);
+        if (0 == outlen)
+            continue;
+        uint16_t n = (uint16_t)((from.addr[0] << 8) | from.addr[1]);
+        TEST_ASSERT_FALSE(seen[n]);
+        seen[n] = true;
+        sent++;
+        coap_addr_t peer = from;
+        receive(COAP_TYPE_ACK, COAP_EMPTY, (uint16_t)((outbuf[2] << 8) | outbuf[3]), &peer, 2);
+    }
+    for (i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coap_deferred_timeout(&table, 2));
+}
+
+void failed_completion_is_cancelled_and_frees_the_slot(void)
+{
+    static const uint8_t big[COAP_DEFERRED_RESPONSE_SIZE] = {0};
+    coap_addr_t peer = peer_addr(1);
+    coap_packet_t rsp = {};
+
+    coap_deferred_init(&table, slots, 1, &cc);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_CON, COAP_GET, 0x1234, &peer, 0));
+    TEST_ASSERT_EQUAL_size_t(1, num_handles);
+
+    rsp.hdr.code = COAP_CONTENT;
+    rsp.payload.p = big;
+    rsp.payload.len = sizeof(big);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_deferred_complete(&table, handles[0], &rsp));
+
+    // the only slot is still pending
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_CON, COAP_GET, 0x1235, &peer, 0));
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_SERVICE_UNAVAILABLE, rsp.hdr.code);
+
+    coap_deferred_cancel(&table, handles[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, coap_deferred_timeout(&table, 10));
+    poll_at(10);
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coap_deferred_timeout(&table, 10));
+
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, receive(COAP_TYPE_CON, COAP_GET, 0x1236, &peer, 20));
+    TEST_ASSERT_EQUAL_size_t(4, outlen);
+    TEST_ASSERT_EQUAL_size_t(2, num_handles);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, complete(handles[1]));
+    poll_at(30);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(confirmable_request_gets_empty_ack_then_separate_response);
+    RUN_TEST(non_confirmable_request_gets_non_response);
+    RUN_TEST(responses_to_one_peer_respect_nstart);
+    RUN_TEST(unacknowledged_response_is_dropped);
+    RUN_TEST(handler_responds_itself_without_deferred_table);
+    RUN_TEST(many_requests_are_completed_concurrently);
+    RUN_TEST(failed_completion_is_cancelled_and_frees_the_slot);
+    return UNITY_END();
+}
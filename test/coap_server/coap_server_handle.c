@@ -0,0 +1,136 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_server.h"
+
+static const char hello[] = "hello";
+
+static int handle_get_hello(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    uint8_t *payload;
+    coap_make_response(outpkt, NULL, 0, ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_TEXT_PLAIN);
+    if (NULL == (payload = coap_payload_alloc(outpkt, arena, strlen(hello))))
+        return COAP_ERR_BUFFER_TOO_SMALL;
+    memcpy(payload, hello, strlen(hello));
+    return 0;
+}
+
+static const coap_endpoint_path_t path_hello = {1, {"hello"}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get_hello, &path_hello, "ct=0", NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static uint8_t arena_memory[1024];
+static coap_server_t server;
+static uint8_t inbuf[64];
+static size_t inlen;
+static uint8_t outbuf[64];
+static size_t outlen;
+
+static void build_request(coap_msgtype_t type, coap_code_t code, const char *path)
+{
+    coap_packet_t req = {};
+    const uint8_t token[2] = {0xCA, 0xFE};
+    coap_header_init(&req, type, code, 0x1234);
+    coap_header_add_token(&req, token, sizeof(token));
+    if (NULL != path)
+        coap_add_option_string(&req, COAP_OPTION_URI_PATH, path);
+    inlen = sizeof(inbuf);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(inbuf, &inlen, &req));
+}
+
+void setUp(void)
+{
+    coap_server_init(&server, endpoints, arena_memory, sizeof(arena_memory));
+    outlen = sizeof(outbuf);
+}
+
+void tearDown(void) {}
+
+void matching_request_is_answered_by_handler(void)
+{
+    build_request(COAP_TYPE_CON, COAP_GET, "hello");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+
+    coap_packet_t rsp = {};
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_ACK, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, rsp.hdr.id);
+    TEST_ASSERT_EQUAL_size_t(2, rsp.tok.len);
+    TEST_ASSERT_EQUAL_HEX8(0xCA, rsp.tok.p[0]);
+    TEST_ASSERT_EQUAL_size_t(strlen(hello), rsp.payload.len);
+    TEST_ASSERT_EQUAL_STRING_LEN(hello, rsp.payload.p, rsp.payload.len);
+}
+
+void unknown_path_is_answered_with_not_found(void)
+{
+    build_request(COAP_TYPE_CON, COAP_GET, "other");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+
+    coap_packet_t rsp = {};
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(COAP_NOT_FOUND, rsp.hdr.code);
+}
+
+void arena_is_reset_after_each_response(void)
+{
+    coap_arena_mark_t before = coap_arena_mark(&server.arena);
+    build_request(COAP_TYPE_NONCON, COAP_GET, "hello");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+    coap_arena_mark_t after = coap_arena_mark(&server.arena);
+    TEST_ASSERT_EQUAL_PTR(before.block, after.block);
+    TEST_ASSERT_EQUAL_size_t(before.used, after.used);
+}
+
+void ping_is_answered_with_reset(void)
+{
+    build_request(COAP_TYPE_CON, COAP_EMPTY, NULL);
+    // an empty message carries no token
+    inbuf[0] &= 0xF0;
+    inlen = 4;
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+    TEST_ASSERT_EQUAL_size_t(4, outlen);
+    TEST_ASSERT_EQUAL_HEX8(0x70, outbuf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, outbuf[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, outbuf[3]);
+}
+
+void exhausted_arena_returns_error(void)
+{
+    coap_server_init(&server, endpoints, arena_memory, sizeof(coap_packet_t) + 8);
+    build_request(COAP_TYPE_CON, COAP_GET, "hello");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+    TEST_ASSERT_EQUAL_size_t(0, outlen);
+}
+
+void failing_handler_is_answered_with_internal_server_error(void)
+{
+    // room for both packets, none for the payload of the handler
+    coap_server_init(&server, endpoints, arena_memory, 2 * sizeof(coap_packet_t));
+    build_request(COAP_TYPE_CON, COAP_GET, "hello");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+
+    coap_packet_t rsp = {};
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&rsp, outbuf, outlen));
+    TEST_ASSERT_EQUAL_UINT8(1, rsp.hdr.ver);
+    TEST_ASSERT_EQUAL_UINT8(COAP_TYPE_ACK, rsp.hdr.t);
+    TEST_ASSERT_EQUAL_UINT8(COAP_INTERNAL_SERVER_ERROR, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, rsp.hdr.id);
+    TEST_ASSERT_EQUAL_size_t(2, rsp.tok.len);
+    TEST_ASSERT_EQUAL_UINT8(0, rsp.numopts);
+    TEST_ASSERT_EQUAL_size_t(0, rsp.payload.len);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(matching_request_is_answered_by_handler);
+    RUN_TEST(unknown_path_is_answered_with_not_found);
+    RUN_TEST(arena_is_reset_after_each_response);
+    RUN_TEST(ping_is_answered_with_reset);
+    RUN_TEST(exhausted_arena_returns_error);
+    RUN_TEST(failing_handler_is_answered_with_internal_server_error);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_server.h"
+
+static int handle_dummy(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    (void)arena;
+    coap_make_response(outpkt, NULL, 0, ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CHANGED, COAP_CONTENTTYPE_NONE);
+    return 0;
+}
+
+static const coap_endpoint_path_t path_temp = {2, {"sensors", "temp"}};
+static const coap_endpoint_path_t path_light = {1, {"light"}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_dummy, &path_temp, "ct=0", "temperature-c", "sensor"},
+    {COAP_PUT, handle_dummy, &path_temp, "ct=0", NULL, NULL},
+    {COAP_GET, handle_dummy, &path_light, "ct=50", "light-lux dimmer", NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+static const char expected_doc[] = "</sensors/temp>;ct=0;rt=\"temperature-c\";if=\"sensor\","
+                                   "</light>;ct=50;rt=\"light-lux dimmer\"";
+
+static char doc_buf[256];
+static coap_wellknown_link_t links[4];
+static coap_wellknown_t wk;
+static uint8_t arena_memory[1024];
+static coap_arena_t arena;
+static coap_packet_t req;
+static coap_packet_t rsp;
+
+void setUp(void)
+{
+    const coap_packet_t zero_packet = {};
+    req = zero_packet;
+    rsp = zero_packet;
+    coap_arena_init(&arena, arena_memory, sizeof(arena_memory));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_init(&wk, endpoints, doc_buf, sizeof(doc_buf), links, 4));
+    coap_header_init(&req, COAP_TYPE_CON, COAP_GET, 1);
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, ".well-known");
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, "core");
+}
+
+void tearDown(void) {}
+
+void document_lists_every_resource_once(void)
+{
+    TEST_ASSERT_EQUAL_size_t(2, wk.num_links);
+    TEST_ASSERT_EQUAL_size_t(strlen(expected_doc), wk.doc_len);
+    TEST_ASSERT_EQUAL_STRING_LEN(expected_doc, wk.doc, wk.doc_len);
+}
+
+void too_small_buffer_returns_error(void)
+{
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_wellknown_init(&wk, endpoints, doc_buf, 20, links, 4));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_wellknown_init(&wk, endpoints, doc_buf, sizeof(doc_buf), links, 1));
+}
+
+void unfiltered_response_points_into_document(void)
+{
+    TEST_ASSERT_TRUE(coap_wellknown_is_request(&req));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, rsp.hdr.code);
+    TEST_ASSERT_EQUAL_PTR(wk.doc, rsp.payload.p);
+    TEST_ASSERT_EQUAL_size_t(wk.doc_len, rsp.payload.len);
+    uint32_t ct = 0;
+    TEST_ASSERT_TRUE(coap_option_get_uint(&rsp, COAP_OPTION_CONTENT_FORMAT, &ct));
+    TEST_ASSERT_EQUAL_UINT32(COAP_CONTENTTYPE_APPLICATION_LINKFORMAT, ct);
+}
+
+void block2_slices_the_document(void)
+{
+    uint8_t count;
+    const coap_option_t *block;
+
+    coap_add_option_uint(&req, COAP_OPTION_BLOCK_2, (1 << 4) | COAP_BLOCKSIZE_32);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_PTR(wk.doc + 32, rsp.payload.p);
+    TEST_ASSERT_EQUAL_size_t(32, rsp.payload.len);
+    block = coap_findOptions(&rsp, COAP_OPTION_BLOCK_2, &count);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL_UINT32(1, coap_option_blockwise_get_num(block));
+    TEST_ASSERT_TRUE(coap_option_blockwise_get_m(block));
+}
+
+void block_behind_document_is_rejected(void)
+{
+    coap_add_option_uint(&req, COAP_OPTION_BLOCK_2, (10 << 4) | COAP_BLOCKSIZE_32);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_UINT8(COAP_BAD_OPTION, rsp.hdr.code);
+}
+
+void rt_filter_matches_one_of_several_values(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "rt=dimmer");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_STRING_LEN("</light>;ct=50;rt=\"light-lux dimmer\"", rsp.payload.p, rsp.payload.len);
+    TEST_ASSERT_EQUAL_size_t(strlen("</light>;ct=50;rt=\"light-lux dimmer\""), rsp.payload.len);
+}
+
+void href_prefix_filter_matches(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "href=/sensors*");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_size_t(strlen("</sensors/temp>;ct=0;rt=\"temperature-c\";if=\"sensor\""), rsp.payload.len);
+}
+
+void filtered_document_is_sliced_across_links(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "rt=*");
+    coap_add_option_uint(&req, COAP_OPTION_BLOCK_2, (3 << 4) | COAP_BLOCKSIZE_16);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_size_t(16, rsp.payload.len);
+    TEST_ASSERT_EQUAL_STRING_LEN(expected_doc + 48, rsp.payload.p, 16);
+}
+
+void if_filter_matches_indexed_value(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "if=sensor");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_STRING_LEN("</sensors/temp>;ct=0;rt=\"temperature-c\";if=\"sensor\"", rsp.payload.p, rsp.payload.len);
+}
+
+void rt_prefix_filter_matches_later_value(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "rt=dim*");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_STRING_LEN("</light>;ct=50;rt=\"light-lux dimmer\"", rsp.payload.p, rsp.payload.len);
+}
+
+void too_many_values_return_error(void)
+{
+    static const coap_endpoint_t crowded[] =
+    {
+        {COAP_GET, handle_dummy, &path_light, NULL, "a b c", "d e"},
+        {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+    };
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_wellknown_init(&wk, crowded, doc_buf, sizeof(doc_buf), links, 4));
+}
+
+void no_match_is_not_found(void)
+{
+    coap_add_option_string(&req, COAP_OPTION_URI_QUERY, "if=actuator");
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_wellknown_respond(&wk, &arena, &req, &rsp));
+    TEST_ASSERT_EQUAL_UINT8(COAP_NOT_FOUND, rsp.hdr.code);
+}
+
+void server_serves_well_known_core(void)
+{
+    static uint8_t server_arena[2048];
+    coap_server_t server;
+    uint8_t inbuf[64], outbuf[256];
+    size_t inlen = sizeof(inbuf), outlen = sizeof(outbuf);
+    coap_packet_t parsed = {};
+
+    coap_server_init(&server, endpoints, server_arena, sizeof(server_arena));
+    server.wellknown = &wk;
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(inbuf, &inlen, &req));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_server_handle(&server, inbuf, inlen, outbuf, &outlen));
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&parsed, outbuf, outlen));
+    TEST_ASSERT_EQUAL_size_t(wk.doc_len, parsed.payload.len);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(document_lists_every_resource_once);
+    RUN_TEST(too_small_buffer_returns_error);
+    RUN_TEST(unfiltered_response_points_into_document);
+    RUN_TEST(block2_slices_the_document);
+    RUN_TEST(block_behind_document_is_rejected);
+    RUN_TEST(rt_filter_matches_one_of_several_values);
+    RUN_TEST(href_prefix_filter_matches);
+    RUN_TEST(filtered_document_is_sliced_across_links);
+    RUN_TEST(if_filter_matches_indexed_value);
+    RUN_TEST(rt_prefix_filter_matches_later_value);
+    RUN_TEST(too_many_values_return_error);
+    RUN_TEST(no_match_is_not_found);
+    RUN_TEST(server_serves_well_known_core);
+    return UNITY_END();
+}
@@ -0,0 +1,251 @@
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "unity.h"
+#include "coap_shm.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+
+static coap_shm_t shm;
+
+static void make_message(coap_packet_t *pkt, uint16_t id, const char *path, uint8_t *payload, size_t len)
+{
+    static const uint8_t token[2] = {0x12, 0x34};
+    memset(pkt, 0, sizeof(*pkt));
+    coap_header_init(pkt, COAP_TYPE_NONCON, COAP_POST, id);
+    coap_header_add_token(pkt, token, sizeof(token));
+    coap_add_option_string(pkt, COAP_OPTION_URI_PATH, path);
+    pkt->payload.p = payload;
+    pkt->payload.len = len;
+}
+
+void setUp(void) {}
+
+void tearDown(void)
+{
+    if (NULL != shm.ring)
+        coap_shm_close(&shm);
+}
+
+void messages_are_parsed_in_place(void)
+{
+    coap_packet_t pkt;
+    coap_buffer_t msgs[8];
+    uint8_t payload[3] = {1, 2, 3};
+    uint8_t count;
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 4096, COAP_SHM_SPSC));
+    TEST_ASSERT_EQUAL_size_t(0, coap_shm_peek(&shm, msgs, 8));
+    make_message(&pkt, 1, "telemetry", payload, sizeof(payload));
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_send_packet(&shm, &pkt));
+    make_message(&pkt, 2, "events", payload, 1);
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_send_packet(&shm, &pkt));
+
+    TEST_ASSERT_EQUAL_size_t(2, coap_shm_peek(&shm, msgs, 8));
+    TEST_ASSERT_EQUAL(0, coap_parse(&pkt, msgs[0].p, msgs[0].len));
+    TEST_ASSERT_EQUAL_UINT16(1, pkt.hdr.id);
+    TEST_ASSERT_TRUE(coap_buffer_equals_string(&coap_findOptions(&pkt, COAP_OPTION_URI_PATH, &count)->buf, "telemetry"));
+    // the payload is a view into the segment
+    TEST_ASSERT_TRUE(pkt.payload.p > (const uint8_t *)shm.ring && pkt.payload.p < (const uint8_t *)shm.ring + shm.map_len);
+    TEST_ASSERT_EQUAL_MEMORY(payload, pkt.payload.p, 3);
+    TEST_ASSERT_EQUAL(0, coap_parse(&pkt, msgs[1].p, msgs[1].len));
+    TEST_ASSERT_EQUAL_UINT16(2, pkt.hdr.id);
+    coap_shm_release(&shm);
+    TEST_ASSERT_EQUAL_size_t(0, coap_shm_peek(&shm, msgs, 8));
+    TEST_ASSERT_FALSE(coap_shm_wait(&shm, 0));
+}
+
+void ring_wraps_and_fills_up(void)
+{
+    coap_buffer_t msgs[64];
+    uint8_t msg[100];
+    uint32_t sent = 0, received = 0, i;
+    size_t n;
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 256, COAP_SHM_MPSC));
+    TEST_ASSERT_EQUAL(COAP_SHM_TOO_LARGE, coap_shm_send(&shm, msg, 121));
+    // message lengths 1 to 100 do not divide the ring, so padding records are needed
+    while (sent < 1000)
+    {
+        memset(msg, (int)sent, sizeof(msg));
+        if (COAP_SHM_OK == coap_shm_send(&shm, msg, 1 + sent % 100))
+        {
+            sent++;
+            continue;
+        }
+        n = coap_shm_peek(&shm, msgs, 64);
+        TEST_ASSERT_TRUE(n > 0);
+        for (i = 0; i < n; i++, received++)
+        {
+            TEST_ASSERT_EQUAL_size_t(1 + received % 100, msgs[i].len);
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)received, msgs[i].p[0]);
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)received, msgs[i].p[msgs[i].len - 1]);
+        }
+        coap_shm_release(&shm);
+    }
+    n = coap_shm_peek(&shm, msgs, 64);
+    coap_shm_release(&shm);
+    TEST_ASSERT_EQUAL_UINT32(1000, received + n);
+}
+
+void reserved_messages_are_cancelled_and_shrunk(void)
+{
+    coap_shm_slot_t first, second;
+    coap_buffer_t msgs[4];
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 1024, COAP_SHM_MPSC));
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_reserve(&shm, 64, &first));
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_reserve(&shm, 64, &second));
+    memcpy(second.p, "second", 6);
+    coap_shm_commit(&shm, &second, 6);
+    // the consumer does not pass the first message while it is being written
+    TEST_ASSERT_EQUAL_size_t(0, coap_shm_peek(&shm, msgs, 4));
+    coap_shm_commit(&shm, &first, 0);
+    TEST_ASSERT_EQUAL_size_t(1, coap_shm_peek(&shm, msgs, 4));
+    TEST_ASSERT_EQUAL_MEMORY("second", msgs[0].p, 6);
+    coap_shm_release(&shm);
+    coap_shm_close(&shm);
+
+    // an SPSC ring takes back what the producer did not use
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 1024, COAP_SHM_SPSC));
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_reserve(&shm, 500, &first));
+    memcpy(first.p, "first", 5);
+    coap_shm_commit(&shm, &first, 5);
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_reserve(&shm, 500, &second));
+    TEST_ASSERT_EQUAL_UINT64(16, second.pos);
+}
+
+void corrupt_records_are_not_exposed(void)
+{
+    // record header: span, then message length
+    const uint32_t past_end[2] = {4096, 8}, too_long[2] = {24, 100}, unaligned[2] = {12, 1};
+    coap_buffer_t msgs[4];
+    coap_shm_t other;
+    int memfd, efd;
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 256, COAP_SHM_SPSC));
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_send(&shm, (const uint8_t *)"valid", 5));
+    // a faulty producer writes behind the first record
+    memcpy(shm.ring->data + 16, past_end, sizeof(past_end));
+    TEST_ASSERT_EQUAL_size_t(1, coap_shm_peek(&shm, msgs, 4));
+    TEST_ASSERT_EQUAL_MEMORY("valid", msgs[0].p, 5);
+    TEST_ASSERT_FALSE(coap_shm_wait(&shm, 0));
+    coap_shm_release(&shm);
+    memcpy(shm.ring->data + 16, too_long, sizeof(too_long));
+    TEST_ASSERT_EQUAL_size_t(0, coap_shm_peek(&shm, msgs, 4));
+    memcpy(shm.ring->data + 16, unaligned, sizeof(unaligned));
+    TEST_ASSERT_EQUAL_size_t(0, coap_shm_peek(&shm, msgs, 4));
+
+    shm.ring->mode = 3;
+    memfd = dup(shm.memfd);
+    efd = dup(shm.eventfd);
+    TEST_ASSERT_EQUAL(COAP_SHM_INVALID, coap_shm_attach(&other, memfd, efd));
+    close(memfd);
+    close(efd);
+}
+
+void producer_process_wakes_consumer(void)
+{
+    coap_buffer_t msgs[32];
+    coap_packet_t pkt;
+    uint32_t received = 0, errors = 0, i, n;
+    int status = -1;
+    pid_t child;
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 16384, COAP_SHM_SPSC));
+    child = fork();
+    if (0 == child)
+    {
+        // the child maps the segment again, at another address
+        coap_shm_t producer;
+        uint8_t payload[4];
+        if (COAP_SHM_OK != coap_shm_attach(&producer, dup(shm.memfd), dup(shm.eventfd)))
+            _exit(2);
+        for (i = 0; i < 5000; i++)
+        {
+            memcpy(payload, &i, sizeof(i));
+            make_message(&pkt, (uint16_t)i, "telemetry", payload, sizeof(payload));
+            while (COAP_SHM_FULL == coap_shm_send_packet(&producer, &pkt))
+                usleep(100);
+        }
+        coap_shm_close(&producer);
+        _exit(0);
+    }
+    TEST_ASSERT_TRUE(child > 0);
+    while (received < 5000 && coap_shm_wait(&shm, 5000))
+    {
+        n = (uint32_t)coap_shm_peek(&shm, msgs, 32);
+        for (i = 0; i < n; i++, received++)
+        {
+            uint32_t value;
+            if (0 != coap_parse(&pkt, msgs[i].p, msgs[i].len) || (uint16_t)received != pkt.hdr.id)
+                errors++;
+            memcpy(&value, pkt.payload.p, sizeof(value));
+            errors += (value != received);
+        }
+        coap_shm_release(&shm);
+    }
+    if (received < 5000)
+        kill(child, SIGKILL);
+    waitpid(child, &status, 0);
+    TEST_ASSERT_EQUAL_INT(0, status);
+    TEST_ASSERT_EQUAL_UINT32(5000, received);
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+}
+
+static void *produce(void *arg)
+{
+    uint32_t producer = (uint32_t)(uintptr_t)arg, seq, msg[2];
+
+    for (seq = 0; seq < PER_PRODUCER; seq++)
+    {
+        msg[0] = producer;
+        msg[1] = seq;
+        while (COAP_SHM_FULL == coap_shm_send(&shm, (const uint8_t *)msg, sizeof(msg)))
+            sched_yield();
+    }
+    return NULL;
+}
+
+void producer_threads_keep_their_order(void)
+{
+    pthread_t threads[PRODUCERS];
+    uint32_t next[PRODUCERS] = {0}, received = 0, errors = 0, i, n, msg[2];
+    coap_buffer_t msgs[64];
+
+    TEST_ASSERT_EQUAL(COAP_SHM_OK, coap_shm_create(&shm, 4096, COAP_SHM_MPSC));
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, produce, (void *)(uintptr_t)i);
+    while (received < PRODUCERS * PER_PRODUCER && coap_shm_wait(&shm, 5000))
+    {
+        n = (uint32_t)coap_shm_peek(&shm, msgs, 64);
+        for (i = 0; i < n; i++, received++)
+        {
+            memcpy(msg, msgs[i].p, sizeof(msg));
+            if (msgs[i].len != sizeof(msg) || msg[0] >= PRODUCERS || msg[1] != next[msg[0]]++)
+                errors++;
+        }
+        coap_shm_release(&shm);
+    }
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_UINT32(PRODUCERS * PER_PRODUCER, received);
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(messages_are_parsed_in_place);
+    RUN_TEST(ring_wraps_and_fills_up);
+    RUN_TEST(reserved_messages_are_cancelled_and_shrunk);
+    RUN_TEST(corrupt_records_are_not_exposed);
+    RUN_TEST(producer_process_wakes_consumer);
+    RUN_TEST(producer_threads_keep_their_order);
+    return UNITY_END();
+}
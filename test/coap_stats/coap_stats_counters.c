@@ -0,0 +1,126 @@
+#include <string.h>
+#include <pthread.h>
+#include "unity.h"
+#include "coap_stats.h"
+#include "coap_server.h"
+
+static const char long_path[] = "a-path-segment-longer-than-12";
+static coap_stats_thread_t main_stats;
+static coap_stats_thread_t worker_stats;
+static uint8_t msg[64];
+static size_t msglen;
+
+static int handle_get(coap_arena_t *arena, const coap_packet_t *inpkt, coap_packet_t *outpkt, uint8_t id_hi, uint8_t id_lo)
+{
+    (void)arena;
+    return coap_make_response(outpkt, NULL, 0, ((uint16_t)id_hi << 8) | id_lo, &inpkt->tok, COAP_CONTENT, COAP_CONTENTTYPE_NONE);
+}
+
+static const coap_endpoint_path_t path = {1, {long_path}};
+static const coap_endpoint_t endpoints[] =
+{
+    {COAP_GET, handle_get, &path, NULL, NULL, NULL},
+    {(coap_code_t)0, NULL, NULL, NULL, NULL, NULL}
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void build_request(void)
+{
+    coap_packet_t req = {};
+    coap_header_init(&req, COAP_TYPE_CON, COAP_GET, 1);
+    coap_add_option_string(&req, COAP_OPTION_URI_PATH, long_path);
+    msglen = sizeof(msg);
+    coap_build(msg, &msglen, &req);
+}
+
+static void *worker(void *arg)
+{
+    coap_packet_t pkt;
+    (void)arg;
+    coap_stats_register(&worker_stats);
+    coap_parse(&pkt, msg, msglen);
+    return NULL;
+}
+
+void codec_and_dispatch_are_counted(void)
+{
+    static const uint8_t bad_version[] = {0x80, 0x01, 0x00, 0x01};
+    coap_packet_t pkt, rsp;
+    uint8_t arena_buf[256];
+    coap_arena_t arena;
+    coap_stats_t stats;
+    size_t small = 4;
+
+    coap_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    build_request();
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&pkt, msg, msglen));
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_BUFFER_TOO_SMALL, coap_build(msg, &small, &pkt));
+    coap_handle_req(&arena, endpoints, &pkt, &rsp);
+    pkt.numopts = 0;
+    coap_handle_req(&arena, endpoints, &pkt, &rsp);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_VERSION_NOT_1, coap_parse(&pkt, bad_version, sizeof(bad_version)));
+
+    coap_stats_snapshot(&stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.build_ok);
+    TEST_ASSERT_EQUAL_UINT64(msglen, stats.build_bytes);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.build_size[coap_stats_log2(msglen)]);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.build_errors[COAP_ERR_BUFFER_TOO_SMALL]);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.build_ext_headers);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.parse_ok);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.parse_options);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.parse_ext_headers);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.parse_errors[COAP_ERR_VERSION_NOT_1]);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.dispatch_ok);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.dispatch_not_found);
+}
+
+void options_beyond_maxopt_are_counted_as_truncation(void)
+{
+    coap_packet_t req = {}, pkt;
+    coap_stats_t before, after;
+    int i;
+
+    coap_header_init(&req, COAP_TYPE_CON, COAP_GET, 1);
+    for (i = 0; i < MAXOPT; i++)
+        coap_add_option(&req, COAP_OPTION_URI_QUERY, NULL, 0);
+    msglen = sizeof(msg);
+    TEST_ASSERT_EQUAL_INT(COAP_ERR_NONE, coap_build(msg, &msglen, &req));
+    msg[msglen++] = 0x00;   // one more Uri-Query
+
+    coap_stats_snapshot(&before);
+    TEST_ASSERT_EQUAL_INT(0, coap_parse(&pkt, msg, msglen));
+    coap_stats_snapshot(&after);
+    TEST_ASSERT_EQUAL_UINT64(before.parse_truncated + 1, after.parse_truncated);
+}
+
+void snapshot_sums_threads_and_merges(void)
+{
+    coap_stats_t before, after, merged;
+    pthread_t thread;
+
+    build_request();
+    coap_stats_snapshot(&before);
+    pthread_create(&thread, NULL, worker, NULL);
+    pthread_join(thread, NULL);
+    coap_stats_snapshot(&after);
+    TEST_ASSERT_EQUAL_UINT64(before.parse_ok + 1, after.parse_ok);
+    TEST_ASSERT_EQUAL_UINT64(1, worker_stats.counters[COAP_STATS_INDEX(parse_ok)]);
+
+    merged = after;
+    coap_stats_merge(&merged, &after);
+    TEST_ASSERT_EQUAL_UINT64(2 * after.parse_ok, merged.parse_ok);
+    TEST_ASSERT_EQUAL_UINT64(2 * after.build_bytes, merged.build_bytes);
+}
+
+int main(void)
+{
+    coap_stats_register(&main_stats);
+    UNITY_BEGIN();
+    RUN_TEST(codec_and_dispatch_are_counted);
+    RUN_TEST(options_beyond_maxopt_are_counted_as_truncation);
+    RUN_TEST(snapshot_sums_threads_and_merges);
+    return UNITY_END();
+}
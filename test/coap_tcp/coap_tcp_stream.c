@@ -0,0 +1,202 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_tcp.h"
+
+static const uint8_t token[] = {0xCA, 0xFE};
+static uint8_t payload[70000];
+static uint8_t stream[71000];
+static size_t stream_len;
+static uint8_t reassembly[512];
+static coap_tcp_decoder_t dec;
+
+void setUp(void)
+{
+    size_t i;
+    for (i = 0; i < sizeof(payload); i++)
+        payload[i] = (uint8_t)i;
+    coap_tcp_decoder_init(&dec, reassembly, sizeof(reassembly));
+}
+
+void tearDown(void) {}
+
+static void make_request(coap_packet_t *pkt, size_t payload_len)
+{
+    coap_tcp_signal_init(pkt, COAP_POST);
+    coap_header_add_token(pkt, token, sizeof(token));
+    coap_add_option_string(pkt, COAP_OPTION_URI_PATH, "data");
+    pkt->payload.p = payload;
+    pkt->payload.len = payload_len;
+}
+
+static void append(const coap_packet_t *pkt)
+{
+    size_t len = sizeof(stream) - stream_len;
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_build(stream + stream_len, &len, pkt, false));
+    stream_len += len;
+}
+
+void every_length_encoding_round_trips(void)
+{
+    static const size_t payload_lens[] = {0, 1, 6, 7, 262, 263, 65798, 65799, 69000};
+    static const size_t len_nibbles[] = {5, 7, 12, 13, 13, 14, 14, 15, 15};
+    size_t i;
+    for (i = 0; i < sizeof(payload_lens) / sizeof(payload_lens[0]); i++)
+    {
+        coap_packet_t pkt, parsed;
+        size_t len = sizeof(stream);
+        make_request(&pkt, payload_lens[i]);
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_build(stream, &len, &pkt, false));
+        TEST_ASSERT_EQUAL_UINT8(len_nibbles[i], stream[0] >> 4);
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_parse(&parsed, stream, len, false));
+        TEST_ASSERT_EQUAL_UINT8(COAP_POST, parsed.hdr.code);
+        TEST_ASSERT_EQUAL_MEMORY(token, parsed.tok.p, sizeof(token));
+        TEST_ASSERT_EQUAL_UINT8(1, parsed.numopts);
+        TEST_ASSERT_TRUE(coap_buffer_equals_string(&parsed.opts[0].buf, "data"));
+        TEST_ASSERT_EQUAL_size_t(payload_lens[i], parsed.payload.len);
+        if (payload_lens[i] > 0)
+            TEST_ASSERT_EQUAL_MEMORY(payload, parsed.payload.p, payload_lens[i]);
+        TEST_ASSERT_EQUAL(COAP_ERR_FRAME_LENGTH_MISMATCH, coap_tcp_parse(&parsed, stream, len - 1, false));
+    }
+}
+
+// http://tools.ietf.org/html/rfc8323#section-3.2, empty message and ping without token
+void minimal_messages(void)
+{
+    coap_packet_t pkt;
+    uint8_t buf[2];
+    size_t len = sizeof(buf);
+    coap_tcp_signal_init(&pkt, COAP_SIGNAL_PING);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_build(buf, &len, &pkt, false));
+    TEST_ASSERT_EQUAL_size_t(2, len);
+    TEST_ASSERT_EQUAL_HEX8(0x00, buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xE2, buf[1]);
+}
+
+void websocket_format_has_no_length(void)
+{
+    coap_packet_t pkt, parsed;
+    size_t len = sizeof(stream);
+    make_request(&pkt, 100);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_build(stream, &len, &pkt, true));
+    TEST_ASSERT_EQUAL_HEX8(0x02, stream[0]);
+    TEST_ASSERT_EQUAL_size_t(1 + 1 + 2 + 5 + 1 + 100, len);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_parse(&parsed, stream, len, true));
+    TEST_ASSERT_EQUAL_size_t(100, parsed.payload.len);
+}
+
+static void build_stream(void)
+{
+    coap_packet_t pkt, ping;
+    stream_len = 0;
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_make_csm(&pkt, 4096, true));
+    append(&pkt);
+    coap_tcp_signal_init(&ping, COAP_SIGNAL_PING);
+    coap_header_add_token(&ping, token, sizeof(token));
+    append(&ping);
+    make_request(&pkt, 300);
+    append(&pkt);
+    coap_tcp_make_pong(&pkt, &ping);
+    append(&pkt);
+}
+
+static size_t decode_stream(size_t chunk_size, size_t *in_place)
+{
+    static const uint8_t codes[] = {COAP_SIGNAL_CSM, COAP_SIGNAL_PING, COAP_POST, COAP_SIGNAL_PONG};
+    size_t offset, messages = 0;
+    *in_place = 0;
+    for (offset = 0; offset < stream_len; offset += chunk_size)
+    {
+        size_t len = (stream_len - offset < chunk_size) ? stream_len - offset : chunk_size;
+        coap_packet_t pkt;
+        bool available;
+        coap_tcp_decoder_feed(&dec, stream + offset, len);
+        while (true)
+        {
+            TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_decoder_next(&dec, &pkt, &available));
+            if (!available)
+                break;
+            TEST_ASSERT_EQUAL_UINT8(codes[messages], pkt.hdr.code);
+            if (COAP_POST == pkt.hdr.code)
+            {
+                TEST_ASSERT_EQUAL_size_t(300, pkt.payload.len);
+                TEST_ASSERT_EQUAL_MEMORY(payload, pkt.payload.p, 300);
+            }
+            if (pkt.hdr.code != COAP_SIGNAL_CSM)
+                TEST_ASSERT_EQUAL_MEMORY(token, pkt.tok.p, sizeof(token));
+            if (pkt.hdr.code == COAP_SIGNAL_CSM)
+            {
+                uint32_t max_message_size = COAP_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+                bool block_wise = false;
+                coap_tcp_read_csm(&pkt, &max_message_size, &block_wise);
+                TEST_ASSERT_EQUAL_UINT32(4096, max_message_size);
+                TEST_ASSERT_TRUE(block_wise);
+            }
+            if (pkt.hdr.code == COAP_SIGNAL_PING || pkt.hdr.code == COAP_SIGNAL_PONG)
+                TEST_ASSERT_EQUAL_UINT8(0, pkt.numopts);
+            if (pkt.tok.p >= stream && pkt.tok.p < stream + stream_len)
+                (*in_place)++;
+            messages++;
+        }
+    }
+    return messages;
+}
+
+void single_chunk_is_decoded_in_place(void)
+{
+    size_t in_place;
+    build_stream();
+    TEST_ASSERT_EQUAL_size_t(4, decode_stream(stream_len, &in_place));
+    // the CSM has no token, all others are referenced in the chunk
+    TEST_ASSERT_EQUAL_size_t(3, in_place);
+}
+
+void every_chunk_size_gives_the_same_messages(void)
+{
+    size_t chunk_size, in_place;
+    build_stream();
+    for (chunk_size = 1; chunk_size <= stream_len; chunk_size++)
+    {
+        setUp();
+        TEST_ASSERT_EQUAL_size_t(4, decode_stream(chunk_size, &in_place));
+    }
+}
+
+void split_message_larger_than_buffer_is_rejected(void)
+{
+    coap_packet_t pkt;
+    bool available;
+    make_request(&pkt, 1000);
+    stream_len = 0;
+    append(&pkt);
+    coap_tcp_decoder_feed(&dec, stream, 10);
+    TEST_ASSERT_EQUAL(COAP_ERR_BUFFER_TOO_SMALL, coap_tcp_decoder_next(&dec, &pkt, &available));
+
+    // the same message in one chunk does not need the buffer
+    setUp();
+    coap_tcp_decoder_feed(&dec, stream, stream_len);
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_tcp_decoder_next(&dec, &pkt, &available));
+    TEST_ASSERT_TRUE(available);
+    TEST_ASSERT_EQUAL_size_t(1000, pkt.payload.len);
+}
+
+void reserved_token_length_is_rejected(void)
+{
+    static const uint8_t msg[] = {0x09, 0x01};
+    coap_packet_t pkt;
+    bool available;
+    coap_tcp_decoder_feed(&dec, msg, sizeof(msg));
+    TEST_ASSERT_EQUAL(COAP_ERR_TOKEN_TOO_LONG, coap_tcp_decoder_next(&dec, &pkt, &available));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(every_length_encoding_round_trips);
+    RUN_TEST(minimal_messages);
+    RUN_TEST(websocket_format_has_no_length);
+    RUN_TEST(single_chunk_is_decoded_in_place);
+    RUN_TEST(every_chunk_size_gives_the_same_messages);
+    RUN_TEST(split_message_larger_than_buffer_is_rejected);
+    RUN_TEST(reserved_token_length_is_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "unity.h"
+#include "coap_uri.h"
+
+static uint8_t arena_buf[256];
+static coap_arena_t arena;
+static coap_packet_t pkt;
+static char uri_buf[128];
+
+void setUp(void)
+{
+    coap_arena_init(&arena, arena_buf, sizeof(arena_buf));
+    memset(&pkt, 0, sizeof(pkt));
+}
+
+void tearDown(void) {}
+
+static void assert_option(uint8_t index, coap_option_num_t num, const char *value)
+{
+    TEST_ASSERT_EQUAL_UINT8(num, pkt.opts[index].num);
+    TEST_ASSERT_EQUAL_size_t(strlen(value), pkt.opts[index].buf.len);
+    TEST_ASSERT_EQUAL_MEMORY(value, pkt.opts[index].buf.p, strlen(value));
+}
+
+static const char *to_uri(const char *default_host, bool secure)
+{
+    size_t len = sizeof(uri_buf);
+    if (COAP_ERR_NONE != coap_options_to_uri(&pkt, default_host, secure, uri_buf, &len) || len != strlen(uri_buf))
+        return "";
+    return uri_buf;
+}
+
+// http://tools.ietf.org/html/rfc7252#section-6.3
+void equivalent_uris_give_the_same_options(void)
+{
+    static const char *uris[] = {
+        "coap://example.com:5683/~sensors/temp.xml",
+        "coap://EXAMPLE.com/%7Esensors/temp.xml",
+        "coap://EXAMPLE.com:/%7esensors/temp.xml",
+    };
+    size_t i;
+    for (i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        setUp();
+        TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_uri_to_options(&pkt, &arena, uris[i], strlen(uris[i]), NULL));
+        TEST_ASSERT_EQUAL_UINT8(3, pkt.numopts);
+        assert_option(0, COAP_OPTION_URI_HOST, "example.com");
+        assert_option(1, COAP_OPTION_URI_PATH, "~sensors");
+        assert_option(2, COAP_OPTION_URI_PATH, "temp.xml");
+        TEST_ASSERT_EQUAL_STRING("coap://example.com/~sensors/temp.xml", to_uri(NULL, false));
+    }
+}
+
+void plain_components_reference_the_uri(void)
+{
+    static const char uri[] = "coap://host/a/b?x=1&y";
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_uri_to_options(&pkt, &arena, uri, strlen(uri), NULL));
+    TEST_ASSERT_EQUAL_UINT8(5, pkt.numopts);
+    assert_option(3, COAP_OPTION_URI_QUERY, "x=1");
+    assert_option(4, COAP_OPTION_URI_QUERY, "y");
+    TEST_ASSERT_EQUAL_PTR(uri + 7, pkt.opts[0].buf.p);
+    TEST_ASSERT_EQUAL_PTR(uri + 20, pkt.opts[4].buf.p);
+    TEST_ASSERT_EQUAL_size_t(0, arena.used);
+}
+
+void ip_literal_and_port(void)
+{
+    static const char uri[] = "coaps://[2001:db8::1]:61616/?q=%26";
+    bool secure = false;
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_uri_to_options(&pkt, &arena, uri, strlen(uri), &secure));
+    TEST_ASSERT_TRUE(secure);
+    TEST_ASSERT_EQUAL_UINT8(2, pkt.numopts);
+    TEST_ASSERT_EQUAL_UINT8(COAP_OPTION_URI_PORT, pkt.opts[0].num);
+    assert_option(1, COAP_OPTION_URI_QUERY, "q=&");
+    TEST_ASSERT_EQUAL_STRING("coaps://[2001:db8::1]:61616/?q=%26", to_uri("[2001:db8::1]", true));
+    TEST_ASSERT_EQUAL_STRING("/?q=%26", to_uri(NULL, true));
+}
+
+void ipv4_host_and_trailing_slash(void)
+{
+    static const char uri[] = "coap://192.0.2.1/a/";
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_uri_to_options(&pkt, &arena, uri, strlen(uri), NULL));
+    TEST_ASSERT_EQUAL_UINT8(2, pkt.numopts);
+    assert_option(0, COAP_OPTION_URI_PATH, "a");
+    assert_option(1, COAP_OPTION_URI_PATH, "");
+    TEST_ASSERT_EQUAL_STRING("coap://192.0.2.1/a/", to_uri("192.0.2.1", false));
+}
+
+void reserved_characters_are_encoded(void)
+{
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "a b/c");
+    coap_add_option_string(&pkt, COAP_OPTION_URI_QUERY, "k=v&w");
+    TEST_ASSERT_EQUAL_STRING("/a%20b%2Fc?k=v%26w", to_uri(NULL, false));
+}
+
+void invalid_uris_are_rejected(void)
+{
+    static const char *uris[] = {
+        "http://example.com/",
+        "coap://example.com/#frag",
+        "coap://example.com:99999/",
+        "coap://example.com:12a/",
+        "coap:///path",
+        "coap://example.com/%4",
+    };
+    size_t i;
+    for (i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        setUp();
+        TEST_ASSERT_EQUAL(COAP_ERR_URI_INVALID, coap_uri_to_options(&pkt, &arena, uris[i], strlen(uris[i]), NULL));
+    }
+}
+
+void port_out_of_range_is_rejected(void)
+{
+    static uint8_t too_large[3] = {0x01, 0x00, 0x00};
+    size_t len = sizeof(uri_buf);
+    coap_add_option_string(&pkt, COAP_OPTION_URI_HOST, "example.com");
+    coap_add_option(&pkt, COAP_OPTION_URI_PORT, too_large, sizeof(too_large));
+    TEST_ASSERT_EQUAL(COAP_ERR_URI_INVALID, coap_options_to_uri(&pkt, NULL, false, uri_buf, &len));
+}
+
+void small_buffer_is_reported(void)
+{
+    size_t len = 8;
+    coap_add_option_string(&pkt, COAP_OPTION_URI_PATH, "sensors");
+    TEST_ASSERT_EQUAL(COAP_ERR_BUFFER_TOO_SMALL, coap_options_to_uri(&pkt, NULL, false, uri_buf, &len));
+    len = 9;
+    TEST_ASSERT_EQUAL(COAP_ERR_NONE, coap_options_to_uri(&pkt, NULL, false, uri_buf, &len));
+    TEST_ASSERT_EQUAL_STRING("/sensors", uri_buf);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(equivalent_uris_give_the_same_options);
+    RUN_TEST(plain_components_reference_the_uri);
+    RUN_TEST(ip_literal_and_port);
+    RUN_TEST(ipv4_host_and_trailing_slash);
+    RUN_TEST(reserved_characters_are_encoded);
+    RUN_TEST(invalid_uris_are_rejected);
+    RUN_TEST(port_out_of_range_is_rejected);
+    RUN_TEST(small_buffer_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,666 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "coap.h"
+#include "coap_uri.h"
+
+/* Load generator for CoAP servers over UDP on loopback.
+ * Requests are generated from templates with weights (the mix), spread over many sockets (one source port each),
+ * in one of two modes:
+ *   closed loop  each socket keeps -n requests in flight, a completed request is replaced at once
+ *   open loop    -r requests per second in total on a fixed schedule, independent of the responses
+ * Latencies are recorded in HDR-style histograms (log buckets with linear sub-buckets, 0.1% precision).
+ * Coordinated omission: in open loop the response time is measured from the time a request was scheduled, so a
+ * stalled server is charged for every request it held back, even if it was sent late. In closed loop the requests
+ * a stall suppressed are filled in from the expected interval -e, like HdrHistogram's recordValueWithExpectedInterval.
+ * Service time (from the actual send) is reported as well. Responses with Block2 and the more flag set are followed
+ * until the last block, the latency of such a request covers all of its blocks.
+ *
+ * usage: coap_loadgen [options] host:port
+ *   -c sockets   UDP sockets (default 16)
+ *   -n requests  in flight per socket: closed loop (default 1), maximum for open loop (default 64)
+ *   -r rate      open loop with rate requests/s in total, closed loop without. Above 1000 requests/s the
+ *                sends are less than 1 ms apart and the generator polls, keeping one core busy.
+ *   -d seconds   duration of the measurement (default 10)
+ *   -w seconds   warm-up before the measurement, not recorded (default 1)
+ *   -T ms        time after which a request counts as lost (default 2000)
+ *   -e us        closed loop: expected interval between requests of one socket for coordinated omission correction
+ *   -t template  adds a template to the mix, repeatable (default "GET /"):
+ *                [weight*]METHOD /path[?query] [p=payload bytes] [ct=content format] [b2=szx] [non]
+ *                for example -t "9*GET /sensors/temp" -t "1*PUT /config p=512 ct=42" -t "GET /fw b2=6"
+ *   -S           also runs a built-in server on host:port, to check the setup and the ceiling of the generator
+ * Exits with 3 if no request completed.
+ */
+
+#define MAX_TEMPLATES 16
+#define MAX_SOCKETS 4096
+#define MAX_DATAGRAM 65535
+#define TOKEN_LEN 4
+#define MAX_EVENTS 256
+
+#define HIST_SUB_BITS 11                        // 2048 linear sub-buckets, 3 significant digits
+#define HIST_HALF (1U << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS 33                         // up to 2^43 ns, more than two hours
+#define HIST_SIZE ((HIST_BUCKETS + 1) * HIST_HALF)
+
+typedef struct
+{
+    uint64_t counts[HIST_SIZE];
+    uint64_t total;
+    uint64_t max;
+} histogram_t;
+
+typedef struct
+{
+    const char *spec;
+    uint32_t weight;
+    coap_packet_t pkt;                          // Token, message ID and Block2 are set per datagram
+    uint8_t arena_memory[256];
+    coap_arena_t arena;
+    uint8_t first[2048];                        // Built first datagram, token and ID are patched per send
+    size_t first_len;
+    int szx;                                    // Early Block2 negotiation, -1 for none
+} template_t;
+
+typedef struct
+{
+    uint64_t intended;                          // Scheduled start (open loop) or send time (closed loop)
+    uint64_t sent;                              // Send time of the first datagram
+    uint64_t deadline;                          // Loss deadline of the current datagram
+    uint16_t tmpl;
+    uint8_t gen;                                // Tells stale responses of a reused slot apart
+    bool busy;
+} slot_t;
+
+typedef struct
+{
+    int fd;
+    uint16_t next_id;
+    uint32_t first_slot;
+    uint32_t in_flight;
+    uint32_t free_hint;
+} socket_state_t;
+
+static template_t templates[MAX_TEMPLATES];
+static uint32_t num_templates, total_weight;
+static socket_state_t sockets[MAX_SOCKETS];
+static uint32_t num_sockets = 16, per_socket;
+static slot_t *slots;
+static uint8_t payload[MAX_DATAGRAM];
+static histogram_t response_time, service_time;
+
+static bool open_loop;
+static double rate;
+static uint64_t timeout_ns = 2000000000ULL, expected_interval_ns, record_from;
+static uint64_t completed, lost, late, blocks, stale, codes[8];
+static uint32_t rng = 0x12345678;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static size_t hist_index(uint64_t value)
+{
+    unsigned bucket = 63U - (unsigned)__builtin_clzll(value | ((1U << HIST_SUB_BITS) - 1)) - (HIST_SUB_BITS - 1);
+    if (bucket >= HIST_BUCKETS)
+        return HIST_SIZE - 1;
+    return ((size_t)bucket << (HIST_SUB_BITS - 1)) + (size_t)(value >> bucket);
+}
+
+// Highest value that falls into the same sub-bucket
+static uint64_t hist_value(size_t index)
+{
+    unsigned bucket;
+    if (index < 2 * HIST_HALF)
+        return index;
+    bucket = (unsigned)(index / HIST_HALF) - 1;
+    return (((uint64_t)(index - bucket * HIST_HALF) + 1) << bucket) - 1;
+}
+
+static void hist_record(histogram_t *h, uint64_t value)
+{
+    h->counts[hist_index(value)]++;
+    h->total++;
+    if (value > h->max)
+        h->max = value;
+}
+
+static void hist_record_corrected(histogram_t *h, uint64_t value, uint64_t expected_interval)
+{
+    uint64_t missing;
+    hist_record(h, value);
+    if (0 == expected_interval || value <= expected_interval)
+        return;
+    for (missing = value - expected_interval; missing >= expected_interval; missing -= expected_interval)
+        hist_record(h, missing);
+}
+
+static uint64_t hist_percentile(const histogram_t *h, double q)
+{
+    uint64_t rank = (uint64_t)(q * (double)h->total + 0.5), seen = 0;
+    size_t i;
+    if (0 == rank)
+        rank = 1;
+    for (i = 0; i < HIST_SIZE; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+            return (hist_value(i) < h->max) ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+static void hist_print(const char *name, const histogram_t *h)
+{
+    static const double q[] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+    size_t i;
+    printf("%-14s", name);
+    if (0 == h->total)
+    {
+        printf("no samples\n");
+        return;
+    }
+    for (i = 0; i < sizeof(q) / sizeof(q[0]); i++)
+        printf("  %9.1f", hist_percentile(h, q[i]) / 1e3);
+    printf("  %9.1f\n", h->max / 1e3);
+}
+
+static bool parse_template(template_t *t, const char *spec)
+{
+    static const char *methods[] = {"GET", "POST", "PUT", "DELETE"};
+    char method[8], uri[512], word[64];
+    const char *p = spec;
+    uint32_t payload_len = 0;
+    int ct = -1, n, i;
+    bool non = false;
+    char *end;
+
+    t->spec = spec;
+    t->weight = (uint32_t)strtoul(p, &end, 10);
+    if (end != p && '*' == *end)
+        p = end + 1;
+    else
+        t->weight = 1;
+    t->szx = -1;
+    n = 0;
+    if (1 != sscanf(p, "%7s %n", method, &n) || '/' != p[n])
+        return false;
+    p += n;
+    n = (int)strcspn(p, " ");
+    snprintf(uri, sizeof(uri), "coap://127.0.0.1%.*s", n, p);
+    p += n;
+    while (1 == sscanf(p, " %63s%n", word, &n))
+    {
+        p += n;
+        if (0 == strncmp(word, "p=", 2))
+            payload_len = (uint32_t)strtoul(word + 2, NULL, 10);
+        else if (0 == strncmp(word, "ct=", 3))
+            ct = atoi(word + 3);
+        else if (0 == strncmp(word, "b2=", 3))
+            t->szx = atoi(word + 3);
+        else if (0 == strcmp(word, "non"))
+            non = true;
+        else
+            return false;
+    }
+    if (payload_len > 1500 || t->szx > COAP_BLOCKSIZE_1024 || 0 == t->weight)
+        return false;
+
+    for (i = 0; i < 4; i++)
+        if (0 == strcmp(method, methods[i]))
+            break;
+    if (4 == i)
+        return false;
+    memset(&t->pkt, 0, sizeof(t->pkt));
+    coap_header_init(&t->pkt, non ? COAP_TYPE_NONCON : COAP_TYPE_CON, (coap_code_t)(COAP_GET + i), 0);
+    coap_arena_init(&t->arena, t->arena_memory, sizeof(t->arena_memory));
+    // the URI is temporary, so everything it references is copied
+    if (COAP_ERR_NONE != coap_uri_to_options(&t->pkt, &t->arena, uri, strlen(uri), NULL))
+        return false;
+    for (i = 0; i < t->pkt.numopts; i++)
+        if (t->pkt.opts[i].buf.p >= (const uint8_t *)uri && t->pkt.opts[i].buf.p < (const uint8_t *)uri + sizeof(uri))
+            t->pkt.opts[i].buf.p = coap_arena_dup(&t->arena, t->pkt.opts[i].buf.p, t->pkt.opts[i].buf.len);
+    if (ct >= 0)
+        coap_add_option_uint(&t->pkt, COAP_OPTION_CONTENT_FORMAT, (uint32_t)ct);
+    t->pkt.payload.p = payload;
+    t->pkt.payload.len = payload_len;
+    return true;
+}
+
+// Builds a request of template t, token and message ID are zero and patched per send
+static coap_error_t build_request(const template_t *t, uint32_t block, int szx, uint8_t *buf, size_t *len)
+{
+    static const uint8_t zero_token[TOKEN_LEN] = {0};
+    coap_packet_t pkt = t->pkt;
+    uint8_t block_option[3];
+
+    coap_header_add_token(&pkt, zero_token, TOKEN_LEN);
+    if (szx >= 0)
+        coap_add_option(&pkt, COAP_OPTION_BLOCK_2, block_option,
+            coap_make_option_blockwise(block_option, (coap_blocksize_t)szx, false, block));
+    return coap_build(buf, len, &pkt);
+}
+
+static void send_datagram(socket_state_t *s, uint32_t index, uint8_t *buf, size_t len)
+{
+    slot_t *slot = &slots[index];
+    uint32_t token = (index << 8) | slot->gen;
+    buf[2] = (uint8_t)(s->next_id >> 8);
+    buf[3] = (uint8_t)s->next_id;
+    s->next_id++;
+    buf[4] = (uint8_t)(token >> 24);
+    buf[5] = (uint8_t)(token >> 16);
+    buf[6] = (uint8_t)(token >> 8);
+    buf[7] = (uint8_t)token;
+    // a full socket buffer is a loss like any other, the deadline catches it
+    (void)send(s->fd, buf, len, 0);
+}
+
+static const template_t *pick_template(uint16_t *index)
+{
+    uint32_t r = next_random() % total_weight;
+    uint16_t i;
+    for (i = 0; r >= templates[i].weight; i++)
+        r -= templates[i].weight;
+    *index = i;
+    return &templates[i];
+}
+
+static void issue(socket_state_t *s, uint32_t index, uint64_t intended, uint64_t now)
+{
+    static uint8_t buf[MAX_DATAGRAM];
+    slot_t *slot = &slots[index];
+    const template_t *t = pick_template(&slot->tmpl);
+
+    slot->busy = true;
+    slot->gen++;
+    slot->intended = intended;
+    slot->sent = now;
+    slot->deadline = now + timeout_ns;
+    s->in_flight++;
+    memcpy(buf, t->first, t->first_len);
+    send_datagram(s, index, buf, t->first_len);
+}
+
+static void release(socket_state_t *s, uint32_t index)
+{
+    slots[index].busy = false;
+    s->in_flight--;
+    s->free_hint = index - s->first_slot;
+}
+
+static int free_slot(socket_state_t *s)
+{
+    uint32_t i;
+    if (s->in_flight >= per_socket)
+        return -1;
+    for (i = 0; i < per_socket; i++)
+    {
+        uint32_t index = s->first_slot + (s->free_hint + i) % per_socket;
+        if (!slots[index].busy)
+            return (int)index;
+    }
+    return -1;
+}
+
+static void complete(socket_state_t *s, uint32_t index, uint8_t code, uint64_t now)
+{
+    slot_t *slot = &slots[index];
+
+    if (slot->intended >= record_from)
+    {
+        completed++;
+        codes[code >> 5]++;
+        if (open_loop)
+            hist_record(&response_time, now - slot->intended);
+        else
+            hist_record_corrected(&response_time, now - slot->intended, expected_interval_ns);
+        hist_record(&service_time, now - slot->sent);
+    }
+    release(s, index);
+    if (!open_loop)
+        issue(s, index, now, now);
+}
+
+static void receive(socket_state_t *s, uint64_t now)
+{
+    static uint8_t buf[MAX_DATAGRAM], out[MAX_DATAGRAM];
+    coap_packet_t pkt;
+    const coap_option_t *block;
+    uint32_t token, index;
+    uint8_t count;
+    ssize_t len;
+
+    while ((len = recv(s->fd, buf, sizeof(buf), 0)) >= 0)
+    {
+        if (0 != coap_parse(&pkt, buf, (size_t)len) || TOKEN_LEN != pkt.tok.len)
+            continue;   // malformed, or an empty ACK of a separate response
+        if (COAP_TYPE_CON == pkt.hdr.t)
+        {
+            // separate response, acknowledge it
+            const uint8_t ack[4] = {0x60, 0, buf[2], buf[3]};
+            (void)send(s->fd, ack, sizeof(ack), 0);
+        }
+        token = ((uint32_t)pkt.tok.p[0] << 24) | ((uint32_t)pkt.tok.p[1] << 16) | ((uint32_t)pkt.tok.p[2] << 8) | pkt.tok.p[3];
+        index = token >> 8;
+        if (index < s->first_slot || index >= s->first_slot + per_socket || !slots[index].busy || (uint8_t)token != slots[index].gen)
+        {
+            stale++;    // answer after the deadline, or a duplicate
+            continue;
+        }
+
+        block = coap_findOptions(&pkt, COAP_OPTION_BLOCK_2, &count);
+        if (COAP_CONTENT == pkt.hdr.code && NULL != block && block->buf.len <= 3 && coap_option_blockwise_get_m(block))
+        {
+            // http://tools.ietf.org/html/rfc7959#section-2.4
+            size_t outlen = sizeof(out);
+            if (COAP_ERR_NONE == build_request(&templates[slots[index].tmpl], coap_option_blockwise_get_num(block) + 1,
+                (int)coap_option_blockwise_get_szx(block), out, &outlen))
+            {
+                slots[index].deadline = now + timeout_ns;
+                blocks += (slots[index].intended >= record_from);
+                send_datagram(s, index, out, outlen);
+                continue;
+            }
+        }
+        complete(s, index, pkt.hdr.code, now);
+    }
+}
+
+static void expire(uint64_t now)
+{
+    uint32_t i, j;
+    for (i = 0; i < num_sockets; i++)
+    {
+        for (j = sockets[i].first_slot; j < sockets[i].first_slot + per_socket; j++)
+        {
+            if (!slots[j].busy || (int64_t)(now - slots[j].deadline) < 0)
+                continue;
+            if (slots[j].intended >= record_from)
+                lost++;
+            release(&sockets[i], j);
+            if (!open_loop)
+                issue(&sockets[i], j, now, now);
+        }
+    }
+}
+
+static bool resolve(const char *target, struct addrinfo **ai)
+{
+    char host[256];
+    const char *colon = strrchr(target, ':');
+    struct addrinfo hints;
+
+    if (NULL == colon || (size_t)(colon - target) >= sizeof(host))
+        return false;
+    memcpy(host, target, (size_t)(colon - target));
+    host[colon - target] = '\0';
+    // [::1]:5683
+    if ('[' == host[0] && ']' == host[strlen(host) - 1])
+    {
+        memmove(host, host + 1, strlen(host));
+        host[strlen(host) - 1] = '\0';
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    return 0 == getaddrinfo(host, colon + 1, &hints, ai);
+}
+
+/* Built-in server for -S. GET returns 32 bytes, or with Block2 the blocks of a 2048 byte resource, any other method
+ * returns 2.04. */
+
+static atomic_bool server_stop;
+
+static void *serve(void *arg)
+{
+    static uint8_t body[2048];
+    struct addrinfo *ai = arg;
+    uint8_t buf[MAX_DATAGRAM], out[MAX_DATAGRAM];
+    struct sockaddr_storage from;
+    struct timeval tv = {0, 100000};
+    int fd = socket(ai->ai_family, SOCK_DGRAM, 0);
+
+    memset(body, 'b', sizeof(body));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (fd < 0 || 0 != bind(fd, ai->ai_addr, ai->ai_addrlen))
+    {
+        fprintf(stderr, "cannot bind the built-in server\n");
+        exit(1);
+    }
+    while (!atomic_load(&server_stop))
+    {
+        socklen_t fromlen = sizeof(from);
+        ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+        coap_packet_t req, rsp;
+        const coap_option_t *block;
+        uint8_t block_option[3], count;
+        size_t outlen = sizeof(out);
+
+        if (len < 0 || 0 != coap_parse(&req, buf, (size_t)len) || COAP_EMPTY == req.hdr.code || req.hdr.code > COAP_LASTMETHOD)
+            continue;
+        if (COAP_GET != req.hdr.code)
+            coap_make_response(&rsp, NULL, 0, req.hdr.id, &req.tok, COAP_CHANGED, COAP_CONTENTTYPE_NONE);
+        else if (NULL != (block = coap_findOptions(&req, COAP_OPTION_BLOCK_2, &count)) && block->buf.len <= 3)
+        {
+            size_t size = (size_t)16 << coap_option_blockwise_get_szx(block);
+            size_t offset = coap_option_blockwise_get_num(block) * size;
+            if (offset >= sizeof(body))
+                offset = sizeof(body) - size;
+            coap_make_response(&rsp, body + offset, size, req.hdr.id, &req.tok, COAP_CONTENT, COAP_CONTENTTYPE_TEXT_PLAIN);
+            coap_add_option(&rsp, COAP_OPTION_BLOCK_2, block_option, coap_make_option_blockwise(block_option,
+                coap_option_blockwise_get_szx(block), offset + size < sizeof(body), (uint32_t)(offset / size)));
+        }
+        else
+            coap_make_response(&rsp, body, 32, req.hdr.id, &req.tok, COAP_CONTENT, COAP_CONTENTTYPE_TEXT_PLAIN);
+        if (COAP_TYPE_NONCON == req.hdr.t)
+            rsp.hdr.t = COAP_TYPE_NONCON;
+        if (COAP_ERR_NONE == coap_build(out, &outlen, &rsp))
+            (void)sendto(fd, out, outlen, 0, (struct sockaddr *)&from, fromlen);
+    }
+    close(fd);
+    return NULL;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-c sockets] [-n in flight] [-r rate] [-d s] [-w s] [-T ms] [-e us] [-t template]... [-S] host:port\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct addrinfo *ai;
+    pthread_t server;
+    bool builtin = false;
+    double duration = 10, warmup = 1, elapsed;
+    uint64_t start, end, now, next_expire, scheduled = 0, next_intended;
+    uint32_t i, rr = 0;
+    int ep, opt;
+
+    while ((opt = getopt(argc, argv, "c:n:r:d:w:T:e:t:S")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': num_sockets = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'n': per_socket = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r': rate = atof(optarg); open_loop = true; break;
+        case 'd': duration = atof(optarg); break;
+        case 'w': warmup = atof(optarg); break;
+        case 'T': timeout_ns = strtoull(optarg, NULL, 10) * 1000000ULL; break;
+        case 'e': expected_interval_ns = strtoull(optarg, NULL, 10) * 1000ULL; break;
+        case 't':
+            if (num_templates == MAX_TEMPLATES || !parse_template(&templates[num_templates], optarg))
+            {
+                fprintf(stderr, "invalid template: %s\n", optarg);
+                return 2;
+            }
+            total_weight += templates[num_templates++].weight;
+            break;
+        case 'S': builtin = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || 0 == num_sockets || num_sockets > MAX_SOCKETS || duration <= 0 || (open_loop && rate <= 0))
+        usage(argv[0]);
+    if (0 == per_socket)
+        per_socket = open_loop ? 64 : 1;
+    if (per_socket > (1U << 24) / num_sockets)
+        usage(argv[0]);
+    if (0 == num_templates)
+    {
+        parse_template(&templates[0], "GET /");
+        total_weight = templates[num_templates++].weight;
+    }
+    memset(payload, 'p', sizeof(payload));
+    for (i = 0; i < num_templates; i++)
+    {
+        templates[i].first_len = sizeof(templates[i].first);
+        if (COAP_ERR_NONE != build_request(&templates[i], 0, templates[i].szx, templates[i].first, &templates[i].first_len))
+        {
+            fprintf(stderr, "template too large: %s\n", templates[i].spec);
+            return 2;
+        }
+    }
+    if (!resolve(argv[optind], &ai))
+    {
+        fprintf(stderr, "cannot resolve %s\n", argv[optind]);
+        return 1;
+    }
+    if (builtin)
+    {
+        pthread_create(&server, NULL, serve, ai);
+        usleep(100000);
+    }
+
+    if (NULL == (slots = calloc((size_t)num_sockets * per_socket, sizeof(slot_t))))
+    {
+        fprintf(stderr, "no memory for %u sockets with %u requests in flight each\n", num_sockets, per_socket);
+        return 1;
+    }
+    ep = epoll_create1(0);
+    for (i = 0; i < num_sockets; i++)
+    {
+        struct epoll_event ev;
+        int size = 1 << 20;
+        sockets[i].fd = socket(ai->ai_family, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (sockets[i].fd < 0 || 0 != connect(sockets[i].fd, ai->ai_addr, ai->ai_addrlen))
+        {
+            fprintf(stderr, "cannot open socket %u: %s\n", i, strerror(errno));
+            return 1;
+        }
+        setsockopt(sockets[i].fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        sockets[i].next_id = (uint16_t)next_random();
+        sockets[i].first_slot = i * per_socket;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, sockets[i].fd, &ev);
+    }
+
+    start = now_ns();
+    record_from = start + (uint64_t)(warmup * 1e9);
+    end = record_from + (uint64_t)(duration * 1e9);
+    next_intended = start;
+    next_expire = start + 10000000ULL;
+    if (!open_loop)
+        for (i = 0; i < num_sockets * per_socket; i++)
+            issue(&sockets[i / per_socket], i, start, start);
+
+    for (now = start; now < end; now = now_ns())
+    {
+        int n, e, timeout = 1;
+        if (open_loop)
+        {
+            // requests are sent late rather than skipped while all slots are busy, they keep their scheduled time
+            while (next_intended <= now)
+            {
+                int index = -1;
+                for (i = 0; i < num_sockets && index < 0; i++)
+                    index = free_slot(&sockets[rr = (rr + 1) % num_sockets]);
+                if (index < 0)
+                    break;
+                if (now - next_intended > 1000000ULL && next_intended >= record_from)
+                    late++;
+                issue(&sockets[rr], (uint32_t)index, next_intended, now);
+                next_intended = start + (uint64_t)((double)++scheduled * 1e9 / rate);
+            }
+        }
+        // open loop sleeps until the next send is due, gaps below 1 ms are polled as epoll_wait() counts in ms.
+        // With all slots busy it waits for a response like closed loop.
+        if (open_loop && next_intended > now)
+        {
+            uint64_t until = (next_expire < next_intended) ? next_expire : next_intended;
+            timeout = (until > now) ? (int)((until - now) / 1000000ULL) : 0;
+        }
+        n = epoll_wait(ep, events, MAX_EVENTS, timeout);
+        now = now_ns();
+        for (e = 0; e < n; e++)
+            receive(&sockets[events[e].data.u32], now);
+        if (now >= next_expire)
+        {
+            expire(now);
+            next_expire = now + 10000000ULL;
+        }
+    }
+    elapsed = (double)(now - record_from) / 1e9;
+
+    printf("%s: %u sockets, %s, %u templates\n", argv[optind], num_sockets,
+        open_loop ? "open loop" : "closed loop", num_templates);
+    if (open_loop)
+        printf("target      %.0f req/s, %u in flight per socket at most\n", rate, per_socket);
+    else
+        printf("in flight   %u per socket\n", per_socket);
+    printf("throughput  %.0f req/s, %llu completed, %llu lost, %llu stale, %llu Block2 follow-ups\n",
+        (double)completed / elapsed, (unsigned long long)completed, (unsigned long long)lost,
+        (unsigned long long)stale, (unsigned long long)blocks);
+    printf("codes       2.xx %llu  4.xx %llu  5.xx %llu\n", (unsigned long long)codes[2],
+        (unsigned long long)codes[4], (unsigned long long)codes[5]);
+    if (open_loop)
+    {
+        // an overloaded server holds back the schedule, requests it never let through are no better than lost
+        uint64_t due = (uint64_t)((double)(end - start) / 1e9 * rate);
+        printf("late sends  %llu more than 1 ms behind schedule, %llu never sent\n", (unsigned long long)late,
+            (unsigned long long)((due > scheduled) ? due - scheduled : 0));
+    }
+    printf("latency us          p50        p90        p99      p99.9     p99.99        max\n");
+    hist_print((open_loop || expected_interval_ns) ? "response time" : "response", &response_time);
+    hist_print("service time", &service_time);
+
+    if (builtin)
+    {
+        atomic_store(&server_stop, true);
+        pthread_join(server, NULL);
+    }
+    for (i = 0; i < num_sockets; i++)
+        close(sockets[i].fd);
+    close(ep);
+    free(slots);
+    freeaddrinfo(ai);
+    return (0 == completed) ? 3 : 0;
+}
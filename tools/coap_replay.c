@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "coap.h"
+
+/* Replays the UDP payloads of a pcap or pcapng capture through the codec:
+ * coap_parse, coap_findOptions for the options a dispatcher looks at, and coap_build back into a buffer.
+ * Reports latency percentiles of the round trip, errors per coap_error_t and whether the rebuilt datagram equals
+ * the captured one.
+ *
+ * usage: coap_replay [-n iterations] [-a] capture
+ *   -n  replay the capture n times (default 100)
+ *   -a  take UDP payloads of any port, by default only port 5683 is replayed
+ * Exits with 3 if a datagram does not survive the round trip byte for byte.
+ */
+
+#define MAX_MESSAGES 1000000
+#define MAX_DATAGRAM 65535
+#define NUM_ERRORS 32
+
+typedef struct
+{
+    const uint8_t *p;
+    size_t len;
+} message_t;
+
+static message_t *messages;
+static size_t num_messages;
+static bool any_port;
+
+static const char *error_names[NUM_ERRORS] = {
+    "NONE", "HEADER_TOO_SHORT", "VERSION_NOT_1", "TOKEN_TOO_SHORT", "OPTION_TOO_SHORT_FOR_HEADER",
+    "OPTION_TOO_SHORT", "OPTION_OVERRUNS_PACKET", "OPTION_TOO_BIG", "OPTION_LEN_INVALID", "BUFFER_TOO_SMALL",
+    "UNSUPPORTED", "OPTION_DELTA_INVALID", "TOKEN_LENGTH_MISMATCH", "TOKEN_TOO_LONG", "CBOR_INVALID",
+    "LINKFORMAT_INVALID", "URI_INVALID", "FRAME_LENGTH_MISMATCH",
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint16_t load16(const uint8_t *p, bool swap)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? (uint16_t)((v >> 8) | (v << 8)) : v;
+}
+
+static uint32_t load32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t load_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void add_udp(const uint8_t *p, size_t len)
+{
+    size_t udp_len;
+    if (len < 8)
+        return;
+    if (!any_port && load_be16(p) != 5683 && load_be16(p + 2) != 5683)
+        return;
+    udp_len = load_be16(p + 4);
+    if (udp_len < 8 || udp_len > len)
+        return;     // truncated by the snap length
+    if (num_messages < MAX_MESSAGES)
+    {
+        messages[num_messages].p = p + 8;
+        messages[num_messages].len = udp_len - 8;
+        num_messages++;
+    }
+}
+
+static void add_ip(const uint8_t *p, size_t len)
+{
+    if (len < 1)
+        return;
+    if ((p[0] >> 4) == 4)
+    {
+        size_t ihl = (p[0] & 0x0F) * 4U;
+        if (len < 20 || ihl < 20 || len < ihl || p[9] != 17)
+            return;
+        if ((load_be16(p + 6) & 0x3FFF) != 0)
+            return;     // fragment
+        add_udp(p + ihl, len - ihl);
+    }
+    else if ((p[0] >> 4) == 6)
+    {
+        if (len < 40 || p[6] != 17)
+            return;     // extension headers are not followed
+        add_udp(p + 40, len - 40);
+    }
+}
+
+// http://www.tcpdump.org/linktypes.html
+static void add_frame(uint32_t linktype, const uint8_t *p, size_t len)
+{
+    switch (linktype)
+    {
+    case 0:     // BSD loopback, 4 byte address family
+        if (len >= 4)
+            add_ip(p + 4, len - 4);
+        break;
+    case 1:     // Ethernet, with optional 802.1Q tags
+    {
+        size_t off = 12;
+        while (len >= off + 2 && (load_be16(p + off) == 0x8100 || load_be16(p + off) == 0x88A8))
+            off += 4;
+        if (len >= off + 2 && (load_be16(p + off) == 0x0800 || load_be16(p + off) == 0x86DD))
+            add_ip(p + off + 2, len - off - 2);
+        break;
+    }
+    case 101:   // raw IP
+    case 228:   // IPv4
+    case 229:   // IPv6
+        add_ip(p, len);
+        break;
+    case 113:   // Linux cooked
+        if (len >= 16)
+            add_ip(p + 16, len - 16);
+        break;
+    case 276:   // Linux cooked v2
+        if (len >= 20)
+            add_ip(p + 20, len - 20);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool read_pcap(const uint8_t *p, size_t len)
+{
+    uint32_t magic = load32(p, false);
+    bool swap = (magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1);
+    uint32_t linktype = load32(p + 20, swap) & 0xFFFF;
+    size_t off = 24;
+
+    while (off + 16 <= len)
+    {
+        uint32_t caplen = load32(p + off + 8, swap);
+        if (caplen > len - off - 16)
+            break;
+        add_frame(linktype, p + off + 16, caplen);
+        off += 16 + caplen;
+    }
+    return true;
+}
+
+// https://datatracker.ietf.org/doc/draft-ietf-opsawg-pcapng/
+static bool read_pcapng(const uint8_t *p, size_t len)
+{
+    uint32_t linktypes[64];
+    size_t num_interfaces = 0;
+    size_t off = 0;
+    bool swap = false;
+
+    while (off + 12 <= len)
+    {
+        uint32_t type, block_len;
+        if (load32(p + off, false) == 0x0A0D0D0A)
+        {
+            swap = load32(p + off + 8, false) != 0x1A2B3C4D;
+            num_interfaces = 0;
+        }
+        type = load32(p + off, swap);
+        block_len = load32(p + off + 4, swap);
+        if (block_len < 12 || block_len > len - off)
+            return false;
+        if (type == 1 && num_interfaces < 64 && block_len >= 20)
+            linktypes[num_interfaces++] = load16(p + off + 8, swap);
+        else if (type == 6 && block_len >= 32)
+        {
+            uint32_t iface = load32(p + off + 8, swap);
+            uint32_t caplen = load32(p + off + 20, swap);
+            if (iface < num_interfaces && caplen <= block_len - 32)
+                add_frame(linktypes[iface], p + off + 28, caplen);
+        }
+        else if (type == 3 && block_len >= 16 && num_interfaces > 0)
+        {
+            uint32_t origlen = load32(p + off + 8, swap);
+            uint32_t caplen = block_len - 16;
+            add_frame(linktypes[0], p + off + 12, (origlen < caplen) ? origlen : caplen);
+        }
+        off += block_len;
+    }
+    return true;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t n, double q)
+{
+    size_t i = (size_t)(q * (double)(n - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t out[MAX_DATAGRAM];
+    unsigned long iterations = 100, it;
+    uint64_t parse_errors[NUM_ERRORS] = {0}, build_errors[NUM_ERRORS] = {0};
+    uint64_t *latencies, total_ns = 0, bytes = 0, found = 0;
+    size_t equal = 0, different = 0, i, n = 0;
+    const uint8_t *file;
+    struct stat st;
+    int fd, opt;
+
+    while ((opt = getopt(argc, argv, "n:a")) != -1)
+    {
+        if (opt == 'n')
+            iterations = strtoul(optarg, NULL, 10);
+        else if (opt == 'a')
+            any_port = true;
+        else
+            break;
+    }
+    if (optind != argc - 1 || 0 == iterations)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [-a] capture\n", argv[0]);
+        return 2;
+    }
+
+    if ((fd = open(argv[optind], O_RDONLY)) < 0 || fstat(fd, &st) < 0 || st.st_size < 24)
+    {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    file = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == file)
+    {
+        fprintf(stderr, "cannot map %s\n", argv[optind]);
+        return 1;
+    }
+    if (NULL == (messages = malloc(MAX_MESSAGES * sizeof(message_t))))
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (load32(file, false) == 0x0A0D0D0A)
+        read_pcapng(file, (size_t)st.st_size);
+    else
+    {
+        uint32_t magic = load32(file, false);
+        if (magic != 0xA1B2C3D4 && magic != 0xD4C3B2A1 && magic != 0xA1B23C4D && magic != 0x4D3CB2A1)
+        {
+            fprintf(stderr, "%s is neither pcap nor pcapng\n", argv[optind]);
+            return 1;
+        }
+        read_pcap(file, (size_t)st.st_size);
+    }
+    if (0 == num_messages)
+    {
+        fprintf(stderr, "no UDP payloads found%s\n", any_port ? "" : " on port 5683, try -a");
+        return 1;
+    }
+
+    // one latency per parse, all are kept for exact percentiles
+    if (iterations > SIZE_MAX / sizeof(uint64_t) / num_messages
+        || NULL == (latencies = malloc(num_messages * iterations * sizeof(uint64_t))))
+    {
+        fprintf(stderr, "no memory for the latencies of %zu messages times %lu iterations, lower -n\n", num_messages, iterations);
+        return 1;
+    }
+    for (it = 0; it < iterations; it++)
+    {
+        for (i = 0; i < num_messages; i++)
+        {
+            coap_packet_t pkt;
+            size_t outlen = sizeof(out);
+            uint8_t count;
+            int rc;
+            coap_error_t err = COAP_ERR_NONE;
+            uint64_t start = now_ns(), elapsed;
+
+            rc = coap_parse(&pkt, messages[i].p, messages[i].len);
+            if (0 == rc)
+            {
+                found += (NULL != coap_findOptions(&pkt, COAP_OPTION_URI_PATH, &count));
+                found += (NULL != coap_findOptions(&pkt, COAP_OPTION_CONTENT_FORMAT, &count));
+                found += (NULL != coap_findOptions(&pkt, COAP_OPTION_BLOCK_2, &count));
+                err = coap_build(out, &outlen, &pkt);
+            }
+            elapsed = now_ns() - start;
+            latencies[n++] = elapsed;
+            total_ns += elapsed;
+            bytes += messages[i].len;
+
+            if (0 != rc)
+                parse_errors[(rc < NUM_ERRORS) ? rc : NUM_ERRORS - 1]++;
+            else if (COAP_ERR_NONE != err)
+                build_errors[(err < NUM_ERRORS) ? err : NUM_ERRORS - 1]++;
+            else if (0 == it)
+            {
+                if (outlen == messages[i].len && 0 == memcmp(out, messages[i].p, outlen))
+                    equal++;
+                else
+                    different++;
+            }
+        }
+    }
+
+    qsort(latencies, n, sizeof(uint64_t), compare_u64);
+    printf("%s: %zu messages, %lu iterations\n", argv[optind], num_messages, iterations);
+    printf("throughput  %.0f msg/s, %.1f MB/s\n", n * 1e9 / (double)total_ns, bytes * 1e3 / (double)total_ns);
+    printf("latency ns  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+           (unsigned long long)percentile(latencies, n, 0.5), (unsigned long long)percentile(latencies, n, 0.9),
+           (unsigned long long)percentile(latencies, n, 0.99), (unsigned long long)percentile(latencies, n, 0.999),
+           (unsigned long long)latencies[n - 1]);
+    printf("round trip  %zu equal, %zu different\n", equal, different);
+    for (i = 1; i < NUM_ERRORS; i++)
+    {
+        if (parse_errors[i] > 0)
+            printf("parse error %-28s %llu\n", error_names[i] ? error_names[i] : "?", (unsigned long long)(parse_errors[i] / iterations));
+        if (build_errors[i] > 0)
+            printf("build error %-28s %llu\n", error_names[i] ? error_names[i] : "?", (unsigned long long)(build_errors[i] / iterations));
+    }
+    if (0 == found)
+        printf("no Uri-Path, Content-Format or Block2 option seen\n");
+
+    free(latencies);
+    free(messages);
+    munmap((void *)file, (size_t)st.st_size);
+    close(fd);
+    return (different > 0) ? 3 : 0;
+}